@@ -411,8 +411,12 @@ namespace TJoy
           vJoy.SetDevButton(Handle, ev.targetId, false);
           break;
         case ButtonAction.Click:
+#if USE_VGEN
+          vJoy.PulseDevButton(Handle, ev.targetId, C.BUTTON_CLICK_WAIT_MS);
+#else
           vJoy.SetDevButton(Handle, ev.targetId, true);
           VJoyReleaseButtonLater(ev.type, ev.targetId);
+#endif
           break;
         default:
           if (ev.value == 0 || ev.value == 1)
@@ -432,8 +436,12 @@ namespace TJoy
           //_vjoy.SetDiscPov((int)DPovDirection.Center, ev.devId, ev.targetId);
           break;
         case ButtonAction.Click:
+#if USE_VGEN
+          vJoy.PulseDevDiscPov(Handle, (byte)ev.targetId, (DPOV_DIRECTION)ev.dpovDir, C.BUTTON_CLICK_WAIT_MS);
+#else
           vJoy.SetDevDiscPov(Handle, (byte)ev.targetId, (DPOV_DIRECTION)ev.dpovDir);
           VJoyReleaseButtonLater(ev.type, ev.targetId);
+#endif
           break;
         default:
           if (ev.value > -2 && ev.value < 4)
@@ -453,6 +461,8 @@ namespace TJoy
       vJoy.SetDevAxis(Handle, ev.axis, ev.value);
     }
 
+#if !USE_VGEN
+    // vGen releases clicks itself, see PulseDevButton()
     private void VJoyReleaseButtonLater(ControlType evtype, uint targetId)
     {
       System.Threading.Tasks.Task.Run(async delegate {
@@ -463,6 +473,7 @@ namespace TJoy
           vJoy.SetDevDiscPov(Handle, (byte)targetId, DPOV_DIRECTION.DPOV_Center);
       });
     }
+#endif
 
   #endregion
 
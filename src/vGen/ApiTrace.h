@@ -0,0 +1,172 @@
+//////////////////////////////////////////////////////////
+//
+// API call trace (StartTrace/StopTrace)
+//
+// File layout: a TraceFileHeader followed by DataBytes of
+// records. Each record is
+//   BYTE    Api          vGenNS::PerfApi, or TRACE_API_DROPPED
+//   varint  TimeDelta    zigzag, ns since the previous record (first: since the trace started)
+// and, for an API record,
+//   varint  DurationNs
+//   varint  Thread       1-based index of the calling thread. 0: AcquireDev records that StartTrace() writes first,
+//                        for the devices that were already acquired.
+//   varint  hDev         device handle (AcquireDev: the handle it returned)
+//   varint  Arg          button, axis or POV number (AcquireDev: device ID)
+//   varint  Value        zigzag. Button state, axis/POV value, SetDevAxisPct: the float's bits (AcquireDev: device type)
+//   varint  Status       return value
+// or, for TRACE_API_DROPPED,
+//   varint  Count        records lost because the queue was full
+// Varints are 7 bits per byte, least significant first, high bit set on all but the last byte.
+//
+//////////////////////////////////////////////////////////
+#pragma once
+
+#include <atomic>
+#include <cstring>
+#include <vector>
+
+#include "vGenInterface.h"
+
+#define TRACE_MAGIC         "VGTR"
+#define TRACE_VERSION       1
+#define TRACE_API_DROPPED   0xFF
+#define TRACE_MAX_RECORD    (1 + 7 * 10)  // Longest encoding of one record: Api and at most 7 varints
+
+#pragma pack(push, 1)
+struct TraceFileHeader
+{
+	char Magic[4];             // TRACE_MAGIC
+	DWORD Version;             // TRACE_VERSION
+	ULONGLONG StartTime;       // Wall clock when the trace started, as FILETIME (100ns units since 1601-01-01 UTC)
+	ULONGLONG DataBytes;       // Valid bytes after the header. Kept up to date while recording, so a trace cut short is still readable.
+	ULONGLONG Dropped;         // Total of all TRACE_API_DROPPED records
+};
+#pragma pack(pop)
+
+// One API call, as queued by the calling thread and as decoded from a file.
+struct TraceRecord
+{
+	ULONGLONG TimeNs;   // Queued: steady clock. Decoded: since the trace started.
+	DWORD DurationNs;
+	DWORD Status;
+	HDEVICE hDev;
+	UINT Arg;
+	LONG Value;
+	UINT Thread;
+	BYTE Api;
+};
+
+extern std::atomic_bool g_traceEnabled;
+
+void Trace_Record(vGenNS::PerfApi api, ULONGLONG startNs, ULONGLONG durationNs, HDEVICE hDev, UINT arg, LONG value, DWORD result);
+DWORD Trace_Start(const char * fileName);
+DWORD Trace_Stop(void);
+// Reads a whole trace file. Returns STATUS_NO_SUCH_FILE if it can't be opened.
+DWORD Trace_ReadFile(const char * fileName, std::vector<BYTE> & data);
+DWORD Replay_Run(const char * fileName, FLOAT speed, vGenNS::ReplayStats & stats);
+
+inline LONG Trace_FloatBits(FLOAT value)
+{
+	LONG bits;
+	memcpy(&bits, &value, sizeof(bits));
+	return bits;
+}
+
+inline FLOAT Trace_BitsFloat(LONG bits)
+{
+	FLOAT value;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+inline BYTE * Trace_PutVarint(BYTE * p, ULONGLONG value)
+{
+	while (value >= 0x80) {
+		*p++ = (BYTE)(value | 0x80);
+		value >>= 7;
+	}
+	*p++ = (BYTE)value;
+	return p;
+}
+
+inline BYTE * Trace_PutSigned(BYTE * p, LONGLONG value)
+{
+	return Trace_PutVarint(p, ((ULONGLONG)value << 1) ^ (ULONGLONG)(value >> 63));
+}
+
+// Returns false at the end of the data or on a truncated varint
+inline bool Trace_GetVarint(const BYTE *& p, const BYTE * end, ULONGLONG & value)
+{
+	value = 0;
+	for (UINT shift = 0; p < end && shift < 64; shift += 7) {
+		const BYTE b = *p++;
+		value |= (ULONGLONG)(b & 0x7F) << shift;
+		if (!(b & 0x80))
+			return true;
+	}
+	return false;
+}
+
+inline bool Trace_GetSigned(const BYTE *& p, const BYTE * end, LONGLONG & value)
+{
+	ULONGLONG raw;
+	if (!Trace_GetVarint(p, end, raw))
+		return false;
+	value = (LONGLONG)(raw >> 1) ^ -(LONGLONG)(raw & 1);
+	return true;
+}
+
+// Encodes `rec` at `p` (which must have TRACE_MAX_RECORD bytes available) and returns the end.
+// `prevNs` is the time of the previous record and is advanced.
+inline BYTE * Trace_Encode(BYTE * p, const TraceRecord & rec, ULONGLONG & prevNs)
+{
+	*p++ = rec.Api;
+	p = Trace_PutSigned(p, (LONGLONG)(rec.TimeNs - prevNs));
+	prevNs = rec.TimeNs;
+	if (rec.Api == TRACE_API_DROPPED)
+		return Trace_PutVarint(p, (DWORD)rec.Value);
+
+	p = Trace_PutVarint(p, rec.DurationNs);
+	p = Trace_PutVarint(p, rec.Thread);
+	p = Trace_PutVarint(p, (UINT)rec.hDev);
+	p = Trace_PutVarint(p, rec.Arg);
+	p = Trace_PutSigned(p, rec.Value);
+	return Trace_PutVarint(p, rec.Status);
+}
+
+// Decodes the record at `p` and advances it. Returns false at the end of the data or on a malformed record.
+// `prevNs` is the time of the previous record (0 before the first one) and is advanced.
+inline bool Trace_Decode(const BYTE *& p, const BYTE * end, TraceRecord & rec, ULONGLONG & prevNs)
+{
+	if (p >= end)
+		return false;
+
+	rec = TraceRecord();
+	rec.Api = *p++;
+	LONGLONG delta, value;
+	ULONGLONG duration, thread, hDev, arg, status;
+	if (!Trace_GetSigned(p, end, delta))
+		return false;
+	rec.TimeNs = prevNs += delta;
+
+	if (rec.Api == TRACE_API_DROPPED) {
+		ULONGLONG count;
+		if (!Trace_GetVarint(p, end, count))
+			return false;
+		rec.Value = (LONG)count;
+		return true;
+	}
+
+	if (rec.Api >= vGenNS::PerfApiCount || !Trace_GetVarint(p, end, duration) || !Trace_GetVarint(p, end, thread) ||
+		!Trace_GetVarint(p, end, hDev) || !Trace_GetVarint(p, end, arg) || !Trace_GetSigned(p, end, value) ||
+		!Trace_GetVarint(p, end, status))
+		return false;
+
+	rec.DurationNs = (DWORD)duration;
+	rec.Thread = (UINT)thread;
+	rec.hDev = (HDEVICE)hDev;
+	rec.Arg = (UINT)arg;
+	rec.Value = (LONG)value;
+	rec.Status = (DWORD)status;
+	return true;
+}
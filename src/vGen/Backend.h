@@ -0,0 +1,120 @@
+//////////////////////////////////////////////////////////
+//
+// Device backends
+//
+// A backend is the bus the devices are plugged into. The
+// Common API keeps the report of every device in
+// DEVICE::PPosition, changes it with the Report_*() functions
+// and hands the whole report to the device's backend, which
+// sends it to the bus. Backends don't add devices to or remove
+// them from the device container; AcquireDev() and
+// RelinquishDev() do.
+//
+// DriverBackend (vGenDrivers.cpp) drives vJoy, XOutput and
+// ViGEm and is only built with VGEN_DRIVERS. SimBackend
+// (vGenSimBus.cpp) keeps everything in memory, builds
+// everywhere and can delay or fail operations on request.
+// UinputBackend (vGenUinput.cpp) creates Linux evdev devices,
+// or writes their events into memory.
+//
+// Included by Private.h, after DEVICE.
+//
+//////////////////////////////////////////////////////////
+#pragma once
+
+class DeviceBackend
+{
+public:
+	virtual ~DeviceBackend() {}
+
+	// STATUS_SUCCESS if devices of `type` can be plugged in
+	virtual DWORD BusStatus(vGenNS::DevType type) = 0;
+	// Version of the driver behind `type`, 0 if there is none
+	virtual DWORD BusVersion(vGenNS::DevType type) = 0;
+	// State of slot `id` of `type` on the bus, whether or not vGen has a device for it
+	virtual VjdStat SlotStatus(vGenNS::DevType type, UINT id) = 0;
+
+	// Plugs `dev` in. Fills dev.DevInfo, dev.Caps of a vJoy device, and dev.Feedback if the bus sends feedback.
+	// STATUS_DEVICE_ALREADY_ATTACHED if it is plugged in already.
+	virtual DWORD Plug(DEVICE & dev) = 0;
+	virtual DWORD Unplug(DEVICE & dev) = 0;
+	// Sends the report of `report` to the bus as that of `dev`: dev itself, or a view of the same type over a copy of
+	// dev's report merged with its passthrough pad
+	virtual DWORD Submit(DEVICE & dev, const DEVICE & report) = 0;
+	// Reads the device's report from the bus into `report`, which has the size of dev.PPosition's type
+	virtual DWORD Read(const DEVICE & dev, PVOID report) = 0;
+	// `dev` is being destroyed, plugged in or not. The bus must not use it after this returns.
+	virtual void Release(DEVICE & dev) = 0;
+	// DeInit(), after all devices were destroyed
+	virtual void Shutdown() {}
+
+	// State of the physical XInput controller in `slot` (0-3), STATUS_DEVICE_NOT_CONNECTED if there is none. Called
+	// by the passthrough reader without g_reportLock.
+	virtual DWORD PadState(UINT, XINPUT_STATE &) { return STATUS_DEVICE_NOT_CONNECTED; }
+};
+
+// The selected backend, AcquireDev() plugs new devices into it
+DeviceBackend * Backend_Get(void);
+DWORD Backend_Select(vGenNS::BackendType type);
+void Backend_Shutdown(void);
+
+#ifdef VGEN_DRIVERS
+DeviceBackend * Backend_Driver(void);  // vGenDrivers.cpp
+#endif
+DeviceBackend * Backend_Sim(void);     // vGenSimBus.cpp
+#ifdef __linux__
+DeviceBackend * Backend_Uinput(void);  // vGenUinput.cpp
+#endif
+DeviceBackend * Backend_UinputMemory(void);
+
+// Backend of the device in slot `id` of `type`, or the selected one if vGen has no device there
+inline DeviceBackend * Backend_For(vGenNS::DevType type, UINT id)
+{
+	const PDEVICE pDev = GetDevice(type, id);
+	return pDev && pDev->Backend ? pDev->Backend : Backend_Get();
+}
+
+// Converts and sends `report`, the device's or its passthrough merge, to its LinkDevMirror() targets (vGenMirror.cpp)
+void Mirror_Submit(const DEVICE & dev, const DEVICE & report);
+// Runs the routes of the device's controls that changed since its last report; outputs on the device itself go into
+// this report. Route_Submit() then sends the other devices the routes changed. (vGenRoute.cpp)
+void Route_Update(DEVICE & dev);
+void Route_Submit(DEVICE & dev);
+// Merges the device's passthrough pad into a copy of its report, for the backend and the mirrors; returns a view of
+// the device over the copy, or nullptr if the pad is not connected. The report itself is left as is. (vGenPassthrough.cpp)
+const DEVICE * Pass_Merge(const DEVICE & dev);
+
+inline DWORD Backend_Submit(DEVICE & dev)
+{
+	if (dev.Busy)
+		return STATUS_DEVICE_BUSY;
+	const bool routed = dev.RouteFirst != dev.RouteEnd;
+	if (routed)
+		Route_Update(dev);
+	const DEVICE * merged = dev.Passthrough ? Pass_Merge(dev) : nullptr;
+	const DEVICE & report = merged ? *merged : dev;
+	const DWORD res = dev.Backend ? dev.Backend->Submit(dev, report) : STATUS_DEVICE_NOT_CONNECTED;
+	if (!dev.Mirrors.empty())
+		Mirror_Submit(dev, report);
+	if (routed)
+		Route_Submit(dev);
+	return res;
+}
+
+// Sends the report if the change that returned `res` went through
+inline DWORD Backend_SubmitIf(DEVICE & dev, DWORD res)
+{
+	return res == STATUS_SUCCESS ? Backend_Submit(dev) : res;
+}
+
+// Simulated bus (vGenSimBus.cpp)
+DWORD Sim_SetConfig(const vGenNS::SimBusConfig & config);
+void Sim_GetStats(vGenNS::SimBusStats & stats);
+DWORD Sim_GetReport(vGenNS::DevType type, UINT id, PVOID report);
+DWORD Sim_SendFeedback(vGenNS::DevType type, UINT id, const vGenNS::FeedbackData & data);
+DWORD Sim_SendDs4Report(UINT id, const DS4_OUTPUT_BUFFER & report);
+DWORD Sim_SetPad(UINT slot, const XINPUT_STATE * state);
+
+// uinput (vGenUinput.cpp)
+DWORD Uinput_GetStats(vGenNS::BackendType backend, vGenNS::UinputStats & stats);
+DWORD Uinput_GetEvents(vGenNS::DevType type, UINT id, vGenNS::UinputEvent * events, UINT count, UINT & read);
@@ -0,0 +1,143 @@
+//////////////////////////////////////////////////////////
+//
+// Socket addresses of the vGen daemon
+//
+//   unix:<path>            Unix domain datagram socket (POSIX)
+//   udp:<port>             UDP on 127.0.0.1
+//   udp:<ipv4>:<port>      UDP, the address must be loopback
+//
+// Windows has no datagram Unix domain sockets: UDP only,
+// through Winsock. Shared by the daemon (vGenDaemon.cpp) and
+// the client (vGenClient.cpp), with the few socket calls that
+// differ between Winsock and POSIX.
+//
+//////////////////////////////////////////////////////////
+#pragma once
+
+#ifdef _WIN32
+// Included before windows.h where that matters (vGenClient.cpp): winsock2.h must come first, ntstatus.h after
+#define WIN32_NO_STATUS
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#undef WIN32_NO_STATUS
+#include <ntstatus.h>
+#pragma comment(lib, "ws2_32.lib")
+#else
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+typedef SOCKET DaemonSocket;
+#define DAEMON_NO_SOCKET INVALID_SOCKET
+#else
+typedef int DaemonSocket;
+#define DAEMON_NO_SOCKET (-1)
+#endif
+
+// A datagram socket, DAEMON_NO_SOCKET on failure. On Windows every open socket holds a Winsock reference.
+inline DaemonSocket DaemonSocket_Open(int family)
+{
+#ifdef _WIN32
+	WSADATA data;
+	if (WSAStartup(MAKEWORD(2, 2), &data))
+		return INVALID_SOCKET;
+	const SOCKET s = socket(family, SOCK_DGRAM, 0);
+	if (s == INVALID_SOCKET)
+		WSACleanup();
+	return s;
+#else
+	return socket(family, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+#endif
+}
+
+inline void DaemonSocket_Close(DaemonSocket s)
+{
+#ifdef _WIN32
+	closesocket(s);
+	WSACleanup();
+#else
+	close(s);
+#endif
+}
+
+// The last socket call failed because the address is taken
+inline bool DaemonSocket_InUse()
+{
+#ifdef _WIN32
+	return WSAGetLastError() == WSAEADDRINUSE;
+#else
+	return errno == EADDRINUSE;
+#endif
+}
+
+// The last send or receive failed because the socket at the other end is gone
+inline bool DaemonSocket_PeerGone()
+{
+#ifdef _WIN32
+	const int error = WSAGetLastError();
+	return error == WSAECONNRESET || error == WSAECONNREFUSED || error == WSAENOTCONN;
+#else
+	return errno == ECONNREFUSED || errno == ENOENT || errno == ENOTCONN;
+#endif
+}
+
+// Fills addr/len from an address string, false if it is malformed or not local
+inline bool DaemonSocket_Parse(const char * address, sockaddr_storage & addr, socklen_t & len)
+{
+	memset(&addr, 0, sizeof(addr));
+	if (!address)
+		return false;
+
+#ifndef _WIN32
+	if (!strncmp(address, "unix:", 5)) {
+		sockaddr_un & un = (sockaddr_un &)addr;
+		const size_t pathLen = strlen(address + 5);
+		if (!pathLen || pathLen >= sizeof(un.sun_path))
+			return false;
+		un.sun_family = AF_UNIX;
+		memcpy(un.sun_path, address + 5, pathLen + 1);
+		len = (socklen_t)(offsetof(sockaddr_un, sun_path) + pathLen + 1);
+		return true;
+	}
+#endif
+
+	if (!strncmp(address, "udp:", 4)) {
+		sockaddr_in & in = (sockaddr_in &)addr;
+		in.sin_family = AF_INET;
+		in.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+		const char * port = strrchr(address + 4, ':');
+		if (port) {
+			char host[INET_ADDRSTRLEN] = {};
+			const size_t hostLen = (size_t)(port - (address + 4));
+			if (hostLen >= sizeof(host))
+				return false;
+			memcpy(host, address + 4, hostLen);
+			if (inet_pton(AF_INET, host, &in.sin_addr) != 1 || (ntohl(in.sin_addr.s_addr) >> 24) != 127)
+				return false;
+			++port;
+		}
+		else
+			port = address + 4;
+
+		char * end;
+		const unsigned long number = strtoul(port, &end, 10);
+		if (*end || !number || number > 65535)
+			return false;
+		in.sin_port = htons((uint16_t)number);
+		len = sizeof(sockaddr_in);
+		return true;
+	}
+
+	return false;
+}
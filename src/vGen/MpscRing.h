@@ -0,0 +1,91 @@
+//////////////////////////////////////////////////////////
+//
+// Multi-producer/single-consumer lock-free bounded ring buffer.
+//
+// Any number of threads may call Push() while one thread calls
+// Drain() concurrently, without locking. Each slot carries a
+// sequence number that tells whether it is free for the producer
+// of a given position or filled for the consumer.
+// Capacity must be a power of 2.
+//
+//////////////////////////////////////////////////////////
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+template <typename T, size_t N>
+class MpscRing
+{
+	static_assert(N >= 2 && (N & (N - 1)) == 0, "MpscRing capacity must be a power of 2");
+
+public:
+	static constexpr size_t Capacity = N;
+
+	MpscRing()
+	{
+		for (size_t i = 0; i < N; ++i)
+			m_cells[i].Seq.store(i, std::memory_order_relaxed);
+	}
+
+	MpscRing(const MpscRing &) = delete;
+	MpscRing & operator=(const MpscRing &) = delete;
+
+	// Producer side. Returns false if the ring is full (item is not stored).
+	bool Push(const T &item)
+	{
+		size_t tail = m_tail.load(std::memory_order_relaxed);
+		for (;;) {
+			Cell & cell = m_cells[tail & (N - 1)];
+			const size_t seq = cell.Seq.load(std::memory_order_acquire);
+			const ptrdiff_t diff = (ptrdiff_t)seq - (ptrdiff_t)tail;
+			if (diff == 0) {
+				if (m_tail.compare_exchange_weak(tail, tail + 1, std::memory_order_relaxed)) {
+					cell.Item = item;
+					// Sequentially consistent, as Empty(): a producer that checks for sleeping consumers after
+					// Push() either sees them or they see the item
+					cell.Seq.store(tail + 1, std::memory_order_seq_cst);
+					return true;
+				}
+			}
+			else if (diff < 0)
+				return false;  // The consumer did not free this slot yet
+			else
+				tail = m_tail.load(std::memory_order_relaxed);
+		}
+	}
+
+	// Consumer side. Copies up to `count` items into `out` and returns the number copied.
+	// Stops early at a slot that was claimed but not filled yet.
+	size_t Drain(T *out, size_t count)
+	{
+		size_t n = 0;
+		while (n < count) {
+			Cell & cell = m_cells[m_head & (N - 1)];
+			if (cell.Seq.load(std::memory_order_acquire) != m_head + 1)
+				break;
+			out[n++] = cell.Item;
+			cell.Seq.store(m_head + N, std::memory_order_release);
+			++m_head;
+		}
+		return n;
+	}
+
+	// Consumer side. True if the next slot is not filled yet, even if a producer claimed it.
+	bool Empty() const { return m_cells[m_head & (N - 1)].Seq.load(std::memory_order_seq_cst) != m_head + 1; }
+
+private:
+	struct Cell
+	{
+		std::atomic<size_t> Seq;
+		T Item;
+	};
+
+	// Padding keeps the consumer and producer indices on separate cache lines
+	// (alignas() is not honored by operator new before C++17).
+	size_t m_head = 0;               // next slot to read, consumer only
+	char m_pad0[64];
+	std::atomic<size_t> m_tail {0};  // next slot to claim, shared by producers
+	char m_pad1[64];
+	Cell m_cells[N];
+};
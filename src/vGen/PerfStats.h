@@ -0,0 +1,135 @@
+//////////////////////////////////////////////////////////
+//
+// Per-API latency instrumentation (GetPerfStats) and call trace
+//
+// An exported function opens a PerfApiScope, driver calls made
+// inside it are wrapped in PERF_DRIVER(). Only the outermost scope
+// of a thread records, so an export calling another export is
+// counted once. Recording is off unless EnablePerfStats(TRUE) or
+// StartTrace() was called, and then only touches counters owned by
+// the calling thread or queues one trace record.
+//
+//////////////////////////////////////////////////////////
+#pragma once
+
+#include <atomic>
+#include <chrono>
+
+#include "vGenInterface.h"
+#include "ApiTrace.h"
+
+typedef std::chrono::steady_clock PerfClock;
+
+extern std::atomic_bool g_perfEnabled;
+
+// Per thread state of the open scope. Plain data so the thread_local needs no construction.
+struct PerfThreadState
+{
+	UINT Depth;          // Nesting of PerfApiScope
+	ULONGLONG DriverNs;  // Time spent in PERF_DRIVER() calls of the outermost scope
+	bool DriverCalled;
+};
+
+extern thread_local PerfThreadState t_perf;
+
+void Perf_Record(vGenNS::PerfApi api, ULONGLONG totalNs, ULONGLONG driverNs, bool driverCalled, DWORD result);
+DWORD Perf_Enable(BOOL enable);
+DWORD Perf_GetStats(vGenNS::PerfStats * stats);
+// Adds one sample to a (single threaded) histogram
+void Perf_Sample(vGenNS::PerfHistogram & hist, ULONGLONG ns);
+
+inline ULONGLONG Perf_Ns(PerfClock::duration d)
+{
+	return (ULONGLONG)std::chrono::duration_cast<std::chrono::nanoseconds>(d).count();
+}
+
+class PerfApiScope
+{
+public:
+	// `hDev`, `arg` and `value` only go into the trace, see ApiTrace.h for their meaning per API.
+	explicit PerfApiScope(vGenNS::PerfApi api, HDEVICE hDev = INVALID_DEV, UINT arg = 0, LONG value = 0)
+	{
+		const bool perf = g_perfEnabled.load(std::memory_order_relaxed);
+		const bool trace = g_traceEnabled.load(std::memory_order_relaxed);
+		if (!perf && !trace)
+			return;
+		m_entered = true;
+		if (t_perf.Depth++)
+			return;
+		m_api = api;
+		m_perf = perf;
+		m_trace = trace;
+		m_hDev = hDev;
+		m_arg = arg;
+		m_value = value;
+		t_perf.DriverNs = 0;
+		t_perf.DriverCalled = false;
+		m_start = PerfClock::now();
+	}
+
+	~PerfApiScope()
+	{
+		if (!m_entered)
+			return;
+		--t_perf.Depth;
+		if (!m_perf && !m_trace)
+			return;
+
+		const ULONGLONG totalNs = Perf_Ns(PerfClock::now() - m_start);
+		if (m_perf)
+			Perf_Record(m_api, totalNs, t_perf.DriverNs, t_perf.DriverCalled, m_result);
+		if (m_trace)
+			Trace_Record(m_api, Perf_Ns(m_start.time_since_epoch()), totalNs, m_hDev, m_arg, m_value, m_result);
+	}
+
+	// Passes the return value of the export through, for the error counter and the trace
+	DWORD Result(DWORD result)
+	{
+		m_result = result;
+		return result;
+	}
+
+	// Replaces the traced device handle (AcquireDev() only knows it after the call)
+	void Device(HDEVICE hDev) { m_hDev = hDev; }
+
+	PerfApiScope(const PerfApiScope &) = delete;
+	PerfApiScope & operator=(const PerfApiScope &) = delete;
+
+private:
+	vGenNS::PerfApi m_api = vGenNS::PerfApiCount;
+	DWORD m_result = 0;
+	bool m_entered = false;
+	bool m_perf = false;   // Outermost scope only
+	bool m_trace = false;  // Outermost scope only
+	HDEVICE m_hDev = INVALID_DEV;
+	UINT m_arg = 0;
+	LONG m_value = 0;
+	PerfClock::time_point m_start;
+};
+
+// Times one driver call. Use through PERF_DRIVER().
+class PerfDriverScope
+{
+public:
+	PerfDriverScope() : m_active(t_perf.Depth != 0)
+	{
+		if (m_active)
+			m_start = PerfClock::now();
+	}
+
+	~PerfDriverScope()
+	{
+		if (!m_active)
+			return;
+		t_perf.DriverNs += Perf_Ns(PerfClock::now() - m_start);
+		t_perf.DriverCalled = true;
+	}
+
+private:
+	bool m_active;
+	PerfClock::time_point m_start;
+};
+
+// Evaluates `call` and adds its duration to the driver time of the current PerfApiScope, if any.
+// The temporary lives until the end of the full expression, i.e. until the call returned.
+#define PERF_DRIVER(call) ((void)PerfDriverScope(), (call))
@@ -9,33 +9,143 @@
 #pragma once
 
 #include <atomic>
+#include <condition_variable>
+#include <deque>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include <vector>
 
 #include "stdafx.h"
 
+#ifdef VGEN_DRIVERS
 // Compilation directives
 #define USE_STATIC
 #define STATIC
 #define VJOYHEADERUSED
 
 #include "public.h"
+#endif
+#ifdef _WIN32
 #include <Xinput.h>
+#endif
+#ifdef VGEN_DRIVERS
 #include "vjoyinterface.h"
 #include "XOutput.h"
+#endif
 #include "vGenInterface.h"
+#if defined(VGEN_FFB_STUBS) && !defined(VGEN_DRIVERS)
+#include "test/vJoyFfbStubs.h"
+#endif
+#ifdef VGEN_DRIVERS
 #include "ViGEm/km/BusShared.h"
 #include "ViGEM/Client.h"
+#endif
+#include "SpscRing.h"
+#include "MpscRing.h"
+#include "PerfStats.h"
+#include "vGenProtocol.h"
 
 //////////////////////////////////
 
+// Feedback queue of a ViGEm device. Filled from the ViGEm notification thread or, for DS4, the output report
+// reader thread (the host, serialized by m_publishLock), and from the FFB rumble bridge (serialized by m_bridgeLock),
+// which push without waiting for each other. Read by GetDevFeedback() (consumers are serialized).
+struct DeviceFeedback
+{
+	MpscRing<vGenNS::FeedbackData, 64> Queue;
+	std::atomic<DWORD> Dropped {0};   // records lost because the queue was full
+	std::atomic_bool Closed {false};  // device is being destroyed, wakes up and fails any readers
+	std::thread Reader;                // DS4 output report reader
+	std::atomic_bool StopReader {false};
+
+	// Producer side: queue `data` if any member selected by `fields` (FeedbackFlags) differs from the last
+	// queued values. The record always carries the full current state, with Flags set for the changed members.
+	// FeedbackRumble | FeedbackBridged queues bridge motors, which are compared and kept apart from the host's.
+	bool Publish(vGenNS::FeedbackData data, BYTE fields);
+	// Consumer side: see GetDevFeedback().
+	DWORD Read(vGenNS::FeedbackData * data, UINT count, UINT * read, DWORD timeout);
+	void Close();
+
+private:
+	void Push(vGenNS::FeedbackData & data);  // sets Sequence
+
+	std::mutex m_publishLock;
+	vGenNS::FeedbackData m_last;  // under m_publishLock
+	std::atomic<ULONGLONG> m_lastLights {0};  // m_last but the motors, for the bridge, see Feedback_PackLights()
+	std::mutex m_bridgeLock;
+	BYTE m_bridgeLarge = 0;       // under m_bridgeLock
+	BYTE m_bridgeSmall = 0;       // under m_bridgeLock
+	std::atomic<DWORD> m_sequence {0};
+	std::mutex m_readLock;
+	// Waiting consumers; the producer only takes the lock when somebody waits.
+	std::mutex m_waitLock;
+	std::condition_variable m_waitCond;
+	std::atomic<int> m_waiters {0};
+};
+
+// Controls of a device. Fixed for gamepads, read from the bus when a vJoy device is plugged in.
+struct DeviceCaps
+{
+	DWORD Axes = 0;  // Bit n: usage HID_USAGE_X + n
+	USHORT Buttons = 0;
+	BYTE DiscPovs = 0;
+	BYTE ContPovs = 0;
+
+	bool HasAxis(UINT usage) const { return usage >= HID_USAGE_X && usage <= HID_USAGE_POV && (Axes >> (usage - HID_USAGE_X)) & 1; }
+};
+
+class DeviceBackend;
+struct PadPassthrough;  // vGenPassthrough.cpp
+
+#define SPRING_AXES     9  // HID_USAGE_X to HID_USAGE_WHL
+#define SPRING_DETENTS  4
+#define SPRING_STEP_MS  2  // Integration step
+
+// Spring-return models of a device's axes (SetDevAxisSpring), as arrays by axis so that a step over all the axes is a
+// few plain loops. Positions in the vJoy range, times in seconds. Under g_reportLock.
+struct AxisSprings
+{
+	float Position[SPRING_AXES] = {};
+	float Velocity[SPRING_AXES] = {};
+	float Center[SPRING_AXES] = {};
+	float Stiffness[SPRING_AXES] = {};  // 0: no model
+	float Damping[SPRING_AXES] = {};
+	float Free[SPRING_AXES] = {};       // 1 while let go and moving, else 0
+	float DetentStiffness[SPRING_AXES] = {};
+	float DetentWidth[SPRING_AXES] = {};
+	float Detents[SPRING_DETENTS][SPRING_AXES] = {};  // Far away when unused
+};
+
+#define TIMED_MAX_WRITES  256  // Writes a device holds for later (SetDevAxisAt, SetDevButtonAt)
+
+// A write for later, see vGenTimed.cpp. Under g_reportLock.
+struct TimedWrite
+{
+	ULONGLONG AtUs;  // Timer_NowUs() clock
+	UINT Control;    // Button or axis
+	LONG Value;      // Press, or vJoy range
+	bool Button;
+};
+
 // Device Structure
 typedef struct _DEVICE
 {
 	HDEVICE Handle;
 	vGenNS::DevType Type;
 	UINT Id;		// vJoy ID or vXbox Index
+	DeviceBackend * Backend = nullptr;  // What the device is plugged into, see Backend.h
+	bool Busy = false;  // AcquireDev() or RelinquishDev() is plugging it in or out, without g_reportLock
+#ifdef VGEN_DRIVERS
 	PVIGEM_TARGET VGE_Target = nullptr;
+#endif
+	std::shared_ptr<DeviceFeedback> Feedback;  // ViGEm only
+	std::shared_ptr<AxisSprings> Springs;      // From the first SetDevAxisSpring()
+	std::shared_ptr<std::deque<TimedWrite>> Timed;  // From the first SetDevAxisAt() or SetDevButtonAt(), by AtUs
+	std::vector<HDEVICE> Mirrors;              // LinkDevMirror() targets
+	UINT RouteFirst = 0, RouteEnd = 0;         // Routes from the device, in the compiled table (vGenRoute.cpp)
+	std::shared_ptr<PadPassthrough> Passthrough;  // SetDevPassthrough()
 	union
 	{
 		XINPUT_GAMEPAD * vXboxPos;
@@ -43,6 +153,7 @@ typedef struct _DEVICE
 		DS4_REPORT *ds4Pos;
 	} PPosition;
 	vGenNS::DeviceInfo DevInfo;
+	DeviceCaps Caps;
 } DEVICE, *PDEVICE;
 
 using DevContainer_t = std::map<HDEVICE, DEVICE>;
@@ -51,6 +162,10 @@ using DevContainer_cit = DevContainer_t::const_iterator;
 
 extern const DevContainer_t &DevContainer_cref;
 
+// Serializes the device container and the reports between the application's threads and the library's own (timer
+// wheel, daemon, shared-memory channels). Taken by the Common API exports that change or read a report.
+extern std::mutex g_reportLock;
+
 // Macros
 #define Range_vJoy(x) (((x) > 0 && (x) <= 16))
 #define Range_vXbox(x) (((x) > vGenNS::DevType::vXbox && (x) <= vGenNS::DevType::vXbox + 4))
@@ -66,6 +181,11 @@ extern const DevContainer_t &DevContainer_cref;
 #define XINPUT_NUM_BUTTONS  19
 #define DS4_NUM_BUTTONS  22
 
+// Button n => report mask (vGenPrivate.cpp)
+extern WORD g_xButtons[XINPUT_NUM_BUTTONS];
+#define DS4_SPECIAL_BUTTON_FLAG  (1 << 16)  // Mask is for DS4_REPORT::bSpecial
+extern DWORD g_ds4Buttons[DS4_NUM_BUTTONS];
+
 //// Device Container and Device Handle functions
 
 // Resolves a "ranged" device ID to its actual type and device ID/index.
@@ -88,6 +208,7 @@ inline std::pair<vGenNS::DevType, UINT> DeviceRangedIdToType(UINT rID)
 
 HDEVICE CreateDevice(vGenNS::DevType Type, UINT i);
 void DestroyDevice(HDEVICE & dev);
+void DestroyDevice_Locked(HDEVICE & dev);  // Under g_reportLock
 
 inline HDEVICE GetDeviceHandle(vGenNS::DevType Type, UINT i)
 {
@@ -145,31 +266,62 @@ inline DWORD isDevice_vXbox(HDEVICE h) {
 	return BOOL_TO_STATUS(GetDeviceType(h) == vGenNS::DevType::vXbox);
 }
 
-inline void *GetDevicePos(const PDEVICE dev) {
-	if (!dev)
-		return nullptr;
-
-	switch (dev->Type) {
+// Size of the device's report (PPosition)
+inline size_t GetDevicePosSize(const DEVICE & dev) {
+	switch (dev.Type) {
 		case vGenNS::DevType::vJoy:
-			vJoyNS::GetPosition(dev->Id, (PVOID)dev->PPosition.vJoyPos);
-			return (void *)dev->PPosition.vJoyPos;
+			return sizeof(JOYSTICK_POSITION_V2);
 
 		case vGenNS::DevType::vXbox:
 		case vGenNS::DevType::vgeXbox:
-			return (void *)dev->PPosition.vXboxPos;
+			return sizeof(XINPUT_GAMEPAD);
 
 		case vGenNS::DevType::vgeDS4:
-			return (void *)dev->PPosition.ds4Pos;
+			return sizeof(DS4_REPORT);
 
 		default:
-			return nullptr;
+			return 0;
 	}
 }
 
-inline void * GetDevicePos(HDEVICE h) {
-	return GetDevicePos(GetDevice(h));
-}
-
+#include "Backend.h"
+
+#pragma region Report Conversion
+				//////////// Report Conversion (vGenPrivate.cpp) ////////////
+// Change one control in the device's report, in the units of the report. Nothing is sent, see Backend_Submit().
+
+// Button: 1-based, see the mapping in vGenInterface.h. XInput: Button is an XINPUT_BUTTONS mask (XBox) or a raw DS4 mask.
+DWORD	Report_SetButton(DEVICE & dev, UINT Button, BOOL Press, BOOL XInput = FALSE);
+DWORD	Report_GetButton(const DEVICE & dev, UINT Button, BOOL & Press);
+// Gamepads. Value: XBTN_DPAD_* (XBox) or DS4_BUTTON_DPAD_* (DS4)
+DWORD	Report_SetDpad(DEVICE & dev, USHORT Value);
+// vJoy: 0-0x7FFF. XBox: SHORT, triggers 0-255. DS4: 0-255.
+DWORD	Report_SetAxis(DEVICE & dev, vGenNS::HID_USAGES Axis, LONG Value);
+DWORD	Report_GetAxis(const DEVICE & dev, vGenNS::HID_USAGES Axis, LONG & Value);
+// vJoy. Value: -1 (center) to 3, see DPOV_DIRECTION
+DWORD	Report_SetDiscPov(DEVICE & dev, UCHAR nPov, int Value);
+// vJoy. Value: 0-35999 or -1 (center)
+DWORD	Report_SetContPov(DEVICE & dev, UCHAR nPov, DWORD Value);
+void	Report_Reset(DEVICE & dev);
+
+// Change one control as the SetDev*() exports do, in their units (vGenPrivate.cpp). Nothing is sent, see
+// Backend_Submit(); callers that batch several changes into one report do that once at the end.
+DWORD	Control_SetButton(DEVICE & dev, UINT Button, BOOL Press);
+DWORD	Control_SetAxis(DEVICE & dev, vGenNS::HID_USAGES Axis, LONG Value);
+DWORD	Control_GetAxis(const DEVICE & dev, vGenNS::HID_USAGES Axis, LONG & Value);
+DWORD	Control_SetAxisPct(DEVICE & dev, vGenNS::HID_USAGES Axis, FLOAT Value);
+DWORD	Control_SetDiscPov(DEVICE & dev, UCHAR nPov, vGenNS::DPOV_DIRECTION Value);
+DWORD	Control_SetContPov(DEVICE & dev, UCHAR nPov, DWORD Value);
+DWORD	Control_SetPov(DEVICE & dev, UCHAR nPov, DWORD Value);
+DWORD	Control_GetPov(const DEVICE & dev, UCHAR nPov, DWORD & Value);
+// A VgenCmdButton/Axis/Pov/Reset message of the daemon protocol, as the matching Control_*()
+DWORD	Control_Apply(DEVICE & dev, const VgenMsg & msg);
+// Protocol device number (1-16, 1001-1004, ...) to type and id, false if it can't be one
+bool	Control_ParseDevice(int32_t Number, vGenNS::DevType & Type, UINT & Id);
+
+#pragma endregion Report Conversion
+
+#ifdef VGEN_DRIVERS
 #pragma region vXbox Internal Functions
 				//////////// vXbox Internal Functions ////////////
 
@@ -207,6 +359,8 @@ BOOL	IX_isControllerPluggedIn(HDEVICE hDev);
 DWORD	IX_isControllerOwned(UINT UserIndex, PBOOL Owned);
 BOOL	IX_isControllerOwned(HDEVICE hDev);
 // Virtual device Plug-In/Unplug
+DWORD	IX_BusPlugIn(UINT UserIndex, vGenNS::DeviceInfo & DevInfo);  // Bus only, waits until the device is ready
+DWORD	IX_BusUnPlug(UINT UserIndex);                                 // Bus only, waits until the device is gone
 DWORD	IX_PlugIn(UINT UserIndex);
 DWORD	IX_PlugInNext(UINT * UserIndex);
 DWORD	IX_UnPlug(UINT UserIndex);
@@ -222,11 +376,14 @@ DWORD	IX_ResetControllerDPad(HDEVICE hDev);
 
 // Data Transfer (Data to the device)
 
+// The PDEVICE overloads are called under g_reportLock, the others take it.
 DWORD	IX_SetBtn(const PDEVICE pDev, BOOL Press, WORD Button, BOOL XInput=FALSE);
 inline DWORD IX_SetBtn(HDEVICE hDev, BOOL Press, WORD Button, BOOL XInput = FALSE) {
+	std::lock_guard<std::mutex> lock(g_reportLock);
 	return IX_SetBtn(GetDevice(hDev), Press, Button, XInput);
 }
 inline DWORD IX_SetBtn(UINT UserIndex, BOOL Press, WORD Button, BOOL XInput = FALSE) {
+	std::lock_guard<std::mutex> lock(g_reportLock);
 	return IX_SetBtn(GetDevice(vGenNS::DevType::vXbox, UserIndex), Press, Button, XInput);
 }
 #ifdef SPECIFICBUTTONS
@@ -254,9 +411,11 @@ BOOL	IX_SetBtnRB(UINT UserIndex, BOOL Press); // Right Bumper
 
 DWORD	IX_SetAxis(const PDEVICE pDev, vGenNS::HID_USAGES Axis, SHORT Value);
 inline DWORD IX_SetAxis(HDEVICE hDev, vGenNS::HID_USAGES Axis, SHORT Value) {
+	std::lock_guard<std::mutex> lock(g_reportLock);
 	return IX_SetAxis(GetDevice(hDev), Axis, Value);
 }
 inline DWORD IX_SetAxis(UINT UserIndex, vGenNS::HID_USAGES Axis, SHORT Value) {
+	std::lock_guard<std::mutex> lock(g_reportLock);
 	return IX_SetAxis(GetDevice(vGenNS::DevType::vXbox, UserIndex), Axis, Value);
 }
 #ifdef SPECIFICBUTTONS
@@ -276,9 +435,11 @@ DWORD	IX_SetAxisRy(UINT UserIndex, SHORT Value); // Right Stick Y
 
 DWORD	IX_SetDpad(const PDEVICE pDev, UCHAR Value);
 inline DWORD IX_SetDpad(HDEVICE hDev, UCHAR Value) {
+	std::lock_guard<std::mutex> lock(g_reportLock);
 	return IX_SetDpad(GetDevice(hDev), Value);
 }
 inline DWORD IX_SetDpad(UINT UserIndex, UCHAR Value) {
+	std::lock_guard<std::mutex> lock(g_reportLock);
 	return IX_SetDpad(GetDevice(vGenNS::DevType::vXbox, UserIndex), Value);
 }
 #ifdef SPECIFICBUTTONS
@@ -299,6 +460,7 @@ DWORD	IX_GetLedNumber(UINT UserIndex, PBYTE pLed);
 DWORD	IX_GetVibration(UINT UserIndex, PXINPUT_VIBRATION pVib);
 
 #pragma endregion vXbox Internal Functions
+#endif // VGEN_DRIVERS
 
 #pragma region vJoy Internal Functions
 
@@ -309,22 +471,33 @@ inline void IJ_JoystickReportInit(PJOYSTICK_POSITION_V2 pPos)
 	pPos->bHats = pPos->bHatsEx1  = pPos->bHatsEx2  = pPos->bHatsEx3 = (DWORD)-1;
 }
 
-HDEVICE	IJ_AcquireVJD(UINT rID);				// Acquire the specified vJoy Device.
-DWORD IJ_RelinquishVJD(HDEVICE hDev, PDEVICE pDev);			// Relinquish the specified vJoy Device.
-BOOL IJ_isVJDExists(HDEVICE hDev);
-enum VjdStat IJ_GetVJDStatus(HDEVICE hDev);			// Get the status of the specified vJoy Device.
-BOOL IJ_GetVJDAxisExist(HDEVICE hDev, vGenNS::HID_USAGES Axis); // Test if given axis defined in the specified VDJ
-int	IJ_GetVJDButtonNumber(HDEVICE hDev);	// Get the number of buttons defined in the specified VDJ
-int IJ_GetVJDDiscPovNumber(HDEVICE hDev);   // Get the number of POVs defined in the specified device
-int IJ_GetVJDContPovNumber(HDEVICE hDev);	// Get the number of descrete-type POV hats defined in the specified VDJ
-BOOL IJ_SetAxis(LONG Value, HDEVICE hDev, vGenNS::HID_USAGES Axis);		// Write Value to a given axis defined in the specified VDJ
-BOOL IJ_SetBtn(BOOL Value, HDEVICE hDev, UCHAR nBtn);		// Write Value to a given button defined in the specified VDJ
-BOOL IJ_SetDiscPov(int Value, HDEVICE hDev, UCHAR nPov);	// Write Value to a given descrete POV defined in the specified VDJ
-BOOL IJ_SetContPov(DWORD Value, HDEVICE hDev, UCHAR nPov);	// Write Value to a given continuous POV defined in the specified VDJ
-DWORD IJ_ResetPositions(HDEVICE hDev);  // manual reset of all values
+#ifdef VGEN_DRIVERS
+void IJ_GetCaps(UINT rID, DeviceCaps & caps);  // Controls of the vJoy device as configured in the driver
+#endif // VGEN_DRIVERS
+
+#ifdef VGEN_FFB
+// Decoded FFB packets (vGenFfb.cpp)
+BOOL IJ_FfbDecodePacket(const FFB_DATA * pData, FFB_PACKET & packet);
+void IJ_FfbStart(void);  // Install the decoding vJoy FFB callback, once
+void IJ_FfbRegisterGenCB(FfbGenCB cb, PVOID data);  // Raw packet callback, called after the packet was queued
+DWORD IJ_FfbSubscribe(UINT rID, DWORD TypeMask, FfbPacketCB cb, PVOID data, UINT * Subscription);
+DWORD IJ_FfbUnsubscribe(UINT Subscription);
+DWORD IJ_FfbReadPackets(FFB_PACKET * packets, UINT count, UINT * read, DWORD timeout);
+void IJ_FfbWakeReaders(void);
+
+// FFB effect engine (vGenFfbEngine.cpp)
+void IJ_FfbEngineApply(const FFB_PACKET & packet);
+DWORD IJ_FfbGetForce(UINT rID, LONG * ForceX, LONG * ForceY);
+void IJ_FfbRegisterForceCB(FfbForceCB cb, PVOID data);
+DWORD IJ_FfbSetForceTick(UINT Period);
+void IJ_FfbStopEngine(void);
+void IJ_FfbSetRumbleTarget(UINT rID, const std::shared_ptr<DeviceFeedback> & feedback);  // nullptr unlinks
+#endif // VGEN_FFB
 
 #pragma endregion vJoy Internal Functions
 
+#ifdef VGEN_DRIVERS
+
 #pragma region ViGEm Internal Functions
 
 inline DWORD VGE_ErrorToStatus(VIGEM_ERROR err)
@@ -377,18 +550,145 @@ inline DWORD VGE_ErrorToStatus(VIGEM_ERROR err)
 DWORD VGE_InitClient(void);  // Try to connect to ViGEm Bus
 DWORD VGE_BusExists(void);
 inline DWORD VGE_Version(void) { return VIGEM_COMMON_VERSION; }
-DWORD VGE_PlugIn(vGenNS::DevType dType, UINT DevId);
-DWORD VGE_UnPlug(HDEVICE hDev, PDEVICE pDev, BOOL destroy = FALSE);
-DWORD	VGE_ResetController(HDEVICE hDev);
+DWORD VGE_PlugIn(DEVICE & dev);
+DWORD VGE_UnPlug(DEVICE & dev);
+void	VGE_Release(DEVICE & dev);  // Unplugs and frees the target
 DWORD	VGE_ResetController(vGenNS::DevType dType, UINT DevId);
 
-DWORD VGE_SetBtn(const PDEVICE pDev, BOOL Press, WORD Button, BOOL XInput = FALSE);
-DWORD VGE_SetDpad(const PDEVICE pDev, USHORT Value);
-DWORD	VGE_SetAxis(const PDEVICE pDev, vGenNS::HID_USAGES Axis, SHORT Value);
+DWORD	VGE_RegisterFeedback(PDEVICE pDev);
+void	VGE_UnregisterFeedback(const DEVICE &dev);
+DWORD	VGE_RegisterDs4Notification(PDEVICE pDev);
+DWORD	VGE_AwaitDs4OutputReport(const PDEVICE pDev, DS4_OUTPUT_BUFFER * pReport, DWORD Timeout);
 
-#pragma endregion  ViGEm Internal Functions
+// DS4 output report reader (vGenFeedback.cpp)
+// Any function which blocks up to Timeout ms for the next raw output report of the device. Returns STATUS_TIMEOUT if there was none,
+// STATUS_NOT_SUPPORTED if reports can't be read at all. The default reads from the ViGEm bus; a stand-in bus can replace it for testing.
+typedef DWORD (*Ds4ReportSource)(const PDEVICE pDev, DS4_OUTPUT_BUFFER * pReport, DWORD Timeout);
+void	VGE_SetDs4ReportSource(Ds4ReportSource source);  // nullptr restores the default
+void	Ds4_StartReader(PDEVICE pDev);
+void	Ds4_StopReader(DeviceFeedback & feedback);
 
-// Other helper functions
-//BOOL ConvertPosition_vJoy2vXbox(void *vJoyPos, void *vXboxPos);
-//WORD ConvertButton(LONG vBtns, WORD xBtns, UINT vBtn, UINT xBtn);
+#pragma endregion  ViGEm Internal Functions
+#endif // VGEN_DRIVERS
+
+BYTE	Ds4_DecodeOutputReport(const DS4_OUTPUT_BUFFER & report, vGenNS::FeedbackData & data);
+
+// Daemon mode (vGenDaemon.cpp). Run blocks the calling thread until Stop.
+DWORD	Daemon_Run(const char * address);
+DWORD	Daemon_Stop(void);
+void	Daemon_GetStats(vGenNS::DaemonStats & stats);
+
+// Spring-return axes (vGenSpring.cpp). Under g_reportLock.
+DWORD	Spring_Set(DEVICE & dev, vGenNS::HID_USAGES axis, const vGenNS::AxisSpring * spring);
+// Lets go of the axis from where it is; the caller schedules the TimerAxisSpring timer
+DWORD	Spring_Release(DEVICE & dev, vGenNS::HID_USAGES axis);
+// Takes hold of the axis, or of all, where it is
+void	Spring_Grab(DEVICE & dev, vGenNS::HID_USAGES axis);
+void	Spring_GrabAll(DEVICE & dev);
+// One step of SPRING_STEP_MS for the axes let go of; false once all are at rest. Sets changed if the report changed.
+bool	Spring_Step(DEVICE & dev, bool & changed);
+
+// Timestamped writes (vGenTimed.cpp). Under g_reportLock.
+// Checks the control and buffers the write; first is set if it is now the earliest. The caller schedules TimerTimedWrite.
+DWORD	Timed_Add(DEVICE & dev, const TimedWrite & write, bool & first);
+// Applies the writes due by untilUs and returns the time of the next one, 0 if none. Sets changed if the report changed.
+// Like SetDevAxis() and SetDevButton(), a write cancels the animation, or the release and turbo, of its control.
+ULONGLONG	Timed_Apply(DEVICE & dev, HDEVICE hDev, ULONGLONG untilUs, bool & changed);
+void	Timed_Clear(DEVICE & dev);
+
+// Macros (vGenMacro.cpp). A program is checked by Macro_Load() and shared by its runs; each run is a timer.
+struct MacroProgram
+{
+	std::vector<vGenNS::MacroInstr> Code;
+};
+struct MacroRun
+{
+	std::shared_ptr<const MacroProgram> Program;
+	UINT Pc = 0;
+	std::vector<UINT> Counters;  // By instruction, for MacroLoop
+};
+// A MacroRamp to start once the instructions of the tick ran
+struct MacroAnimation
+{
+	HDEVICE hDev;
+	vGenNS::HID_USAGES Axis;
+	LONG Target;
+	UINT DurationMs;
+	vGenNS::AxisEasing Easing;
+};
+DWORD	Macro_Load(const vGenNS::MacroInstr * program, UINT count, UINT & id);
+DWORD	Macro_Unload(UINT id);
+void	Macro_UnloadAll(void);
+// A run at its start, or no program if there is no macro id
+MacroRun	Macro_Start(UINT id);
+// Under g_reportLock. Runs instructions up to a wait or the end and returns the wait in ms, 0 at the end. Sets changed if
+// the report changed, adds MacroRamp instructions to ramps.
+UINT	Macro_Exec(DEVICE & dev, HDEVICE hDev, MacroRun & run, bool & changed, std::vector<MacroAnimation> & ramps);
+// Under g_reportLock. Starts the animations and clears ramps.
+void	Macro_StartRamps(std::vector<MacroAnimation> & ramps);
+
+// Timer wheel (vGenTimer.cpp). All but Timer_Configure(), Timer_GetStats() and Timer_Stop() are called under
+// g_reportLock. A control has at most one timer: scheduling it again replaces the pending one.
+enum TimerAction : BYTE
+{
+	TimerButtonRelease,  // Control_SetButton(FALSE)
+	TimerDiscPovCenter,  // Control_SetDiscPov(DPOV_Center)
+	TimerAxisAnimate,    // Control_SetAxis() every few ticks, index is the axis
+	TimerButtonTurbo,    // Control_SetButton() at every edge, until cancelled
+	TimerMacro,          // Macro_Exec() after every wait, index is the macro id
+	TimerAxisSpring,     // Spring_Step() every SPRING_STEP_MS, index 0
+	TimerTimedWrite,     // Timed_Apply() at each buffered write's time, index 0
+};
+DWORD	Timer_Schedule(HDEVICE hDev, TimerAction action, UINT index, UINT delayMs);
+// from, to: vJoy range. durationMs > 0.
+DWORD	Timer_Animate(HDEVICE hDev, vGenNS::HID_USAGES axis, LONG from, LONG to, UINT durationMs, vGenNS::AxisEasing easing);
+// onUs and periodUs - onUs at least one tick (1 ms)
+DWORD	Timer_Turbo(HDEVICE hDev, UINT button, UINT periodUs, UINT onUs);
+// A run that Macro_Exec() left waiting waitMs
+DWORD	Timer_Macro(HDEVICE hDev, UINT id, MacroRun && run, UINT waitMs);
+// Due at time atUs of Timer_NowUs(), or the next tick if that has passed
+DWORD	Timer_At(HDEVICE hDev, TimerAction action, UINT index, ULONGLONG atUs);
+void	Timer_Cancel(HDEVICE hDev, TimerAction action, UINT index);
+void	Timer_CancelDevice(HDEVICE hDev);
+// Waits for the thread to apply the settings if it runs
+DWORD	Timer_Configure(const vGenNS::SchedulerConfig & config);
+void	Timer_GetStats(vGenNS::SchedulerStats & stats, bool reset);
+void	Timer_Stop(void);
+// Microseconds of the monotonic clock the timers run on; any thread
+ULONGLONG	Timer_NowUs(void);
+
+// Shared-memory channels (vGenShm.cpp)
+DWORD	Shm_Open(const char * name);
+DWORD	Shm_Close(const char * name);
+void	Shm_CloseAll(void);
+DWORD	Shm_GetStats(const char * name, vGenNS::ShmChannelStats & stats);
+
+// Control routing (vGenRoute.cpp). Under g_reportLock; Route_Update() and Route_Submit() are in Backend.h.
+#define ROUTE_MAX_ROUTES  4096
+#define ROUTE_MAX_DEPTH   4     // Route_Submit() nesting, through routes and mirrors between devices
+// Compiles and applies the table; bad receives the index of a route refused
+DWORD	Route_Set(const vGenNS::ControlRoute * routes, UINT count, UINT & bad);
+// The device is going away: removes the routes from or to it
+void	Route_RemoveDevice(HDEVICE hDev);
+
+// Device mirroring (vGenMirror.cpp). Under g_reportLock; Mirror_Submit() is in Backend.h.
+#define MIRROR_MAX_TARGETS  8
+// Links and sends the target the source's state. STATUS_INVALID_PARAMETER_2 if the link would close a loop.
+DWORD	Mirror_Link(HDEVICE hSource, HDEVICE hTarget);
+DWORD	Mirror_Unlink(HDEVICE hSource, HDEVICE hTarget);
+// The device is going away: removes every link to it
+void	Mirror_UnlinkAll(HDEVICE hDev);
+// Sets the controls of target to those of source, converting between device types
+void	Mirror_Convert(const DEVICE & source, DEVICE & target);
+
+// Physical pad passthrough (vGenPassthrough.cpp). Pass_Set() under g_reportLock, the others without it; Pass_Merge()
+// is in Backend.h.
+#define PASS_SLOTS  4  // XInput user indexes
+// Starts, changes (config) or stops (NULL) the device's passthrough; starts the reader if needed
+DWORD	Pass_Set(DEVICE & dev, const vGenNS::PassthroughConfig * config);
+DWORD	Pass_Configure(const vGenNS::PadPollConfig & config);
+// The reader's snapshot of the slot, STATUS_DEVICE_NOT_CONNECTED if empty
+DWORD	Pass_GetState(UINT slot, XINPUT_STATE & state);
+void	Pass_GetStats(vGenNS::PadPollStats & stats, bool reset);
+void	Pass_Stop(void);
 
@@ -0,0 +1,240 @@
+//////////////////////////////////////////////////////////
+//
+// Shared-memory command channel
+//
+// OpenShmChannel() maps a block with a SpscRing of VgenMsg
+// (vGenProtocol.h) that one feeder process pushes commands
+// into, with plain memory writes. A thread of the process
+// that opened the channel drains the ring; when it runs dry
+// the thread sets Sleeping and waits, and the feeder wakes it
+// (futex on Linux, a named event on Windows) only when it
+// finds Sleeping set after a push.
+//
+// Nothing is answered: the owner publishes the ring position
+// of the last message it applied and counts the failures, the
+// feeder reads them from the block. Shared by the owner (vGenShm.cpp) and the feeder
+// (vGenShmFeeder.cpp).
+//
+//////////////////////////////////////////////////////////
+#pragma once
+
+#include "SpscRing.h"
+#include "vGenProtocol.h"
+
+#include <new>
+#include <string>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+#endif
+
+#define SHM_CHANNEL_MAGIC    0x6E684373  // "sChn"
+#define SHM_CHANNEL_VERSION  2
+#define SHM_CHANNEL_SIZE     1024        // Messages in the ring
+#define SHM_CHANNEL_NAME_MAX 64
+
+static_assert(sizeof(std::atomic<uint32_t>) == 4 && sizeof(std::atomic<uint64_t>) == 8, "ShmChannelBlock layout");
+
+struct ShmChannelBlock
+{
+	uint32_t Magic;                     // SHM_CHANNEL_MAGIC once the owner initialized the block
+	uint32_t Version;                   // SHM_CHANNEL_VERSION
+	std::atomic<uint32_t> Open;         // Cleared when the owner closes the channel
+	std::atomic<uint32_t> Producer;     // Set while a feeder is attached
+	std::atomic<uint32_t> Sleeping;     // The owner waits for a wake
+	std::atomic<uint32_t> Failures;     // Messages that failed
+	std::atomic<uint32_t> LastFailure;  // NTSTATUS of the last one
+	uint32_t Reserved;
+	std::atomic<uint64_t> Consumed;     // Ring position (Popped()) after the last message applied, failed or not
+	char Pad[64];
+	SpscRing<VgenMsg, SHM_CHANNEL_SIZE> Ring;
+};
+
+// Letters, digits, '.', '-' and '_'
+inline bool ShmChannel_ValidName(const char * name)
+{
+	if (!name || !*name)
+		return false;
+	size_t len = 0;
+	for (const char * c = name; *c; ++c, ++len) {
+		const bool ok = (*c >= 'a' && *c <= 'z') || (*c >= 'A' && *c <= 'Z') || (*c >= '0' && *c <= '9') || *c == '.' || *c == '-' || *c == '_';
+		if (!ok || len == SHM_CHANNEL_NAME_MAX)
+			return false;
+	}
+	return true;
+}
+
+// The mapping of a channel's block and its wake object, on either side
+class ShmChannelMap
+{
+public:
+	ShmChannelMap() = default;
+	~ShmChannelMap() { Close(); }
+	ShmChannelMap(const ShmChannelMap &) = delete;
+	ShmChannelMap & operator=(const ShmChannelMap &) = delete;
+
+	// Owner: creates the block, replacing one a crashed owner left behind
+	DWORD Create(const char * name)
+	{
+		if (!ShmChannel_ValidName(name))
+			return STATUS_INVALID_PARAMETER_1;
+		Close();
+		m_owner = true;
+
+#ifdef _WIN32
+		m_mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, 0, sizeof(ShmChannelBlock), MapName(name, "").c_str());
+		if (!m_mapping)
+			return STATUS_INSUFFICIENT_RESOURCES;
+		if (GetLastError() == ERROR_ALREADY_EXISTS) {
+			Close();
+			return STATUS_DEVICE_BUSY;
+		}
+		m_event = CreateEventA(nullptr, FALSE, FALSE, MapName(name, ".wake").c_str());
+		void * view = m_event ? MapViewOfFile(m_mapping, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(ShmChannelBlock)) : nullptr;
+#else
+		m_name = MapName(name, "");
+		shm_unlink(m_name.c_str());
+		const int fd = shm_open(m_name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+		if (fd < 0) {
+			m_name.clear();
+			return errno == EACCES ? STATUS_ACCESS_DENIED : STATUS_INSUFFICIENT_RESOURCES;
+		}
+		void * view = ftruncate(fd, sizeof(ShmChannelBlock)) ? MAP_FAILED : mmap(nullptr, sizeof(ShmChannelBlock), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		close(fd);
+		if (view == MAP_FAILED)
+			view = nullptr;
+#endif
+		if (!view) {
+			Close();
+			return STATUS_INSUFFICIENT_RESOURCES;
+		}
+
+		// The fresh mapping is zeroed, which is the empty state of every member
+		m_block = new (view) ShmChannelBlock;
+		m_block->Version = SHM_CHANNEL_VERSION;
+		m_block->Open = 1;
+		std::atomic_thread_fence(std::memory_order_release);
+		m_block->Magic = SHM_CHANNEL_MAGIC;
+		return STATUS_SUCCESS;
+	}
+
+	// Feeder: maps the block of an open channel
+	DWORD Open(const char * name)
+	{
+		if (!ShmChannel_ValidName(name))
+			return STATUS_INVALID_PARAMETER_1;
+		Close();
+
+#ifdef _WIN32
+		m_mapping = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, MapName(name, "").c_str());
+		if (!m_mapping)
+			return STATUS_NO_SUCH_DEVICE;
+		m_event = OpenEventA(EVENT_MODIFY_STATE, FALSE, MapName(name, ".wake").c_str());
+		void * view = m_event ? MapViewOfFile(m_mapping, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(ShmChannelBlock)) : nullptr;
+#else
+		const int fd = shm_open(MapName(name, "").c_str(), O_RDWR, 0);
+		if (fd < 0)
+			return errno == EACCES ? STATUS_ACCESS_DENIED : STATUS_NO_SUCH_DEVICE;
+		struct stat st;
+		void * view = fstat(fd, &st) || st.st_size < (off_t)sizeof(ShmChannelBlock) ? MAP_FAILED :
+			mmap(nullptr, sizeof(ShmChannelBlock), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		close(fd);
+		if (view == MAP_FAILED)
+			view = nullptr;
+#endif
+		if (!view) {
+			Close();
+			return STATUS_NO_SUCH_DEVICE;
+		}
+
+		m_block = (ShmChannelBlock *)view;
+		if (m_block->Magic != SHM_CHANNEL_MAGIC || m_block->Version != SHM_CHANNEL_VERSION || !m_block->Open) {
+			Close();
+			return STATUS_NOT_SUPPORTED;
+		}
+		std::atomic_thread_fence(std::memory_order_acquire);
+		return STATUS_SUCCESS;
+	}
+
+	// The owner also removes the name, a feeder that is still attached keeps its mapping
+	void Close()
+	{
+#ifdef _WIN32
+		if (m_block)
+			UnmapViewOfFile(m_block);
+		if (m_event)
+			CloseHandle(m_event);
+		if (m_mapping)
+			CloseHandle(m_mapping);
+		m_event = m_mapping = nullptr;
+#else
+		if (m_block)
+			munmap(m_block, sizeof(ShmChannelBlock));
+		if (m_owner && !m_name.empty())
+			shm_unlink(m_name.c_str());
+		m_name.clear();
+#endif
+		m_block = nullptr;
+		m_owner = false;
+	}
+
+	ShmChannelBlock * Block() const { return m_block; }
+
+	// Owner: waits until woken while Sleeping is 1, or timeoutMs passed
+	void Wait(DWORD timeoutMs)
+	{
+#ifdef _WIN32
+		WaitForSingleObject(m_event, timeoutMs);
+#elif defined(__linux__)
+		const timespec timeout = { (time_t)(timeoutMs / 1000), (long)(timeoutMs % 1000) * 1000000 };
+		syscall(SYS_futex, (uint32_t *)&m_block->Sleeping, FUTEX_WAIT, 1, &timeout, nullptr, 0);
+#else
+		// No cross-process wait object here; poll at 1 ms
+		const timespec nap = { 0, 1000000 };
+		for (DWORD ms = 0; ms < timeoutMs && m_block->Sleeping.load(); ++ms)
+			nanosleep(&nap, nullptr);
+#endif
+	}
+
+	// Either side: wakes the owner if it sleeps
+	void Wake()
+	{
+		if (!m_block->Sleeping.exchange(0))
+			return;
+#ifdef _WIN32
+		SetEvent(m_event);
+#elif defined(__linux__)
+		syscall(SYS_futex, (uint32_t *)&m_block->Sleeping, FUTEX_WAKE, 1, nullptr, nullptr, 0);
+#endif
+	}
+
+private:
+	static std::string MapName(const char * name, const char * suffix)
+	{
+#ifdef _WIN32
+		return std::string("Local\\vGenShm.") + name + suffix;
+#else
+		return std::string("/vGenShm.") + name + suffix;
+#endif
+	}
+
+	ShmChannelBlock * m_block = nullptr;
+	bool m_owner = false;
+#ifdef _WIN32
+	HANDLE m_mapping = nullptr;
+	HANDLE m_event = nullptr;
+#else
+	std::string m_name;
+#endif
+};
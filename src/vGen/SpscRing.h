@@ -0,0 +1,83 @@
+//////////////////////////////////////////////////////////
+//
+// Single-producer/single-consumer lock-free ring buffer.
+//
+// One thread may call Push() while another thread calls Pop()/Drain()
+// concurrently without any locking. Capacity must be a power of 2.
+//
+//////////////////////////////////////////////////////////
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+template <typename T, size_t N>
+class SpscRing
+{
+	static_assert(N >= 2 && (N & (N - 1)) == 0, "SpscRing capacity must be a power of 2");
+
+public:
+	static constexpr size_t Capacity = N;
+
+	// Producer side. Returns false if the ring is full (item is not stored).
+	bool Push(const T &item)
+	{
+		const size_t tail = m_tail.load(std::memory_order_relaxed);
+		if (tail - m_headCache == N) {
+			m_headCache = m_head.load(std::memory_order_acquire);
+			if (tail - m_headCache == N)
+				return false;
+		}
+		m_buffer[tail & (N - 1)] = item;
+		m_tail.store(tail + 1, std::memory_order_seq_cst);
+		return true;
+	}
+
+	// Consumer side. Returns false if the ring is empty.
+	bool Pop(T &item)
+	{
+		const size_t head = m_head.load(std::memory_order_relaxed);
+		if (head == m_tailCache) {
+			m_tailCache = m_tail.load(std::memory_order_acquire);
+			if (head == m_tailCache)
+				return false;
+		}
+		item = m_buffer[head & (N - 1)];
+		m_head.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Consumer side. Copies up to `count` items into `out` and returns the number copied.
+	size_t Drain(T *out, size_t count)
+	{
+		const size_t head = m_head.load(std::memory_order_relaxed);
+		m_tailCache = m_tail.load(std::memory_order_acquire);
+		size_t n = m_tailCache - head;
+		if (n > count)
+			n = count;
+		for (size_t i = 0; i < n; ++i)
+			out[i] = m_buffer[(head + i) & (N - 1)];
+		m_head.store(head + n, std::memory_order_release);
+		return n;
+	}
+
+	// Positions: items pushed (producer side) and taken (consumer side) since construction. Each side can publish its
+	// own for the other to compare with.
+	size_t Pushed() const { return m_tail.load(std::memory_order_relaxed); }
+	size_t Popped() const { return m_head.load(std::memory_order_relaxed); }
+
+	// May be called from either side; the result is only a snapshot.
+	bool Empty() const { return m_head.load(std::memory_order_seq_cst) == m_tail.load(std::memory_order_seq_cst); }
+	size_t Size() const { return m_tail.load(std::memory_order_acquire) - m_head.load(std::memory_order_acquire); }
+
+private:
+	// Padding keeps the consumer and producer indices on separate cache lines
+	// (alignas() is not honored by operator new before C++17).
+	std::atomic<size_t> m_head {0};  // next slot to read, written by consumer
+	size_t m_tailCache = 0;          // consumer's last seen tail
+	char m_pad0[64];
+	std::atomic<size_t> m_tail {0};  // next slot to write, written by producer
+	size_t m_headCache = 0;          // producer's last seen head
+	char m_pad1[64];
+	T m_buffer[N];
+};
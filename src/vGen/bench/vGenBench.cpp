@@ -0,0 +1,244 @@
+// vGenBench.cpp : Benchmarks of the Common API on the simulated bus (Google Benchmark).
+//
+// Every call goes through the exports, as an application makes them, so the numbers include the device lookup, the
+// report conversion and the backend submit. The bus adds no latency (SimBusConfig defaults). Exits with 1 if any
+// call failed, which makes a short run (--benchmark_min_time=0.001) usable as a smoke test.
+
+#include "vGenInterface.h"
+
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <stdio.h>
+
+using namespace vGenNS;
+
+namespace {
+
+std::atomic_bool g_failed{ false };  // Set by any thread
+
+bool Bench_Check(benchmark::State & state, DWORD res, const char * call)
+{
+	if (res == STATUS_SUCCESS)
+		return true;
+
+	char msg[96];
+	snprintf(msg, sizeof(msg), "%s returned 0x%08X", call, (unsigned)res);
+	state.SkipWithError(msg);
+	g_failed = true;
+	return false;
+}
+
+const char * Bench_TypeName(DevType type)
+{
+	switch (type) {
+		case vJoy:    return "vJoy";
+		case vXbox:   return "vXbox";
+		case vgeXbox: return "vgeXbox";
+		case vgeDS4:  return "vgeDS4";
+		default:      return "?";
+	}
+}
+
+// Acquires device 1 of the type in range(0) for the benchmark, releases it at the end
+class BenchDevice
+{
+public:
+	explicit BenchDevice(benchmark::State & state)
+	{
+		const DevType type = (DevType)state.range(0);
+		state.SetLabel(Bench_TypeName(type));
+		if (!Bench_Check(state, SelectBackend(BackendSimulated), "SelectBackend") ||
+			!Bench_Check(state, AcquireDev(1, type, &m_hDev), "AcquireDev"))
+			m_hDev = INVALID_DEV;
+	}
+
+	~BenchDevice()
+	{
+		if (m_hDev != INVALID_DEV)
+			RelinquishDev(m_hDev);
+	}
+
+	HDEVICE Handle() const { return m_hDev; }
+	explicit operator bool() const { return m_hDev != INVALID_DEV; }
+
+private:
+	HDEVICE m_hDev = INVALID_DEV;
+};
+
+void Bench_AllTypes(benchmark::internal::Benchmark * bench)
+{
+	bench->Arg(vJoy)->Arg(vXbox)->Arg(vgeXbox)->Arg(vgeDS4);
+}
+
+void BM_SetDevAxis(benchmark::State & state)
+{
+	BenchDevice dev(state);
+	if (!dev)
+		return;
+
+	LONG value = 0;
+	for (auto _ : state) {
+		if (!Bench_Check(state, SetDevAxis(dev.Handle(), (HID_USAGES)HID_USAGE_X, value), "SetDevAxis"))
+			break;
+		value = (value + 97) & 0x7FFF;
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_SetDevAxis)->Apply(Bench_AllTypes);
+
+void BM_SetDevAxisPct(benchmark::State & state)
+{
+	BenchDevice dev(state);
+	if (!dev)
+		return;
+
+	FLOAT value = 0;
+	for (auto _ : state) {
+		if (!Bench_Check(state, SetDevAxisPct(dev.Handle(), (HID_USAGES)HID_USAGE_Y, value), "SetDevAxisPct"))
+			break;
+		value = value >= 100 ? 0 : value + 0.5f;
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_SetDevAxisPct)->Apply(Bench_AllTypes);
+
+void BM_SetDevButton(benchmark::State & state)
+{
+	BenchDevice dev(state);
+	if (!dev)
+		return;
+
+	BOOL press = TRUE;
+	for (auto _ : state) {
+		if (!Bench_Check(state, SetDevButton(dev.Handle(), 1, press), "SetDevButton"))
+			break;
+		press = !press;
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_SetDevButton)->Apply(Bench_AllTypes);
+
+// The press and scheduling its release; releases are due after the run, each pulse moves the one of its button
+void BM_PulseDevButton(benchmark::State & state)
+{
+	BenchDevice dev(state);
+	if (!dev)
+		return;
+
+	UINT button = 0;
+	for (auto _ : state) {
+		if (!Bench_Check(state, PulseDevButton(dev.Handle(), 1 + button, 60000), "PulseDevButton"))
+			break;
+		button = (button + 1) % 10;
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_PulseDevButton)->Apply(Bench_AllTypes);
+
+void BM_SetDevPov(benchmark::State & state)
+{
+	BenchDevice dev(state);
+	if (!dev)
+		return;
+
+	DWORD value = 0;
+	for (auto _ : state) {
+		if (!Bench_Check(state, SetDevPov(dev.Handle(), 1, value), "SetDevPov"))
+			break;
+		value = (value + 4500) % 36000;
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_SetDevPov)->Apply(Bench_AllTypes);
+
+void BM_GetPosition(benchmark::State & state)
+{
+	BenchDevice dev(state);
+	if (!dev)
+		return;
+
+	union {
+		JOYSTICK_POSITION_V2 vJoy;
+		XINPUT_GAMEPAD xbox;
+		DS4_REPORT ds4;
+	} position;
+	for (auto _ : state) {
+		if (!Bench_Check(state, GetPosition(dev.Handle(), &position), "GetPosition"))
+			break;
+		benchmark::DoNotOptimize(position);
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_GetPosition)->Apply(Bench_AllTypes);
+
+void BM_AcquireRelinquish(benchmark::State & state)
+{
+	const DevType type = (DevType)state.range(0);
+	state.SetLabel(Bench_TypeName(type));
+	if (!Bench_Check(state, SelectBackend(BackendSimulated), "SelectBackend"))
+		return;
+
+	HDEVICE hDev;
+	for (auto _ : state) {
+		if (!Bench_Check(state, AcquireDev(1, type, &hDev), "AcquireDev") ||
+			!Bench_Check(state, RelinquishDev(hDev), "RelinquishDev"))
+			break;
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_AcquireRelinquish)->Apply(Bench_AllTypes);
+
+// The same on the uinput backend writing into memory: one batch of changed controls and a SYN_REPORT per call
+void BM_SetDevAxisUinput(benchmark::State & state)
+{
+	const DevType type = (DevType)state.range(0);
+	state.SetLabel(Bench_TypeName(type));
+	HDEVICE hDev = INVALID_DEV;
+	if (!Bench_Check(state, SelectBackend(BackendUinputMemory), "SelectBackend") ||
+		!Bench_Check(state, AcquireDev(1, type, &hDev), "AcquireDev"))
+		return;
+
+	LONG value = 0;
+	for (auto _ : state) {
+		if (!Bench_Check(state, SetDevAxis(hDev, (HID_USAGES)HID_USAGE_X, value), "SetDevAxis"))
+			break;
+		value = (value + 97) & 0x7FFF;
+	}
+	state.SetItemsProcessed(state.iterations());
+	RelinquishDev(hDev);
+}
+BENCHMARK(BM_SetDevAxisUinput)->Apply(Bench_AllTypes);
+
+// Every thread drives its own device, all go through the device registry at once
+void BM_SetDevAxisThreads(benchmark::State & state)
+{
+	HDEVICE hDev = INVALID_DEV;
+	if (!Bench_Check(state, SelectBackend(BackendSimulated), "SelectBackend") ||
+		!Bench_Check(state, AcquireDev(state.thread_index() + 1, vJoy, &hDev), "AcquireDev"))
+		return;
+
+	LONG value = 0;
+	for (auto _ : state) {
+		if (!Bench_Check(state, SetDevAxis(hDev, (HID_USAGES)HID_USAGE_X, value), "SetDevAxis"))
+			break;
+		value = (value + 97) & 0x7FFF;
+	}
+	state.SetItemsProcessed(state.iterations());
+	RelinquishDev(hDev);
+}
+BENCHMARK(BM_SetDevAxisThreads)->Arg(vJoy)->ThreadRange(1, 8)->UseRealTime();
+
+}  // namespace
+
+int main(int argc, char ** argv)
+{
+	benchmark::Initialize(&argc, argv);
+	if (benchmark::ReportUnrecognizedArguments(argc, argv))
+		return 1;
+
+	benchmark::RunSpecifiedBenchmarks();
+	benchmark::Shutdown();
+	DeInit();
+	return g_failed ? 1 : 0;
+}
@@ -0,0 +1,212 @@
+// vGenDaemonBench.cpp : Throughput of the cross-process feeding paths (Google Benchmark).
+//
+// The daemon runs on a thread of this process, on a unix socket in /tmp and the simulated bus; the feeder is a
+// vGenClient, so every number includes both sockets, the frame decoding and the backend submit. The shared-memory
+// channel runs the same way, fed by a vGenShmFeeder. Exits with 1 if any call failed, as vGenBench.
+
+#include "vGenClient.h"
+#include "vGenShmFeeder.h"
+
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <stdio.h>
+#include <thread>
+#include <unistd.h>
+
+using namespace vGenNS;
+
+namespace {
+
+std::atomic_bool g_failed{ false };
+char g_address[64];
+char g_channel[64];
+
+bool Bench_Check(benchmark::State & state, DWORD res, const char * call)
+{
+	if (res == STATUS_SUCCESS)
+		return true;
+
+	char msg[96];
+	snprintf(msg, sizeof(msg), "%s returned 0x%08X", call, (unsigned)res);
+	state.SkipWithError(msg);
+	g_failed = true;
+	return false;
+}
+
+// A client holding vJoy device 1 for the benchmark
+class BenchFeeder
+{
+public:
+	static const int Device = 1;
+
+	explicit BenchFeeder(benchmark::State & state)
+	{
+		m_ok = Bench_Check(state, m_client.Connect(g_address), "Connect") &&
+			Bench_Check(state, m_client.Acquire(Device), "Acquire");
+	}
+
+	vGenClient & Client() { return m_client; }
+	explicit operator bool() const { return m_ok; }
+
+private:
+	vGenClient m_client;
+	bool m_ok;
+};
+
+// One request and its reply
+void BM_DaemonRoundTrip(benchmark::State & state)
+{
+	BenchFeeder feeder(state);
+	if (!feeder)
+		return;
+
+	LONG value = 0;
+	for (auto _ : state) {
+		feeder.Client().SetAxis(BenchFeeder::Device, (HID_USAGES)HID_USAGE_X, value);
+		if (!Bench_Check(state, feeder.Client().Commit(BenchFeeder::Device), "Commit"))
+			break;
+		value = (value + 97) & 0x7FFF;
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_DaemonRoundTrip)->UseRealTime();
+
+// A frame of range(0) control changes and a commit, waiting for the answer. Items are control changes.
+void BM_DaemonFrame(benchmark::State & state)
+{
+	BenchFeeder feeder(state);
+	if (!feeder)
+		return;
+
+	const int changes = (int)state.range(0);
+	LONG value = 0;
+	for (auto _ : state) {
+		for (int i = 0; i < changes; ++i) {
+			if (i % 2)
+				feeder.Client().SetButton(BenchFeeder::Device, 1 + i % 32, value & 1);
+			else
+				feeder.Client().SetAxis(BenchFeeder::Device, (HID_USAGES)(HID_USAGE_X + i / 2 % 8), value);
+		}
+		if (!Bench_Check(state, feeder.Client().Commit(BenchFeeder::Device), "Commit"))
+			break;
+		value = (value + 97) & 0x7FFF;
+	}
+	state.SetItemsProcessed(state.iterations() * changes);
+}
+BENCHMARK(BM_DaemonFrame)->Arg(1)->Arg(8)->Arg(32)->Arg(VGEN_PROTO_MAX_FRAME - 1)->UseRealTime();
+
+// Frames sent without waiting; one commit in 64 waits, which keeps the socket buffers from filling up
+void BM_DaemonPipelined(benchmark::State & state)
+{
+	BenchFeeder feeder(state);
+	if (!feeder)
+		return;
+
+	LONG value = 0;
+	for (auto _ : state) {
+		feeder.Client().SetAxis(BenchFeeder::Device, (HID_USAGES)HID_USAGE_X, value);
+		const bool wait = (value & 63) == 0;
+		if (!Bench_Check(state, feeder.Client().Commit(BenchFeeder::Device, wait), "Commit"))
+			break;
+		++value;
+	}
+	Bench_Check(state, feeder.Client().Commit(BenchFeeder::Device), "Commit");
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_DaemonPipelined)->UseRealTime();
+
+// A shared-memory feeder holding vJoy device 2
+class BenchShmFeeder
+{
+public:
+	static const int Device = 2;
+
+	explicit BenchShmFeeder(benchmark::State & state)
+	{
+		m_ok = Bench_Check(state, m_feeder.Open(g_channel), "Open") &&
+			Bench_Check(state, m_feeder.Acquire(Device), "Acquire");
+	}
+
+	vGenShmFeeder & Feeder() { return m_feeder; }
+	explicit operator bool() const { return m_ok; }
+
+private:
+	vGenShmFeeder m_feeder;
+	bool m_ok;
+};
+
+// range(0) control changes and a commit, then waiting until the channel applied them. Items are control changes.
+void BM_ShmFrame(benchmark::State & state)
+{
+	BenchShmFeeder feeder(state);
+	if (!feeder)
+		return;
+
+	const int changes = (int)state.range(0);
+	LONG value = 0;
+	for (auto _ : state) {
+		for (int i = 0; i < changes; ++i)
+			feeder.Feeder().SetAxis(BenchShmFeeder::Device, (HID_USAGES)(HID_USAGE_X + i % 8), value);
+		feeder.Feeder().Commit(BenchShmFeeder::Device);
+		if (!Bench_Check(state, feeder.Feeder().Sync(1000), "Sync"))
+			break;
+		value = (value + 97) & 0x7FFF;
+	}
+	state.SetItemsProcessed(state.iterations() * changes);
+}
+BENCHMARK(BM_ShmFrame)->Arg(1)->Arg(8)->Arg(32)->UseRealTime();
+
+// Change and commit without waiting; only a full ring makes the feeder wait
+void BM_ShmPipelined(benchmark::State & state)
+{
+	BenchShmFeeder feeder(state);
+	if (!feeder)
+		return;
+
+	LONG value = 0;
+	for (auto _ : state) {
+		while (feeder.Feeder().SetAxis(BenchShmFeeder::Device, (HID_USAGES)HID_USAGE_X, value & 0x7FFF) == STATUS_DEVICE_BUSY ||
+			feeder.Feeder().Commit(BenchShmFeeder::Device) == STATUS_DEVICE_BUSY)
+			;
+		++value;
+	}
+	Bench_Check(state, feeder.Feeder().Sync(1000), "Sync");
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ShmPipelined)->UseRealTime();
+
+}  // namespace
+
+int main(int argc, char ** argv)
+{
+	benchmark::Initialize(&argc, argv);
+	if (benchmark::ReportUnrecognizedArguments(argc, argv))
+		return 1;
+
+	snprintf(g_address, sizeof(g_address), "unix:/tmp/vgend-bench-%d", (int)getpid());
+	snprintf(g_channel, sizeof(g_channel), "bench-%d", (int)getpid());
+	if (SelectBackend(BackendSimulated) != STATUS_SUCCESS || OpenShmChannel(g_channel) != STATUS_SUCCESS)
+		return 1;
+
+	DWORD daemonRes = STATUS_SUCCESS;
+	std::thread daemon([&daemonRes] { daemonRes = RunDaemon(g_address); });
+
+	// Wait for the socket
+	vGenClient probe;
+	for (int i = 0; i < 500 && probe.Connect(g_address, 10) != STATUS_SUCCESS; ++i)
+		usleep(1000);
+	const bool up = probe.Connected();
+	probe.Disconnect();
+
+	if (up)
+		benchmark::RunSpecifiedBenchmarks();
+	else
+		fprintf(stderr, "vGenDaemonBench: no daemon on %s\n", g_address);
+
+	StopDaemon();
+	daemon.join();
+	benchmark::Shutdown();
+	DeInit();
+	return g_failed || !up || daemonRes != STATUS_SUCCESS ? 1 : 0;
+}
@@ -0,0 +1,79 @@
+// vGend.cpp : Runs the vGen daemon (RunDaemon) until SIGINT or SIGTERM.
+//
+//   vGend [--backend driver|sim|uinput] <address>
+//
+// address as for RunDaemon(): unix:<path> (not on Windows) or udp:[127.x.x.x:]<port>. The backend defaults to the library's default
+// (the drivers on Windows, the simulated bus without them). Prints the daemon statistics on exit.
+
+#include "vGenInterface.h"
+
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+
+using namespace vGenNS;
+
+namespace {
+
+void OnSignal(int)
+{
+	StopDaemon();
+}
+
+int Usage()
+{
+	fprintf(stderr, "usage: vGend [--backend driver|sim|uinput] unix:<path> | udp:[127.x.x.x:]<port>\n");
+	return 2;
+}
+
+}  // namespace
+
+int main(int argc, char ** argv)
+{
+	const char * address = nullptr;
+	const char * backend = nullptr;
+	for (int i = 1; i < argc; ++i) {
+		if (!strcmp(argv[i], "--backend") && i + 1 < argc)
+			backend = argv[++i];
+		else if (!address && argv[i][0] != '-')
+			address = argv[i];
+		else
+			return Usage();
+	}
+	if (!address)
+		return Usage();
+
+	if (backend) {
+		BackendType type;
+		if (!strcmp(backend, "driver"))
+			type = BackendDriver;
+		else if (!strcmp(backend, "sim"))
+			type = BackendSimulated;
+		else if (!strcmp(backend, "uinput"))
+			type = BackendUinput;
+		else
+			return Usage();
+
+		const DWORD res = SelectBackend(type);
+		if (res != STATUS_SUCCESS) {
+			fprintf(stderr, "vGend: backend %s: 0x%08X\n", backend, (unsigned)res);
+			return 1;
+		}
+	}
+
+	signal(SIGINT, OnSignal);
+	signal(SIGTERM, OnSignal);
+
+	const DWORD res = RunDaemon(address);
+	DaemonStats stats;
+	GetDaemonStats(&stats);
+	DeInit();
+	if (res != STATUS_SUCCESS) {
+		fprintf(stderr, "vGend: %s: 0x%08X\n", address, (unsigned)res);
+		return 1;
+	}
+
+	printf("vGend: %llu frames, %llu messages, %llu commits, %llu errors\n", (unsigned long long)stats.Frames,
+		(unsigned long long)stats.Messages, (unsigned long long)stats.Commits, (unsigned long long)stats.Errors);
+	return 0;
+}
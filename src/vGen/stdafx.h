@@ -5,14 +5,32 @@
 
 #pragma once
 
+// VGEN_DRIVERS: talk to the vJoy, XOutput and ViGEm drivers. Windows only, define VGEN_NO_DRIVERS to build without them.
+// Without the drivers the simulated bus is the only backend (see Backend.h).
+#if defined(_WIN32) && !defined(VGEN_NO_DRIVERS)
+#define VGEN_DRIVERS
+#endif
+
+// VGEN_FFB: the vJoy force feedback packets and effect engine (vGenFfb.cpp, vGenFfbEngine.cpp), part of the drivers.
+// vGenFfbTest builds them without the drivers, defining VGEN_FFB_STUBS: vJoy's FFB helpers are then stand-ins
+// (test/vJoyFfbStubs.h) and the test delivers the packets itself.
+#if defined(VGEN_DRIVERS) || defined(VGEN_FFB_STUBS)
+#define VGEN_FFB
+#endif
+
+#ifdef _WIN32
 #include "targetver.h"
 
 //#define WIN32_LEAN_AND_MEAN             // Exclude rarely-used stuff from Windows headers
 // Windows Header Files:
 #define WIN32_NO_STATUS
+#include <winsock2.h>  // Before windows.h, which would bring the older winsock.h (vGenDaemon.cpp)
 #include <windows.h>
 #undef WIN32_NO_STATUS
 #include <ntstatus.h>
+#endif
+
+#include "vGenCompat.h"
 
 
 // TODO: reference additional headers your program requires here
@@ -0,0 +1,492 @@
+// vGenFfbTest.cpp : Tests of the vJoy FFB packet queue, subscriptions and effect engine.
+//
+// Built without the drivers on stand-ins for vJoy's FFB helpers (vJoyFfbStubs.h): each case delivers canned FFB_DATA
+// packets to the callback the DLL registered with vJoy, as vJoy's FFB threads do, and checks what came out of
+// the internal FFB functions the exports forward to. The engine reads the axes of vJoy devices on the simulated bus.
+// The rumble bridge's records go into the feedback queue of a ViGEm device, which the host fills as well.
+
+#include "stdafx.h"
+#include "Private.h"
+#include "vGenTest.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+using namespace vGenNS;
+
+namespace {
+
+using TestClock = std::chrono::steady_clock;
+
+template <class Pred>
+bool WaitFor(Pred done, int timeoutMs = 2000)
+{
+	const TestClock::time_point end = TestClock::now() + std::chrono::milliseconds(timeoutMs);
+	while (!done()) {
+		if (TestClock::now() > end)
+			return false;
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	return true;
+}
+
+// Drops whatever earlier cases left in the packet queue
+void DrainPackets()
+{
+	FFB_PACKET packets[64];
+	UINT read = 0;
+	while (IJ_FfbReadPackets(packets, 64, &read, 0) == STATUS_SUCCESS)
+		;
+}
+
+LONG ForceX(UINT id)
+{
+	LONG x = 0, y = 0;
+	IJ_FfbGetForce(id, &x, &y);
+	return x;
+}
+
+FfbStubPacket EffectReport(UINT id, BYTE ebi, FFBEType type, BYTE direction = 64)
+{
+	FFB_EFF_REPORT report = {};
+	report.EffectBlockIndex = ebi;
+	report.EffectType = type;
+	report.Duration = 0xFFFF;
+	report.Gain = 0xFF;
+	report.Polar = TRUE;
+	report.Direction = direction;  // 64: 90 deg, right
+	return FfbStubPacket(id, PT_EFFREP, report);
+}
+
+FfbStubPacket ConstantReport(UINT id, BYTE ebi, LONG magnitude)
+{
+	FFB_EFF_CONSTANT constant = {};
+	constant.EffectBlockIndex = ebi;
+	constant.Magnitude = magnitude;
+	return FfbStubPacket(id, PT_CONSTREP, constant);
+}
+
+FfbStubPacket OperationReport(UINT id, BYTE ebi, FFBOP op)
+{
+	FFB_EFF_OP operation = {};
+	operation.EffectBlockIndex = ebi;
+	operation.EffectOp = op;
+	operation.LoopCount = 1;
+	return FfbStubPacket(id, PT_EFOPREP, operation);
+}
+
+FfbStubPacket ControlReport(UINT id, FFB_CTRL control)
+{
+	return FfbStubPacket(id, PT_CTRLREP, control);
+}
+
+// Plays a constant force of `magnitude` to the right on device `id`, effect block 1
+void PlayConstant(UINT id, LONG magnitude)
+{
+	VGEN_CHECK(FfbStub_Deliver(EffectReport(id, 1, ET_CONST).Data()));
+	VGEN_CHECK(FfbStub_Deliver(ConstantReport(id, 1, magnitude).Data()));
+	VGEN_CHECK(FfbStub_Deliver(OperationReport(id, 1, EFF_START).Data()));
+}
+
+struct Calls
+{
+	std::atomic<int> Packets {0};
+	std::atomic<int> Raw {0};
+	std::atomic<int> Undecoded {0};
+	UINT Subscription = 0;  // Unsubscribed by the callback when set
+};
+
+void CALLBACK CountPacket(const FFB_PACKET *, PVOID data)
+{
+	++((Calls *)data)->Packets;
+}
+
+void CALLBACK CountRaw(PVOID packet, PVOID data)
+{
+	Calls & calls = *(Calls *)data;
+	++calls.Raw;
+	int id = 0;
+	if (vJoyNS::Ffb_h_DeviceID((const FFB_DATA *)packet, &id) != ERROR_SUCCESS)
+		++calls.Undecoded;
+}
+
+void CALLBACK UnsubscribeSelf(const FFB_PACKET *, PVOID data)
+{
+	Calls & calls = *(Calls *)data;
+	++calls.Packets;
+	VGEN_CHECK_EQ(IJ_FfbUnsubscribe(calls.Subscription), STATUS_SUCCESS);
+}
+
+// Holds the FFB thread in the callback until Release is set
+struct Gate
+{
+	std::atomic<bool> Entered {false};
+	std::atomic<bool> Release {false};
+};
+
+void CALLBACK WaitAtGate(const FFB_PACKET *, PVOID data)
+{
+	Gate & gate = *(Gate *)data;
+	gate.Entered = true;
+	while (!gate.Release)
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+}
+
+void CALLBACK CountForce(UINT rID, LONG, LONG, PVOID data)
+{
+	if (rID == 3)
+		++*(std::atomic<int> *)data;
+}
+
+}  // namespace
+
+VGEN_TEST(Packets_Decoded)
+{
+	DrainPackets();  // Also installs the callback
+	FFB_PACKET packets[8];
+	UINT read = 0;
+	VGEN_CHECK_EQ(IJ_FfbReadPackets(packets, 8, &read, 0), STATUS_TIMEOUT);
+
+	VGEN_CHECK(FfbStub_Deliver(EffectReport(2, 5, ET_SINE).Data()));
+	FFB_EFF_PERIOD period = {};
+	period.EffectBlockIndex = 5;
+	period.Magnitude = 8000;
+	period.Period = 250;
+	VGEN_CHECK(FfbStub_Deliver(FfbStubPacket(2, PT_PRIDREP, period).Data()));
+	VGEN_CHECK(FfbStub_Deliver(FfbStubPacket(2, PT_GAINREP, (BYTE)0x80).Data()));
+	VGEN_CHECK(FfbStub_Deliver(FfbStubPacket(2, PT_NEWEFREP, ET_SINE).Data()));
+	VGEN_CHECK(FfbStub_Deliver(FfbStubPacket(0, PT_GAINREP, (BYTE)0x80).Data()));  // No device: not queued
+
+	VGEN_CHECK_EQ(IJ_FfbReadPackets(packets, 8, &read, 1000), STATUS_SUCCESS);
+	if (VGEN_CHECK_EQ(read, 4)) {
+		for (UINT i = 0; i < 4; ++i) {
+			VGEN_CHECK_EQ(packets[i].DeviceID, 2);
+			VGEN_CHECK_EQ(packets[i].Sequence, packets[0].Sequence + i);
+		}
+		VGEN_CHECK_EQ(packets[0].Type, PT_EFFREP);
+		VGEN_CHECK_EQ(packets[0].EffectBlockIndex, 5);
+		VGEN_CHECK_EQ(packets[0].Report.EffectType, ET_SINE);
+		VGEN_CHECK_EQ(packets[1].Type, PT_PRIDREP);
+		VGEN_CHECK_EQ(packets[1].Period.Magnitude, 8000);
+		VGEN_CHECK_EQ(packets[1].Period.Period, 250);
+		VGEN_CHECK_EQ(packets[2].Type, PT_GAINREP);
+		VGEN_CHECK_EQ(packets[2].Gain, 0x80);
+		VGEN_CHECK_EQ(packets[2].EffectBlockIndex, 0);
+		VGEN_CHECK_EQ(packets[3].Type, PT_NEWEFREP);
+		VGEN_CHECK_EQ(packets[3].NewEffect, ET_SINE);
+	}
+
+	// A reader waiting for the next packet
+	std::thread feeder([]() {
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		FfbStub_Deliver(ControlReport(2, CTRL_DEVRST).Data());
+	});
+	VGEN_CHECK_EQ(IJ_FfbReadPackets(packets, 8, &read, 2000), STATUS_SUCCESS);
+	VGEN_CHECK_EQ(read, 1);
+	VGEN_CHECK_EQ(packets[0].Control, CTRL_DEVRST);
+	feeder.join();
+	IJ_FfbStopEngine();
+}
+
+VGEN_TEST(Packets_Subscribers)
+{
+	Calls all, device2, raw;
+	UINT subAll = 0, subDevice2 = 0;
+	VGEN_CHECK_EQ(IJ_FfbSubscribe(0, 0, &CountPacket, &all, &subAll), STATUS_SUCCESS);
+	VGEN_CHECK_EQ(IJ_FfbSubscribe(2, FFB_PT_MASK(PT_CONSTREP), &CountPacket, &device2, &subDevice2), STATUS_SUCCESS);
+	IJ_FfbRegisterGenCB(&CountRaw, &raw);
+
+	VGEN_CHECK(FfbStub_Deliver(ConstantReport(1, 1, 100).Data()));        // all
+	VGEN_CHECK(FfbStub_Deliver(ConstantReport(2, 1, 100).Data()));        // all, device2
+	VGEN_CHECK(FfbStub_Deliver(EffectReport(2, 1, ET_CONST).Data()));  // all: not in device2's mask
+	VGEN_CHECK(FfbStub_Deliver(ConstantReport(0, 1, 100).Data()));        // undecoded: raw only
+	VGEN_CHECK_EQ(all.Packets, 3);
+	VGEN_CHECK_EQ(device2.Packets, 1);
+	VGEN_CHECK_EQ(raw.Raw, 4);
+	VGEN_CHECK_EQ(raw.Undecoded, 1);
+
+	VGEN_CHECK_EQ(IJ_FfbUnsubscribe(subDevice2), STATUS_SUCCESS);
+	VGEN_CHECK_EQ(IJ_FfbUnsubscribe(subDevice2), STATUS_INVALID_PARAMETER_1);
+	IJ_FfbRegisterGenCB(nullptr, nullptr);
+	VGEN_CHECK(FfbStub_Deliver(ConstantReport(2, 1, 100).Data()));
+	VGEN_CHECK_EQ(all.Packets, 4);
+	VGEN_CHECK_EQ(device2.Packets, 1);
+	VGEN_CHECK_EQ(raw.Raw, 4);
+
+	// A callback unsubscribing itself
+	Calls self;
+	VGEN_CHECK_EQ(IJ_FfbSubscribe(1, 0, &UnsubscribeSelf, &self, &self.Subscription), STATUS_SUCCESS);
+	VGEN_CHECK(FfbStub_Deliver(ConstantReport(1, 1, 100).Data()));
+	VGEN_CHECK(FfbStub_Deliver(ConstantReport(1, 1, 100).Data()));
+	VGEN_CHECK_EQ(self.Packets, 1);
+
+	VGEN_CHECK_EQ(IJ_FfbUnsubscribe(subAll), STATUS_SUCCESS);
+	DrainPackets();
+	IJ_FfbStopEngine();
+}
+
+VGEN_TEST(Packets_Threads)
+{
+	// One FFB thread per device, as vJoy has, while subscriptions come and go
+	const int perThread = 2000;
+	std::atomic<bool> done {false};
+	std::vector<std::thread> feeders;
+	for (UINT id = 1; id <= 4; ++id) {
+		feeders.emplace_back([id]() {
+			const FfbStubPacket packet = ConstantReport(id, 1, 100 * id);
+			for (int i = 0; i < perThread; ++i)
+				FfbStub_Deliver(packet.Data());
+		});
+	}
+
+	DWORD last[5] = {};
+	UINT total = 0;
+	bool ordered = true;
+	std::thread reader([&]() {
+		FFB_PACKET packets[64];
+		UINT read = 0;
+		for (;;) {
+			const bool fed = done;
+			if (IJ_FfbReadPackets(packets, 64, &read, 10) != STATUS_SUCCESS) {
+				if (fed)
+					break;
+				continue;
+			}
+			for (UINT i = 0; i < read; ++i) {
+				const FFB_PACKET & p = packets[i];
+				if (p.DeviceID < 1 || p.DeviceID > 4 || p.Sequence <= last[p.DeviceID] || p.Constant.Magnitude != (LONG)(100 * p.DeviceID))
+					ordered = false;
+				else
+					last[p.DeviceID] = p.Sequence;
+			}
+			total += read;
+		}
+	});
+
+	int unsubscribed = 0;
+	while (unsubscribed < 200) {
+		Calls * calls = new Calls;
+		UINT sub = 0;
+		VGEN_CHECK_EQ(IJ_FfbSubscribe(0, 0, &CountPacket, calls, &sub), STATUS_SUCCESS);
+		std::this_thread::yield();
+		VGEN_CHECK_EQ(IJ_FfbUnsubscribe(sub), STATUS_SUCCESS);
+		delete calls;  // No callback may run any more
+		++unsubscribed;
+	}
+
+	for (std::thread & t : feeders)
+		t.join();
+	done = true;
+	reader.join();
+	VGEN_CHECK(ordered);
+	VGEN_CHECK(total > 0);
+	VGEN_CHECK(total <= 4 * perThread);
+	IJ_FfbStopEngine();
+}
+
+VGEN_TEST(Packets_UnsubscribeWaits)
+{
+	// Steady traffic doesn't hold up unsubscribing
+	std::atomic<bool> stop {false};
+	std::thread feeder([&stop]() {
+		const FfbStubPacket packet = ConstantReport(1, 1, 100);
+		while (!stop)
+			FfbStub_Deliver(packet.Data());
+	});
+	const TestClock::time_point start = TestClock::now();
+	for (int i = 0; i < 100; ++i) {
+		Calls calls;
+		UINT sub = 0;
+		VGEN_CHECK_EQ(IJ_FfbSubscribe(1, 0, &CountPacket, &calls, &sub), STATUS_SUCCESS);
+		VGEN_CHECK_EQ(IJ_FfbUnsubscribe(sub), STATUS_SUCCESS);
+	}
+	VGEN_CHECK(TestClock::now() - start < std::chrono::seconds(2));
+
+	// A callback still running holds up its own unsubscription, not that of subscribers added since
+	Gate gate;
+	UINT gated = 0;
+	VGEN_CHECK_EQ(IJ_FfbSubscribe(2, 0, &WaitAtGate, &gate, &gated), STATUS_SUCCESS);
+	std::thread held([]() { FfbStub_Deliver(ConstantReport(2, 1, 100).Data()); });
+	VGEN_CHECK(WaitFor([&gate]() { return gate.Entered.load(); }));
+
+	Calls calls;
+	UINT sub = 0;
+	VGEN_CHECK_EQ(IJ_FfbSubscribe(2, 0, &CountPacket, &calls, &sub), STATUS_SUCCESS);
+	VGEN_CHECK_EQ(IJ_FfbUnsubscribe(sub), STATUS_SUCCESS);
+
+	std::atomic<bool> unsubscribed {false};
+	std::thread unsubscriber([&]() {
+		VGEN_CHECK_EQ(IJ_FfbUnsubscribe(gated), STATUS_SUCCESS);
+		unsubscribed = true;
+	});
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	VGEN_CHECK(!unsubscribed);
+	gate.Release = true;
+	VGEN_CHECK(WaitFor([&unsubscribed]() { return unsubscribed.load(); }));
+
+	unsubscriber.join();
+	held.join();
+	stop = true;
+	feeder.join();
+	DrainPackets();
+	IJ_FfbStopEngine();
+}
+
+VGEN_TEST(Engine_Constant)
+{
+	std::atomic<int> forceCalls {0};
+	VGEN_CHECK_EQ(IJ_FfbSetForceTick(0), STATUS_INVALID_PARAMETER_1);
+	VGEN_CHECK_EQ(IJ_FfbSetForceTick(1), STATUS_SUCCESS);
+	IJ_FfbRegisterForceCB(&CountForce, &forceCalls);
+
+	PlayConstant(3, 5000);
+	VGEN_CHECK(WaitFor([]() { return ForceX(3) == 5000; }));
+	LONG x = 0, y = 1;
+	VGEN_CHECK_EQ(IJ_FfbGetForce(3, &x, &y), STATUS_SUCCESS);
+	VGEN_CHECK_EQ(y, 0);
+	VGEN_CHECK(forceCalls > 0);
+	VGEN_CHECK_EQ(IJ_FfbGetForce(17, &x, &y), STATUS_INVALID_PARAMETER_1);
+
+	// Device gain, then pause and stop
+	VGEN_CHECK(FfbStub_Deliver(FfbStubPacket(3, PT_GAINREP, (BYTE)0x80).Data()));
+	VGEN_CHECK(WaitFor([]() { return ForceX(3) == 5000 * 0x80 / 0xFF; }));
+	VGEN_CHECK(FfbStub_Deliver(ControlReport(3, CTRL_DEVPAUSE).Data()));
+	VGEN_CHECK(WaitFor([]() { return ForceX(3) == 0; }));
+	VGEN_CHECK(FfbStub_Deliver(ControlReport(3, CTRL_DEVCONT).Data()));
+	VGEN_CHECK(WaitFor([]() { return ForceX(3) != 0; }));
+	VGEN_CHECK(FfbStub_Deliver(ControlReport(3, CTRL_STOPALL).Data()));
+	VGEN_CHECK(WaitFor([]() { return ForceX(3) == 0; }));
+
+	IJ_FfbRegisterForceCB(nullptr, nullptr);
+	DrainPackets();
+	IJ_FfbStopEngine();
+}
+
+VGEN_TEST(Engine_SpringOnAxis)
+{
+	// The spring pushes against the axis of the vJoy device, as the DLL last sent it
+	const SimBusConfig config;
+	HDEVICE hDev = INVALID_DEV;
+	VGEN_CHECK_EQ(SelectBackend(BackendSimulated), STATUS_SUCCESS);
+	VGEN_CHECK_EQ(SetSimBusConfig(&config), STATUS_SUCCESS);
+	VGEN_CHECK_EQ(AcquireDev(1, vJoy, &hDev), STATUS_SUCCESS);
+	VGEN_CHECK_EQ(SetDevAxis(hDev, (HID_USAGES)HID_USAGE_X, 0x8000), STATUS_SUCCESS);
+
+	VGEN_CHECK(FfbStub_Deliver(EffectReport(1, 2, ET_SPRNG).Data()));
+	FFB_EFF_COND condition = {};
+	condition.EffectBlockIndex = 2;
+	condition.PosCoeff = 10000;
+	condition.NegCoeff = 10000;
+	VGEN_CHECK(FfbStub_Deliver(FfbStubPacket(1, PT_CONDREP, condition).Data()));
+	VGEN_CHECK(FfbStub_Deliver(OperationReport(1, 2, EFF_START).Data()));
+	VGEN_CHECK(WaitFor([]() { return ForceX(1) == -10000; }));
+
+	VGEN_CHECK_EQ(SetDevAxis(hDev, (HID_USAGES)HID_USAGE_X, 1), STATUS_SUCCESS);
+	VGEN_CHECK(WaitFor([]() { return ForceX(1) > 9900; }));
+
+	// Unplugged: the last position stays
+	VGEN_CHECK_EQ(RelinquishDev(hDev), STATUS_SUCCESS);
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	VGEN_CHECK(ForceX(1) > 9900);
+
+	DrainPackets();
+	IJ_FfbStopEngine();
+}
+
+VGEN_TEST(Engine_Rumble)
+{
+	const std::shared_ptr<DeviceFeedback> feedback = std::make_shared<DeviceFeedback>();
+	IJ_FfbSetRumbleTarget(4, feedback);
+	PlayConstant(4, 10000);
+
+	FeedbackData data[16];
+	UINT read = 0;
+	bool full = false;
+	const TestClock::time_point end = TestClock::now() + std::chrono::seconds(2);
+	while (!full && TestClock::now() < end) {
+		if (feedback->Read(data, 16, &read, 100) != STATUS_SUCCESS)
+			continue;
+		for (UINT i = 0; i < read; ++i) {
+			VGEN_CHECK_EQ(data[i].Flags, FeedbackRumble | FeedbackBridged);
+			full = full || data[i].LargeMotor == 255;
+		}
+	}
+	VGEN_CHECK(full);
+
+	// Stopped, the motors run down
+	VGEN_CHECK(FfbStub_Deliver(OperationReport(4, 1, EFF_STOP).Data()));
+	bool stopped = false;
+	while (!stopped && TestClock::now() < end + std::chrono::seconds(2)) {
+		if (feedback->Read(data, 16, &read, 100) != STATUS_SUCCESS)
+			continue;
+		stopped = data[read - 1].LargeMotor == 0 && data[read - 1].SmallMotor == 0;
+	}
+	VGEN_CHECK(stopped);
+
+	IJ_FfbSetRumbleTarget(4, nullptr);
+	DrainPackets();
+	IJ_FfbStopEngine();
+}
+
+VGEN_TEST(Rumble_AlongsideHost)
+{
+	// The host and the bridge publish at once, neither waiting for the other
+	DeviceFeedback feedback;
+	const UINT records = 2000;
+	std::atomic<int> running {2};
+	std::thread host([&]() {
+		for (UINT i = 0; i < records; ++i) {
+			FeedbackData data;
+			data.LedNumber = (BYTE)(i % 4 + 1);
+			data.ColorBar = 0xFF000000 | i;
+			feedback.Publish(data, FeedbackLed | FeedbackLightbar);
+		}
+		--running;
+	});
+	std::thread bridge([&]() {
+		for (UINT i = 0; i < records; ++i) {
+			FeedbackData data;
+			data.LargeMotor = (BYTE)(i % 255 + 1);
+			feedback.Publish(data, FeedbackRumble | FeedbackBridged);
+		}
+		--running;
+	});
+
+	// Every record once, the bridge's with the host's lights of one record
+	std::vector<bool> seen(2 * records + 1);
+	FeedbackData data[16];
+	UINT read = 0, total = 0;
+	bool ok = true;
+	for (;;) {
+		const bool done = !running;  // Before the read, which then gets the last records
+		if (feedback.Read(data, 16, &read, 10) != STATUS_SUCCESS) {
+			if (done)
+				break;
+			continue;
+		}
+		for (UINT i = 0; ok && i < read; ++i) {
+			const FeedbackData & rec = data[i];
+			ok = VGEN_CHECK(rec.Sequence >= 1 && rec.Sequence <= 2 * records && !seen[rec.Sequence]);
+			if (!ok)
+				break;
+			seen[rec.Sequence] = true;
+			if (rec.Flags & FeedbackBridged)
+				ok = VGEN_CHECK(rec.LargeMotor && (!rec.LedNumber || (rec.ColorBar & 0xFFFF) % 4 + 1 == rec.LedNumber));
+			else
+				ok = VGEN_CHECK_EQ(rec.Flags, FeedbackLed | FeedbackLightbar) && VGEN_CHECK_EQ(rec.LargeMotor, 0);
+		}
+		total += read;
+	}
+	host.join();
+	bridge.join();
+	VGEN_CHECK_EQ(total + feedback.Dropped, 2 * records);
+}
+
+int main()
+{
+	const int res = vGenTest::Main();
+	DeInit();
+	return res;
+}
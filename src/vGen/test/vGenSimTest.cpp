@@ -0,0 +1,948 @@
+// vGenSimTest.cpp : Tests of the Common API on the simulated bus.
+//
+// Every case goes through the exports, as an application does, and checks what the bus received (GetSimBusReport,
+// GetSimBusStats), the feedback the host sent back (SendSimBusFeedback, SendSimBusDs4Report, GetDevFeedback) and what
+// the timer thread did. A shared-memory channel is fed from this process, as another process would.
+// Timed checks poll for the expected state with a generous deadline, so that a loaded machine doesn't fail them.
+
+#include "vGenInterface.h"
+#include "vGenShmFeeder.h"
+#include "vGenTest.h"
+
+#include <chrono>
+#include <cstdio>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+using namespace vGenNS;
+
+namespace {
+
+using TestClock = std::chrono::steady_clock;
+
+// Acquires a device on a freshly configured simulated bus, releases it at the end
+class SimDevice
+{
+public:
+	SimDevice(DevType type, UINT id = 1)
+		: m_type(type), m_id(id)
+	{
+		const SimBusConfig config;
+		VGEN_CHECK_EQ(SelectBackend(BackendSimulated), STATUS_SUCCESS);
+		VGEN_CHECK_EQ(SetSimBusConfig(&config), STATUS_SUCCESS);
+		VGEN_CHECK_EQ(AcquireDev(id, type, &m_hDev), STATUS_SUCCESS);
+	}
+
+	~SimDevice()
+	{
+		if (m_hDev != INVALID_DEV)
+			RelinquishDev(m_hDev);
+	}
+
+	HDEVICE Handle() const { return m_hDev; }
+
+	// The last report the bus received
+	template <class Report>
+	Report Sent() const
+	{
+		Report report;
+		memset(&report, 0, sizeof(report));
+		VGEN_CHECK_EQ(GetSimBusReport(m_type, m_id, &report), STATUS_SUCCESS);
+		return report;
+	}
+
+private:
+	DevType m_type;
+	UINT m_id;
+	HDEVICE m_hDev = INVALID_DEV;
+};
+
+ULONGLONG Submits()
+{
+	SimBusStats stats;
+	GetSimBusStats(&stats);
+	return stats.Submits;
+}
+
+// Polls `done` until it holds or `timeoutMs` passed
+template <class Pred>
+bool WaitFor(Pred done, int timeoutMs = 2000)
+{
+	const TestClock::time_point end = TestClock::now() + std::chrono::milliseconds(timeoutMs);
+	while (!done()) {
+		if (TestClock::now() > end)
+			return false;
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	return true;
+}
+
+MacroInstr Instr(MacroOp op, USHORT arg16 = 0, LONG arg32 = 0, BYTE arg8 = 0)
+{
+	MacroInstr instr;
+	instr.Op = op;
+	instr.Arg8 = arg8;
+	instr.Arg16 = arg16;
+	instr.Arg32 = arg32;
+	return instr;
+}
+
+bool TimersIdle()
+{
+	SchedulerStats now;
+	GetSchedulerStats(&now, FALSE);
+	return now.Pending == 0;
+}
+
+}  // namespace
+
+VGEN_TEST(Reports_vJoy)
+{
+	SimDevice dev(vJoy);
+	VGEN_CHECK_EQ(SetDevAxis(dev.Handle(), (HID_USAGES)HID_USAGE_X, 1000), STATUS_SUCCESS);
+	VGEN_CHECK_EQ(SetDevButton(dev.Handle(), 3, TRUE), STATUS_SUCCESS);
+	VGEN_CHECK_EQ(SetDevPov(dev.Handle(), 1, 9000), STATUS_SUCCESS);
+
+	const JOYSTICK_POSITION_V2 report = dev.Sent<JOYSTICK_POSITION_V2>();
+	VGEN_CHECK_EQ(report.bDevice, 1);
+	VGEN_CHECK_EQ(report.wAxisX, 1000);
+	VGEN_CHECK_EQ(report.lButtons, 0x4);
+	VGEN_CHECK_EQ(report.bHats, 9000);
+	VGEN_CHECK_EQ(Submits(), 3);
+}
+
+VGEN_TEST(Reports_Xbox)
+{
+	SimDevice dev(vgeXbox);
+	VGEN_CHECK_EQ(SetDevButton(dev.Handle(), 1, TRUE), STATUS_SUCCESS);
+	VGEN_CHECK_EQ(SetDevAxis(dev.Handle(), (HID_USAGES)HID_USAGE_X, 32767), STATUS_SUCCESS);
+	VGEN_CHECK_EQ(SetDevAxis(dev.Handle(), (HID_USAGES)HID_USAGE_LT, 32767), STATUS_SUCCESS);
+	VGEN_CHECK_EQ(SetDevDiscPov(dev.Handle(), 1, DPOV_North), STATUS_SUCCESS);
+
+	XINPUT_GAMEPAD report = dev.Sent<XINPUT_GAMEPAD>();
+	VGEN_CHECK_EQ(report.wButtons, XBTN_A | XBTN_DPAD_UP);
+	VGEN_CHECK_EQ(report.sThumbLX, 32766);
+	VGEN_CHECK_EQ(report.bLeftTrigger, 255);
+
+	// A write that changes nothing still reaches the bus; a refused one doesn't
+	const ULONGLONG submits = Submits();
+	VGEN_CHECK_EQ(SetDevButton(dev.Handle(), 1, TRUE), STATUS_SUCCESS);
+	VGEN_CHECK(SetDevButton(dev.Handle(), 99, TRUE) != STATUS_SUCCESS);
+	VGEN_CHECK_EQ(Submits(), submits + 1);
+
+	VGEN_CHECK_EQ(ResetDevPositions(dev.Handle()), STATUS_SUCCESS);
+	report = dev.Sent<XINPUT_GAMEPAD>();
+	VGEN_CHECK_EQ(report.wButtons, 0);
+	VGEN_CHECK_EQ(report.sThumbLX, 0);
+}
+
+VGEN_TEST(Reports_Ds4)
+{
+	SimDevice dev(vgeDS4);
+	VGEN_CHECK_EQ(SetDevAxis(dev.Handle(), (HID_USAGES)HID_USAGE_Y, 32767), STATUS_SUCCESS);
+	VGEN_CHECK_EQ(SetDevDiscPov(dev.Handle(), 1, DPOV_East), STATUS_SUCCESS);
+
+	const DS4_REPORT report = dev.Sent<DS4_REPORT>();
+	VGEN_CHECK_EQ(report.bThumbLY, 0);  // DS4 Y axes point down
+	VGEN_CHECK_EQ(report.wButtons & 0xF, DS4_BUTTON_DPAD_EAST);
+}
+
+VGEN_TEST(Feedback)
+{
+	SimDevice dev(vgeXbox);
+	FeedbackData data;
+	data.Flags = FeedbackRumble | FeedbackLed;
+	data.LargeMotor = 200;
+	data.SmallMotor = 10;
+	data.LedNumber = 2;
+	VGEN_CHECK_EQ(SendSimBusFeedback(vgeXbox, 1, &data), STATUS_SUCCESS);
+	VGEN_CHECK_EQ(SendSimBusFeedback(vgeXbox, 1, &data), STATUS_SUCCESS);  // Same values, not queued again
+	data.Flags = FeedbackRumble;
+	data.LargeMotor = 0;
+	VGEN_CHECK_EQ(SendSimBusFeedback(vgeXbox, 1, &data), STATUS_SUCCESS);
+
+	FeedbackData records[4];
+	UINT read = 0;
+	VGEN_CHECK_EQ(GetDevFeedback(dev.Handle(), records, 4, &read, 0), STATUS_SUCCESS);
+	if (VGEN_CHECK_EQ(read, 2)) {
+		VGEN_CHECK_EQ(records[0].Sequence, 1);
+		VGEN_CHECK_EQ(records[0].Flags, FeedbackRumble | FeedbackLed);
+		VGEN_CHECK_EQ(records[0].LargeMotor, 200);
+		VGEN_CHECK_EQ(records[0].LedNumber, 2);
+		VGEN_CHECK_EQ(records[1].Sequence, 2);
+		VGEN_CHECK_EQ(records[1].Flags, FeedbackRumble);
+		VGEN_CHECK_EQ(records[1].LargeMotor, 0);
+		VGEN_CHECK_EQ(records[1].SmallMotor, 10);
+		VGEN_CHECK_EQ(records[1].LedNumber, 2);  // Full state in every record
+	}
+	VGEN_CHECK_EQ(GetDevFeedback(dev.Handle(), records, 4, &read, 0), STATUS_TIMEOUT);
+
+	DeviceInfo info;
+	VGEN_CHECK_EQ(GetDevInfo(dev.Handle(), &info), STATUS_SUCCESS);
+	VGEN_CHECK_EQ(info.LedNumber, 2);
+
+	// vJoy devices get no feedback
+	VGEN_CHECK(SendSimBusFeedback(vJoy, 1, &data) != STATUS_SUCCESS);
+}
+
+VGEN_TEST(Ds4OutputReport)
+{
+	SimDevice dev(vgeDS4);
+
+	// USB report 0x05: rumble and lightbar
+	const BYTE usb[] = { 0x05, 0x03, 0x00, 0x00, 40, 220, 0x10, 0x20, 0x30 };
+	VGEN_CHECK_EQ(SendSimBusDs4Report(1, usb, sizeof(usb)), STATUS_SUCCESS);
+	// Bluetooth report 0x11, two more header bytes: flash only, the motors and the color stay
+	const BYTE bluetooth[] = { 0x11, 0xC0, 0x20, 0x04, 0x00, 0x00, 0, 0, 0x99, 0x99, 0x99, 25, 50 };
+	VGEN_CHECK_EQ(SendSimBusDs4Report(1, bluetooth, sizeof(bluetooth)), STATUS_SUCCESS);
+
+	FeedbackData records[4];
+	UINT read = 0;
+	VGEN_CHECK_EQ(GetDevFeedback(dev.Handle(), records, 4, &read, 0), STATUS_SUCCESS);
+	if (VGEN_CHECK_EQ(read, 2)) {
+		VGEN_CHECK_EQ(records[0].Flags, FeedbackRumble | FeedbackLightbar);
+		VGEN_CHECK_EQ(records[0].SmallMotor, 40);
+		VGEN_CHECK_EQ(records[0].LargeMotor, 220);
+		VGEN_CHECK_EQ(records[0].ColorBar, 0xFF102030);
+		VGEN_CHECK_EQ(records[1].Flags, FeedbackFlash);
+		VGEN_CHECK_EQ(records[1].FlashOn, 25);
+		VGEN_CHECK_EQ(records[1].FlashOff, 50);
+		VGEN_CHECK_EQ(records[1].LargeMotor, 220);
+		VGEN_CHECK_EQ(records[1].ColorBar, 0xFF102030);
+	}
+
+	DeviceInfo info;
+	VGEN_CHECK_EQ(GetDevInfo(dev.Handle(), &info), STATUS_SUCCESS);
+	VGEN_CHECK_EQ(info.ColorBar, 0xFF102030);
+
+	// Another report id, or none of the sections
+	const BYTE input[] = { 0x01, 0x03, 0x00, 0x00, 1, 1 };
+	VGEN_CHECK_EQ(SendSimBusDs4Report(1, input, sizeof(input)), STATUS_INVALID_PARAMETER_2);
+	const BYTE empty[] = { 0x05, 0x00 };
+	VGEN_CHECK_EQ(SendSimBusDs4Report(1, empty, sizeof(empty)), STATUS_INVALID_PARAMETER_2);
+	VGEN_CHECK_EQ(SendSimBusDs4Report(2, usb, sizeof(usb)), STATUS_DEVICE_NOT_CONNECTED);
+}
+
+VGEN_TEST(Timers_Pulse)
+{
+	SimDevice dev(vgeXbox);
+	VGEN_CHECK_EQ(PulseDevButton(dev.Handle(), 1, 20), STATUS_SUCCESS);
+	VGEN_CHECK_EQ(dev.Sent<XINPUT_GAMEPAD>().wButtons, XBTN_A);
+	VGEN_CHECK(WaitFor([&]() { return dev.Sent<XINPUT_GAMEPAD>().wButtons == 0; }));
+
+	// SetDevButton() cancels the release
+	VGEN_CHECK_EQ(PulseDevButton(dev.Handle(), 2, 20), STATUS_SUCCESS);
+	VGEN_CHECK_EQ(SetDevButton(dev.Handle(), 2, TRUE), STATUS_SUCCESS);
+	std::this_thread::sleep_for(std::chrono::milliseconds(60));
+	VGEN_CHECK_EQ(dev.Sent<XINPUT_GAMEPAD>().wButtons, XBTN_B);
+}
+
+VGEN_TEST(Timers_Turbo)
+{
+	SimDevice dev(vJoy);
+	VGEN_CHECK_EQ(SetDevButtonTurbo(dev.Handle(), 1, 50, 50), STATUS_SUCCESS);
+	VGEN_CHECK_EQ(dev.Sent<JOYSTICK_POSITION_V2>().lButtons, 1);
+	VGEN_CHECK(WaitFor([&]() { return dev.Sent<JOYSTICK_POSITION_V2>().lButtons == 0; }));
+	VGEN_CHECK(WaitFor([&]() { return dev.Sent<JOYSTICK_POSITION_V2>().lButtons == 1; }));
+
+	VGEN_CHECK_EQ(SetDevButtonTurbo(dev.Handle(), 1, 0, 50), STATUS_SUCCESS);
+	VGEN_CHECK_EQ(dev.Sent<JOYSTICK_POSITION_V2>().lButtons, 0);
+	const ULONGLONG submits = Submits();
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	VGEN_CHECK_EQ(Submits(), submits);
+}
+
+VGEN_TEST(Timers_Animation)
+{
+	SimDevice dev(vJoy);
+	VGEN_CHECK_EQ(SetDevAxis(dev.Handle(), (HID_USAGES)HID_USAGE_X, 0), STATUS_SUCCESS);
+	VGEN_CHECK_EQ(AnimateDevAxis(dev.Handle(), (HID_USAGES)HID_USAGE_X, 30000, 50, EaseLinear), STATUS_SUCCESS);
+	VGEN_CHECK(WaitFor([&]() { return dev.Sent<JOYSTICK_POSITION_V2>().wAxisX == 30000; }));
+
+	SchedulerStats stats;
+	VGEN_CHECK_EQ(GetSchedulerStats(&stats, FALSE), STATUS_SUCCESS);
+	VGEN_CHECK(stats.Running);
+	VGEN_CHECK(stats.Fired > 1);
+	VGEN_CHECK(WaitFor([]() { SchedulerStats now; GetSchedulerStats(&now, FALSE); return now.Pending == 0; }));
+
+	// SetDevAxis() stops an animation where it is
+	VGEN_CHECK_EQ(AnimateDevAxis(dev.Handle(), (HID_USAGES)HID_USAGE_X, 0, 1000, EaseLinear), STATUS_SUCCESS);
+	VGEN_CHECK_EQ(SetDevAxis(dev.Handle(), (HID_USAGES)HID_USAGE_X, 12345), STATUS_SUCCESS);
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	VGEN_CHECK_EQ(dev.Sent<JOYSTICK_POSITION_V2>().wAxisX, 12345);
+}
+
+VGEN_TEST(Timers_TimedWrite)
+{
+	SimDevice dev(vJoy);
+	ULONGLONG now = 0;
+	VGEN_CHECK_EQ(GetSchedulerTime(&now), STATUS_SUCCESS);
+	VGEN_CHECK_EQ(SetDevAxisAt(dev.Handle(), (HID_USAGES)HID_USAGE_Y, 5000, now + 30000), STATUS_SUCCESS);
+	VGEN_CHECK_EQ(SetDevButtonAt(dev.Handle(), 2, TRUE, now + 30000), STATUS_SUCCESS);
+
+	// Started after the calls: the writes stop them when they are made, as SetDevAxis() and SetDevButton() would
+	VGEN_CHECK_EQ(AnimateDevAxis(dev.Handle(), (HID_USAGES)HID_USAGE_Y, 30000, 1000, EaseLinear), STATUS_SUCCESS);
+	VGEN_CHECK_EQ(SetDevButtonTurbo(dev.Handle(), 2, 20, 10), STATUS_SUCCESS);
+	VGEN_CHECK(WaitFor([]() { SchedulerStats now; GetSchedulerStats(&now, FALSE); return now.Pending == 0; }));
+	const JOYSTICK_POSITION_V2 report = dev.Sent<JOYSTICK_POSITION_V2>();
+	VGEN_CHECK_EQ(report.wAxisY, 5000);
+	VGEN_CHECK_EQ(report.lButtons & 2, 2);
+
+	// Started before the call: it goes on while the write is held
+	VGEN_CHECK_EQ(AnimateDevAxis(dev.Handle(), (HID_USAGES)HID_USAGE_X, 30000, 1000, EaseLinear), STATUS_SUCCESS);
+	VGEN_CHECK_EQ(GetSchedulerTime(&now), STATUS_SUCCESS);
+	VGEN_CHECK_EQ(SetDevAxisAt(dev.Handle(), (HID_USAGES)HID_USAGE_X, 5000, now + 300000), STATUS_SUCCESS);
+	const LONG held = dev.Sent<JOYSTICK_POSITION_V2>().wAxisX;
+	VGEN_CHECK(WaitFor([&]() { return (LONG)dev.Sent<JOYSTICK_POSITION_V2>().wAxisX > held; }, 250));
+	VGEN_CHECK(WaitFor([&]() { return dev.Sent<JOYSTICK_POSITION_V2>().wAxisX == 5000; }));
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	VGEN_CHECK_EQ(dev.Sent<JOYSTICK_POSITION_V2>().wAxisX, 5000);
+}
+
+VGEN_TEST(Springs)
+{
+	SimDevice dev(vJoy);
+	const HID_USAGES x = (HID_USAGES)HID_USAGE_X;
+	AxisSpring spring;
+	spring.Stiffness = 20000;
+	VGEN_CHECK_EQ(SetDevAxisSpring(dev.Handle(), x, &spring), STATUS_INVALID_PARAMETER_3);
+	VGEN_CHECK_EQ(ReleaseDevAxis(dev.Handle(), x), STATUS_INVALID_PARAMETER_2);  // No model
+
+	// Held where SetDevAxis() puts it; let go of, back to Center, where the axis rests and stops being stepped
+	spring.Stiffness = 400;
+	spring.Damping = 40;
+	VGEN_CHECK_EQ(SetDevAxisSpring(dev.Handle(), x, &spring), STATUS_SUCCESS);
+	VGEN_CHECK_EQ(SetDevAxis(dev.Handle(), x, 0), STATUS_SUCCESS);
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	VGEN_CHECK_EQ(dev.Sent<JOYSTICK_POSITION_V2>().wAxisX, 0);
+	VGEN_CHECK_EQ(ReleaseDevAxis(dev.Handle(), x), STATUS_SUCCESS);
+	VGEN_CHECK(WaitFor([&]() { return dev.Sent<JOYSTICK_POSITION_V2>().wAxisX > 0; }, 250));
+	VGEN_CHECK(WaitFor(TimersIdle));
+	VGEN_CHECK_EQ(dev.Sent<JOYSTICK_POSITION_V2>().wAxisX, 0x4000);
+
+	// A detent close enough holds it, a little short of the detent where the pulls balance
+	spring.Stiffness = 100;
+	spring.Damping = 150;
+	spring.DetentStiffness = 5000;
+	spring.DetentWidth = 3000;
+	spring.DetentCount = 1;
+	spring.Detents[0] = 24000;
+	VGEN_CHECK_EQ(SetDevAxisSpring(dev.Handle(), x, &spring), STATUS_SUCCESS);
+	VGEN_CHECK_EQ(SetDevAxis(dev.Handle(), x, 26000), STATUS_SUCCESS);
+	VGEN_CHECK_EQ(ReleaseDevAxis(dev.Handle(), x), STATUS_SUCCESS);
+	VGEN_CHECK(WaitFor(TimersIdle));
+	const LONG detent = dev.Sent<JOYSTICK_POSITION_V2>().wAxisX;
+	VGEN_CHECK(detent > 23800 && detent < 24000);
+
+	// Setting or animating the axis takes hold of it again
+	spring = AxisSpring();
+	spring.Stiffness = 4;
+	spring.Damping = 4;
+	VGEN_CHECK_EQ(SetDevAxisSpring(dev.Handle(), x, &spring), STATUS_SUCCESS);
+	VGEN_CHECK_EQ(SetDevAxis(dev.Handle(), x, 0), STATUS_SUCCESS);
+	VGEN_CHECK_EQ(ReleaseDevAxis(dev.Handle(), x), STATUS_SUCCESS);
+	VGEN_CHECK(WaitFor([&]() { return dev.Sent<JOYSTICK_POSITION_V2>().wAxisX > 0; }, 250));
+	VGEN_CHECK_EQ(SetDevAxis(dev.Handle(), x, 5000), STATUS_SUCCESS);
+	VGEN_CHECK(WaitFor(TimersIdle, 250));
+	ULONGLONG submits = Submits();
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	VGEN_CHECK_EQ(Submits(), submits);
+	VGEN_CHECK_EQ(dev.Sent<JOYSTICK_POSITION_V2>().wAxisX, 5000);
+
+	VGEN_CHECK_EQ(ReleaseDevAxis(dev.Handle(), x), STATUS_SUCCESS);
+	VGEN_CHECK_EQ(AnimateDevAxis(dev.Handle(), x, 10000, 30, EaseLinear), STATUS_SUCCESS);
+	VGEN_CHECK(WaitFor(TimersIdle, 250));
+	VGEN_CHECK_EQ(dev.Sent<JOYSTICK_POSITION_V2>().wAxisX, 10000);
+
+	// Removing the model leaves the axis where it is
+	VGEN_CHECK_EQ(ReleaseDevAxis(dev.Handle(), x), STATUS_SUCCESS);
+	VGEN_CHECK(WaitFor([&]() { return dev.Sent<JOYSTICK_POSITION_V2>().wAxisX != 10000; }, 250));
+	VGEN_CHECK_EQ(SetDevAxisSpring(dev.Handle(), x, nullptr), STATUS_SUCCESS);
+	VGEN_CHECK(WaitFor(TimersIdle, 250));
+	submits = Submits();
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	VGEN_CHECK_EQ(Submits(), submits);
+	VGEN_CHECK_EQ(ReleaseDevAxis(dev.Handle(), x), STATUS_INVALID_PARAMETER_2);
+}
+
+VGEN_TEST(Macros_Check)
+{
+	UINT id = 0;
+	const MacroInstr spin[] = { Instr(MacroButton, 1, 0, 1), Instr(MacroButton, 1), Instr(MacroLoop, 0, 3) };
+	VGEN_CHECK_EQ(LoadMacro(spin, 3, &id), STATUS_INVALID_PARAMETER_1);  // A loop needs a wait
+	const MacroInstr forward[] = { Instr(MacroWait, 0, 5), Instr(MacroLoop, 1, 3) };
+	VGEN_CHECK_EQ(LoadMacro(forward, 2, &id), STATUS_INVALID_PARAMETER_1);
+	const MacroInstr bad[] = { Instr(MacroWait), Instr(MacroAxis, HID_USAGE_X, 0x8000), Instr((MacroOp)(MacroLoop + 1)) };
+	for (const MacroInstr & instr : bad)
+		VGEN_CHECK_EQ(LoadMacro(&instr, 1, &id), STATUS_INVALID_PARAMETER_1);
+	const std::vector<MacroInstr> tooLong(4097);
+	VGEN_CHECK_EQ(LoadMacro(tooLong.data(), 4097, &id), STATUS_INVALID_PARAMETER_1);
+	VGEN_CHECK_EQ(LoadMacro(tooLong.data(), 0, &id), STATUS_INVALID_PARAMETER_1);
+
+	const MacroInstr loop[] = { Instr(MacroButton, 1, 0, 1), Instr(MacroWait, 0, 5), Instr(MacroLoop, 0, 3) };
+	VGEN_CHECK_EQ(LoadMacro(loop, 3, &id), STATUS_SUCCESS);
+	VGEN_CHECK_EQ(UnloadMacro(id), STATUS_SUCCESS);
+	VGEN_CHECK_EQ(UnloadMacro(id), STATUS_INVALID_PARAMETER_1);
+	SimDevice dev(vJoy);
+	VGEN_CHECK_EQ(RunMacro(dev.Handle(), id), STATUS_INVALID_PARAMETER_2);
+}
+
+VGEN_TEST(Macros_Run)
+{
+	SimDevice dev(vJoy);
+	UINT id = 0;
+
+	// Counted loops, the inner one counting again from 0 each time the outer one reaches it: 3 x 2 presses
+	const MacroInstr counted[] = {
+		Instr(MacroButton, 1, 0, 1), Instr(MacroWait, 0, 5), Instr(MacroButton, 1), Instr(MacroWait, 0, 5),
+		Instr(MacroLoop, 0, 2), Instr(MacroLoop, 0, 3), Instr(MacroAxis, HID_USAGE_X, 30000),
+	};
+	VGEN_CHECK_EQ(LoadMacro(counted, 7, &id), STATUS_SUCCESS);
+	ULONGLONG submits = Submits();
+	VGEN_CHECK_EQ(RunMacro(dev.Handle(), id), STATUS_SUCCESS);
+	VGEN_CHECK_EQ(dev.Sent<JOYSTICK_POSITION_V2>().lButtons, 1);  // Up to the first wait before returning
+	VGEN_CHECK(WaitFor([&]() { return dev.Sent<JOYSTICK_POSITION_V2>().wAxisX == 30000; }));
+	VGEN_CHECK_EQ(Submits(), submits + 13);
+	VGEN_CHECK(WaitFor(TimersIdle));
+
+	// RunMacro() starts a running macro over, the old run stops
+	const MacroInstr steps[] = {
+		Instr(MacroAxis, HID_USAGE_X, 1000), Instr(MacroWait, 0, 20), Instr(MacroAxis, HID_USAGE_X, 2000),
+		Instr(MacroWait, 0, 20), Instr(MacroAxis, HID_USAGE_X, 3000),
+	};
+	VGEN_CHECK_EQ(LoadMacro(steps, 5, &id), STATUS_SUCCESS);
+	VGEN_CHECK_EQ(RunMacro(dev.Handle(), id), STATUS_SUCCESS);
+	VGEN_CHECK(WaitFor([&]() { return dev.Sent<JOYSTICK_POSITION_V2>().wAxisX == 2000; }));
+	submits = Submits();
+	VGEN_CHECK_EQ(RunMacro(dev.Handle(), id), STATUS_SUCCESS);
+	VGEN_CHECK_EQ(dev.Sent<JOYSTICK_POSITION_V2>().wAxisX, 1000);
+	VGEN_CHECK(WaitFor(TimersIdle));
+	VGEN_CHECK_EQ(dev.Sent<JOYSTICK_POSITION_V2>().wAxisX, 3000);
+	VGEN_CHECK_EQ(Submits(), submits + 3);
+
+	// 1024 instructions without a wait, then the run yields for a millisecond
+	std::vector<MacroInstr> busy;
+	for (LONG i = 1; i <= 1024; ++i)
+		busy.push_back(Instr(MacroAxis, HID_USAGE_X, i));
+	busy.push_back(Instr(MacroButton, 2, 0, 1));
+	VGEN_CHECK_EQ(LoadMacro(busy.data(), (UINT)busy.size(), &id), STATUS_SUCCESS);
+	VGEN_CHECK_EQ(RunMacro(dev.Handle(), id), STATUS_SUCCESS);
+	VGEN_CHECK_EQ(dev.Sent<JOYSTICK_POSITION_V2>().wAxisX, 1024);
+	VGEN_CHECK_EQ(dev.Sent<JOYSTICK_POSITION_V2>().lButtons & 2, 0);
+	VGEN_CHECK(WaitFor([&]() { return (dev.Sent<JOYSTICK_POSITION_V2>().lButtons & 2) != 0; }));
+
+	// An endless loop, which goes on unloaded, until StopMacro() leaves the controls as they are
+	const MacroInstr endless[] = {
+		Instr(MacroButton, 1, 0, 1), Instr(MacroWait, 0, 5), Instr(MacroButton, 1), Instr(MacroWait, 0, 5), Instr(MacroLoop, 0, 0),
+	};
+	VGEN_CHECK_EQ(LoadMacro(endless, 5, &id), STATUS_SUCCESS);
+	VGEN_CHECK_EQ(RunMacro(dev.Handle(), id), STATUS_SUCCESS);
+	VGEN_CHECK_EQ(UnloadMacro(id), STATUS_SUCCESS);
+	submits = Submits();
+	VGEN_CHECK(WaitFor([&]() { return Submits() > submits + 10; }));
+	VGEN_CHECK_EQ(StopMacro(dev.Handle(), id), STATUS_SUCCESS);
+	const JOYSTICK_POSITION_V2 stopped = dev.Sent<JOYSTICK_POSITION_V2>();
+	submits = Submits();
+	std::this_thread::sleep_for(std::chrono::milliseconds(30));
+	VGEN_CHECK_EQ(Submits(), submits);
+	VGEN_CHECK_EQ(dev.Sent<JOYSTICK_POSITION_V2>().lButtons, stopped.lButtons);
+	VGEN_CHECK(TimersIdle());
+}
+
+VGEN_TEST(Relinquish)
+{
+	HDEVICE hDev = INVALID_DEV;
+	{
+		SimDevice dev(vgeXbox);
+		hDev = dev.Handle();
+		VGEN_CHECK_EQ(SetDevButtonTurbo(hDev, 1, 100, 50), STATUS_SUCCESS);
+	}
+	XINPUT_GAMEPAD report;
+	VGEN_CHECK(GetSimBusReport(vgeXbox, 1, &report) != STATUS_SUCCESS);
+	VGEN_CHECK(SetDevButton(hDev, 1, TRUE) != STATUS_SUCCESS);
+	VGEN_CHECK(WaitFor([]() { SchedulerStats now; GetSchedulerStats(&now, FALSE); return now.Pending == 0; }));
+}
+
+VGEN_TEST(SlowPlugDoesNotBlock)
+{
+	SimDevice dev(vgeXbox);
+	SimBusConfig config;
+	config.PlugLatencyNs = 400000000;  // 400 ms
+	VGEN_CHECK_EQ(SetSimBusConfig(&config), STATUS_SUCCESS);
+
+	// While another device is being plugged in, this one's reports go through
+	HDEVICE other = INVALID_DEV;
+	DWORD acquired = STATUS_UNSUCCESSFUL;
+	std::thread plug([&]() { acquired = AcquireDev(2, vgeXbox, &other); });
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	const TestClock::time_point start = TestClock::now();
+	VGEN_CHECK_EQ(SetDevButton(dev.Handle(), 1, TRUE), STATUS_SUCCESS);
+	VGEN_CHECK(TestClock::now() - start < std::chrono::milliseconds(200));
+	HDEVICE busy = INVALID_DEV;
+	VGEN_CHECK_EQ(AcquireDev(2, vgeXbox, &busy), STATUS_DEVICE_BUSY);
+	plug.join();
+	VGEN_CHECK_EQ(acquired, STATUS_SUCCESS);
+
+	config.PlugLatencyNs = 0;
+	VGEN_CHECK_EQ(SetSimBusConfig(&config), STATUS_SUCCESS);
+	VGEN_CHECK_EQ(RelinquishDev(other), STATUS_SUCCESS);
+}
+
+VGEN_TEST(Routes_Transforms)
+{
+	SimDevice dev(vJoy);
+	const HDEVICE h = dev.Handle();
+	ControlRoute routes[5];
+	for (ControlRoute & route : routes) {
+		route.SrcDev = route.DstDev = h;
+		route.SrcIndex = HID_USAGE_X;
+	}
+	routes[0].Transform = RouteThreshold;
+	routes[0].DstKind = RouteButton;
+	routes[0].DstIndex = 1;
+	routes[0].Threshold = 0x6000;
+	routes[0].Hysteresis = 0x1000;
+	routes[1].Transform = RouteSplitLow;
+	routes[1].DstIndex = HID_USAGE_Z;
+	routes[2].Transform = RouteSplitHigh;
+	routes[2].DstIndex = HID_USAGE_RX;
+	routes[3].Transform = RouteScale;
+	routes[3].DstIndex = HID_USAGE_RY;
+	routes[3].Scale = 2;
+	routes[3].Offset = -0x4000;
+	routes[4].Transform = RouteCombine;
+	routes[4].SrcKind = RouteButton;
+	routes[4].SrcIndex = 2;
+	routes[4].SrcIndex2 = 3;
+	routes[4].DstIndex = HID_USAGE_Y;
+	UINT bad = 99;
+	VGEN_CHECK_EQ(SetControlRoutes(routes, 5, &bad), STATUS_SUCCESS);
+	VGEN_CHECK_EQ(dev.Sent<JOYSTICK_POSITION_V2>().wAxisY, 0x4000);  // Applied at once: neither button
+
+	// Threshold: pressed from 0x6000, released below 0x5000
+	const LONG threshold[] = { 0x6000, 0x5800, 0x4FFF, 0x5800, 0x6000 };
+	const LONG pressed[] = { 1, 1, 0, 0, 1 };
+	for (int i = 0; i < 5; ++i) {
+		VGEN_CHECK_EQ(SetDevAxis(h, (HID_USAGES)HID_USAGE_X, threshold[i]), STATUS_SUCCESS);
+		VGEN_CHECK_EQ(dev.Sent<JOYSTICK_POSITION_V2>().lButtons & 1, pressed[i]);
+	}
+
+	// Split and scale, clamped to 0-0x7FFF
+	VGEN_CHECK_EQ(SetDevAxis(h, (HID_USAGES)HID_USAGE_X, 1), STATUS_SUCCESS);
+	JOYSTICK_POSITION_V2 report = dev.Sent<JOYSTICK_POSITION_V2>();
+	VGEN_CHECK_EQ(report.wAxisZ, (0x4000 - 1) * 0x7FFF / 0x4000);
+	VGEN_CHECK_EQ(report.wAxisXRot, 0);
+	VGEN_CHECK_EQ(report.wAxisYRot, 0);
+	VGEN_CHECK_EQ(SetDevAxis(h, (HID_USAGES)HID_USAGE_X, 0x4000), STATUS_SUCCESS);
+	report = dev.Sent<JOYSTICK_POSITION_V2>();
+	VGEN_CHECK_EQ(report.wAxisZ, 0);
+	VGEN_CHECK_EQ(report.wAxisXRot, 0);
+	VGEN_CHECK_EQ(report.wAxisYRot, 0x4000);
+	VGEN_CHECK_EQ(SetDevAxis(h, (HID_USAGES)HID_USAGE_X, 0x7FFF), STATUS_SUCCESS);
+	report = dev.Sent<JOYSTICK_POSITION_V2>();
+	VGEN_CHECK_EQ(report.wAxisZ, 0);
+	VGEN_CHECK_EQ(report.wAxisXRot, 0x7FFF);
+	VGEN_CHECK_EQ(report.wAxisYRot, 0x7FFF);
+
+	// Combine: button 2 towards 0, button 3 towards 0x7FFF, the center for both
+	const UINT button[] = { 2, 3, 2, 3 };
+	const BOOL press[] = { TRUE, TRUE, FALSE, FALSE };
+	const LONG combined[] = { 0, 0x4000, 0x7FFF, 0x4000 };
+	for (int i = 0; i < 4; ++i) {
+		VGEN_CHECK_EQ(SetDevButton(h, button[i], press[i]), STATUS_SUCCESS);
+		VGEN_CHECK_EQ(dev.Sent<JOYSTICK_POSITION_V2>().wAxisY, combined[i]);
+	}
+
+	// Refused: a POV the device lacks, a transform that doesn't take the kinds
+	ControlRoute refused[2];
+	refused[0].SrcDev = refused[0].DstDev = refused[1].SrcDev = refused[1].DstDev = h;
+	refused[0].SrcIndex = HID_USAGE_X;
+	refused[0].DstIndex = HID_USAGE_Y;
+	refused[1].SrcKind = refused[1].DstKind = RoutePov;
+	refused[1].SrcIndex = 0x100;
+	refused[1].DstIndex = 1;
+	VGEN_CHECK_EQ(SetControlRoutes(refused, 2, &bad), STATUS_INVALID_PARAMETER_1);
+	VGEN_CHECK_EQ(bad, 1);
+	refused[1].SrcIndex = 1;
+	refused[1].Transform = RouteInvert;
+	VGEN_CHECK_EQ(SetControlRoutes(refused, 2, &bad), STATUS_INVALID_PARAMETER_1);
+	VGEN_CHECK_EQ(SetControlRoutes(nullptr, 0, nullptr), STATUS_SUCCESS);
+}
+
+VGEN_TEST(Routes_Depth)
+{
+	// X of each device drives X of the next: six devices, five routes
+	SimDevice dev1(vJoy, 1), dev2(vJoy, 2), dev3(vJoy, 3), dev4(vJoy, 4), dev5(vJoy, 5), dev6(vJoy, 6);
+	SimDevice * const devs[] = { &dev1, &dev2, &dev3, &dev4, &dev5, &dev6 };
+	ControlRoute routes[5];
+	for (int i = 0; i < 5; ++i) {
+		routes[i].SrcDev = devs[i]->Handle();
+		routes[i].DstDev = devs[i + 1]->Handle();
+		routes[i].SrcIndex = routes[i].DstIndex = HID_USAGE_X;
+	}
+	VGEN_CHECK_EQ(SetControlRoutes(routes, 5, nullptr), STATUS_SUCCESS);
+
+	// The report of device 1 leads to those of devices 2 to 5, ROUTE_MAX_DEPTH routes deep; device 6 has the value but
+	// it isn't sent
+	VGEN_CHECK_EQ(SetDevAxis(devs[0]->Handle(), (HID_USAGES)HID_USAGE_X, 1234), STATUS_SUCCESS);
+	for (int i = 0; i < 5; ++i)
+		VGEN_CHECK_EQ(devs[i]->Sent<JOYSTICK_POSITION_V2>().wAxisX, 1234);
+	VGEN_CHECK(devs[5]->Sent<JOYSTICK_POSITION_V2>().wAxisX != 1234);
+	VGEN_CHECK_EQ(SetDevButton(devs[5]->Handle(), 1, TRUE), STATUS_SUCCESS);
+	VGEN_CHECK_EQ(devs[5]->Sent<JOYSTICK_POSITION_V2>().wAxisX, 1234);
+
+	// Relinquishing a device removes the routes from and to it
+	VGEN_CHECK_EQ(RelinquishDev(devs[2]->Handle()), STATUS_SUCCESS);
+	VGEN_CHECK_EQ(SetDevAxis(devs[0]->Handle(), (HID_USAGES)HID_USAGE_X, 2000), STATUS_SUCCESS);
+	VGEN_CHECK_EQ(devs[1]->Sent<JOYSTICK_POSITION_V2>().wAxisX, 2000);
+	VGEN_CHECK_EQ(SetDevAxis(devs[3]->Handle(), (HID_USAGES)HID_USAGE_X, 3000), STATUS_SUCCESS);
+	VGEN_CHECK_EQ(devs[4]->Sent<JOYSTICK_POSITION_V2>().wAxisX, 3000);
+	HDEVICE again = INVALID_DEV;
+	VGEN_CHECK_EQ(AcquireDev(3, vJoy, &again), STATUS_SUCCESS);
+	VGEN_CHECK_EQ(SetDevAxis(devs[1]->Handle(), (HID_USAGES)HID_USAGE_X, 4000), STATUS_SUCCESS);
+	VGEN_CHECK(devs[2]->Sent<JOYSTICK_POSITION_V2>().wAxisX != 4000);
+	VGEN_CHECK_EQ(RelinquishDev(again), STATUS_SUCCESS);
+
+	UINT bad = 99;
+	VGEN_CHECK_EQ(SetControlRoutes(routes, 5, &bad), STATUS_INVALID_HANDLE);
+	VGEN_CHECK_EQ(bad, 1);
+	VGEN_CHECK_EQ(SetControlRoutes(nullptr, 0, nullptr), STATUS_SUCCESS);
+}
+
+VGEN_TEST(Mirror_Chain)
+{
+	SimDevice joy(vJoy), pad(vgeXbox), ds4(vgeDS4), back(vJoy, 2);
+	VGEN_CHECK_EQ(LinkDevMirror(joy.Handle(), pad.Handle()), STATUS_SUCCESS);
+	VGEN_CHECK_EQ(LinkDevMirror(pad.Handle(), ds4.Handle()), STATUS_SUCCESS);
+	VGEN_CHECK_EQ(LinkDevMirror(pad.Handle(), back.Handle()), STATUS_SUCCESS);
+
+	// Through both links: button 1 is A and Cross, the axis keeps its value
+	VGEN_CHECK_EQ(SetDevButton(joy.Handle(), 1, TRUE), STATUS_SUCCESS);
+	VGEN_CHECK_EQ(SetDevAxis(joy.Handle(), (HID_USAGES)HID_USAGE_X, 0x7FFF), STATUS_SUCCESS);
+	VGEN_CHECK_EQ(pad.Sent<XINPUT_GAMEPAD>().wButtons, XBTN_A);
+	VGEN_CHECK_EQ(pad.Sent<XINPUT_GAMEPAD>().sThumbLX, 32766);
+	VGEN_CHECK_EQ(ds4.Sent<DS4_REPORT>().wButtons & DS4_BUTTON_CROSS, DS4_BUTTON_CROSS);
+	VGEN_CHECK_EQ(ds4.Sent<DS4_REPORT>().bThumbLX, 255);
+	VGEN_CHECK_EQ(back.Sent<JOYSTICK_POSITION_V2>().lButtons, 1);
+
+	// The hat becomes the dpad, and the dpad a hat again
+	VGEN_CHECK_EQ(SetDevPov(joy.Handle(), 1, 4500), STATUS_SUCCESS);
+	VGEN_CHECK_EQ(pad.Sent<XINPUT_GAMEPAD>().wButtons, XBTN_A | XBTN_DPAD_UP | XBTN_DPAD_RIGHT);
+	VGEN_CHECK_EQ(back.Sent<JOYSTICK_POSITION_V2>().bHats, 4500);
+	VGEN_CHECK_EQ(SetDevDiscPov(pad.Handle(), 1, DPOV_West), STATUS_SUCCESS);
+	VGEN_CHECK_EQ(ds4.Sent<DS4_REPORT>().wButtons & 0xF, DS4_BUTTON_DPAD_WEST);
+	VGEN_CHECK_EQ(back.Sent<JOYSTICK_POSITION_V2>().bHats, 27000);
+	VGEN_CHECK_EQ(SetDevPov(joy.Handle(), 1, -1), STATUS_SUCCESS);  // The source's next report wins
+	VGEN_CHECK_EQ(pad.Sent<XINPUT_GAMEPAD>().wButtons, XBTN_A);
+	VGEN_CHECK_EQ(back.Sent<JOYSTICK_POSITION_V2>().bHats, (DWORD)-1);
+
+	// No loops, however long
+	VGEN_CHECK_EQ(LinkDevMirror(joy.Handle(), joy.Handle()), STATUS_INVALID_PARAMETER_2);
+	VGEN_CHECK_EQ(LinkDevMirror(pad.Handle(), joy.Handle()), STATUS_INVALID_PARAMETER_2);
+	VGEN_CHECK_EQ(LinkDevMirror(ds4.Handle(), joy.Handle()), STATUS_INVALID_PARAMETER_2);
+	VGEN_CHECK_EQ(LinkDevMirror(back.Handle(), pad.Handle()), STATUS_INVALID_PARAMETER_2);
+	VGEN_CHECK_EQ(LinkDevMirror(ds4.Handle(), back.Handle()), STATUS_SUCCESS);  // Two ways in, no way back
+
+	VGEN_CHECK_EQ(UnlinkDevMirror(pad.Handle(), ds4.Handle()), STATUS_SUCCESS);
+	VGEN_CHECK_EQ(UnlinkDevMirror(pad.Handle(), ds4.Handle()), STATUS_INVALID_PARAMETER_2);
+	VGEN_CHECK_EQ(SetDevButton(joy.Handle(), 1, FALSE), STATUS_SUCCESS);
+	VGEN_CHECK_EQ(back.Sent<JOYSTICK_POSITION_V2>().lButtons, 0);
+	VGEN_CHECK_EQ(ds4.Sent<DS4_REPORT>().wButtons & DS4_BUTTON_CROSS, DS4_BUTTON_CROSS);
+}
+
+VGEN_TEST(Mirror_DpadButtons)
+{
+	// Without a hat on the source the dpad follows buttons 12-19, diagonals included
+	SimDevice pad(vgeXbox);
+	SimBusConfig config;
+	config.vJoyContPovs = 0;
+	VGEN_CHECK_EQ(SetSimBusConfig(&config), STATUS_SUCCESS);
+	HDEVICE joy = INVALID_DEV;
+	VGEN_CHECK_EQ(AcquireDev(1, vJoy, &joy), STATUS_SUCCESS);
+	VGEN_CHECK_EQ(LinkDevMirror(joy, pad.Handle()), STATUS_SUCCESS);
+
+	VGEN_CHECK_EQ(SetDevButton(joy, 16, TRUE), STATUS_SUCCESS);  // Up-right
+	VGEN_CHECK_EQ(pad.Sent<XINPUT_GAMEPAD>().wButtons, XBTN_DPAD_UP | XBTN_DPAD_RIGHT);
+	VGEN_CHECK_EQ(SetDevButton(joy, 12, TRUE), STATUS_SUCCESS);  // Up
+	VGEN_CHECK_EQ(pad.Sent<XINPUT_GAMEPAD>().wButtons, XBTN_DPAD_UP | XBTN_DPAD_RIGHT);
+	// Releasing the diagonal, which comes after up, leaves up pressed
+	VGEN_CHECK_EQ(SetDevButton(joy, 16, FALSE), STATUS_SUCCESS);
+	VGEN_CHECK_EQ(pad.Sent<XINPUT_GAMEPAD>().wButtons, XBTN_DPAD_UP);
+
+	VGEN_CHECK_EQ(RelinquishDev(joy), STATUS_SUCCESS);
+	VGEN_CHECK_EQ(SetDevButton(pad.Handle(), 1, TRUE), STATUS_SUCCESS);  // The link went with the source
+}
+
+VGEN_TEST(Passthrough_Merge)
+{
+	SimDevice joy(vJoy);
+	XINPUT_STATE state = {};
+	state.Gamepad.sThumbLX = 20000;   // X 26384
+	state.Gamepad.sThumbLY = 100;     // Y 16434, in a deadzone of 500
+	state.Gamepad.wButtons = XBTN_B | XBTN_DPAD_LEFT;
+	VGEN_CHECK_EQ(SetSimBusPad(1, &state), STATUS_SUCCESS);
+	VGEN_CHECK_EQ(SetDevAxis(joy.Handle(), (HID_USAGES)HID_USAGE_Y, 1000), STATUS_SUCCESS);
+
+	// MergeMax: the side further from rest; the dpad is POV 1 and not buttons 12-19, buttons of both sides
+	PassthroughConfig config;
+	config.Slot = 1;
+	config.Deadzone = 500;
+	VGEN_CHECK_EQ(SetDevPassthrough(joy.Handle(), &config), STATUS_SUCCESS);
+	VGEN_CHECK(WaitFor([&] { return joy.Sent<JOYSTICK_POSITION_V2>().wAxisX == 26384; }));
+	VGEN_CHECK_EQ(joy.Sent<JOYSTICK_POSITION_V2>().wAxisY, 1000);
+	VGEN_CHECK_EQ(joy.Sent<JOYSTICK_POSITION_V2>().bHats, 27000);
+	VGEN_CHECK_EQ(joy.Sent<JOYSTICK_POSITION_V2>().lButtons, 0x2);
+	VGEN_CHECK_EQ(SetDevButton(joy.Handle(), 1, TRUE), STATUS_SUCCESS);
+	VGEN_CHECK_EQ(joy.Sent<JOYSTICK_POSITION_V2>().lButtons, 0x3);
+	VGEN_CHECK_EQ(SetDevAxis(joy.Handle(), (HID_USAGES)HID_USAGE_X, 0), STATUS_SUCCESS);
+	VGEN_CHECK_EQ(joy.Sent<JOYSTICK_POSITION_V2>().wAxisX, 0);
+	VGEN_CHECK_EQ(SetDevAxis(joy.Handle(), (HID_USAGES)HID_USAGE_X, 20000), STATUS_SUCCESS);
+	VGEN_CHECK_EQ(joy.Sent<JOYSTICK_POSITION_V2>().wAxisX, 26384);
+
+	// MergePadFirst: the pad wherever it is off rest, out of the deadzone
+	config.Merge = MergePadFirst;
+	VGEN_CHECK_EQ(SetDevPassthrough(joy.Handle(), &config), STATUS_SUCCESS);
+	VGEN_CHECK_EQ(SetDevAxis(joy.Handle(), (HID_USAGES)HID_USAGE_X, 0), STATUS_SUCCESS);
+	VGEN_CHECK_EQ(joy.Sent<JOYSTICK_POSITION_V2>().wAxisX, 26384);
+	VGEN_CHECK_EQ(joy.Sent<JOYSTICK_POSITION_V2>().wAxisY, 1000);
+	config.Deadzone = 0;
+	VGEN_CHECK_EQ(SetDevPassthrough(joy.Handle(), &config), STATUS_SUCCESS);
+	VGEN_CHECK_EQ(joy.Sent<JOYSTICK_POSITION_V2>().wAxisY, 16434);
+
+	// MergeFeederFirst: the application wherever it is off rest, POV 1 included
+	config.Merge = MergeFeederFirst;
+	VGEN_CHECK_EQ(SetDevPassthrough(joy.Handle(), &config), STATUS_SUCCESS);
+	VGEN_CHECK_EQ(joy.Sent<JOYSTICK_POSITION_V2>().wAxisX, 0);
+	VGEN_CHECK_EQ(joy.Sent<JOYSTICK_POSITION_V2>().wAxisY, 1000);
+	VGEN_CHECK_EQ(joy.Sent<JOYSTICK_POSITION_V2>().bHats, 27000);
+	VGEN_CHECK_EQ(SetDevPov(joy.Handle(), 1, 9000), STATUS_SUCCESS);
+	VGEN_CHECK_EQ(joy.Sent<JOYSTICK_POSITION_V2>().bHats, 9000);
+	VGEN_CHECK_EQ(ResetDevPositions(joy.Handle()), STATUS_SUCCESS);
+	VGEN_CHECK_EQ(joy.Sent<JOYSTICK_POSITION_V2>().wAxisX, 26384);
+	VGEN_CHECK_EQ(joy.Sent<JOYSTICK_POSITION_V2>().bHats, 27000);
+
+	// A button released on the pad goes back to what the application set
+	VGEN_CHECK_EQ(SetDevButton(joy.Handle(), 2, TRUE), STATUS_SUCCESS);
+	state.Gamepad.wButtons = XBTN_A;
+	VGEN_CHECK_EQ(SetSimBusPad(1, &state), STATUS_SUCCESS);
+	VGEN_CHECK(WaitFor([&] { return joy.Sent<JOYSTICK_POSITION_V2>().bHats == (DWORD)-1; }));
+	VGEN_CHECK_EQ(joy.Sent<JOYSTICK_POSITION_V2>().lButtons, 0x3);
+	state.Gamepad.wButtons = 0;
+	VGEN_CHECK_EQ(SetSimBusPad(1, &state), STATUS_SUCCESS);
+	VGEN_CHECK(WaitFor([&] { return joy.Sent<JOYSTICK_POSITION_V2>().lButtons == 0x2; }));
+
+	// Without a POV the dpad presses buttons 12-19
+	SimBusConfig noPov;
+	noPov.vJoyContPovs = 0;
+	VGEN_CHECK_EQ(SetSimBusConfig(&noPov), STATUS_SUCCESS);
+	HDEVICE buttons = INVALID_DEV;
+	VGEN_CHECK_EQ(AcquireDev(2, vJoy, &buttons), STATUS_SUCCESS);
+	VGEN_CHECK_EQ(SetDevPassthrough(buttons, &config), STATUS_SUCCESS);
+	state.Gamepad.wButtons = XBTN_DPAD_LEFT;
+	VGEN_CHECK_EQ(SetSimBusPad(1, &state), STATUS_SUCCESS);
+	JOYSTICK_POSITION_V2 report = {};
+	VGEN_CHECK(WaitFor([&] { return GetSimBusReport(vJoy, 2, &report) == STATUS_SUCCESS && report.lButtons == 1 << 14; }));
+	VGEN_CHECK_EQ(RelinquishDev(buttons), STATUS_SUCCESS);
+
+	// The application's report is never written
+	VGEN_CHECK_EQ(SetDevPassthrough(joy.Handle(), nullptr), STATUS_SUCCESS);
+	VGEN_CHECK_EQ(joy.Sent<JOYSTICK_POSITION_V2>().wAxisX, 16384);
+	VGEN_CHECK_EQ(joy.Sent<JOYSTICK_POSITION_V2>().lButtons, 0x2);
+
+	// Not the slot of one of vGen's own pads, whose LED shows its slot, nor a bad setting
+	SimDevice own(vgeXbox, 2);
+	VGEN_CHECK_EQ(SetDevPassthrough(joy.Handle(), &config), STATUS_INVALID_PARAMETER_2);
+	config.Slot = 0;
+	VGEN_CHECK_EQ(SetDevPassthrough(joy.Handle(), &config), STATUS_SUCCESS);
+	config.Slot = 4;
+	VGEN_CHECK_EQ(SetDevPassthrough(joy.Handle(), &config), STATUS_INVALID_PARAMETER_2);
+	config.Slot = 0;
+	config.Deadzone = -1;
+	VGEN_CHECK_EQ(SetDevPassthrough(joy.Handle(), &config), STATUS_INVALID_PARAMETER_2);
+	config.Deadzone = 0;
+	config.Merge = (PassthroughMerge)(MergeFeederFirst + 1);
+	VGEN_CHECK_EQ(SetDevPassthrough(joy.Handle(), &config), STATUS_INVALID_PARAMETER_2);
+
+	VGEN_CHECK_EQ(SetDevPassthrough(joy.Handle(), nullptr), STATUS_SUCCESS);
+	VGEN_CHECK_EQ(SetSimBusPad(1, nullptr), STATUS_SUCCESS);
+}
+
+VGEN_TEST(PadReader_Snapshot)
+{
+	const SimBusConfig bus;
+	VGEN_CHECK_EQ(SelectBackend(BackendSimulated), STATUS_SUCCESS);
+	VGEN_CHECK_EQ(SetSimBusConfig(&bus), STATUS_SUCCESS);
+	PadPollConfig config;
+	config.IntervalUs = 999;
+	VGEN_CHECK_EQ(SetPadPollConfig(&config), STATUS_INVALID_PARAMETER_1);
+	config.IntervalUs = 50000;
+	config.EmptyProbeMs = 64;
+	VGEN_CHECK_EQ(SetPadPollConfig(&config), STATUS_SUCCESS);
+	PadPollStats stats;
+	VGEN_CHECK_EQ(GetPadPollStats(&stats, TRUE), STATUS_SUCCESS);
+
+	// The first call reads the slot, the next ones are served from the snapshot between two polls
+	XINPUT_STATE state = {}, read = {};
+	state.Gamepad.sThumbLX = 1234;
+	VGEN_CHECK_EQ(SetSimBusPad(2, &state), STATUS_SUCCESS);
+	VGEN_CHECK_EQ(GetXInputState(4, &read), ERROR_BAD_ARGUMENTS);
+	const TestClock::time_point start = TestClock::now();
+	for (int i = 0; i < 100; ++i) {
+		if (!VGEN_CHECK_EQ(GetXInputState(2, &read), ERROR_SUCCESS) || !VGEN_CHECK_EQ(read.Gamepad.sThumbLX, 1234))
+			break;
+	}
+	const ULONGLONG elapsedMs = std::chrono::duration_cast<std::chrono::milliseconds>(TestClock::now() - start).count();
+	VGEN_CHECK_EQ(GetPadPollStats(&stats, FALSE), STATUS_SUCCESS);
+	VGEN_CHECK_EQ(stats.Served, 100);
+	VGEN_CHECK(stats.Reads <= elapsedMs / 50 + 2);
+
+	// Which the reader keeps up to date
+	state.Gamepad.sThumbLX = 4321;
+	VGEN_CHECK_EQ(SetSimBusPad(2, &state), STATUS_SUCCESS);
+	VGEN_CHECK(WaitFor([&] { return GetXInputState(2, &read) == ERROR_SUCCESS && read.Gamepad.sThumbLX == 4321; }));
+
+	// An empty slot is probed after a wait that doubles up to EmptyProbeMs, skipped in the polls between
+	config.IntervalUs = 1000;
+	VGEN_CHECK_EQ(SetPadPollConfig(&config), STATUS_SUCCESS);
+	VGEN_CHECK_EQ(GetXInputState(3, &read), ERROR_DEVICE_NOT_CONNECTED);
+	VGEN_CHECK_EQ(GetPadPollStats(&stats, TRUE), STATUS_SUCCESS);
+	const TestClock::time_point empty = TestClock::now();
+	std::this_thread::sleep_for(std::chrono::milliseconds(300));
+	VGEN_CHECK_EQ(GetPadPollStats(&stats, FALSE), STATUS_SUCCESS);
+	const ULONGLONG emptyMs = std::chrono::duration_cast<std::chrono::milliseconds>(TestClock::now() - empty).count();
+	VGEN_CHECK(stats.Probes >= 1);
+	VGEN_CHECK(stats.Probes <= emptyMs / config.EmptyProbeMs + 3);  // 16, 32, then every 64 ms
+	VGEN_CHECK(stats.Skipped > stats.Probes);
+	VGEN_CHECK(stats.Reads >= stats.Polls);  // Slot 2, at every poll
+	VGEN_CHECK_EQ(stats.Served, 0);
+	VGEN_CHECK_EQ(stats.Connected, 1 << 2);
+
+	// A pad plugged into it is found at the next probe
+	VGEN_CHECK_EQ(SetSimBusPad(3, &state), STATUS_SUCCESS);
+	VGEN_CHECK(WaitFor([&] { return GetXInputState(3, &read) == ERROR_SUCCESS; }));
+	VGEN_CHECK_EQ(read.Gamepad.sThumbLX, 4321);
+	VGEN_CHECK_EQ(GetPadPollStats(&stats, TRUE), STATUS_SUCCESS);
+	VGEN_CHECK_EQ(stats.Connected, 1 << 2 | 1 << 3);
+
+	VGEN_CHECK_EQ(SetSimBusPad(2, nullptr), STATUS_SUCCESS);
+	VGEN_CHECK_EQ(SetSimBusPad(3, nullptr), STATUS_SUCCESS);
+	VGEN_CHECK(WaitFor([&] { return GetXInputState(2, &read) == ERROR_DEVICE_NOT_CONNECTED; }));
+	const PadPollConfig defaults;
+	VGEN_CHECK_EQ(SetPadPollConfig(&defaults), STATUS_SUCCESS);
+}
+
+VGEN_TEST(Trace_RoundTrip)
+{
+	const char * const file = "vGenSimTest.trace";
+	const SimBusConfig defaults;
+	VGEN_CHECK_EQ(SelectBackend(BackendSimulated), STATUS_SUCCESS);
+	VGEN_CHECK_EQ(SetSimBusConfig(&defaults), STATUS_SUCCESS);
+	HDEVICE before = INVALID_DEV, joy = INVALID_DEV, none = INVALID_DEV;
+	VGEN_CHECK_EQ(AcquireDev(1, vgeDS4, &before), STATUS_SUCCESS);  // The trace starts with it
+
+	VGEN_CHECK_EQ(StartTrace(file), STATUS_SUCCESS);
+	VGEN_CHECK_EQ(StartTrace(file), STATUS_INVALID_DEVICE_STATE);
+	VGEN_CHECK_EQ(AcquireDev(1, vJoy, &joy), STATUS_SUCCESS);
+	VGEN_CHECK(AcquireDev(5, vXbox, &none) != STATUS_SUCCESS);
+	VGEN_CHECK(SetDevButton(none, 1, TRUE) != STATUS_SUCCESS);
+	VGEN_CHECK_EQ(SetDevAxis(joy, (HID_USAGES)HID_USAGE_X, 1000), STATUS_SUCCESS);
+	VGEN_CHECK_EQ(SetDevButton(joy, 3, TRUE), STATUS_SUCCESS);
+	VGEN_CHECK(SetDevButton(joy, 200, TRUE) != STATUS_SUCCESS);
+	JOYSTICK_POSITION_V2 position;
+	VGEN_CHECK_EQ(GetPosition(joy, &position), STATUS_SUCCESS);
+	VGEN_CHECK_EQ(SetDevButton(before, 1, TRUE), STATUS_SUCCESS);
+	VGEN_CHECK_EQ(RelinquishDev(joy), STATUS_SUCCESS);
+	VGEN_CHECK_EQ(StopTrace(), STATUS_SUCCESS);
+	VGEN_CHECK_EQ(RelinquishDev(before), STATUS_SUCCESS);
+
+	// The calls come back as recorded, on devices of their own, released at the end; calls on devices the trace did not
+	// acquire, or whose acquisition failed, are skipped
+	ReplayStats stats;
+	VGEN_CHECK_EQ(ReplayTrace(file, 0, &stats), STATUS_SUCCESS);
+	VGEN_CHECK_EQ(stats.Calls, 8);
+	VGEN_CHECK_EQ(stats.Errors, 1);
+	VGEN_CHECK_EQ(stats.Mismatches, 0);
+	VGEN_CHECK_EQ(stats.Skipped, 2);
+	VGEN_CHECK_EQ(stats.Dropped, 0);
+	VGEN_CHECK_EQ(stats.Latency[PerfAcquireDev].Count, 2);
+	VGEN_CHECK_EQ(stats.Latency[PerfSetDevButton].Count, 3);
+	BOOL owned = TRUE;
+	VGEN_CHECK_EQ(isDevOwned(1, vJoy, &owned), STATUS_SUCCESS);
+	VGEN_CHECK(!owned);
+	DS4_REPORT ds4;
+	VGEN_CHECK(GetSimBusReport(vgeDS4, 1, &ds4) != STATUS_SUCCESS);
+
+	// A call that returns something else than during recording is a mismatch
+	SimBusConfig config;
+	config.FailEvery = 1;
+	config.FailOps = SimOpRead;
+	VGEN_CHECK_EQ(SetSimBusConfig(&config), STATUS_SUCCESS);
+	stats = ReplayStats();
+	VGEN_CHECK_EQ(ReplayTrace(file, 0, &stats), STATUS_SUCCESS);
+	VGEN_CHECK_EQ(stats.Calls, 8);
+	VGEN_CHECK_EQ(stats.Errors, 2);
+	VGEN_CHECK_EQ(stats.Mismatches, 1);
+	VGEN_CHECK_EQ(SetSimBusConfig(&defaults), STATUS_SUCCESS);
+
+	VGEN_CHECK_EQ(ReplayTrace("vGenSimTest.missing", 0, &stats), STATUS_NO_SUCH_FILE);
+	std::remove(file);
+}
+
+VGEN_TEST(SlotQueries)
+{
+	// A free vXbox slot exists but isn't owned, as a free vJoy device
+	BOOL exist = FALSE, owned = TRUE;
+	VGEN_CHECK_EQ(isDevExist(2, vXbox, &exist), STATUS_SUCCESS);
+	VGEN_CHECK(exist);
+	VGEN_CHECK_EQ(isDevOwned(2, vXbox, &owned), STATUS_SUCCESS);
+	VGEN_CHECK(!owned);
+	VGEN_CHECK_EQ(isDevExist(5, vXbox, &exist), STATUS_SUCCESS);
+	VGEN_CHECK(!exist);
+
+	SimDevice dev(vXbox);
+	VGEN_CHECK_EQ(isDevExist(1, vXbox, &exist), STATUS_SUCCESS);
+	VGEN_CHECK(exist);
+	VGEN_CHECK_EQ(isDevOwned(1, vXbox, &owned), STATUS_SUCCESS);
+	VGEN_CHECK(owned);
+}
+
+VGEN_TEST(ShmChannel_Sync)
+{
+	const SimBusConfig config;
+	VGEN_CHECK_EQ(SelectBackend(BackendSimulated), STATUS_SUCCESS);
+	VGEN_CHECK_EQ(SetSimBusConfig(&config), STATUS_SUCCESS);
+	VGEN_CHECK_EQ(OpenShmChannel("vGenSimTest"), STATUS_SUCCESS);
+
+	// Once Sync() returns, the bus has every report committed before it
+	vGenShmFeeder feeder;
+	const int device = vgeXbox + 1;
+	VGEN_CHECK_EQ(feeder.Open("vGenSimTest"), STATUS_SUCCESS);
+	VGEN_CHECK_EQ(feeder.Acquire(device), STATUS_SUCCESS);
+	for (int i = 0; i < 200; ++i) {
+		const BOOL pressed = i & 1 ? FALSE : TRUE;
+		VGEN_CHECK_EQ(feeder.SetButton(device, 1, pressed), STATUS_SUCCESS);
+		VGEN_CHECK_EQ(feeder.Commit(device), STATUS_SUCCESS);
+		VGEN_CHECK_EQ(feeder.Sync(2000), STATUS_SUCCESS);
+
+		XINPUT_GAMEPAD report = {};
+		VGEN_CHECK_EQ(GetSimBusReport(vgeXbox, 1, &report), STATUS_SUCCESS);
+		if (!VGEN_CHECK_EQ(report.wButtons, pressed ? XBTN_A : 0))
+			break;
+	}
+
+	// Failures come back at the next Sync()
+	VGEN_CHECK_EQ(feeder.SetButton(device + 1, 1, TRUE), STATUS_SUCCESS);
+	VGEN_CHECK(feeder.Sync(2000) != STATUS_SUCCESS);
+	VGEN_CHECK_EQ(feeder.Sync(2000), STATUS_SUCCESS);
+
+	feeder.Close();
+	VGEN_CHECK_EQ(CloseShmChannel("vGenSimTest"), STATUS_SUCCESS);
+}
+
+int main()
+{
+	const int res = vGenTest::Main();
+	DeInit();
+	return res;
+}
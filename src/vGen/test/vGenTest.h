@@ -0,0 +1,74 @@
+// vGenTest.h : The few checks the vGen tests need, without a test framework.
+//
+// VGEN_TEST(Name) defines a case, VGEN_CHECK(expr) and VGEN_CHECK_EQ(a, b) report a failed check and let the case go
+// on. vGenTest::Main() runs every case in the order of definition and returns 1 if any check failed, for ctest.
+
+#pragma once
+
+#include <functional>
+#include <stdio.h>
+#include <vector>
+
+namespace vGenTest {
+
+struct TestCase
+{
+	const char * Name;
+	std::function<void()> Run;
+};
+
+inline std::vector<TestCase> & Cases()
+{
+	static std::vector<TestCase> cases;
+	return cases;
+}
+
+inline unsigned & Failures()
+{
+	static unsigned failures = 0;
+	return failures;
+}
+
+struct Register
+{
+	Register(const char * name, std::function<void()> run) { Cases().push_back({ name, run }); }
+};
+
+inline bool Check(bool ok, const char * expr, const char * file, int line)
+{
+	if (!ok) {
+		printf("%s(%d): check failed: %s\n", file, line, expr);
+		++Failures();
+	}
+	return ok;
+}
+
+inline bool CheckEq(long long a, long long b, const char * expr, const char * file, int line)
+{
+	if (a != b) {
+		printf("%s(%d): check failed: %s (%lld != %lld)\n", file, line, expr, a, b);
+		++Failures();
+	}
+	return a == b;
+}
+
+inline int Main()
+{
+	for (const TestCase & test : Cases()) {
+		const unsigned before = Failures();
+		test.Run();
+		printf("%-40s %s\n", test.Name, Failures() == before ? "ok" : "FAILED");
+	}
+	printf("%u check(s) failed\n", Failures());
+	return Failures() ? 1 : 0;
+}
+
+}  // namespace vGenTest
+
+#define VGEN_TEST(name) \
+	static void name(); \
+	static vGenTest::Register name##_register(#name, name); \
+	static void name()
+
+#define VGEN_CHECK(expr) vGenTest::Check((expr) != 0, #expr, __FILE__, __LINE__)
+#define VGEN_CHECK_EQ(a, b) vGenTest::CheckEq((long long)(a), (long long)(b), #a " == " #b, __FILE__, __LINE__)
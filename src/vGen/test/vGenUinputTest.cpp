@@ -0,0 +1,142 @@
+// vGenUinputTest.cpp : Tests of the uinput backend, writing into memory (BackendUinputMemory).
+//
+// Checks the events of each commit as GetUinputEvents() returns them: only the controls that changed, then exactly one
+// SYN_REPORT, and nothing at all for a report that changed nothing.
+
+#include "vGenInterface.h"
+#include "vGenTest.h"
+
+#include <vector>
+
+using namespace vGenNS;
+
+namespace {
+
+// linux/input-event-codes.h
+const USHORT EvSyn = 0x00, EvKey = 0x01, EvAbs = 0x03;
+const USHORT SynReport = 0;
+const USHORT AbsX = 0x00, AbsY = 0x01, AbsZ = 0x02, AbsHat0X = 0x10, AbsHat0Y = 0x11;
+const USHORT BtnSouth = 0x130, BtnEast = 0x131;
+
+// Acquires device 1 of a type on the in-memory uinput backend, releases it at the end
+class UinputDevice
+{
+public:
+	explicit UinputDevice(DevType type)
+		: m_type(type)
+	{
+		VGEN_CHECK_EQ(SelectBackend(BackendUinputMemory), STATUS_SUCCESS);
+		VGEN_CHECK_EQ(AcquireDev(1, type, &m_hDev), STATUS_SUCCESS);
+		Events();  // What plugging in wrote
+	}
+
+	~UinputDevice()
+	{
+		if (m_hDev != INVALID_DEV)
+			RelinquishDev(m_hDev);
+		SelectBackend(BackendSimulated);
+	}
+
+	HDEVICE Handle() const { return m_hDev; }
+
+	// Takes the events written since the last call
+	std::vector<UinputEvent> Events()
+	{
+		std::vector<UinputEvent> events(64);
+		UINT read = 0;
+		VGEN_CHECK_EQ(GetUinputEvents(m_type, 1, events.data(), (UINT)events.size(), &read), STATUS_SUCCESS);
+		events.resize(read);
+		return events;
+	}
+
+	UinputStats Stats()
+	{
+		UinputStats stats;
+		VGEN_CHECK_EQ(GetUinputStats(BackendUinputMemory, &stats), STATUS_SUCCESS);
+		return stats;
+	}
+
+private:
+	DevType m_type;
+	HDEVICE m_hDev = INVALID_DEV;
+};
+
+bool IsEvent(const UinputEvent & event, USHORT type, USHORT code, LONG value)
+{
+	return event.Type == type && event.Code == code && event.Value == value;
+}
+
+// The commit is the given control events followed by one SYN_REPORT
+void CheckCommit(const std::vector<UinputEvent> & events, std::initializer_list<UinputEvent> expected)
+{
+	if (!VGEN_CHECK_EQ(events.size(), expected.size() + 1))
+		return;
+	size_t i = 0;
+	for (const UinputEvent & event : expected) {
+		VGEN_CHECK(IsEvent(events[i], event.Type, event.Code, event.Value));
+		++i;
+	}
+	VGEN_CHECK(IsEvent(events.back(), EvSyn, SynReport, 0));
+}
+
+}  // namespace
+
+VGEN_TEST(Uinput_ChangedOnly)
+{
+	UinputDevice dev(vgeXbox);
+	VGEN_CHECK_EQ(SetDevButton(dev.Handle(), 1, TRUE), STATUS_SUCCESS);
+	CheckCommit(dev.Events(), { { EvKey, BtnSouth, 1 } });
+
+	VGEN_CHECK_EQ(SetDevAxis(dev.Handle(), (HID_USAGES)HID_USAGE_X, 32767), STATUS_SUCCESS);
+	CheckCommit(dev.Events(), { { EvAbs, AbsX, 32766 } });
+
+	VGEN_CHECK_EQ(SetDevDiscPov(dev.Handle(), 1, DPOV_NorthEast), STATUS_SUCCESS);
+	CheckCommit(dev.Events(), { { EvAbs, AbsHat0X, 1 }, { EvAbs, AbsHat0Y, -1 } });
+
+	VGEN_CHECK_EQ(SetDevButton(dev.Handle(), 1, FALSE), STATUS_SUCCESS);
+	CheckCommit(dev.Events(), { { EvKey, BtnSouth, 0 } });
+}
+
+VGEN_TEST(Uinput_OneSynPerCommit)
+{
+	UinputDevice dev(vgeXbox);
+	VGEN_CHECK_EQ(SetDevButton(dev.Handle(), 1, TRUE), STATUS_SUCCESS);
+	VGEN_CHECK_EQ(SetDevButton(dev.Handle(), 2, TRUE), STATUS_SUCCESS);
+	VGEN_CHECK_EQ(SetDevAxis(dev.Handle(), (HID_USAGES)HID_USAGE_Y, 0), STATUS_SUCCESS);
+	const std::vector<UinputEvent> events = dev.Events();
+	VGEN_CHECK_EQ(events.size(), 6);
+	UINT syns = 0;
+	for (const UinputEvent & event : events)
+		syns += event.Type == EvSyn;
+	VGEN_CHECK_EQ(syns, 3);
+
+	// A reset changing three controls at once is one commit. Y points down, the centered stick is at -1.
+	const UinputStats before = dev.Stats();
+	VGEN_CHECK_EQ(ResetDevPositions(dev.Handle()), STATUS_SUCCESS);
+	CheckCommit(dev.Events(), { { EvAbs, AbsY, -1 }, { EvKey, BtnSouth, 0 }, { EvKey, BtnEast, 0 } });
+	const UinputStats after = dev.Stats();
+	VGEN_CHECK_EQ(after.Commits, before.Commits + 1);
+	VGEN_CHECK_EQ(after.Events, before.Events + 3);
+}
+
+VGEN_TEST(Uinput_Unchanged)
+{
+	UinputDevice dev(vJoy);
+	VGEN_CHECK_EQ(SetDevAxis(dev.Handle(), (HID_USAGES)HID_USAGE_Z, 100), STATUS_SUCCESS);
+	CheckCommit(dev.Events(), { { EvAbs, AbsZ, 100 } });
+
+	const UinputStats before = dev.Stats();
+	VGEN_CHECK_EQ(SetDevAxis(dev.Handle(), (HID_USAGES)HID_USAGE_Z, 100), STATUS_SUCCESS);
+	VGEN_CHECK_EQ(SetDevButton(dev.Handle(), 5, FALSE), STATUS_SUCCESS);
+	VGEN_CHECK_EQ(dev.Events().size(), 0);
+	const UinputStats after = dev.Stats();
+	VGEN_CHECK_EQ(after.Commits, before.Commits);
+	VGEN_CHECK_EQ(after.Unchanged, before.Unchanged + 2);
+}
+
+int main()
+{
+	const int res = vGenTest::Main();
+	DeInit();
+	return res;
+}
@@ -0,0 +1,86 @@
+// vJoyFfbStubs.cpp : Stand-ins for vJoy's FFB helpers, see vJoyFfbStubs.h.
+//
+
+#include "stdafx.h"
+#include "Private.h"
+
+namespace {
+
+FfbGenCB g_genCB = nullptr;
+PVOID g_genData = nullptr;
+
+// Header byte and the report structure after it, if the packet is of the given type
+template <class Report>
+DWORD StubReport(const FFB_DATA * Packet, FFBPType type, Report * report)
+{
+	FFBPType actual;
+	if (!report || vJoyNS::Ffb_h_Type(Packet, &actual) != ERROR_SUCCESS || actual != type || Packet->size < 1 + sizeof(Report))
+		return ERROR_BAD_ARGUMENTS;
+	memcpy(report, Packet->data + 1, sizeof(Report));
+	return ERROR_SUCCESS;
+}
+
+}  // namespace
+
+namespace vJoyNS {
+
+VOID FfbRegisterGenCB(FfbGenCB cb, PVOID data)
+{
+	g_genCB = cb;
+	g_genData = data;
+}
+
+DWORD Ffb_h_DeviceID(const FFB_DATA * Packet, int * DeviceID)
+{
+	if (!Packet || !DeviceID || !Packet->data || Packet->size < 1)
+		return ERROR_BAD_ARGUMENTS;
+	*DeviceID = Packet->data[0] >> 4;
+	return Range_vJoy(*DeviceID) ? ERROR_SUCCESS : ERROR_BAD_ARGUMENTS;
+}
+
+DWORD Ffb_h_Type(const FFB_DATA * Packet, FFBPType * Type)
+{
+	if (!Packet || !Type || !Packet->data || Packet->size < 1)
+		return ERROR_BAD_ARGUMENTS;
+	*Type = (FFBPType)((Packet->data[0] & 0x0F) + (Packet->cmd == FFB_STUB_FEATURE ? 0x10 : 0));
+	return ERROR_SUCCESS;
+}
+
+DWORD Ffb_h_EBI(const FFB_DATA * Packet, int * Index)
+{
+	FFBPType type;
+	if (!Index || vJoyNS::Ffb_h_Type(Packet, &type) != ERROR_SUCCESS || Packet->size < 2)
+		return ERROR_BAD_ARGUMENTS;
+	switch (type) {
+		case PT_CTRLREP:
+		case PT_GAINREP:
+		case PT_NEWEFREP:
+		case PT_POOLREP:
+			return ERROR_BAD_ARGUMENTS;  // Device wide
+		default:
+			*Index = Packet->data[1];  // EffectBlockIndex leads every effect structure
+			return ERROR_SUCCESS;
+	}
+}
+
+DWORD Ffb_h_Eff_Report(const FFB_DATA * Packet, FFB_EFF_REPORT * Effect) { return StubReport(Packet, PT_EFFREP, Effect); }
+DWORD Ffb_h_Eff_Ramp(const FFB_DATA * Packet, FFB_EFF_RAMP * RampEffect) { return StubReport(Packet, PT_RAMPREP, RampEffect); }
+DWORD Ffb_h_EffOp(const FFB_DATA * Packet, FFB_EFF_OP * Operation) { return StubReport(Packet, PT_EFOPREP, Operation); }
+DWORD Ffb_h_DevCtrl(const FFB_DATA * Packet, FFB_CTRL * Control) { return StubReport(Packet, PT_CTRLREP, Control); }
+DWORD Ffb_h_Eff_Period(const FFB_DATA * Packet, FFB_EFF_PERIOD * Effect) { return StubReport(Packet, PT_PRIDREP, Effect); }
+DWORD Ffb_h_Eff_Cond(const FFB_DATA * Packet, FFB_EFF_COND * Condition) { return StubReport(Packet, PT_CONDREP, Condition); }
+DWORD Ffb_h_DevGain(const FFB_DATA * Packet, BYTE * Gain) { return StubReport(Packet, PT_GAINREP, Gain); }
+DWORD Ffb_h_Eff_Envlp(const FFB_DATA * Packet, FFB_EFF_ENVLP * Envelope) { return StubReport(Packet, PT_ENVREP, Envelope); }
+DWORD Ffb_h_EffNew(const FFB_DATA * Packet, FFBEType * Effect) { return StubReport(Packet, PT_NEWEFREP, Effect); }
+DWORD Ffb_h_Eff_Constant(const FFB_DATA * Packet, FFB_EFF_CONSTANT * ConstantEffect) { return StubReport(Packet, PT_CONSTREP, ConstantEffect); }
+
+}  // namespace vJoyNS
+
+bool FfbStub_Deliver(const FFB_DATA * Packet)
+{
+	const FfbGenCB cb = g_genCB;
+	if (!cb)
+		return false;
+	cb((PVOID)Packet, g_genData);
+	return true;
+}
@@ -0,0 +1,61 @@
+// vJoyFfbStubs.h : Stand-ins for vJoy's FFB helpers, to build and test the FFB code without the drivers.
+//
+// Included by Private.h when VGEN_FFB_STUBS is defined (vGenFfbTest). A canned packet has vJoy's first byte, the
+// device ID in the high nibble and the HID report ID in the low one (feature reports have cmd FFB_STUB_FEATURE),
+// followed by the bytes of the report's FFB_* structure rather than the HID report fields.
+
+#pragma once
+
+#include <string.h>
+#include <vector>
+
+#define FFB_STUB_OUTPUT   0
+#define FFB_STUB_FEATURE  1  // PT_NEWEFREP, PT_BLKLDREP, PT_POOLREP: the report ID is the type minus 0x10
+
+namespace vJoyNS {
+
+VOID	FfbRegisterGenCB(FfbGenCB cb, PVOID data);
+DWORD	Ffb_h_DeviceID(const FFB_DATA * Packet, int * DeviceID);
+DWORD	Ffb_h_Type(const FFB_DATA * Packet, FFBPType * Type);
+DWORD	Ffb_h_EBI(const FFB_DATA * Packet, int * Index);
+DWORD	Ffb_h_Eff_Report(const FFB_DATA * Packet, FFB_EFF_REPORT * Effect);
+DWORD	Ffb_h_Eff_Ramp(const FFB_DATA * Packet, FFB_EFF_RAMP * RampEffect);
+DWORD	Ffb_h_EffOp(const FFB_DATA * Packet, FFB_EFF_OP * Operation);
+DWORD	Ffb_h_DevCtrl(const FFB_DATA * Packet, FFB_CTRL * Control);
+DWORD	Ffb_h_Eff_Period(const FFB_DATA * Packet, FFB_EFF_PERIOD * Effect);
+DWORD	Ffb_h_Eff_Cond(const FFB_DATA * Packet, FFB_EFF_COND * Condition);
+DWORD	Ffb_h_DevGain(const FFB_DATA * Packet, BYTE * Gain);
+DWORD	Ffb_h_Eff_Envlp(const FFB_DATA * Packet, FFB_EFF_ENVLP * Envelope);
+DWORD	Ffb_h_EffNew(const FFB_DATA * Packet, FFBEType * Effect);
+DWORD	Ffb_h_Eff_Constant(const FFB_DATA * Packet, FFB_EFF_CONSTANT * ConstantEffect);
+
+}  // namespace vJoyNS
+
+// Calls the callback registered with vJoyNS::FfbRegisterGenCB(), as vJoy's FFB thread of the device would.
+// Returns false if none was registered.
+bool FfbStub_Deliver(const FFB_DATA * Packet);
+
+// A canned packet of device `id`
+class FfbStubPacket
+{
+public:
+	template <class Report>
+	FfbStubPacket(UINT id, FFBPType type, const Report & report)
+		: m_bytes(1 + sizeof(Report))
+	{
+		m_bytes[0] = (UCHAR)(id << 4 | (type & 0x0F));
+		memcpy(&m_bytes[1], &report, sizeof(Report));
+		m_data.size = (ULONG)m_bytes.size();
+		m_data.cmd = type >= 0x10 ? FFB_STUB_FEATURE : FFB_STUB_OUTPUT;
+	}
+
+	const FFB_DATA * Data() const
+	{
+		m_data.data = (UCHAR *)m_bytes.data();  // after a copy too
+		return &m_data;
+	}
+
+private:
+	std::vector<UCHAR> m_bytes;
+	mutable FFB_DATA m_data;
+};
@@ -0,0 +1,272 @@
+// vGenClient.cpp : Client side of the daemon protocol (vGenClient.h).
+//
+// The socket is connected to the daemon, so every frame is one send() and every answer one recv(). A request that waits
+// is the last message of its frame and the only one without VGEN_MSG_QUIET: the daemon answers a frame with one
+// datagram in request order, so the reply to it is the end of the answer. Failures of earlier, quiet frames arrive
+// ahead of it and are kept for the next Commit().
+
+#include "DaemonSocket.h"  // First, for Windows: brings the Winsock and Windows headers vGenInterface.h needs
+#include "vGenClient.h"
+
+#ifndef _WIN32
+#include <poll.h>
+#endif
+#include <stdio.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+
+vGenClient::~vGenClient()
+{
+	Disconnect();
+}
+
+DWORD vGenClient::Connect(const char * address, DWORD timeoutMs)
+{
+	sockaddr_storage addr;
+	socklen_t addrLen;
+	if (!DaemonSocket_Parse(address, addr, addrLen))
+		return STATUS_INVALID_PARAMETER_1;
+
+	Disconnect();
+	m_socket = DaemonSocket_Open(addr.ss_family);
+	if (m_socket == NoSocket)
+		return STATUS_INSUFFICIENT_RESOURCES;
+
+#ifndef _WIN32
+	// A datagram unix socket needs an address of its own for the daemon to answer to
+	if (addr.ss_family == AF_UNIX) {
+		sockaddr_un local = {};
+		local.sun_family = AF_UNIX;
+#ifdef __linux__
+		const int res = bind(m_socket, (const sockaddr *)&local, sizeof(sa_family_t));  // Autobind, abstract name
+#else
+		static std::atomic<unsigned> s_next{ 0 };
+		snprintf(local.sun_path, sizeof(local.sun_path), "/tmp/vgenc-%d-%u", (int)getpid(), s_next++);
+		unlink(local.sun_path);
+		const int res = bind(m_socket, (const sockaddr *)&local, sizeof(local));
+		if (!res)
+			m_localPath = local.sun_path;
+#endif
+		if (res) {
+			Disconnect();
+			return STATUS_ACCESS_DENIED;
+		}
+	}
+#endif
+
+	if (connect(m_socket, (const sockaddr *)&addr, addrLen)) {
+		Disconnect();
+		return STATUS_DEVICE_NOT_CONNECTED;
+	}
+
+	m_timeoutMs = timeoutMs;
+	const DWORD res = Request(VgenCmdHello, 0, VGEN_PROTO_VERSION);
+	if (res != STATUS_SUCCESS)
+		Disconnect();
+	return res;
+}
+
+void vGenClient::Disconnect()
+{
+	if (Connected()) {
+		const VgenMsg bye = { VgenCmdBye, 0, 0, 0, 0, 0 };
+		send(m_socket, (const char *)&bye, (int)sizeof(bye), 0);
+		DaemonSocket_Close(m_socket);
+		m_socket = NoSocket;
+	}
+#ifndef _WIN32
+	if (!m_localPath.empty()) {
+		unlink(m_localPath.c_str());
+		m_localPath.clear();
+	}
+#endif
+	m_count = 0;
+	m_failure = STATUS_SUCCESS;
+	m_states.clear();
+}
+
+DWORD vGenClient::Acquire(int device)
+{
+	return Request(VgenCmdAcquire, device);
+}
+
+DWORD vGenClient::Release(int device)
+{
+	return Request(VgenCmdRelease, device);
+}
+
+DWORD vGenClient::SetButton(int device, UINT button, BOOL pressed)
+{
+	return Queue(VgenCmdButton, device, (uint16_t)button, pressed ? 1 : 0);
+}
+
+DWORD vGenClient::SetAxis(int device, vGenNS::HID_USAGES axis, LONG value)
+{
+	return Queue(VgenCmdAxis, device, (uint16_t)axis, value);
+}
+
+DWORD vGenClient::SetPov(int device, UCHAR pov, DWORD value)
+{
+	return Queue(VgenCmdPov, device, pov, (int32_t)value);
+}
+
+DWORD vGenClient::Reset(int device)
+{
+	return Queue(VgenCmdReset, device, 0, 0);
+}
+
+DWORD vGenClient::Commit(int device, bool wait)
+{
+	DWORD res = Queue(VgenCmdCommit, device, 0, 0, wait ? 0 : VGEN_MSG_QUIET);
+	if (res == STATUS_SUCCESS)
+		res = Flush(wait);
+	if (!wait)
+		return res;
+
+	const DWORD failure = m_failure;
+	m_failure = STATUS_SUCCESS;
+	return failure != STATUS_SUCCESS ? failure : res;
+}
+
+DWORD vGenClient::Subscribe(int device)
+{
+	return Request(VgenCmdSubscribe, device);
+}
+
+DWORD vGenClient::Unsubscribe(int device)
+{
+	return Request(VgenCmdUnsubscribe, device);
+}
+
+DWORD vGenClient::ReadState(int & device, void * report, size_t size, DWORD timeoutMs)
+{
+	if (!Connected())
+		return STATUS_DEVICE_NOT_CONNECTED;
+
+	const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+	for (;;) {
+		// The chunks of a report come in one datagram, so the stash always starts at a report's first chunk
+		while (!m_states.empty()) {
+			const VgenMsg chunk = m_states.front();
+			m_states.pop_front();
+
+			const size_t offset = (size_t)chunk.Index * VGEN_PROTO_STATE_SIZE;
+			BYTE data[VGEN_PROTO_STATE_SIZE];
+			memcpy(data, &chunk.Value, sizeof(chunk.Value));
+			memcpy(data + sizeof(chunk.Value), &chunk.Status, sizeof(chunk.Status));
+			if (offset < size)
+				memcpy((BYTE *)report + offset, data, std::min<size_t>(VGEN_PROTO_STATE_SIZE, size - offset));
+			if (chunk.Flags & VGEN_MSG_LAST) {
+				device = chunk.Device;
+				return STATUS_SUCCESS;
+			}
+		}
+
+		const auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+		if (left.count() <= 0)
+			return STATUS_TIMEOUT;
+		bool done = false;
+		DWORD status;
+		const DWORD res = Receive((DWORD)left.count(), 0, -1, done, status);
+		if (res != STATUS_SUCCESS)
+			return res;
+	}
+}
+
+DWORD vGenClient::Queue(uint8_t cmd, int device, uint16_t index, int32_t value, uint8_t flags)
+{
+	if (!Connected())
+		return STATUS_DEVICE_NOT_CONNECTED;
+	if (m_count == VGEN_PROTO_MAX_FRAME) {
+		const DWORD res = Flush(false);
+		if (res != STATUS_SUCCESS)
+			return res;
+	}
+
+	VgenMsg & msg = m_frame[m_count++];
+	msg.Cmd = cmd;
+	msg.Flags = flags;
+	msg.Index = index;
+	msg.Device = device;
+	msg.Value = value;
+	msg.Status = 0;
+	return STATUS_SUCCESS;
+}
+
+DWORD vGenClient::Flush(bool wait)
+{
+	if (!m_count)
+		return STATUS_SUCCESS;
+
+	const uint8_t cmd = m_frame[m_count - 1].Cmd;
+	const int32_t pos = (int32_t)(m_count - 1);
+	const auto sent = send(m_socket, (const char *)m_frame, (int)(m_count * sizeof(VgenMsg)), 0);
+	m_count = 0;
+	if (sent < 0)
+		return STATUS_DEVICE_NOT_CONNECTED;
+	if (!wait)
+		return STATUS_SUCCESS;
+
+	for (bool done = false;;) {
+		DWORD status = STATUS_SUCCESS;
+		const DWORD res = Receive(m_timeoutMs, cmd, pos, done, status);
+		if (res != STATUS_SUCCESS)
+			return res;
+		if (done)
+			return status;
+	}
+}
+
+// Stashes the states of one datagram and keeps the first failure among its replies, except for the reply to the
+// request at awaitPos in the frame (awaitCmd), which is returned in done/status. Quiet replies are failures of
+// earlier frames that nobody waits for, so they never match.
+DWORD vGenClient::Receive(DWORD timeoutMs, uint8_t awaitCmd, int32_t awaitPos, bool & done, DWORD & status)
+{
+#ifdef _WIN32
+	WSAPOLLFD fd = { m_socket, POLLRDNORM, 0 };
+	const int ready = WSAPoll(&fd, 1, (INT)timeoutMs);
+	if (ready < 0)
+		return STATUS_UNEXPECTED_IO_ERROR;
+#else
+	// A signal only cuts the wait short: poll again for the rest of the time
+	const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+	pollfd fd = { m_socket, POLLIN, 0 };
+	int ready;
+	while ((ready = poll(&fd, 1, (int)timeoutMs)) < 0) {
+		if (errno != EINTR)
+			return STATUS_UNEXPECTED_IO_ERROR;
+		const auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+		timeoutMs = left.count() > 0 ? (DWORD)left.count() : 0;
+	}
+#endif
+	if (!ready)
+		return STATUS_TIMEOUT;
+
+	VgenMsg msgs[VGEN_PROTO_MAX_FRAME];
+	const auto size = recv(m_socket, (char *)msgs, (int)sizeof(msgs), 0);
+	if (size < 0)
+		return DaemonSocket_PeerGone() ? STATUS_DEVICE_NOT_CONNECTED : STATUS_UNEXPECTED_IO_ERROR;
+
+	for (size_t i = 0; i < (size_t)size / sizeof(VgenMsg); ++i) {
+		const VgenMsg & msg = msgs[i];
+		if (msg.Cmd == VgenCmdState)
+			m_states.push_back(msg);
+		else if (msg.Cmd != VgenCmdReply)
+			continue;
+		else if (!(msg.Flags & VGEN_MSG_QUIET) && msg.Index == awaitCmd && msg.Value == awaitPos) {
+			done = true;
+			status = msg.Status;
+		}
+		else if (msg.Status != STATUS_SUCCESS && m_failure == STATUS_SUCCESS)
+			m_failure = msg.Status;
+	}
+	return STATUS_SUCCESS;
+}
+
+DWORD vGenClient::Request(uint8_t cmd, int device, int32_t value)
+{
+	const DWORD res = Queue(cmd, device, 0, value, 0);
+	return res == STATUS_SUCCESS ? Flush(true) : res;
+}
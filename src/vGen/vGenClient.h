@@ -0,0 +1,82 @@
+//////////////////////////////////////////////////////////
+//
+// vGen daemon client
+//
+// Feeds devices of a daemon started with RunDaemon(), see
+// vGenProtocol.h. Control changes are queued into the current
+// frame; Commit() sends the frame as one datagram and, unless
+// asked not to wait, reads the daemon's answer. A frame that
+// fills up is sent on its own, quietly.
+//
+// Needs only this header, vGenProtocol.h and vGenInterface.h
+// (for the HID_USAGES and STATUS values); it does not link the
+// vGen library. One vGenClient per thread.
+//
+//////////////////////////////////////////////////////////
+#pragma once
+
+#include "vGenInterface.h"
+#include "vGenProtocol.h"
+
+#include <deque>
+#include <string>
+
+class vGenClient
+{
+public:
+	vGenClient() = default;
+	~vGenClient();
+	vGenClient(const vGenClient &) = delete;
+	vGenClient & operator=(const vGenClient &) = delete;
+
+	// Address as for RunDaemon(). Checks the protocol version with the daemon.
+	DWORD Connect(const char * address, DWORD timeoutMs = 1000);
+	// Releases everything this client holds or subscribed to
+	void Disconnect();
+
+	// Sent at once, returns the daemon's answer
+	DWORD Acquire(int device);
+	DWORD Release(int device);
+
+	// Queued into the frame, sent by Commit(). Failures are reported by Commit().
+	DWORD SetButton(int device, UINT button, BOOL pressed);
+	DWORD SetAxis(int device, vGenNS::HID_USAGES axis, LONG value);
+	DWORD SetPov(int device, UCHAR pov, DWORD value);
+	DWORD Reset(int device);
+
+	// Sends the frame and commits device (0: every device this client holds). With wait, returns the first failure of
+	// the frame; without, returns once the frame is sent and failures are reported by a later Commit() with wait.
+	DWORD Commit(int device = 0, bool wait = true);
+
+	// State pushes after every commit of device, by any feeder
+	DWORD Subscribe(int device);
+	DWORD Unsubscribe(int device);
+	// Waits for the next complete report of a subscribed device and copies up to size bytes of it into report.
+	// Returns STATUS_TIMEOUT if none arrives within timeoutMs.
+	DWORD ReadState(int & device, void * report, size_t size, DWORD timeoutMs);
+
+	bool Connected() const { return m_socket != NoSocket; }
+
+private:
+	DWORD Queue(uint8_t cmd, int device, uint16_t index, int32_t value, uint8_t flags = VGEN_MSG_QUIET);
+	DWORD Flush(bool wait);
+	DWORD Receive(DWORD timeoutMs, uint8_t awaitCmd, int32_t awaitPos, bool & done, DWORD & status);
+	DWORD Request(uint8_t cmd, int device, int32_t value = 0);
+
+#ifdef _WIN32
+	typedef uintptr_t Socket;  // SOCKET, without the Winsock headers
+#else
+	typedef int Socket;
+#endif
+	static constexpr Socket NoSocket = (Socket)-1;  // INVALID_SOCKET on Windows
+
+	Socket m_socket = NoSocket;
+	std::string m_localPath;  // Bound unix socket file, removed on Disconnect()
+	DWORD m_timeoutMs = 1000;
+
+	VgenMsg m_frame[VGEN_PROTO_MAX_FRAME];
+	unsigned m_count = 0;
+	DWORD m_failure = 0;  // First failure reported by the daemon since the last Commit() with wait
+
+	std::deque<VgenMsg> m_states;  // VgenCmdState chunks received while waiting for replies
+};
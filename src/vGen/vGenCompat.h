@@ -0,0 +1,250 @@
+//////////////////////////////////////////////////////////
+//
+// Builds without Windows or without the device drivers
+//
+// Outside Windows this supplies the part of the Win32 and
+// XInput headers that vGen and its interface use. Without the
+// drivers (VGEN_DRIVERS, see stdafx.h) it supplies the report
+// layouts of vJoy and ViGEm, byte for byte as the drivers
+// define them, so reports stay interchangeable between builds.
+//
+// Included by stdafx.h, and by vGenInterface.h outside Windows.
+//
+//////////////////////////////////////////////////////////
+#pragma once
+
+#ifndef _WIN32
+
+#include <stdint.h>
+#include <string.h>
+
+typedef uint8_t   BYTE, UCHAR, BOOLEAN;
+typedef char      CHAR;
+typedef int16_t   SHORT;
+typedef uint16_t  USHORT, WORD;
+typedef int32_t   INT, LONG, BOOL;
+typedef uint32_t  UINT, ULONG, DWORD;
+typedef int64_t   LONGLONG;
+typedef uint64_t  ULONGLONG;
+typedef float     FLOAT;
+typedef wchar_t   WCHAR;
+typedef size_t    SIZE_T;
+typedef void      VOID;
+typedef void *    PVOID, * LPVOID, * HANDLE;
+typedef BYTE *    PBYTE;
+typedef BOOL *    PBOOL;
+typedef DWORD *   PDWORD;
+
+#define TRUE   1
+#define FALSE  0
+
+#define CALLBACK
+#define WINAPI
+#define __cdecl
+
+#define INFINITE  0xFFFFFFFF
+#define MAXDWORD  0xFFFFFFFF
+
+#define SUCCEEDED(x)  (((LONG)(x)) >= 0)
+#define FAILED(x)     (((LONG)(x)) < 0)
+
+#define RtlZeroMemory(p, n)  memset((p), 0, (n))
+#define ZeroMemory           RtlZeroMemory
+
+#ifdef __cplusplus
+template <typename T, size_t N> char (&_countof_helper(T (&)[N]))[N];
+#define _countof(a)  (sizeof(_countof_helper(a)))
+#endif
+
+#define InterlockedExchange(p, v)   __atomic_exchange_n((p), (v), __ATOMIC_SEQ_CST)
+#define InterlockedExchange8(p, v)  __atomic_exchange_n((p), (v), __ATOMIC_SEQ_CST)
+
+// Win32 error codes (some exports return these instead of a status)
+#define ERROR_SUCCESS               0
+#define ERROR_INVALID_HANDLE        6
+#define ERROR_BAD_ARGUMENTS         160
+#define ERROR_DEVICE_NOT_CONNECTED  1167
+#define ERROR_DEVICE_NOT_AVAILABLE  4319
+
+// NTSTATUS values, as in ntstatus.h
+#define STATUS_SUCCESS                  ((DWORD)0x00000000)
+#define STATUS_TIMEOUT                  ((DWORD)0x00000102)
+#define STATUS_DEVICE_BUSY              ((DWORD)0x80000011)
+#define STATUS_UNSUCCESSFUL             ((DWORD)0xC0000001)
+#define STATUS_NOT_IMPLEMENTED          ((DWORD)0xC0000002)
+#define STATUS_INVALID_HANDLE           ((DWORD)0xC0000008)
+#define STATUS_INVALID_PARAMETER        ((DWORD)0xC000000D)
+#define STATUS_NO_SUCH_DEVICE           ((DWORD)0xC000000E)
+#define STATUS_NO_SUCH_FILE             ((DWORD)0xC000000F)
+#define STATUS_INVALID_DEVICE_REQUEST   ((DWORD)0xC0000010)
+#define STATUS_ACCESS_DENIED            ((DWORD)0xC0000022)
+#define STATUS_BUFFER_TOO_SMALL         ((DWORD)0xC0000023)
+#define STATUS_DEVICE_ALREADY_ATTACHED  ((DWORD)0xC0000038)
+#define STATUS_DELETE_PENDING           ((DWORD)0xC0000056)
+#define STATUS_INSUFFICIENT_RESOURCES   ((DWORD)0xC000009A)
+#define STATUS_DEVICE_NOT_CONNECTED     ((DWORD)0xC000009D)
+#define STATUS_DEVICE_NOT_READY         ((DWORD)0xC00000A3)
+#define STATUS_NOT_SUPPORTED            ((DWORD)0xC00000BB)
+#define STATUS_DEVICE_DOES_NOT_EXIST    ((DWORD)0xC00000C0)
+#define STATUS_UNEXPECTED_IO_ERROR      ((DWORD)0xC00000E9)
+#define STATUS_INVALID_PARAMETER_1      ((DWORD)0xC00000EF)
+#define STATUS_INVALID_PARAMETER_2      ((DWORD)0xC00000F0)
+#define STATUS_INVALID_PARAMETER_3      ((DWORD)0xC00000F1)
+#define STATUS_INVALID_PARAMETER_4      ((DWORD)0xC00000F2)
+#define STATUS_INVALID_PARAMETER_5      ((DWORD)0xC00000F3)
+#define STATUS_FILE_CORRUPT_ERROR       ((DWORD)0xC0000102)
+#define STATUS_CANCELLED                ((DWORD)0xC0000120)
+#define STATUS_INVALID_DEVICE_STATE     ((DWORD)0xC0000184)
+#define STATUS_IO_DEVICE_ERROR          ((DWORD)0xC0000185)
+#define STATUS_RESOURCE_NOT_OWNED       ((DWORD)0xC0000264)
+#define STATUS_DEVICE_REMOVED           ((DWORD)0xC00002B6)
+#define STATUS_FILE_TOO_LARGE           ((DWORD)0xC0000904)
+
+// Xinput.h
+typedef struct _XINPUT_GAMEPAD
+{
+	WORD wButtons;
+	BYTE bLeftTrigger;
+	BYTE bRightTrigger;
+	SHORT sThumbLX;
+	SHORT sThumbLY;
+	SHORT sThumbRX;
+	SHORT sThumbRY;
+} XINPUT_GAMEPAD, *PXINPUT_GAMEPAD;
+
+typedef struct _XINPUT_STATE
+{
+	DWORD dwPacketNumber;
+	XINPUT_GAMEPAD Gamepad;
+} XINPUT_STATE, *PXINPUT_STATE;
+
+typedef struct _XINPUT_VIBRATION
+{
+	WORD wLeftMotorSpeed;
+	WORD wRightMotorSpeed;
+} XINPUT_VIBRATION, *PXINPUT_VIBRATION;
+
+#endif // !_WIN32
+
+#ifndef VGEN_DRIVERS
+
+// vJoy (public.h)
+typedef struct _JOYSTICK_POSITION_V2
+{
+	BYTE bDevice;  // Index of device. 1-based.
+	LONG wThrottle;
+	LONG wRudder;
+	LONG wAileron;
+	LONG wAxisX;
+	LONG wAxisY;
+	LONG wAxisZ;
+	LONG wAxisXRot;
+	LONG wAxisYRot;
+	LONG wAxisZRot;
+	LONG wSlider;
+	LONG wDial;
+	LONG wWheel;
+	LONG wAxisVX;
+	LONG wAxisVY;
+	LONG wAxisVZ;
+	LONG wAxisVBRX;
+	LONG wAxisVBRY;
+	LONG wAxisVBRZ;
+	LONG lButtons;  // 32 buttons: 0x00000001 means button1 is pressed, 0x80000000 -> button32 is pressed
+	DWORD bHats;    // Lower 4 bits: HAT switch or 16-bit of continuous HAT switch
+	DWORD bHatsEx1; // 16-bit of continuous HAT switch
+	DWORD bHatsEx2; // 16-bit of continuous HAT switch
+	DWORD bHatsEx3; // 16-bit of continuous HAT switch
+	LONG lButtonsEx1; // Buttons 33-64
+	LONG lButtonsEx2; // Buttons 65-96
+	LONG lButtonsEx3; // Buttons 97-128
+} JOYSTICK_POSITION_V2, *PJOYSTICK_POSITION_V2;
+
+// ViGEm (ViGEm/Common.h)
+typedef struct _XUSB_REPORT
+{
+	USHORT wButtons;
+	BYTE bLeftTrigger;
+	BYTE bRightTrigger;
+	SHORT sThumbLX;
+	SHORT sThumbLY;
+	SHORT sThumbRX;
+	SHORT sThumbRY;
+} XUSB_REPORT, *PXUSB_REPORT;
+
+typedef enum _DS4_BUTTONS
+{
+	DS4_BUTTON_THUMB_RIGHT    = 1 << 15,
+	DS4_BUTTON_THUMB_LEFT     = 1 << 14,
+	DS4_BUTTON_OPTIONS        = 1 << 13,
+	DS4_BUTTON_SHARE          = 1 << 12,
+	DS4_BUTTON_TRIGGER_RIGHT  = 1 << 11,
+	DS4_BUTTON_TRIGGER_LEFT   = 1 << 10,
+	DS4_BUTTON_SHOULDER_RIGHT = 1 << 9,
+	DS4_BUTTON_SHOULDER_LEFT  = 1 << 8,
+	DS4_BUTTON_TRIANGLE       = 1 << 7,
+	DS4_BUTTON_CIRCLE         = 1 << 6,
+	DS4_BUTTON_CROSS          = 1 << 5,
+	DS4_BUTTON_SQUARE         = 1 << 4
+} DS4_BUTTONS, *PDS4_BUTTONS;
+
+typedef enum _DS4_SPECIAL_BUTTONS
+{
+	DS4_SPECIAL_BUTTON_PS       = 1 << 0,
+	DS4_SPECIAL_BUTTON_TOUCHPAD = 1 << 1
+} DS4_SPECIAL_BUTTONS, *PDS4_SPECIAL_BUTTONS;
+
+typedef enum _DS4_DPAD_DIRECTIONS
+{
+	DS4_BUTTON_DPAD_NONE      = 0x8,
+	DS4_BUTTON_DPAD_NORTHWEST = 0x7,
+	DS4_BUTTON_DPAD_WEST      = 0x6,
+	DS4_BUTTON_DPAD_SOUTHWEST = 0x5,
+	DS4_BUTTON_DPAD_SOUTH     = 0x4,
+	DS4_BUTTON_DPAD_SOUTHEAST = 0x3,
+	DS4_BUTTON_DPAD_EAST      = 0x2,
+	DS4_BUTTON_DPAD_NORTHEAST = 0x1,
+	DS4_BUTTON_DPAD_NORTH     = 0x0
+} DS4_DPAD_DIRECTIONS, *PDS4_DPAD_DIRECTIONS;
+
+typedef struct _DS4_REPORT
+{
+	BYTE bThumbLX;
+	BYTE bThumbLY;
+	BYTE bThumbRX;
+	BYTE bThumbRY;
+	USHORT wButtons;
+	BYTE bSpecial;
+	BYTE bTriggerL;
+	BYTE bTriggerR;
+} DS4_REPORT, *PDS4_REPORT;
+
+inline void DS4_SET_DPAD(PDS4_REPORT Report, DS4_DPAD_DIRECTIONS Dpad)
+{
+	Report->wButtons &= ~0xF;
+	Report->wButtons |= (USHORT)Dpad;
+}
+
+inline void DS4_REPORT_INIT(PDS4_REPORT Report)
+{
+	RtlZeroMemory(Report, sizeof(DS4_REPORT));
+	Report->bThumbLX = 0x80;
+	Report->bThumbLY = 0x80;
+	Report->bThumbRX = 0x80;
+	Report->bThumbRY = 0x80;
+	DS4_SET_DPAD(Report, DS4_BUTTON_DPAD_NONE);
+}
+
+typedef struct _DS4_LIGHTBAR_COLOR
+{
+	BYTE Red;
+	BYTE Green;
+	BYTE Blue;
+} DS4_LIGHTBAR_COLOR, *PDS4_LIGHTBAR_COLOR;
+
+typedef struct _DS4_OUTPUT_BUFFER
+{
+	UCHAR Buffer[64];
+} DS4_OUTPUT_BUFFER, *PDS4_OUTPUT_BUFFER;
+
+#endif // !VGEN_DRIVERS
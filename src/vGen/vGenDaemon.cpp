@@ -0,0 +1,518 @@
+// vGenDaemon.cpp : Daemon mode (RunDaemon). Serves the devices to feeders in other processes, see vGenProtocol.h.
+//
+// Everything runs on the thread that called RunDaemon(): one loop, on poll() or on Windows WaitForMultipleObjects(), that
+// receives a frame, applies it and answers it. Devices are acquired through the exports and changed with the Control_*()
+// functions, so a frame reaches the bus as one report per committed device. Feeders are known by their socket address; a
+// feeder that said Bye, or whose socket is gone, loses its holds and subscriptions.
+
+#include "stdafx.h"
+#include "Private.h"
+
+#include "DaemonSocket.h"
+
+#ifdef _WIN32
+#include <mstcpip.h>
+#ifndef SIO_UDP_CONNRESET
+#define SIO_UDP_CONNRESET _WSAIOW(IOC_VENDOR, 12)
+#endif
+#else
+#include <fcntl.h>
+#include <poll.h>
+#endif
+
+#include <set>
+#include <string>
+
+using namespace vGenNS;
+
+namespace {
+
+struct DaemonDevice
+{
+	HDEVICE Handle = INVALID_DEV;  // Valid while Holders isn't empty
+	std::set<UINT> Holders;        // Feeder ids
+	std::set<UINT> Subscribers;
+	bool Changed = false;          // The report changed since the last commit
+};
+
+struct DaemonFeeder
+{
+	sockaddr_storage Addr;
+	socklen_t AddrLen;
+};
+
+class Daemon
+{
+public:
+	DWORD Run(const char * address)
+	{
+		sockaddr_storage addr;
+		socklen_t addrLen;
+		if (!DaemonSocket_Parse(address, addr, addrLen))
+			return STATUS_INVALID_PARAMETER_1;
+
+		bool expected = false;
+		if (!m_running.compare_exchange_strong(expected, true))
+			return STATUS_DEVICE_BUSY;
+
+		DWORD res = Open(addr, addrLen);
+		if (res == STATUS_SUCCESS) {
+			res = Loop();
+			Close();
+		}
+		{
+			std::lock_guard<std::mutex> lock(m_statsLock);
+			m_stats.Feeders = m_stats.Devices = 0;
+		}
+		m_running = false;
+		return res;
+	}
+
+	DWORD Stop()
+	{
+		if (!m_running)
+			return STATUS_INVALID_DEVICE_STATE;
+#ifdef _WIN32
+		return SetEvent(m_events[0]) ? STATUS_SUCCESS : STATUS_UNSUCCESSFUL;
+#else
+		const char wake = 1;
+		return write(m_wake[1], &wake, 1) == 1 ? STATUS_SUCCESS : STATUS_UNSUCCESSFUL;
+#endif
+	}
+
+	void GetStats(DaemonStats & stats)
+	{
+		std::lock_guard<std::mutex> lock(m_statsLock);
+		stats = m_stats;
+	}
+
+private:
+	DWORD Open(const sockaddr_storage & addr, socklen_t addrLen)
+	{
+		m_unixPath.clear();
+		m_socket = DaemonSocket_Open(addr.ss_family);
+		if (m_socket == DAEMON_NO_SOCKET)
+			return STATUS_INSUFFICIENT_RESOURCES;
+
+#ifndef _WIN32
+		if (addr.ss_family == AF_UNIX) {
+			// A socket file left behind by a daemon that didn't exit cleanly would fail the bind
+			m_unixPath = ((const sockaddr_un &)addr).sun_path;
+			unlink(m_unixPath.c_str());
+		}
+#endif
+		if (bind(m_socket, (const sockaddr *)&addr, addrLen) || !OpenWake()) {
+			const DWORD res = DaemonSocket_InUse() ? STATUS_DEVICE_BUSY : STATUS_ACCESS_DENIED;
+			DaemonSocket_Close(m_socket);
+			m_socket = DAEMON_NO_SOCKET;
+			m_unixPath.clear();
+			return res;
+		}
+		return STATUS_SUCCESS;
+	}
+
+	// Non-blocking socket, and the wake for Stop()
+	bool OpenWake()
+	{
+#ifdef _WIN32
+		// A datagram sent to a feeder that is gone would fail the next receive, whatever its sender; the feeder is
+		// kept instead, as it is on POSIX for UDP
+		BOOL reset = FALSE;
+		DWORD bytes;
+		WSAIoctl(m_socket, SIO_UDP_CONNRESET, &reset, sizeof(reset), nullptr, 0, &bytes, nullptr, nullptr);
+
+		m_events[0] = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+		m_events[1] = WSACreateEvent();
+		if (m_events[0] && m_events[1] != WSA_INVALID_EVENT && !WSAEventSelect(m_socket, m_events[1], FD_READ))
+			return true;
+		CloseWake();
+		return false;
+#else
+		if (pipe(m_wake))
+			return false;
+		fcntl(m_socket, F_SETFL, O_NONBLOCK);
+		return true;
+#endif
+	}
+
+	void CloseWake()
+	{
+#ifdef _WIN32
+		if (m_events[0])
+			CloseHandle(m_events[0]);
+		if (m_events[1] != WSA_INVALID_EVENT)
+			WSACloseEvent(m_events[1]);
+		m_events[0] = nullptr;
+		m_events[1] = WSA_INVALID_EVENT;
+#else
+		close(m_wake[0]);
+		close(m_wake[1]);
+		m_wake[0] = m_wake[1] = -1;
+#endif
+	}
+
+	void Close()
+	{
+		while (!m_feeders.empty())
+			Drop(m_feeders.begin()->first);
+		m_devices.clear();
+		m_feederIds.clear();
+
+		DaemonSocket_Close(m_socket);
+		m_socket = DAEMON_NO_SOCKET;
+		CloseWake();
+#ifndef _WIN32
+		if (!m_unixPath.empty())
+			unlink(m_unixPath.c_str());
+#endif
+	}
+
+	DWORD Loop()
+	{
+#ifdef _WIN32
+		for (;;) {
+			// Stop() first: the lowest signaled event is the one reported
+			const DWORD wait = WaitForMultipleObjects(2, m_events, FALSE, INFINITE);
+			if (wait == WAIT_OBJECT_0)
+				return STATUS_SUCCESS;
+			if (wait != WAIT_OBJECT_0 + 1)
+				return STATUS_UNEXPECTED_IO_ERROR;
+			WSAResetEvent(m_events[1]);  // Before draining: a datagram arriving meanwhile sets it again
+			Drain();
+		}
+#else
+		pollfd fds[2] = { { m_socket, POLLIN, 0 }, { m_wake[0], POLLIN, 0 } };
+		for (;;) {
+			if (poll(fds, 2, -1) < 0) {
+				if (errno == EINTR)
+					continue;
+				return STATUS_UNEXPECTED_IO_ERROR;
+			}
+			if (fds[1].revents)
+				return STATUS_SUCCESS;
+			Drain();
+		}
+#endif
+	}
+
+	// Applies everything that arrived, a frame at a time
+	void Drain()
+	{
+		for (;;) {
+			VgenMsg frame[VGEN_PROTO_MAX_FRAME];
+			sockaddr_storage from;
+			socklen_t fromLen = sizeof(from);
+			const auto size = recvfrom(m_socket, (char *)frame, (int)sizeof(frame), 0, (sockaddr *)&from, &fromLen);
+			if (size < 0)
+				break;
+			if (!size || size % sizeof(VgenMsg))
+				continue;  // Not ours
+			Frame(Feeder(from, fromLen), frame, (UINT)(size / sizeof(VgenMsg)));
+		}
+	}
+
+	UINT Feeder(const sockaddr_storage & addr, socklen_t addrLen)
+	{
+		const std::string key((const char *)&addr, addrLen);
+		const auto it = m_feederIds.find(key);
+		if (it != m_feederIds.end())
+			return it->second;
+
+		const UINT id = ++m_lastFeeder;
+		m_feederIds[key] = id;
+		DaemonFeeder & feeder = m_feeders[id];
+		feeder.Addr = addr;
+		feeder.AddrLen = addrLen;
+		return id;
+	}
+
+	void Frame(UINT feeder, const VgenMsg * msgs, UINT count)
+	{
+		VgenMsg replies[VGEN_PROTO_MAX_FRAME];
+		UINT nReplies = 0;
+		ULONGLONG errors = 0;
+		m_committed.clear();
+
+		for (UINT i = 0; i < count; ++i) {
+			if (msgs[i].Cmd == VgenCmdBye) {
+				// Answers the messages before it while the feeder is known; any after it are dropped with the feeder
+				if (nReplies)
+					Send(feeder, replies, nReplies);
+				nReplies = 0;
+				Apply(feeder, msgs[i]);
+				count = i + 1;
+				break;
+			}
+
+			const DWORD res = Apply(feeder, msgs[i]);
+			if (res != STATUS_SUCCESS)
+				++errors;
+			if (res == STATUS_SUCCESS && (msgs[i].Flags & VGEN_MSG_QUIET))
+				continue;
+
+			VgenMsg & reply = replies[nReplies++];
+			reply.Cmd = VgenCmdReply;
+			reply.Flags = msgs[i].Flags & VGEN_MSG_QUIET;
+			reply.Index = msgs[i].Cmd;
+			reply.Device = msgs[i].Device;
+			reply.Value = (int32_t)i;
+			reply.Status = res;
+		}
+
+		if (nReplies)
+			Send(feeder, replies, nReplies);
+		for (int32_t number : m_committed)
+			Publish(number);
+
+		std::lock_guard<std::mutex> lock(m_statsLock);
+		++m_stats.Frames;
+		m_stats.Messages += count;
+		m_stats.Errors += errors;
+		m_stats.Feeders = (UINT)m_feeders.size();
+		m_stats.Devices = (UINT)m_devices.size();
+	}
+
+	DWORD Apply(UINT feeder, const VgenMsg & msg)
+	{
+		switch (msg.Cmd) {
+			case VgenCmdHello:
+				return msg.Value == VGEN_PROTO_VERSION ? STATUS_SUCCESS : STATUS_NOT_SUPPORTED;
+
+			case VgenCmdBye:
+				Drop(feeder);
+				return STATUS_SUCCESS;
+
+			case VgenCmdAcquire:
+				return Acquire(feeder, msg.Device);
+
+			case VgenCmdRelease:
+				return Release(feeder, msg.Device);
+
+			case VgenCmdButton:
+			case VgenCmdAxis:
+			case VgenCmdPov:
+			case VgenCmdReset: {
+				std::lock_guard<std::mutex> lock(g_reportLock);
+				DaemonDevice * device = Held(feeder, msg.Device);
+				const PDEVICE pDev = device ? GetDevice(device->Handle) : nullptr;
+				if (!pDev)
+					return STATUS_RESOURCE_NOT_OWNED;
+
+				const DWORD res = Control_Apply(*pDev, msg);
+				if (res == STATUS_SUCCESS)
+					device->Changed = true;
+				return res;
+			}
+
+			case VgenCmdCommit:
+				if (msg.Device)
+					return Commit(Held(feeder, msg.Device), msg.Device);
+				for (auto & device : m_devices) {
+					if (device.second.Holders.count(feeder)) {
+						const DWORD res = Commit(&device.second, device.first);
+						if (res != STATUS_SUCCESS)
+							return res;
+					}
+				}
+				return STATUS_SUCCESS;
+
+			case VgenCmdSubscribe: {
+				DevType type;
+				UINT id;
+				if (!Control_ParseDevice(msg.Device, type, id))
+					return STATUS_INVALID_PARAMETER_2;
+				m_devices[msg.Device].Subscribers.insert(feeder);
+				return STATUS_SUCCESS;
+			}
+
+			case VgenCmdUnsubscribe: {
+				const auto it = m_devices.find(msg.Device);
+				if (it == m_devices.end() || !it->second.Subscribers.erase(feeder))
+					return STATUS_INVALID_PARAMETER_2;
+				Forget(it);
+				return STATUS_SUCCESS;
+			}
+
+			default:
+				return STATUS_INVALID_DEVICE_REQUEST;
+		}
+	}
+
+	DWORD Acquire(UINT feeder, int32_t number)
+	{
+		DevType type;
+		UINT id;
+		if (!Control_ParseDevice(number, type, id))
+			return STATUS_INVALID_PARAMETER_2;
+
+		const auto it = m_devices.emplace(number, DaemonDevice()).first;
+		DaemonDevice & device = it->second;
+		if (device.Holders.empty()) {
+			HDEVICE hDev = INVALID_DEV;
+			const DWORD res = AcquireDev(id, type, &hDev);
+			if (res != STATUS_SUCCESS) {
+				Forget(it);
+				return res;
+			}
+			device.Handle = hDev;
+			device.Changed = false;
+		}
+		device.Holders.insert(feeder);
+		return STATUS_SUCCESS;
+	}
+
+	DWORD Release(UINT feeder, int32_t number)
+	{
+		const auto it = m_devices.find(number);
+		if (it == m_devices.end() || !it->second.Holders.erase(feeder))
+			return STATUS_RESOURCE_NOT_OWNED;
+
+		DWORD res = STATUS_SUCCESS;
+		if (it->second.Holders.empty()) {
+			res = RelinquishDev(it->second.Handle);
+			it->second.Handle = INVALID_DEV;
+		}
+		Forget(it);
+		return res;
+	}
+
+	DWORD Commit(DaemonDevice * device, int32_t number)
+	{
+		{
+			std::lock_guard<std::mutex> lock(g_reportLock);
+			const PDEVICE pDev = device ? GetDevice(device->Handle) : nullptr;
+			if (!pDev)
+				return STATUS_RESOURCE_NOT_OWNED;
+			if (!device->Changed)
+				return STATUS_SUCCESS;
+
+			const DWORD res = Backend_Submit(*pDev);
+			if (res != STATUS_SUCCESS)
+				return res;  // Still changed, the next commit tries again
+		}
+		device->Changed = false;
+		m_committed.insert(number);
+
+		std::lock_guard<std::mutex> lock(m_statsLock);
+		++m_stats.Commits;
+		return STATUS_SUCCESS;
+	}
+
+	DaemonDevice * Held(UINT feeder, int32_t number)
+	{
+		const auto it = m_devices.find(number);
+		return it != m_devices.end() && it->second.Holders.count(feeder) ? &it->second : nullptr;
+	}
+
+	// Removes a device nobody holds or subscribed to
+	void Forget(std::map<int32_t, DaemonDevice>::iterator it)
+	{
+		if (it->second.Holders.empty() && it->second.Subscribers.empty())
+			m_devices.erase(it);
+	}
+
+	// Releases and unsubscribes everything of a feeder, and forgets it
+	void Drop(UINT feeder)
+	{
+		for (auto it = m_devices.begin(); it != m_devices.end();) {
+			const auto next = std::next(it);
+			it->second.Subscribers.erase(feeder);
+			if (it->second.Holders.count(feeder))
+				Release(feeder, it->first);
+			else
+				Forget(it);
+			it = next;
+		}
+
+		const auto feederIt = m_feeders.find(feeder);
+		if (feederIt == m_feeders.end())
+			return;
+		m_feederIds.erase(std::string((const char *)&feederIt->second.Addr, feederIt->second.AddrLen));
+		m_feeders.erase(feederIt);
+	}
+
+	// Sends the committed report of a device to its subscribers
+	void Publish(int32_t number)
+	{
+		const auto it = m_devices.find(number);
+		if (it == m_devices.end() || it->second.Subscribers.empty())
+			return;
+
+		std::unique_lock<std::mutex> lock(g_reportLock);
+		const PDEVICE pDev = GetDevice(it->second.Handle);
+		if (!pDev)
+			return;
+
+		VgenMsg chunks[VGEN_PROTO_MAX_FRAME];
+		const size_t size = GetDevicePosSize(*pDev);
+		const UINT count = (UINT)((size + VGEN_PROTO_STATE_SIZE - 1) / VGEN_PROTO_STATE_SIZE);
+		const BYTE * report = (const BYTE *)pDev->PPosition.vJoyPos;
+		for (UINT i = 0; i < count; ++i) {
+			VgenMsg & chunk = chunks[i];
+			chunk.Cmd = VgenCmdState;
+			chunk.Flags = i == count - 1 ? VGEN_MSG_LAST : 0;
+			chunk.Index = (uint16_t)i;
+			chunk.Device = number;
+			BYTE data[VGEN_PROTO_STATE_SIZE] = {};
+			memcpy(data, report + i * VGEN_PROTO_STATE_SIZE, std::min<size_t>(VGEN_PROTO_STATE_SIZE, size - i * VGEN_PROTO_STATE_SIZE));
+			memcpy(&chunk.Value, data, sizeof(chunk.Value));
+			memcpy(&chunk.Status, data + sizeof(chunk.Value), sizeof(chunk.Status));
+		}
+		lock.unlock();
+
+		// Copy: a subscriber whose socket is gone is dropped while we iterate
+		const std::set<UINT> subscribers = it->second.Subscribers;
+		for (UINT feeder : subscribers)
+			Send(feeder, chunks, count);
+	}
+
+	void Send(UINT feeder, const VgenMsg * msgs, UINT count)
+	{
+		const auto it = m_feeders.find(feeder);
+		if (it == m_feeders.end())
+			return;
+
+		const auto sent = sendto(m_socket, (const char *)msgs, (int)(count * sizeof(VgenMsg)), 0, (const sockaddr *)&it->second.Addr,
+			it->second.AddrLen);
+		if (sent < 0 && DaemonSocket_PeerGone())
+			Drop(feeder);
+	}
+
+	std::atomic_bool m_running {false};
+	DaemonSocket m_socket = DAEMON_NO_SOCKET;
+#ifdef _WIN32
+	HANDLE m_events[2] = { nullptr, WSA_INVALID_EVENT };  // Set by Stop(), and by the socket when readable
+#else
+	int m_wake[2] = { -1, -1 };  // Stop() writes to [1]
+#endif
+	std::string m_unixPath;      // Socket file to remove on exit
+
+	// Loop thread only
+	std::map<std::string, UINT> m_feederIds;  // Socket address => feeder id
+	std::map<UINT, DaemonFeeder> m_feeders;
+	UINT m_lastFeeder = 0;
+	std::map<int32_t, DaemonDevice> m_devices;  // By protocol device number
+	std::set<int32_t> m_committed;              // Devices committed by the current frame
+
+	std::mutex m_statsLock;
+	DaemonStats m_stats;  // under m_statsLock
+};
+
+Daemon g_daemon;
+
+}  // namespace
+
+DWORD Daemon_Run(const char * address)
+{
+	return g_daemon.Run(address);
+}
+
+DWORD Daemon_Stop(void)
+{
+	return g_daemon.Stop();
+}
+
+void Daemon_GetStats(DaemonStats & stats)
+{
+	g_daemon.GetStats(stats);
+}
@@ -0,0 +1,996 @@
+// vGenDrivers.cpp : The driver backend. Feeds vJoy, the XOutput (SCP) bus and the ViGEm bus.
+//
+// Built with VGEN_DRIVERS only, see stdafx.h. The legacy vXbox API (IX_*) lives here as well since it talks to
+// the XOutput bus directly.
+
+#include "stdafx.h"
+#include "Private.h"
+
+#ifdef VGEN_DRIVERS
+
+#pragma comment(lib, "vJoyInterfaceStat.lib")
+#pragma comment(lib, "XOutputStatic_1_2.lib")
+#pragma comment(lib, "XInput")
+#pragma comment(lib, "setupapi.lib")
+
+using namespace vGenNS;
+
+PVIGEM_CLIENT VGE_Client = nullptr;
+
+#pragma region Internal vXbox
+
+DWORD	IX_isVBusExists(void)
+{
+	DWORD Version;
+	DWORD res = XOutputGetBusVersion(&Version);
+	return IX_ErrorToStatus(res);
+}
+
+DWORD	IX_GetNumEmptyBusSlots(UCHAR * nSlots)
+{
+	DWORD res = XOutputGetFreeSlots(1, nSlots);
+	return IX_ErrorToStatus(res);
+}
+
+DWORD	IX_isControllerPluggedIn(UINT UserIndex, PBOOL Exist)
+{
+	DWORD res = XOutputIsPluggedIn(UserIndex - 1, Exist);
+	return IX_ErrorToStatus(res);
+}
+
+BOOL	IX_isControllerPluggedIn(HDEVICE hDev)
+{
+	UINT UserIndex = GetDeviceId(hDev);
+	if (!UserIndex)
+		return FALSE;
+
+	BOOL Exist;
+	return XOutputIsPluggedIn(UserIndex - 1, &Exist) == ERROR_SUCCESS && Exist;
+}
+
+DWORD	IX_isControllerOwned(UINT UserIndex, PBOOL Owned)
+{
+	DWORD res = XOutputIsOwned(UserIndex - 1, Owned);
+	return IX_ErrorToStatus(res);
+}
+
+BOOL	IX_isControllerOwned(HDEVICE hDev)
+{
+	BOOL Owned;
+	if (!hDev)
+		return FALSE;
+
+	UINT UserIndex = GetDeviceId(hDev);
+	if (!UserIndex)
+		return FALSE;
+
+	if (ERROR_SUCCESS == XOutputIsOwned(UserIndex - 1, &Owned))
+		return Owned;
+	else
+		return FALSE;
+}
+
+DWORD	IX_BusPlugIn(UINT UserIndex, DeviceInfo & DevInfo)
+{
+	// Test is it is possible to Plug-In
+	BOOL Exist;
+	DWORD res;
+
+	res = IX_isControllerPluggedIn(UserIndex, &Exist);
+	if (res != ERROR_SUCCESS)
+		return IX_ErrorToStatus(res);
+	if (Exist)
+		return STATUS_DEVICE_ALREADY_ATTACHED;
+
+	// Plug-in
+	res = PERF_DRIVER(XOutputPlugIn(UserIndex - 1));
+	if (res != ERROR_SUCCESS)
+		return IX_ErrorToStatus(res);
+
+	// Wait for device to start - try up to 2 seconds
+	BYTE Led;
+	for (int i = 0; i < 2000; i++)
+	{
+		res = XoutputGetLedNumber(UserIndex - 1, &Led);
+
+		// If device not ready then wait and try again
+		if (res == XOUTPUT_VBUS_DEVICE_NOT_READY)
+		{
+			Sleep(1);
+			continue;
+		}
+
+		// Device is ready or error occured
+		break;
+	}
+
+	// If still not ready
+	if (res == XOUTPUT_VBUS_DEVICE_NOT_READY)
+		return STATUS_DEVICE_NOT_READY;
+
+	DevInfo.LedNumber = Led;
+	DWORD serial;
+	if (XOutputGetRealUserIndex(UserIndex - 1, &serial) == STATUS_SUCCESS)
+		DevInfo.Serial = serial;
+	return STATUS_SUCCESS;
+}
+
+DWORD	IX_PlugIn(UINT UserIndex)
+{
+	DeviceInfo info;
+	const DWORD res = IX_BusPlugIn(UserIndex, info);
+	if (res != STATUS_SUCCESS)
+		return res;
+
+	// Create the device data structure and insert it into the device-container
+	if (HDEVICE hDev = CreateDevice(vXbox, UserIndex)) {
+		std::lock_guard<std::mutex> lock(g_reportLock);
+		PDEVICE pDev = GetDevice(hDev);
+		pDev->Backend = Backend_Driver();
+		pDev->DevInfo = info;
+		return STATUS_SUCCESS;
+	}
+
+	// Failed to create device
+	PERF_DRIVER(XOutputUnPlug(UserIndex - 1));
+	return STATUS_INVALID_HANDLE;
+
+}
+
+DWORD	IX_PlugInNext(UINT * UserIndex)
+{
+	// Look for an empty slot
+	BOOL Exist;
+	UINT i = 0;
+	DWORD res;
+	do {
+		res = IX_isControllerPluggedIn(++i, &Exist);
+		if (!Exist)
+		{
+			*UserIndex = i;
+			break;
+		}
+	} while (res == STATUS_SUCCESS);
+
+	// Slot not found?
+	if (res != STATUS_SUCCESS)
+		return res;
+
+	// Found, now plugin
+	return IX_PlugIn(i);
+}
+
+DWORD	IX_BusUnPlug(UINT UserIndex)
+{
+	DWORD res;
+
+	// Owned?
+	BOOL Owned;
+	res = IX_isControllerOwned(UserIndex, &Owned);
+	if (res != STATUS_SUCCESS)
+		return res;
+	if (!Owned)
+		return STATUS_RESOURCE_NOT_OWNED;
+
+	// Unplug
+	res = PERF_DRIVER(XOutputUnPlug(UserIndex - 1));
+	res = IX_ErrorToStatus(res);
+
+	// Wait for device to be unplugged
+	BOOL Exist = TRUE;
+	for (int i = 0; i < 2000; i++)
+	{
+		if (IX_isControllerPluggedIn(UserIndex, &Exist) != STATUS_SUCCESS || !Exist)
+			break;
+		Sleep(2);
+	}
+
+	// If still exists - error
+	if (Exist)
+		return STATUS_TIMEOUT;
+	return res;
+}
+
+DWORD	IX_UnPlug(UINT UserIndex)
+{
+	const DWORD res = IX_BusUnPlug(UserIndex);
+	if (res == STATUS_TIMEOUT || res == STATUS_RESOURCE_NOT_OWNED)
+		return res;
+
+	// Get handle to device and destroy it
+	HDEVICE hDev = GetDeviceHandle(vXbox, UserIndex);
+	DestroyDevice(hDev);
+	return res;
+}
+
+DWORD	IX_UnPlugForce(UINT UserIndex)
+{
+	DWORD res;
+	BOOL Exist;
+
+	// Exists?
+	res = IX_isControllerPluggedIn(UserIndex, &Exist);
+	if (res != STATUS_SUCCESS)
+		return res;
+	if (!Exist)
+		return STATUS_SUCCESS; // STATUS_DEVICE_DOES_NOT_EXIST;
+
+	// Unplug
+	res = PERF_DRIVER(XOutputUnPlugForce(UserIndex - 1));
+	if (res != ERROR_SUCCESS)
+		return IX_ErrorToStatus(res);
+
+	// Wait for device to be unplugged
+	for (int i = 0; i < 2000; i++)
+	{
+		if (!IX_isControllerPluggedIn(UserIndex))
+			break;
+		Sleep(2);
+	}
+
+	//Sleep(1000); // Temporary - replace with detection code
+
+	// If still exists - error
+	if (IX_isControllerPluggedIn(UserIndex))
+		return STATUS_TIMEOUT;
+
+
+	// Get handle to device and destroy it
+	HDEVICE h = GetDeviceHandle(vXbox, UserIndex);
+	DestroyDevice(h);
+	return STATUS_SUCCESS;
+}
+
+// IX Reset                        ////////////////////////////////////////////////////////
+
+DWORD	IX_ResetController(HDEVICE hDev)
+{
+	std::lock_guard<std::mutex> lock(g_reportLock);
+	const PDEVICE pDev = GetDevice(hDev);
+	if (!pDev || !pDev->Id)
+		return STATUS_INVALID_HANDLE;
+	if (!pDev->PPosition.vXboxPos)
+		return STATUS_MEMORY_NOT_ALLOCATED;
+
+	Report_Reset(*pDev);
+	return Backend_Submit(*pDev);
+}
+
+DWORD	IX_ResetController(UINT UserIndex)
+{
+	return IX_ResetController(GetDeviceHandle(vXbox, UserIndex));
+}
+
+DWORD	IX_ResetAllControllers()
+{
+	DWORD res[4] = {0};
+	res[0] = IX_ResetController((UINT)1);
+	res[1] = IX_ResetController((UINT)2);
+	res[2] = IX_ResetController((UINT)3);
+	res[3] = IX_ResetController((UINT)4);
+
+	for (int i = 0; i < 4; i++)
+		if (res[i] != STATUS_SUCCESS)
+			return res[i];
+	return STATUS_SUCCESS;
+}
+
+DWORD	IX_ResetControllerBtns(HDEVICE hDev)
+{
+	std::lock_guard<std::mutex> lock(g_reportLock);
+	const PDEVICE pDev = GetDevice(hDev);
+	if (!pDev || !pDev->Id)
+		return STATUS_INVALID_HANDLE;
+	if (!pDev->PPosition.vXboxPos)
+		return STATUS_MEMORY_NOT_ALLOCATED;
+
+	// Change position value
+	pDev->PPosition.vXboxPos->wButtons &= XBTN_DPAD_MASK;
+	return Backend_Submit(*pDev);
+}
+
+DWORD	IX_ResetControllerBtns(UINT UserIndex)
+{
+	return IX_ResetControllerBtns(GetDeviceHandle(vXbox, UserIndex));
+}
+
+DWORD	IX_ResetControllerDPad(HDEVICE hDev)
+{
+	std::lock_guard<std::mutex> lock(g_reportLock);
+	const PDEVICE pDev = GetDevice(hDev);
+	if (!pDev || !pDev->Id)
+		return STATUS_INVALID_HANDLE;
+	if (!pDev->PPosition.vXboxPos)
+		return STATUS_MEMORY_NOT_ALLOCATED;
+
+	// Change position value
+	pDev->PPosition.vXboxPos->wButtons &= ~XBTN_DPAD_MASK;
+	return Backend_Submit(*pDev);
+}
+
+DWORD	IX_ResetControllerDPad(UINT UserIndex)
+{
+	return IX_ResetControllerDPad(GetDeviceHandle(vXbox, UserIndex));
+}
+
+// IX Buttons                        ////////////////////////////////////////////////////////
+
+DWORD	IX_SetBtn(const PDEVICE pDev, BOOL Press, WORD Button, BOOL XInput)
+{
+	if (!pDev)
+		return STATUS_INVALID_HANDLE;
+	if (!pDev->PPosition.vXboxPos)
+		return STATUS_MEMORY_NOT_ALLOCATED;
+
+	// Anything beyond the button numbers is a mask
+	return Backend_SubmitIf(*pDev, Report_SetButton(*pDev, Button, Press, XInput || Button > XINPUT_NUM_BUTTONS));
+}
+
+#ifdef SPECIFICBUTTONS
+BOOL	IX_SetBtnA(HDEVICE hDev, BOOL Press)
+{
+	return IX_SetBtn(hDev, Press, XINPUT_GAMEPAD_A);
+}
+
+BOOL	IX_SetBtnB(HDEVICE hDev, BOOL Press)
+{
+	return IX_SetBtn(hDev, Press, XINPUT_GAMEPAD_B);
+}
+
+BOOL	IX_SetBtnX(HDEVICE hDev, BOOL Press)
+{
+	return IX_SetBtn(hDev, Press, XINPUT_GAMEPAD_X);
+}
+
+BOOL	IX_SetBtnY(HDEVICE hDev, BOOL Press)
+{
+	return IX_SetBtn(hDev, Press, XINPUT_GAMEPAD_Y);
+}
+
+BOOL	IX_SetBtnStart(HDEVICE hDev, BOOL Press)
+{
+	return IX_SetBtn(hDev, Press, XINPUT_GAMEPAD_START);
+}
+
+BOOL	IX_SetBtnBack(HDEVICE hDev, BOOL Press)
+{
+	return IX_SetBtn(hDev, Press, XINPUT_GAMEPAD_BACK);
+}
+
+BOOL	IX_SetBtnLT(HDEVICE hDev, BOOL Press) // Left Thumb/Stick
+{
+	return IX_SetBtn(hDev, Press, XINPUT_GAMEPAD_LEFT_THUMB);
+}
+
+BOOL	IX_SetBtnRT(HDEVICE hDev, BOOL Press) // Right Thumb/Stick
+{
+	return IX_SetBtn(hDev, Press, XINPUT_GAMEPAD_RIGHT_THUMB);
+}
+
+BOOL	IX_SetBtnLB(HDEVICE hDev, BOOL Press) // Left Bumper
+{
+	return IX_SetBtn(hDev, Press, XINPUT_GAMEPAD_LEFT_SHOULDER);
+}
+
+BOOL	IX_SetBtnRB(HDEVICE hDev, BOOL Press) // Right Bumper
+{
+	return IX_SetBtn(hDev, Press, XINPUT_GAMEPAD_RIGHT_SHOULDER);
+}
+
+BOOL	IX_SetBtnA(UINT UserIndex, BOOL Press)
+{
+	return IX_SetBtn(UserIndex, Press, XINPUT_GAMEPAD_A);
+}
+
+BOOL	IX_SetBtnB(UINT UserIndex, BOOL Press)
+{
+	return IX_SetBtn(UserIndex, Press, XINPUT_GAMEPAD_B);
+}
+
+BOOL	IX_SetBtnX(UINT UserIndex, BOOL Press)
+{
+	return IX_SetBtn(UserIndex, Press, XINPUT_GAMEPAD_X);
+}
+
+BOOL	IX_SetBtnY(UINT UserIndex, BOOL Press)
+{
+	return IX_SetBtn(UserIndex, Press, XINPUT_GAMEPAD_Y);
+}
+
+BOOL	IX_SetBtnStart(UINT UserIndex, BOOL Press)
+{
+	return IX_SetBtn(UserIndex, Press, XINPUT_GAMEPAD_START);
+}
+
+BOOL	IX_SetBtnBack(UINT UserIndex, BOOL Press)
+{
+	return IX_SetBtn(UserIndex, Press, XINPUT_GAMEPAD_BACK);
+}
+
+BOOL	IX_SetBtnLT(UINT UserIndex, BOOL Press) // Left Thumb/Stick
+{
+	return IX_SetBtn(UserIndex, Press, XINPUT_GAMEPAD_LEFT_THUMB);
+}
+
+BOOL	IX_SetBtnRT(UINT UserIndex, BOOL Press) // Right Thumb/Stick
+{
+	return IX_SetBtn(UserIndex, Press, XINPUT_GAMEPAD_RIGHT_THUMB);
+}
+
+BOOL	IX_SetBtnLB(UINT UserIndex, BOOL Press) // Left Bumper
+{
+	return IX_SetBtn(UserIndex, Press, XINPUT_GAMEPAD_LEFT_SHOULDER);
+}
+
+BOOL	IX_SetBtnRB(UINT UserIndex, BOOL Press) // Right Bumper
+{
+	return IX_SetBtn(UserIndex, Press, XINPUT_GAMEPAD_RIGHT_SHOULDER);
+}
+
+#endif // SPECIFICBUTTONS
+
+// IX Axis                //////////////////////////////////////////////
+
+DWORD	IX_SetAxis(const PDEVICE pDev, HID_USAGES Axis, SHORT Value)
+{
+	if (!pDev)
+		return STATUS_INVALID_HANDLE;
+	if (!pDev->PPosition.vXboxPos)
+		return STATUS_MEMORY_NOT_ALLOCATED;
+
+	return Backend_SubmitIf(*pDev, Report_SetAxis(*pDev, Axis, Value));
+}
+
+#ifdef SPECIFICBUTTONS
+DWORD	IX_SetTriggerL(HDEVICE hDev, BYTE Value) // Left Trigger
+{
+	return IX_SetAxis(hDev, HID_USAGE_LT, Value);
+}
+
+DWORD	IX_SetTriggerL(UINT UserIndex, BYTE Value) // Left Trigger
+{
+	return IX_SetTriggerL(GetDeviceHandle(vXbox, UserIndex), Value);
+}
+
+DWORD	IX_SetTriggerR(HDEVICE hDev, BYTE Value) // Right Trigger
+{
+	return IX_SetAxis(hDev, HID_USAGE_RT, Value);
+}
+
+DWORD	IX_SetTriggerR(UINT UserIndex, BYTE Value) // Right Trigger
+{
+	return IX_SetTriggerR(GetDeviceHandle(vXbox, UserIndex), Value);
+}
+
+DWORD	IX_SetAxisLx(HDEVICE hDev, SHORT Value) // Left Stick X
+{
+	return IX_SetAxis(hDev, HID_USAGE_LX, Value);
+}
+
+DWORD	IX_SetAxisLx(UINT UserIndex, SHORT Value) // Left Stick X
+{
+	return IX_SetAxisLx(GetDeviceHandle(vXbox, UserIndex), Value);
+}
+
+DWORD	IX_SetAxisLy(HDEVICE hDev, SHORT Value) // Left Stick Y
+{
+	return IX_SetAxis(hDev, HID_USAGE_LY, Value);
+}
+
+DWORD	IX_SetAxisLy(UINT UserIndex, SHORT Value) // Left Stick Y
+{
+	return IX_SetAxisLy(GetDeviceHandle(vXbox, UserIndex), Value);
+}
+
+DWORD	IX_SetAxisRx(HDEVICE hDev, SHORT Value) // Right Stick X
+{
+	return IX_SetAxis(hDev, HID_USAGE_RX, Value);
+}
+
+DWORD	IX_SetAxisRx(UINT UserIndex, SHORT Value) // Right Stick X
+{
+	return IX_SetAxisRx(GetDeviceHandle(vXbox, UserIndex), Value);
+}
+
+DWORD	IX_SetAxisRy(HDEVICE hDev, SHORT Value) // Right Stick Y
+{
+	return IX_SetAxis(hDev, HID_USAGE_RY, Value);
+}
+
+DWORD	IX_SetAxisRy(UINT UserIndex, SHORT Value) // Right Stick Y
+{
+	return IX_SetAxisRy(GetDeviceHandle(vXbox, UserIndex), Value);
+}
+#endif // SPECIFICBUTTONS
+
+// IX DPAD               ///////////////////////////////////////
+
+// This lets any of the 4 dpov button bits be set at any one time but will not allow
+// individual bits to be set one at a time, like you get with the actual "button" types.
+// Subsequent calls to this function will clear any previously set DPOV button bits (0xF)
+DWORD	IX_SetDpad(const PDEVICE pDev, UCHAR Value)
+{
+	if (!pDev)
+		return STATUS_INVALID_HANDLE;
+	if (!pDev->PPosition.vXboxPos)
+		return STATUS_MEMORY_NOT_ALLOCATED;
+
+	return Backend_SubmitIf(*pDev, Report_SetDpad(*pDev, Value));
+}
+
+#ifdef SPECIFICBUTTONS
+BOOL	IX_SetDpadUp(HDEVICE hDev)
+{
+	return IX_SetDpad(hDev, XBTN_DPAD_UP);
+}
+
+BOOL	IX_SetDpadUp(UINT UserIndex)
+{
+	return IX_SetDpad(UserIndex, XBTN_DPAD_UP);
+}
+
+BOOL	IX_SetDpadRight(HDEVICE hDev)
+{
+	return IX_SetDpad(hDev, XBTN_DPAD_RIGHT);
+}
+
+BOOL	IX_SetDpadRight(UINT UserIndex)
+{
+	return IX_SetDpad(UserIndex, XBTN_DPAD_RIGHT);
+}
+
+BOOL	IX_SetDpadDown(HDEVICE hDev)
+{
+	return IX_SetDpad(hDev, XBTN_DPAD_DOWN);
+}
+
+BOOL	IX_SetDpadDown(UINT UserIndex)
+{
+	return IX_SetDpad(UserIndex, XBTN_DPAD_DOWN);
+}
+
+BOOL	IX_SetDpadLeft(HDEVICE hDev)
+{
+	return IX_SetDpad(hDev, XBTN_DPAD_LEFT);
+}
+
+BOOL	IX_SetDpadLeft(UINT UserIndex)
+{
+	return IX_SetDpad(UserIndex, XBTN_DPAD_LEFT);
+}
+
+BOOL	IX_SetDpadOff(HDEVICE hDev)
+{
+	return IX_SetDpad(hDev, XBTN_NONE);
+}
+
+BOOL	IX_SetDpadOff(UINT UserIndex)
+{
+	return IX_SetDpad(UserIndex, XBTN_NONE);
+}
+#endif // SPECIFICBUTTONS
+
+// IX Get infos                 /////////////////////////////////////////
+
+DWORD	IX_GetLedNumber(UINT UserIndex, PBYTE pLed)
+{
+	BOOL Exist;
+	DWORD res;
+
+	// Test if device is plugged-in
+	res = IX_isControllerPluggedIn(UserIndex, &Exist);
+	if (res != STATUS_SUCCESS)
+		return res;
+	if (!Exist)
+		return STATUS_DEVICE_DOES_NOT_EXIST;
+
+	HDEVICE h = GetDeviceHandle(vXbox, UserIndex);
+	if (!h)
+		return STATUS_INVALID_HANDLE;
+
+	if (!pLed)
+		return STATUS_INVALID_PARAMETER_2;
+
+	res = XoutputGetLedNumber(UserIndex - 1, pLed);
+	return IX_ErrorToStatus(res);
+}
+
+DWORD	IX_GetVibration(UINT UserIndex, PXINPUT_VIBRATION pVib)
+{
+	HDEVICE h = GetDeviceHandle(vXbox, UserIndex);
+	if (!h)
+		return STATUS_INVALID_HANDLE;
+
+	if (!pVib)
+		return STATUS_INVALID_PARAMETER_2;
+
+	const DWORD res = XoutputGetVibration(UserIndex - 1, pVib);
+	return IX_ErrorToStatus(res);
+}
+
+#pragma endregion Internal vXbox
+
+/////////////////////////////////////////
+
+#pragma region Internal vJoy
+
+void IJ_GetCaps(UINT rID, DeviceCaps & caps)
+{
+	caps = DeviceCaps();
+	for (UINT usage = HID_USAGE_X; usage <= HID_USAGE_WHL; ++usage) {
+		if (vJoyNS::GetVJDAxisExist(rID, usage))
+			caps.Axes |= 1UL << (usage - HID_USAGE_X);
+	}
+	caps.Buttons = (USHORT)vJoyNS::GetVJDButtonNumber(rID);
+	caps.DiscPovs = (BYTE)vJoyNS::GetVJDDiscPovNumber(rID);
+	caps.ContPovs = (BYTE)vJoyNS::GetVJDContPovNumber(rID);
+}
+
+#pragma endregion
+
+#pragma region ViGEm Internal Functions
+
+DWORD VGE_InitClient(void)
+{
+	if (VGE_Client)
+		return STATUS_SUCCESS;
+
+	VGE_Client = vigem_alloc();
+	if (!VGE_Client)
+		return STATUS_MEMORY_NOT_ALLOCATED;
+
+	const VIGEM_ERROR res = vigem_connect(VGE_Client);
+	if (res == VIGEM_ERROR_NONE || res == VIGEM_ERROR_BUS_ALREADY_CONNECTED)
+		return STATUS_SUCCESS;
+
+	vigem_free(VGE_Client);
+	VGE_Client = nullptr;
+	return VGE_ErrorToStatus(res);
+}
+
+DWORD VGE_BusExists(void)
+{
+	// There's no better way to check if the bus exists than to init it.
+	return VGE_InitClient();
+}
+
+// Called by the ViGEm client's notification thread for the target each time the host sends an output report.
+static VOID CALLBACK VGE_notification_x360(
+	PVIGEM_CLIENT Client, PVIGEM_TARGET Target,
+	UCHAR LargeMotor, UCHAR SmallMotor, UCHAR LedNumber,
+	LPVOID UserData
+)
+{
+	PDEVICE pDev = (PDEVICE)UserData;
+	if (!pDev || !pDev->Feedback)
+		return;
+
+	FeedbackData fb;
+	fb.LargeMotor = LargeMotor;
+	fb.SmallMotor = SmallMotor;
+	fb.LedNumber = LedNumber + 1;
+	if (pDev->DevInfo.LedNumber != fb.LedNumber)
+		InterlockedExchange8((CHAR *)&pDev->DevInfo.LedNumber, (CHAR)fb.LedNumber);
+	pDev->Feedback->Publish(fb, FeedbackRumble | FeedbackLed);
+}
+
+static VOID CALLBACK VGE_notification_ds4(
+	PVIGEM_CLIENT Client, PVIGEM_TARGET Target,
+	UCHAR LargeMotor, UCHAR SmallMotor, DS4_LIGHTBAR_COLOR LightbarColor,
+	LPVOID UserData
+)
+{
+	PDEVICE pDev = (PDEVICE)UserData;
+	if (!pDev || !pDev->Feedback)
+		return;
+
+	FeedbackData fb;
+	fb.LargeMotor = LargeMotor;
+	fb.SmallMotor = SmallMotor;
+	fb.ColorBar = (0xFF << 24) | (LightbarColor.Red << 16) | (LightbarColor.Green << 8) | LightbarColor.Blue;
+	if (pDev->DevInfo.ColorBar != fb.ColorBar)
+		InterlockedExchange((LONG *)&pDev->DevInfo.ColorBar, (LONG)fb.ColorBar);
+	pDev->Feedback->Publish(fb, FeedbackRumble | FeedbackLightbar);
+}
+
+// Start receiving feedback for an attached ViGEm target. XBox targets use notifications while
+// DS4 targets get an output report reader thread, which also provides the lightbar flash timing.
+DWORD VGE_RegisterFeedback(PDEVICE pDev)
+{
+	if (!pDev || !pDev->VGE_Target)
+		return STATUS_INVALID_HANDLE;
+
+	if (!pDev->Feedback)
+		pDev->Feedback = std::make_shared<DeviceFeedback>();
+
+	if (pDev->Type == DevType::vgeDS4) {
+		Ds4_StartReader(pDev);
+		return STATUS_SUCCESS;
+	}
+
+	const VIGEM_ERROR res = vigem_target_x360_register_notification(VGE_Client, pDev->VGE_Target, &VGE_notification_x360, pDev);
+	return VGE_ErrorToStatus(res);
+}
+
+// Fallback for buses which can't deliver raw DS4 output reports; called from the reader thread when it gives up.
+DWORD VGE_RegisterDs4Notification(PDEVICE pDev)
+{
+	const VIGEM_ERROR res = vigem_target_ds4_register_notification(VGE_Client, pDev->VGE_Target, &VGE_notification_ds4, pDev);
+	return VGE_ErrorToStatus(res);
+}
+
+// Stop feedback notifications. Must be called before the target is removed or the device destroyed.
+void VGE_UnregisterFeedback(const DEVICE &dev)
+{
+	if (!dev.VGE_Target || !dev.Feedback)
+		return;
+
+	if (dev.Type == DevType::vgeXbox) {
+		vigem_target_x360_unregister_notification(dev.VGE_Target);
+	}
+	else {
+		Ds4_StopReader(*dev.Feedback);
+		vigem_target_ds4_unregister_notification(dev.VGE_Target);
+	}
+}
+
+DWORD VGE_AwaitDs4OutputReport(const PDEVICE pDev, DS4_OUTPUT_BUFFER * pReport, DWORD Timeout)
+{
+	if (!pDev || !pDev->VGE_Target)
+		return STATUS_INVALID_HANDLE;
+
+	const VIGEM_ERROR res = vigem_target_ds4_await_output_report_timeout(VGE_Client, pDev->VGE_Target, Timeout, pReport);
+	return VGE_ErrorToStatus(res);
+}
+
+DWORD VGE_PlugIn(DEVICE & dev)
+{
+	if (!dev.VGE_Target) {
+		DWORD stat = VGE_InitClient();
+		if (stat != STATUS_SUCCESS)
+			return stat;
+
+		dev.VGE_Target = dev.Type == DevType::vgeXbox ? vigem_target_x360_alloc() : vigem_target_ds4_alloc();
+		if (!dev.VGE_Target)
+			return STATUS_MEMORY_NOT_ALLOCATED;
+	}
+	else if (vigem_target_is_attached(dev.VGE_Target)) {
+		return STATUS_DEVICE_ALREADY_ATTACHED;
+	}
+
+	dev.DevInfo.LedNumber = 0;
+	dev.DevInfo.Serial = 0;
+	const VIGEM_ERROR res = PERF_DRIVER(vigem_target_add(VGE_Client, dev.VGE_Target));
+	if (res == VIGEM_ERROR_NONE) {
+		dev.DevInfo.Serial = vigem_target_get_index(dev.VGE_Target);
+		dev.DevInfo.VendId = vigem_target_get_vid(dev.VGE_Target);
+		dev.DevInfo.ProdId = vigem_target_get_pid(dev.VGE_Target);
+		if (dev.Type == DevType::vgeXbox) {
+			ULONG led;
+			if (vigem_target_x360_get_user_index(VGE_Client, dev.VGE_Target, &led) == VIGEM_ERROR_NONE)
+				dev.DevInfo.LedNumber = (BYTE)led + 1;
+		}
+		// Feedback is optional, the device is still usable without it.
+		VGE_RegisterFeedback(&dev);
+	}
+	return VGE_ErrorToStatus(res);
+}
+
+DWORD VGE_UnPlug(DEVICE & dev)
+{
+	if (!dev.VGE_Target || !vigem_target_is_attached(dev.VGE_Target))
+		return STATUS_DEVICE_NOT_CONNECTED;
+
+	VGE_UnregisterFeedback(dev);
+	const VIGEM_ERROR res = PERF_DRIVER(vigem_target_remove(VGE_Client, dev.VGE_Target));
+	return VGE_ErrorToStatus(res);
+}
+
+void VGE_Release(DEVICE & dev)
+{
+	if (!dev.VGE_Target)
+		return;
+
+	VGE_UnregisterFeedback(dev);
+	if (vigem_target_is_attached(dev.VGE_Target))
+		PERF_DRIVER(vigem_target_remove(VGE_Client, dev.VGE_Target));
+	vigem_target_free(dev.VGE_Target);
+	dev.VGE_Target = nullptr;
+}
+
+DWORD VGE_ResetController(vGenNS::DevType dType, UINT DevId)
+{
+	std::lock_guard<std::mutex> lock(g_reportLock);
+	PDEVICE pDev = GetDevice(dType, DevId);
+	if (!pDev || !pDev->Backend)
+		return STATUS_INVALID_HANDLE;
+
+	Report_Reset(*pDev);
+	return Backend_Submit(*pDev);
+}
+
+#pragma endregion  ViGEm Internal Functions
+
+#pragma region Driver Backend
+
+namespace {
+
+class DriverBackend : public DeviceBackend
+{
+public:
+	DWORD BusStatus(DevType type) override
+	{
+		switch (type) {
+			case DevType::vJoy:
+				return BOOL_TO_STATUS(vJoyNS::vJoyEnabled());
+			case DevType::vXbox:
+				return IX_isVBusExists();
+			case DevType::vgeXbox:
+			case DevType::vgeDS4:
+				return VGE_BusExists();
+			default:
+				return STATUS_INVALID_PARAMETER_1;
+		}
+	}
+
+	DWORD BusVersion(DevType type) override
+	{
+		switch (type) {
+			case DevType::vJoy:
+				return (DWORD)vJoyNS::GetvJoyVersion();
+			case DevType::vXbox:
+				return GetVBusVersion();
+			case DevType::vgeXbox:
+			case DevType::vgeDS4:
+				return VGE_Version();
+			default:
+				return 0;
+		}
+	}
+
+	VjdStat SlotStatus(DevType type, UINT id) override
+	{
+		switch (type) {
+			case DevType::vJoy:
+				return vJoyNS::GetVJDStatus(id);
+
+			case DevType::vXbox: {
+				BOOL Exist, Owned;
+				if SUCCEEDED(IX_isControllerOwned(id, &Owned)) {
+					if (Owned)
+						return VJD_STAT_OWN;
+				}
+
+				if SUCCEEDED(IX_isControllerPluggedIn(id, &Exist)) {
+					if (Exist)
+						return VJD_STAT_BUSY;
+				}
+				return VJD_STAT_FREE;
+			}
+
+			case DevType::vgeXbox:
+			case DevType::vgeDS4: {
+				if (VGE_BusExists() != STATUS_SUCCESS)
+					return VJD_STAT_MISS;
+
+				// ViGEm can't tell about targets of other clients
+				const PDEVICE pDev = GetDevice(type, id);
+				if (pDev && pDev->VGE_Target && vigem_target_is_attached(pDev->VGE_Target))
+					return VJD_STAT_OWN;
+				return VJD_STAT_FREE;
+			}
+
+			default:
+				return VJD_STAT_MISS;
+		}
+	}
+
+	DWORD Plug(DEVICE & dev) override
+	{
+		switch (dev.Type) {
+			case DevType::vJoy:
+				if (vJoyNS::GetVJDStatus(dev.Id) == VJD_STAT_OWN)
+					return STATUS_DEVICE_ALREADY_ATTACHED;
+				if (!PERF_DRIVER(vJoyNS::AcquireVJD(dev.Id)))
+					return STATUS_UNSUCCESSFUL;
+				IJ_GetCaps(dev.Id, dev.Caps);
+				return STATUS_SUCCESS;
+
+			case DevType::vXbox:
+				return IX_BusPlugIn(dev.Id, dev.DevInfo);
+
+			case DevType::vgeXbox:
+			case DevType::vgeDS4:
+				return VGE_PlugIn(dev);
+
+			default:
+				return STATUS_INVALID_PARAMETER_2;
+		}
+	}
+
+	DWORD Unplug(DEVICE & dev) override
+	{
+		switch (dev.Type) {
+			case DevType::vJoy:
+				PERF_DRIVER(vJoyNS::RelinquishVJD(dev.Id));
+				return STATUS_SUCCESS;
+
+			case DevType::vXbox:
+				return IX_BusUnPlug(dev.Id);
+
+			case DevType::vgeXbox:
+			case DevType::vgeDS4:
+				return VGE_UnPlug(dev);
+
+			default:
+				return STATUS_INVALID_HANDLE;
+		}
+	}
+
+	DWORD Submit(DEVICE & dev, const DEVICE & report) override
+	{
+		switch (dev.Type) {
+			case DevType::vJoy:
+				return BOOL_TO_STATUS(PERF_DRIVER(vJoyNS::UpdateVJD(dev.Id, report.PPosition.vJoyPos)));
+
+			case DevType::vXbox:
+				return IX_ErrorToStatus(PERF_DRIVER(XOutputSetState(dev.Id - 1, report.PPosition.vXboxPos)));
+
+			case DevType::vgeXbox:
+				if (!dev.VGE_Target)
+					return STATUS_INVALID_HANDLE;
+				return VGE_ErrorToStatus(PERF_DRIVER(vigem_target_x360_update(VGE_Client, dev.VGE_Target, *((PXUSB_REPORT)report.PPosition.vXboxPos))));
+
+			case DevType::vgeDS4:
+				if (!dev.VGE_Target)
+					return STATUS_INVALID_HANDLE;
+				return VGE_ErrorToStatus(PERF_DRIVER(vigem_target_ds4_update(VGE_Client, dev.VGE_Target, *report.PPosition.ds4Pos)));
+
+			default:
+				return STATUS_INVALID_HANDLE;
+		}
+	}
+
+	// None of the drivers reads back reliably, the last report sent is what the bus has
+	DWORD Read(const DEVICE & dev, PVOID report) override
+	{
+		const size_t size = GetDevicePosSize(dev);
+		if (!size || !dev.PPosition.vJoyPos)
+			return STATUS_DEVICE_NOT_CONNECTED;
+		memcpy(report, dev.PPosition.vJoyPos, size);
+		return STATUS_SUCCESS;
+	}
+
+	void Release(DEVICE & dev) override
+	{
+		if (dev.Type == DevType::vgeXbox || dev.Type == DevType::vgeDS4)
+			VGE_Release(dev);
+	}
+
+	DWORD PadState(UINT slot, XINPUT_STATE & state) override
+	{
+		return XInputGetState(slot, &state) == ERROR_SUCCESS ? STATUS_SUCCESS : STATUS_DEVICE_NOT_CONNECTED;
+	}
+
+	void Shutdown() override
+	{
+		if (VGE_Client) {
+			vigem_disconnect(VGE_Client);
+			vigem_free(VGE_Client);
+			VGE_Client = nullptr;
+		}
+	}
+};
+
+DriverBackend g_driverBackend;
+
+}  // namespace
+
+DeviceBackend * Backend_Driver(void)
+{
+	return &g_driverBackend;
+}
+
+#pragma endregion Driver Backend
+
+#endif // VGEN_DRIVERS
@@ -0,0 +1,228 @@
+// vGenFeedback.cpp : Device feedback (rumble/LED/lightbar) queues and the DS4 output report reader.
+//
+
+#include "stdafx.h"
+#include "Private.h"
+
+#include <chrono>
+
+using namespace vGenNS;
+
+extern std::atomic_bool g_isShuttingDown;
+
+// The host's LED, lightbar and flash in one word, which the bridge reads without m_publishLock
+static ULONGLONG Feedback_PackLights(const FeedbackData & data)
+{
+	return (ULONGLONG)data.ColorBar << 32 | (ULONGLONG)data.LedNumber << 16 | (ULONGLONG)data.FlashOn << 8 | data.FlashOff;
+}
+
+static void Feedback_UnpackLights(ULONGLONG lights, FeedbackData & data)
+{
+	data.ColorBar = (DWORD)(lights >> 32);
+	data.LedNumber = (BYTE)(lights >> 16);
+	data.FlashOn = (BYTE)(lights >> 8);
+	data.FlashOff = (BYTE)lights;
+}
+
+bool DeviceFeedback::Publish(FeedbackData data, BYTE fields)
+{
+	if (fields & FeedbackBridged) {
+		// Rumble bridge: the host state as is, with the bridge motors. Never waits for the host's producers.
+		std::lock_guard<std::mutex> bridgeLock(m_bridgeLock);
+		if (!(fields & FeedbackRumble) || (data.LargeMotor == m_bridgeLarge && data.SmallMotor == m_bridgeSmall))
+			return false;
+		m_bridgeLarge = data.LargeMotor;
+		m_bridgeSmall = data.SmallMotor;
+		Feedback_UnpackLights(m_lastLights.load(std::memory_order_acquire), data);
+		data.Flags = FeedbackRumble | FeedbackBridged;
+		Push(data);
+		return true;
+	}
+
+	std::lock_guard<std::mutex> publishLock(m_publishLock);
+	BYTE changed = FeedbackNone;
+	if ((fields & FeedbackRumble) && (data.LargeMotor != m_last.LargeMotor || data.SmallMotor != m_last.SmallMotor))
+		changed |= FeedbackRumble;
+	else {
+		data.LargeMotor = m_last.LargeMotor;
+		data.SmallMotor = m_last.SmallMotor;
+	}
+	if ((fields & FeedbackLed) && data.LedNumber != m_last.LedNumber)
+		changed |= FeedbackLed;
+	else
+		data.LedNumber = m_last.LedNumber;
+	if ((fields & FeedbackLightbar) && data.ColorBar != m_last.ColorBar)
+		changed |= FeedbackLightbar;
+	else
+		data.ColorBar = m_last.ColorBar;
+	if ((fields & FeedbackFlash) && (data.FlashOn != m_last.FlashOn || data.FlashOff != m_last.FlashOff))
+		changed |= FeedbackFlash;
+	else {
+		data.FlashOn = m_last.FlashOn;
+		data.FlashOff = m_last.FlashOff;
+	}
+
+	if (changed == FeedbackNone)
+		return false;
+
+	data.Flags = changed;
+	m_last = data;
+	m_lastLights.store(Feedback_PackLights(data), std::memory_order_release);
+	Push(data);
+	return true;
+}
+
+// A host record and a bridge record pushed at the same time may come out of Sequence order
+void DeviceFeedback::Push(FeedbackData & data)
+{
+	data.Sequence = m_sequence.fetch_add(1) + 1;
+	if (!Queue.Push(data))
+		++Dropped;
+
+	// Queue.Push() and m_waiters use sequentially consistent ordering so either we see the
+	// waiter here or the waiter sees the new record before going to sleep.
+	if (m_waiters.load()) {
+		std::lock_guard<std::mutex> lock(m_waitLock);
+		m_waitCond.notify_all();
+	}
+}
+
+DWORD DeviceFeedback::Read(FeedbackData * data, UINT count, UINT * read, DWORD timeout)
+{
+	std::lock_guard<std::mutex> readLock(m_readLock);
+
+	*read = (UINT)Queue.Drain(data, count);
+	if (*read)
+		return STATUS_SUCCESS;
+	if (!timeout)
+		return STATUS_TIMEOUT;
+
+	{
+		std::unique_lock<std::mutex> lock(m_waitLock);
+		++m_waiters;
+		const auto ready = [this]() { return !Queue.Empty() || Closed || g_isShuttingDown; };
+		if (timeout == INFINITE)
+			m_waitCond.wait(lock, ready);
+		else
+			m_waitCond.wait_for(lock, std::chrono::milliseconds(timeout), ready);
+		--m_waiters;
+	}
+
+	if (Closed)
+		return STATUS_DEVICE_REMOVED;
+
+	*read = (UINT)Queue.Drain(data, count);
+	return *read ? STATUS_SUCCESS : STATUS_TIMEOUT;
+}
+
+void DeviceFeedback::Close()
+{
+	Closed = true;
+	std::lock_guard<std::mutex> lock(m_waitLock);
+	m_waitCond.notify_all();
+}
+
+#pragma region DS4 Output Report Reader
+
+// How long one await on the bus may block; bounds how long stopping the reader takes.
+#define DS4_READER_TIMEOUT_MS  100
+// Pause after a read error before trying again.
+#define DS4_READER_RETRY_MS    250
+
+// Output report flags (byte 1 of the report) telling which sections are valid.
+#define DS4_OUT_FLAG_RUMBLE    0x01
+#define DS4_OUT_FLAG_LIGHTBAR  0x02
+#define DS4_OUT_FLAG_FLASH     0x04
+
+#ifdef VGEN_DRIVERS
+static Ds4ReportSource g_ds4ReportSource = &VGE_AwaitDs4OutputReport;
+
+void VGE_SetDs4ReportSource(Ds4ReportSource source)
+{
+	g_ds4ReportSource = source ? source : &VGE_AwaitDs4OutputReport;
+}
+#endif // VGEN_DRIVERS
+
+// Decodes a raw DS4 output report (USB report 0x05, or Bluetooth report 0x11) into `data`
+// and returns the FeedbackFlags of the sections it contained.
+BYTE Ds4_DecodeOutputReport(const DS4_OUTPUT_BUFFER & report, FeedbackData & data)
+{
+	const UCHAR * buf = report.Buffer;
+	if (buf[0] == 0x11)  // Bluetooth has 2 extra header bytes
+		buf += 2;
+	else if (buf[0] != 0x05)
+		return FeedbackNone;
+
+	BYTE fields = FeedbackNone;
+	const UCHAR flags = buf[1];
+	if (flags & DS4_OUT_FLAG_RUMBLE) {
+		data.SmallMotor = buf[4];
+		data.LargeMotor = buf[5];
+		fields |= FeedbackRumble;
+	}
+	if (flags & DS4_OUT_FLAG_LIGHTBAR) {
+		data.ColorBar = (0xFF << 24) | (buf[6] << 16) | (buf[7] << 8) | buf[8];
+		fields |= FeedbackLightbar;
+	}
+	if (flags & DS4_OUT_FLAG_FLASH) {
+		data.FlashOn = buf[9];
+		data.FlashOff = buf[10];
+		fields |= FeedbackFlash;
+	}
+	return fields;
+}
+
+// The reader waits on the ViGEm bus
+#ifdef VGEN_DRIVERS
+static void Ds4_ReaderProc(PDEVICE pDev, DeviceFeedback * feedback)
+{
+	DS4_OUTPUT_BUFFER report;
+	while (!feedback->StopReader) {
+		const DWORD res = g_ds4ReportSource(pDev, &report, DS4_READER_TIMEOUT_MS);
+		if (res == STATUS_TIMEOUT)
+			continue;
+
+		if (res == STATUS_NOT_SUPPORTED) {
+			// Older bus: fall back to notifications, which have rumble and lightbar color but no flash timing.
+			VGE_RegisterDs4Notification(pDev);
+			return;
+		}
+
+		if (res != STATUS_SUCCESS) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(DS4_READER_RETRY_MS));
+			continue;
+		}
+
+		FeedbackData data;
+		const BYTE fields = Ds4_DecodeOutputReport(report, data);
+		if (fields & FeedbackLightbar && pDev->DevInfo.ColorBar != data.ColorBar)
+			InterlockedExchange((LONG *)&pDev->DevInfo.ColorBar, (LONG)data.ColorBar);
+		if (fields)
+			feedback->Publish(data, fields);
+	}
+}
+
+void Ds4_StartReader(PDEVICE pDev)
+{
+	DeviceFeedback * feedback = pDev->Feedback.get();
+	if (!feedback || feedback->Reader.joinable())
+		return;
+
+	feedback->StopReader = false;
+	feedback->Reader = std::thread(&Ds4_ReaderProc, pDev, feedback);
+}
+
+void Ds4_StopReader(DeviceFeedback & feedback)
+{
+	if (!feedback.Reader.joinable())
+		return;
+
+	feedback.StopReader = true;
+	if (feedback.Reader.get_id() != std::this_thread::get_id())
+		feedback.Reader.join();
+	else
+		feedback.Reader.detach();
+}
+#endif // VGEN_DRIVERS
+
+#pragma endregion DS4 Output Report Reader
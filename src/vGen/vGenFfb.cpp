@@ -0,0 +1,314 @@
+// vGenFfb.cpp : vJoy force feedback packets, decoded once and queued for the readers.
+//
+
+#include "stdafx.h"
+#include "Private.h"
+
+#include <algorithm>
+#include <chrono>
+
+#ifdef VGEN_FFB
+
+extern std::atomic_bool g_isShuttingDown;
+
+namespace {
+
+// Decoded packets. vJoy runs one FFB thread per acquired device, which push without locking;
+// FfbReadPackets() callers are serialized by m_readLock, the single consumer. The packets of one
+// device come out in Sequence order, those of devices publishing at the same time may interleave.
+class FfbPacketQueue
+{
+public:
+	void Publish(FFB_PACKET & packet)
+	{
+		packet.Sequence = m_sequence.fetch_add(1) + 1;
+		m_queue.Push(packet);  // when full the packet is dropped, readers see the gap in Sequence
+
+		// See DeviceFeedback::Publish()
+		if (m_waiters.load()) {
+			std::lock_guard<std::mutex> lock(m_waitLock);
+			m_waitCond.notify_all();
+		}
+	}
+
+	DWORD Read(FFB_PACKET * packets, UINT count, UINT * read, DWORD timeout)
+	{
+		std::lock_guard<std::mutex> readLock(m_readLock);
+
+		*read = (UINT)m_queue.Drain(packets, count);
+		if (*read)
+			return STATUS_SUCCESS;
+		if (!timeout)
+			return STATUS_TIMEOUT;
+
+		{
+			std::unique_lock<std::mutex> lock(m_waitLock);
+			++m_waiters;
+			const auto ready = [this]() { return !m_queue.Empty() || g_isShuttingDown; };
+			if (timeout == INFINITE)
+				m_waitCond.wait(lock, ready);
+			else
+				m_waitCond.wait_for(lock, std::chrono::milliseconds(timeout), ready);
+			--m_waiters;
+		}
+
+		if (g_isShuttingDown)
+			return STATUS_CANCELLED;
+
+		*read = (UINT)m_queue.Drain(packets, count);
+		return *read ? STATUS_SUCCESS : STATUS_TIMEOUT;
+	}
+
+	void WakeReaders()
+	{
+		std::lock_guard<std::mutex> lock(m_waitLock);
+		m_waitCond.notify_all();
+	}
+
+private:
+	MpscRing<FFB_PACKET, 256> m_queue;
+	std::atomic<DWORD> m_sequence {0};
+	std::mutex m_readLock;
+	std::mutex m_waitLock;
+	std::condition_variable m_waitCond;
+	std::atomic<int> m_waiters {0};
+};
+
+FfbPacketQueue g_ffbQueue;
+std::once_flag g_ffbStarted;
+
+// Subscribers, as an immutable snapshot that is replaced whenever a subscription changes.
+// Subscribers of all devices are merged into every device's list, so the driver thread only
+// picks the list of the packet's device and tests the type mask.
+struct FfbSubscriber
+{
+	UINT Id;
+	DWORD TypeMask;
+	FfbPacketCB PacketCB;  // either this
+	FfbGenCB GenCB;        // or a raw packet callback (FfbRegisterGenCB)
+	PVOID Data;
+};
+
+struct FfbDispatch
+{
+	std::vector<FfbSubscriber> All;          // as registered, rID 0 for all devices
+	std::vector<UINT> DevIds;                // rID of each entry of All
+	std::vector<FfbSubscriber> Device[17];   // by rID. [0]: packets that could not be decoded (raw callbacks only)
+};
+
+// A replaced snapshot lives on while IJ_FfbGenCB() calls that loaded it run its subscribers; its deleter wakes
+// the IJ_FfbUnsubscribe() calls waiting for those to be over.
+std::mutex g_ffbRetireLock;
+std::condition_variable g_ffbRetireCond;
+
+void FfbDeleteDispatch(const FfbDispatch * dispatch)
+{
+	delete dispatch;
+	std::lock_guard<std::mutex> lock(g_ffbRetireLock);
+	g_ffbRetireCond.notify_all();
+}
+
+std::mutex g_ffbSubscribeLock;
+std::shared_ptr<const FfbDispatch> g_ffbDispatch(new FfbDispatch, &FfbDeleteDispatch);
+std::vector<std::weak_ptr<const FfbDispatch>> g_ffbRetired;  // replaced snapshots, possibly still in use; under g_ffbSubscribeLock
+UINT g_ffbNextSubscription = 1;
+std::mutex g_ffbGenCBLock;
+UINT g_ffbGenCBSubscription = 0;  // FfbRegisterGenCB() subscription, under g_ffbGenCBLock
+thread_local bool t_ffbDispatching = false;  // This thread is in IJ_FfbGenCB(), calling the subscribers
+
+// Rebuilds the per-device lists after `next.All` changed and publishes the snapshot. Call under g_ffbSubscribeLock.
+void FfbPublishDispatch(std::unique_ptr<FfbDispatch> next)
+{
+	for (size_t i = 0; i < next->All.size(); ++i) {
+		const FfbSubscriber & sub = next->All[i];
+		const UINT rID = next->DevIds[i];
+		if (sub.GenCB && !rID)
+			next->Device[0].push_back(sub);
+		for (UINT id = 1; id <= 16; ++id) {
+			if (!rID || rID == id)
+				next->Device[id].push_back(sub);
+		}
+	}
+	g_ffbRetired.erase(std::remove_if(g_ffbRetired.begin(), g_ffbRetired.end(),
+		[](const std::weak_ptr<const FfbDispatch> & retired) { return retired.expired(); }), g_ffbRetired.end());
+	g_ffbRetired.push_back(std::atomic_load(&g_ffbDispatch));
+	std::atomic_store(&g_ffbDispatch, std::shared_ptr<const FfbDispatch>(next.release(), &FfbDeleteDispatch));
+}
+
+UINT FfbAddSubscriber(UINT rID, FfbSubscriber sub)
+{
+	std::lock_guard<std::mutex> lock(g_ffbSubscribeLock);
+	const std::shared_ptr<const FfbDispatch> current = std::atomic_load(&g_ffbDispatch);
+	std::unique_ptr<FfbDispatch> next(new FfbDispatch);
+	next->All = current->All;
+	next->DevIds = current->DevIds;
+	sub.Id = g_ffbNextSubscription++;
+	next->All.push_back(sub);
+	next->DevIds.push_back(rID);
+	FfbPublishDispatch(std::move(next));
+	return sub.Id;
+}
+
+// `retired`: the snapshots that may still hold the subscriber
+bool FfbRemoveSubscriber(UINT id, std::vector<std::weak_ptr<const FfbDispatch>> * retired = nullptr)
+{
+	std::lock_guard<std::mutex> lock(g_ffbSubscribeLock);
+	const std::shared_ptr<const FfbDispatch> current = std::atomic_load(&g_ffbDispatch);
+	std::unique_ptr<FfbDispatch> next(new FfbDispatch);
+	bool found = false;
+	for (size_t i = 0; i < current->All.size(); ++i) {
+		if (current->All[i].Id == id) {
+			found = true;
+			continue;
+		}
+		next->All.push_back(current->All[i]);
+		next->DevIds.push_back(current->DevIds[i]);
+	}
+	if (!found)
+		return false;
+
+	FfbPublishDispatch(std::move(next));
+	if (retired) {
+		for (const std::weak_ptr<const FfbDispatch> & snapshot : g_ffbRetired) {
+			const std::shared_ptr<const FfbDispatch> held = snapshot.lock();
+			if (held && std::any_of(held->All.begin(), held->All.end(), [id](const FfbSubscriber & sub) { return sub.Id == id; }))
+				retired->push_back(snapshot);
+		}
+	}
+	return true;
+}
+
+void CALLBACK IJ_FfbGenCB(PVOID data, PVOID)
+{
+	FFB_PACKET packet;
+	const BOOL decoded = IJ_FfbDecodePacket((const FFB_DATA *)data, packet);
+	if (decoded) {
+		IJ_FfbEngineApply(packet);
+		g_ffbQueue.Publish(packet);
+	}
+
+	t_ffbDispatching = true;
+	{
+		const std::shared_ptr<const FfbDispatch> dispatch = std::atomic_load(&g_ffbDispatch);
+		const std::vector<FfbSubscriber> & subscribers = dispatch->Device[decoded && Range_vJoy(packet.DeviceID) ? packet.DeviceID : 0];
+		const DWORD type = FFB_PT_MASK(packet.Type);
+		for (const FfbSubscriber & sub : subscribers) {
+			if (sub.GenCB)
+				sub.GenCB(data, sub.Data);
+			else if (sub.TypeMask & type)
+				sub.PacketCB(&packet, sub.Data);
+		}
+	}
+	t_ffbDispatching = false;
+}
+
+}  // namespace
+
+#pragma warning( push )
+#pragma warning( disable : 4996 )
+BOOL IJ_FfbDecodePacket(const FFB_DATA * pData, FFB_PACKET & packet)
+{
+	RtlZeroMemory(&packet, sizeof(packet));
+
+	int id = 0;
+	if (!pData || vJoyNS::Ffb_h_DeviceID(pData, &id) != ERROR_SUCCESS || vJoyNS::Ffb_h_Type(pData, &packet.Type) != ERROR_SUCCESS)
+		return FALSE;
+	packet.DeviceID = (UINT)id;
+
+	int ebi = 0;
+	if (vJoyNS::Ffb_h_EBI(pData, &ebi) == ERROR_SUCCESS)
+		packet.EffectBlockIndex = (BYTE)ebi;
+
+	DWORD res = ERROR_SUCCESS;
+	switch (packet.Type) {
+		case PT_EFFREP:
+			res = vJoyNS::Ffb_h_Eff_Report(pData, &packet.Report);
+			break;
+		case PT_ENVREP:
+			res = vJoyNS::Ffb_h_Eff_Envlp(pData, &packet.Envelope);
+			break;
+		case PT_CONDREP:
+			res = vJoyNS::Ffb_h_Eff_Cond(pData, &packet.Condition);
+			break;
+		case PT_PRIDREP:
+			res = vJoyNS::Ffb_h_Eff_Period(pData, &packet.Period);
+			break;
+		case PT_CONSTREP:
+			res = vJoyNS::Ffb_h_Eff_Constant(pData, &packet.Constant);
+			break;
+		case PT_RAMPREP:
+			res = vJoyNS::Ffb_h_Eff_Ramp(pData, &packet.Ramp);
+			break;
+		case PT_EFOPREP:
+			res = vJoyNS::Ffb_h_EffOp(pData, &packet.Operation);
+			break;
+		case PT_CTRLREP:
+			res = vJoyNS::Ffb_h_DevCtrl(pData, &packet.Control);
+			break;
+		case PT_GAINREP:
+			res = vJoyNS::Ffb_h_DevGain(pData, &packet.Gain);
+			break;
+		case PT_NEWEFREP:
+			res = vJoyNS::Ffb_h_EffNew(pData, &packet.NewEffect);
+			break;
+		default:  // Block free, custom force and pool reports carry nothing beyond type and index
+			break;
+	}
+	return res == ERROR_SUCCESS;
+}
+#pragma warning( pop )
+
+void IJ_FfbStart(void)
+{
+	std::call_once(g_ffbStarted, []() { vJoyNS::FfbRegisterGenCB(&IJ_FfbGenCB, nullptr); });
+}
+
+void IJ_FfbRegisterGenCB(FfbGenCB cb, PVOID data)
+{
+	// Replaces the previous raw callback, like vJoy did
+	std::lock_guard<std::mutex> lock(g_ffbGenCBLock);
+	if (g_ffbGenCBSubscription)
+		FfbRemoveSubscriber(g_ffbGenCBSubscription);
+	g_ffbGenCBSubscription = 0;
+	if (cb)
+		g_ffbGenCBSubscription = FfbAddSubscriber(0, { 0, FFB_PT_ALL, nullptr, cb, data });
+	IJ_FfbStart();
+}
+
+DWORD IJ_FfbSubscribe(UINT rID, DWORD TypeMask, FfbPacketCB cb, PVOID data, UINT * Subscription)
+{
+	*Subscription = FfbAddSubscriber(rID, { 0, TypeMask ? TypeMask : FFB_PT_ALL, cb, nullptr, data });
+	IJ_FfbStart();
+	return STATUS_SUCCESS;
+}
+
+DWORD IJ_FfbUnsubscribe(UINT Subscription)
+{
+	std::vector<std::weak_ptr<const FfbDispatch>> retired;
+	if (!FfbRemoveSubscriber(Subscription, &retired))
+		return STATUS_INVALID_PARAMETER_1;
+
+	// Dispatches that loaded a snapshot from before may still call the subscriber: wait until they let go of those.
+	// Later ones use the new snapshot and don't hold this up. A callback unsubscribing can't wait for itself.
+	if (!t_ffbDispatching) {
+		std::unique_lock<std::mutex> lock(g_ffbRetireLock);
+		g_ffbRetireCond.wait(lock, [&retired]() {
+			return std::all_of(retired.begin(), retired.end(),
+				[](const std::weak_ptr<const FfbDispatch> & snapshot) { return snapshot.expired(); });
+		});
+	}
+	return STATUS_SUCCESS;
+}
+
+DWORD IJ_FfbReadPackets(FFB_PACKET * packets, UINT count, UINT * read, DWORD timeout)
+{
+	IJ_FfbStart();
+	return g_ffbQueue.Read(packets, count, read, timeout);
+}
+
+void IJ_FfbWakeReaders(void)
+{
+	g_ffbQueue.WakeReaders();
+}
+
+#endif // VGEN_FFB
@@ -0,0 +1,663 @@
+// vGenFfbEngine.cpp : vJoy FFB effect block table and evaluation of the resulting per-axis force.
+//
+// Forces are in the range -10000 to 10000 per axis and point in the direction of the effect
+// (0 = North/Up, 90 deg = East/Right; Y is positive below the center).
+//
+
+#include "stdafx.h"
+#include "Private.h"
+
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+
+#ifdef VGEN_FFB
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+#define FFB_MAX_EFFECTS      100     // Effect block indices are 1-based
+#define FFB_FORCE_MAX        10000
+#define FFB_DURATION_INF     0xFFFF
+#define FFB_LOOP_INF         0xFF
+#define FFB_DEFAULT_TICK_MS  5
+#define FFB_MAX_TICK_MS      100
+// Velocity and acceleration of an axis are scaled so that moving half the axis travel in 100ms is full scale.
+#define FFB_METRIC_MS        100.0
+// Rumble bridge: a force change of full scale within this time drives the small motor at full speed.
+#define FFB_RUMBLE_CHANGE_MS 10.0
+// Rumble bridge: motor levels follow rises at once and then decay with this time constant,
+// so periodic forces give a steady rumble instead of beating at the effect frequency.
+#define FFB_RUMBLE_DECAY_MS  50.0
+
+enum { AxisX = 0, AxisY, NumAxes };
+
+struct Effect
+{
+	bool Used = false;
+	bool Playing = false;
+	bool HasEnvelope = false;
+	bool HasCondition[NumAxes] = { false, false };
+	UINT LoopsLeft = 0;         // including the current one, FFB_LOOP_INF repeats forever
+	Clock::time_point Start;    // start of the current loop
+	FFB_EFF_REPORT Report = {};
+	FFB_EFF_ENVLP Envelope = {};
+	FFB_EFF_COND Condition[NumAxes] = {};
+	FFB_EFF_PERIOD Period = {};
+	FFB_EFF_CONSTANT Constant = {};
+	FFB_EFF_RAMP Ramp = {};
+};
+
+struct FfbDevice
+{
+	Effect Effects[FFB_MAX_EFFECTS];
+	BYTE Gain = 0xFF;
+	bool Enabled = true;        // actuators
+	bool Paused = false;
+	Clock::time_point PausedAt;
+	// Axis history for the condition effects, normalized to -10000 to 10000
+	bool HasHistory = false;
+	Clock::time_point LastSample;
+	double Position[NumAxes] = {};
+	double Velocity[NumAxes] = {};
+	double Acceleration[NumAxes] = {};
+	LONG Force[NumAxes] = {};
+	// Rumble bridge
+	std::shared_ptr<DeviceFeedback> Rumble;
+	Clock::time_point LastRumble;
+	LONG RumbleForce[NumAxes] = {};
+	double RumbleLarge = 0;
+	double RumbleSmall = 0;
+
+	bool AnyPlaying() const
+	{
+		for (const Effect & e : Effects) {
+			if (e.Playing)
+				return true;
+		}
+		return false;
+	}
+};
+
+inline double Clamp(double v, double limit)
+{
+	return v > limit ? limit : (v < -limit ? -limit : v);
+}
+
+inline double Milliseconds(Clock::duration d)
+{
+	return std::chrono::duration<double, std::milli>(d).count();
+}
+
+inline bool IsInfinite(WORD duration)
+{
+	return duration == FFB_DURATION_INF || duration == 0;
+}
+
+// Position of a vJoy axis (1 - 0x8000) normalized to -10000 to 10000
+inline double NormalizeAxis(LONG value)
+{
+	return Clamp((value - 0x4000) * (double)FFB_FORCE_MAX / 0x4000, FFB_FORCE_MAX);
+}
+
+// Scales the magnitude of a playing effect at time t (ms into the current loop) by its envelope.
+double ApplyEnvelope(const Effect & e, double t, double magnitude)
+{
+	if (!e.HasEnvelope)
+		return magnitude;
+
+	const double sign = magnitude < 0 ? -1.0 : 1.0;
+	const double level = std::fabs(magnitude);
+	const FFB_EFF_ENVLP & env = e.Envelope;
+	const double duration = e.Report.Duration;
+	if (env.AttackTime && t < env.AttackTime)
+		return sign * (env.AttackLevel + (level - env.AttackLevel) * t / env.AttackTime);
+	if (!IsInfinite(e.Report.Duration) && env.FadeTime && t > duration - env.FadeTime)
+		return sign * (env.FadeLevel + (level - env.FadeLevel) * (duration - t) / env.FadeTime);
+	return magnitude;
+}
+
+// Periodic waveform of the given type, -1 to 1, at `cycle` (0 to 1) of its period.
+double Waveform(FFBEType type, double cycle)
+{
+	static const double Pi = 3.14159265358979323846;
+	switch (type) {
+		case ET_SQR:
+			return cycle < 0.5 ? 1.0 : -1.0;
+		case ET_SINE:
+			return std::sin(2.0 * Pi * cycle);
+		case ET_TRNGL:
+			return cycle < 0.25 ? 4.0 * cycle : (cycle < 0.75 ? 2.0 - 4.0 * cycle : 4.0 * cycle - 4.0);
+		case ET_STUP:
+			return 2.0 * cycle - 1.0;
+		case ET_STDN:
+			return 1.0 - 2.0 * cycle;
+		default:
+			return 0;
+	}
+}
+
+// Force of one condition effect axis for the given metric (position, velocity or acceleration).
+// The force pushes back towards the center point, limited by the saturation (0 means no limit).
+double ConditionForce(const FFB_EFF_COND & c, double metric, bool friction)
+{
+	const double low = (double)c.CenterPointOffset - c.DeadBand;
+	const double high = (double)c.CenterPointOffset + c.DeadBand;
+	double force = 0;
+	if (metric > high)
+		force = -(friction ? c.PosCoeff : c.PosCoeff * (metric - high) / FFB_FORCE_MAX);
+	else if (metric < low)
+		force = friction ? c.NegCoeff : -c.NegCoeff * (metric - low) / FFB_FORCE_MAX;
+
+	const DWORD saturation = force > 0 ? c.PosSatur : c.NegSatur;
+	return Clamp(force, saturation ? saturation : FFB_FORCE_MAX);
+}
+
+// Maps the force of a device onto the rumble motors of its linked ViGEm target:
+// the strength of the force drives the large (low frequency) motor and how fast
+// it changes drives the small (high frequency) motor.
+void PublishRumble(FfbDevice & dev, Clock::time_point now)
+{
+	if (dev.Rumble->Closed) {
+		dev.Rumble.reset();
+		return;
+	}
+
+	const double x = dev.Force[AxisX], y = dev.Force[AxisY];
+	const double dx = x - dev.RumbleForce[AxisX], dy = y - dev.RumbleForce[AxisY];
+	const double dt = Milliseconds(now - dev.LastRumble);
+	const double strength = std::sqrt(x * x + y * y);
+	const double change = dt > 0 ? std::sqrt(dx * dx + dy * dy) * FFB_RUMBLE_CHANGE_MS / dt : 0;
+
+	const double decay = std::exp(-dt / FFB_RUMBLE_DECAY_MS);
+	dev.RumbleLarge = (std::max)(Clamp(strength, FFB_FORCE_MAX), dev.RumbleLarge * decay);
+	dev.RumbleSmall = (std::max)(Clamp(change, FFB_FORCE_MAX), dev.RumbleSmall * decay);
+	// The decay alone never gets there: stop a motor once it is below one step
+	if (dev.RumbleLarge * 255 < FFB_FORCE_MAX)
+		dev.RumbleLarge = 0;
+	if (dev.RumbleSmall * 255 < FFB_FORCE_MAX)
+		dev.RumbleSmall = 0;
+
+	vGenNS::FeedbackData data;
+	data.LargeMotor = (BYTE)(dev.RumbleLarge * 255 / FFB_FORCE_MAX);
+	data.SmallMotor = (BYTE)(dev.RumbleSmall * 255 / FFB_FORCE_MAX);
+	dev.Rumble->Publish(data, vGenNS::FeedbackRumble | vGenNS::FeedbackBridged);  // unchanged motors are not queued again
+
+	dev.LastRumble = now;
+	dev.RumbleForce[AxisX] = dev.Force[AxisX];
+	dev.RumbleForce[AxisY] = dev.Force[AxisY];
+}
+
+class FfbEngine
+{
+public:
+	~FfbEngine()
+	{
+		// DeInit() normally stopped the thread. Joining it here, under the loader lock, could dead-lock.
+		if (m_thread.joinable())
+			m_thread.detach();
+	}
+
+	void Apply(const FFB_PACKET & packet);
+	bool GetForce(UINT id, LONG & x, LONG & y);
+	void SetTick(UINT period) { m_tickMs = period; }
+	void RegisterCB(FfbForceCB cb, PVOID data)
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		m_cb = cb;
+		m_cbData = data;
+	}
+	void SetRumbleTarget(UINT id, const std::shared_ptr<DeviceFeedback> & feedback)
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		FfbDevice * dev = Device(id);
+		if (!dev)
+			return;
+		if (dev->Rumble && dev->Rumble != feedback) {
+			// Let go of the old target with the motors stopped
+			vGenNS::FeedbackData data;
+			dev->Rumble->Publish(data, vGenNS::FeedbackRumble | vGenNS::FeedbackBridged);
+		}
+		if (dev->Rumble != feedback) {
+			dev->RumbleLarge = 0;
+			dev->RumbleSmall = 0;
+		}
+		dev->Rumble = feedback;
+		dev->LastRumble = Clock::now();
+	}
+	void Stop();
+
+private:
+	FfbDevice * Device(UINT id)
+	{
+		if (!Range_vJoy(id))
+			return nullptr;
+		if (!m_devices[id - 1])
+			m_devices[id - 1].reset(new FfbDevice);
+		return m_devices[id - 1].get();
+	}
+
+	void Play(FfbDevice & dev, Effect & e, UINT loops, Clock::time_point now);
+	// pos: the device's report, read before taking m_lock; nullptr if there is none
+	void Evaluate(FfbDevice & dev, const JOYSTICK_POSITION_V2 * pos, Clock::time_point now);
+	bool Active() const;
+	void Run();
+
+	std::mutex m_lock;
+	std::condition_variable m_cond;
+	std::thread m_thread;
+	bool m_stop = false;
+	bool m_dirty = false;  // a device changed and its force has to be evaluated even if nothing is playing
+	std::atomic<UINT> m_tickMs {FFB_DEFAULT_TICK_MS};
+	std::unique_ptr<FfbDevice> m_devices[16];
+	// Output: forces packed as X (low) and Y (high) so readers never see half an update
+	std::atomic<ULONGLONG> m_force[16] = {};
+	FfbForceCB m_cb = nullptr;
+	PVOID m_cbData = nullptr;
+};
+
+void FfbEngine::Play(FfbDevice & dev, Effect & e, UINT loops, Clock::time_point now)
+{
+	e.Playing = true;
+	e.LoopsLeft = loops ? loops : 1;
+	e.Start = dev.Paused ? dev.PausedAt : now;
+}
+
+void FfbEngine::Apply(const FFB_PACKET & packet)
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+	FfbDevice * dev = Device(packet.DeviceID);
+	if (!dev)
+		return;
+
+	const Clock::time_point now = Clock::now();
+	const BYTE ebi = packet.EffectBlockIndex;
+	Effect * e = (ebi >= 1 && ebi <= FFB_MAX_EFFECTS) ? &dev->Effects[ebi - 1] : nullptr;
+	switch (packet.Type) {
+		case PT_EFFREP:
+			if (!e)
+				return;
+			e->Used = true;
+			e->Report = packet.Report;
+			break;
+
+		case PT_ENVREP:
+			if (!e)
+				return;
+			e->HasEnvelope = true;
+			e->Envelope = packet.Envelope;
+			break;
+
+		case PT_CONDREP:
+			if (!e)
+				return;
+			e->HasCondition[packet.Condition.isY ? AxisY : AxisX] = true;
+			e->Condition[packet.Condition.isY ? AxisY : AxisX] = packet.Condition;
+			break;
+
+		case PT_PRIDREP:
+			if (!e)
+				return;
+			e->Period = packet.Period;
+			break;
+
+		case PT_CONSTREP:
+			if (!e)
+				return;
+			e->Constant = packet.Constant;
+			break;
+
+		case PT_RAMPREP:
+			if (!e)
+				return;
+			e->Ramp = packet.Ramp;
+			break;
+
+		case PT_EFOPREP:
+			if (!e || !e->Used)
+				return;
+			if (packet.Operation.EffectOp == EFF_STOP) {
+				e->Playing = false;
+				break;
+			}
+			if (packet.Operation.EffectOp == EFF_SOLO) {
+				for (Effect & other : dev->Effects)
+					other.Playing = false;
+			}
+			Play(*dev, *e, packet.Operation.LoopCount, now);
+			break;
+
+		case PT_BLKFRREP:
+			if (!e)
+				return;
+			*e = Effect();
+			break;
+
+		case PT_GAINREP:
+			dev->Gain = packet.Gain;
+			break;
+
+		case PT_CTRLREP:
+			switch (packet.Control) {
+				case CTRL_ENACT:
+					dev->Enabled = true;
+					break;
+				case CTRL_DISACT:
+					dev->Enabled = false;
+					break;
+				case CTRL_STOPALL:
+					for (Effect & other : dev->Effects)
+						other.Playing = false;
+					break;
+				case CTRL_DEVRST:
+					for (Effect & other : dev->Effects)
+						other = Effect();
+					dev->Enabled = true;
+					dev->Paused = false;
+					break;
+				case CTRL_DEVPAUSE:
+					if (!dev->Paused) {
+						dev->Paused = true;
+						dev->PausedAt = now;
+					}
+					break;
+				case CTRL_DEVCONT:
+					if (dev->Paused) {
+						// Continue every effect from where it was paused
+						const Clock::duration paused = now - dev->PausedAt;
+						for (Effect & other : dev->Effects)
+							other.Start += paused;
+						dev->Paused = false;
+					}
+					break;
+			}
+			break;
+
+		default:
+			return;
+	}
+
+	m_dirty = true;
+	if (!m_thread.joinable()) {
+		m_stop = false;
+		m_thread = std::thread(&FfbEngine::Run, this);
+	}
+	else
+		m_cond.notify_one();
+}
+
+bool FfbEngine::GetForce(UINT id, LONG & x, LONG & y)
+{
+	if (!Range_vJoy(id))
+		return false;
+	const ULONGLONG force = m_force[id - 1].load(std::memory_order_relaxed);
+	x = (LONG)(DWORD)force;
+	y = (LONG)(DWORD)(force >> 32);
+	return true;
+}
+
+void FfbEngine::Evaluate(FfbDevice & dev, const JOYSTICK_POSITION_V2 * pos, Clock::time_point now)
+{
+	double force[NumAxes] = {};
+
+	// Axis motion, for the condition effects
+	if (pos) {
+		const double position[NumAxes] = { NormalizeAxis(pos->wAxisX), NormalizeAxis(pos->wAxisY) };
+		const double dt = dev.HasHistory ? Milliseconds(now - dev.LastSample) : 0;
+		for (int axis = AxisX; axis < NumAxes; ++axis) {
+			const double velocity = dt > 0 ? Clamp((position[axis] - dev.Position[axis]) * FFB_METRIC_MS / dt, FFB_FORCE_MAX) : 0;
+			dev.Acceleration[axis] = dt > 0 ? Clamp((velocity - dev.Velocity[axis]) * FFB_METRIC_MS / dt, FFB_FORCE_MAX) : 0;
+			dev.Position[axis] = position[axis];
+			dev.Velocity[axis] = velocity;
+		}
+		dev.HasHistory = true;
+		dev.LastSample = now;
+	}
+
+	const Clock::time_point t0 = dev.Paused ? dev.PausedAt : now;
+	for (Effect & e : dev.Effects) {
+		if (!e.Playing)
+			continue;
+
+		// Play time of the current loop
+		double t = Milliseconds(t0 - e.Start);
+		if (t < 0)
+			t = 0;
+		if (!IsInfinite(e.Report.Duration)) {
+			while (t >= e.Report.Duration) {
+				if (e.LoopsLeft != FFB_LOOP_INF && --e.LoopsLeft == 0) {
+					e.Playing = false;
+					break;
+				}
+				e.Start += std::chrono::milliseconds(e.Report.Duration);
+				t -= e.Report.Duration;
+			}
+			if (!e.Playing)
+				continue;
+		}
+
+		const double gain = e.Report.Gain / 255.0;
+		double magnitude = 0;
+		switch (e.Report.EffectType) {
+			case ET_CONST:
+				magnitude = ApplyEnvelope(e, t, e.Constant.Magnitude);
+				break;
+
+			case ET_RAMP:
+				magnitude = IsInfinite(e.Report.Duration) ? e.Ramp.Start :
+					e.Ramp.Start + (e.Ramp.End - e.Ramp.Start) * t / e.Report.Duration;
+				magnitude = ApplyEnvelope(e, t, magnitude);
+				break;
+
+			case ET_SQR:
+			case ET_SINE:
+			case ET_TRNGL:
+			case ET_STUP:
+			case ET_STDN:
+			{
+				const double period = e.Period.Period ? e.Period.Period : 1;
+				const double cycle = std::fmod(e.Period.Phase / 36000.0 + t / period, 1.0);
+				magnitude = e.Period.Offset + ApplyEnvelope(e, t, e.Period.Magnitude) * Waveform(e.Report.EffectType, cycle);
+				break;
+			}
+
+			case ET_SPRNG:
+			case ET_DMPR:
+			case ET_INRT:
+			case ET_FRCTN:
+			{
+				// Condition effects act on each axis separately, regardless of direction
+				for (int axis = AxisX; axis < NumAxes; ++axis) {
+					if (!e.HasCondition[axis])
+						continue;
+					double metric = dev.Position[axis];
+					if (e.Report.EffectType == ET_DMPR || e.Report.EffectType == ET_FRCTN)
+						metric = dev.Velocity[axis];
+					else if (e.Report.EffectType == ET_INRT)
+						metric = dev.Acceleration[axis];
+					force[axis] += gain * ConditionForce(e.Condition[axis], metric, e.Report.EffectType == ET_FRCTN);
+				}
+				continue;
+			}
+
+			default:  // Custom force is not supported
+				continue;
+		}
+
+		// Project the magnitude onto the axes along the effect direction
+		double dx, dy;
+		if (e.Report.Polar) {
+			const double angle = e.Report.Direction * 2.0 * 3.14159265358979323846 / 256.0;
+			dx = std::sin(angle);
+			dy = -std::cos(angle);
+		}
+		else {
+			dx = (signed char)e.Report.DirX;
+			dy = (signed char)e.Report.DirY;
+			const double length = std::sqrt(dx * dx + dy * dy);
+			if (length > 0) {
+				dx /= length;
+				dy /= length;
+			}
+			else
+				dx = 1.0;  // No direction: single axis effect
+		}
+		force[AxisX] += gain * magnitude * dx;
+		force[AxisY] += gain * magnitude * dy;
+	}
+
+	const double devGain = (dev.Enabled && !dev.Paused) ? dev.Gain / 255.0 : 0;
+	for (int axis = AxisX; axis < NumAxes; ++axis)
+		dev.Force[axis] = (LONG)Clamp(force[axis] * devGain, FFB_FORCE_MAX);
+}
+
+bool FfbEngine::Active() const
+{
+	if (m_dirty)
+		return true;
+	for (const auto & dev : m_devices) {
+		if (dev && !dev->Paused && dev->AnyPlaying())
+			return true;
+		// Keep ticking until the bridged motors have run down
+		if (dev && dev->Rumble && (dev->RumbleLarge > 0 || dev->RumbleSmall > 0))
+			return true;
+	}
+	return false;
+}
+
+void FfbEngine::Run()
+{
+	struct Change { UINT Id; LONG X, Y; };
+
+	std::unique_lock<std::mutex> lock(m_lock);
+	Clock::time_point next = Clock::now();
+	while (!m_stop) {
+		if (!Active()) {
+			m_cond.wait(lock, [this]() { return m_stop || Active(); });
+			next = Clock::now();
+			continue;
+		}
+
+		// The positions first, from the DLL's own copy of each report rather than the driver's read-back. That copy is
+		// under g_reportLock, which is never taken with m_lock held.
+		bool present[16];
+		for (UINT i = 0; i < 16; ++i)
+			present[i] = m_devices[i] != nullptr;
+		JOYSTICK_POSITION_V2 positions[16];
+		bool read[16] = {};
+		lock.unlock();
+		{
+			std::lock_guard<std::mutex> reportLock(g_reportLock);
+			for (UINT i = 0; i < 16; ++i) {
+				const PDEVICE pDev = present[i] ? GetDevice(vGenNS::DevType::vJoy, i + 1) : nullptr;
+				if (pDev && !pDev->Busy) {
+					positions[i] = *pDev->PPosition.vJoyPos;
+					read[i] = true;
+				}
+			}
+		}
+		lock.lock();
+		if (m_stop)
+			break;
+
+		const Clock::time_point now = Clock::now();
+		m_dirty = false;
+		Change changes[16];
+		UINT nChanges = 0;
+		for (UINT i = 0; i < 16; ++i) {
+			FfbDevice * dev = m_devices[i].get();
+			if (!dev)
+				continue;
+			Evaluate(*dev, read[i] ? &positions[i] : nullptr, now);
+			const ULONGLONG force = (DWORD)dev->Force[AxisX] | ((ULONGLONG)(DWORD)dev->Force[AxisY] << 32);
+			if (m_force[i].exchange(force, std::memory_order_relaxed) != force)
+				changes[nChanges++] = { i + 1, dev->Force[AxisX], dev->Force[AxisY] };
+			if (dev->Rumble)
+				PublishRumble(*dev, now);
+		}
+
+		const FfbForceCB cb = m_cb;
+		const PVOID cbData = m_cbData;
+		if (cb && nChanges) {
+			lock.unlock();
+			for (UINT i = 0; i < nChanges; ++i)
+				cb(changes[i].Id, changes[i].X, changes[i].Y, cbData);
+			lock.lock();
+		}
+
+		next += std::chrono::milliseconds(m_tickMs.load());
+		if (next < Clock::now())
+			next = Clock::now();
+		m_cond.wait_until(lock, next, [this]() { return m_stop; });
+	}
+}
+
+void FfbEngine::Stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		m_stop = true;
+		m_cond.notify_all();
+	}
+	if (m_thread.joinable())
+		m_thread.join();
+
+	// Start over with an empty effect table
+	std::lock_guard<std::mutex> lock(m_lock);
+	for (UINT i = 0; i < 16; ++i) {
+		m_devices[i].reset();
+		m_force[i] = 0;
+	}
+	m_dirty = false;
+}
+
+FfbEngine g_ffbEngine;
+
+}  // namespace
+
+void IJ_FfbEngineApply(const FFB_PACKET & packet)
+{
+	g_ffbEngine.Apply(packet);
+}
+
+DWORD IJ_FfbGetForce(UINT rID, LONG * ForceX, LONG * ForceY)
+{
+	LONG x, y;
+	if (!g_ffbEngine.GetForce(rID, x, y))
+		return STATUS_INVALID_PARAMETER_1;
+
+	IJ_FfbStart();
+	if (ForceX)
+		*ForceX = x;
+	if (ForceY)
+		*ForceY = y;
+	return STATUS_SUCCESS;
+}
+
+void IJ_FfbRegisterForceCB(FfbForceCB cb, PVOID data)
+{
+	g_ffbEngine.RegisterCB(cb, data);
+	IJ_FfbStart();
+}
+
+DWORD IJ_FfbSetForceTick(UINT Period)
+{
+	if (!Period || Period > FFB_MAX_TICK_MS)
+		return STATUS_INVALID_PARAMETER_1;
+	g_ffbEngine.SetTick(Period);
+	return STATUS_SUCCESS;
+}
+
+void IJ_FfbStopEngine(void)
+{
+	g_ffbEngine.Stop();
+}
+
+void IJ_FfbSetRumbleTarget(UINT rID, const std::shared_ptr<DeviceFeedback> & feedback)
+{
+	g_ffbEngine.SetRumbleTarget(rID, feedback);
+	IJ_FfbStart();
+}
+
+#endif // VGEN_FFB
@@ -1,18 +1,20 @@
 // vGenInterface.cpp : Defines the exported functions for the DLL application.
 //
 
-#include "private.h"
+#include "stdafx.h"
+#include "Private.h"
 
 using namespace vGenNS;
 
 extern DevContainer_t DevContainer;
 extern const DevContainer_t &DevContainer_cref;
-extern PVIGEM_CLIENT VGE_Client;
 extern std::atomic_bool g_isShuttingDown;
 
 
 extern "C" {
 
+// The vJoy and vXbox APIs talk to their drivers directly
+#ifdef VGEN_DRIVERS
 #pragma region Interface Functions (vJoy)
 VGENINTERFACE_API SHORT GetvJoyVersion(void)
 {
@@ -367,7 +369,7 @@ VGENINTERFACE_API BOOL ResetPovs(UINT rID)		// Reset all POV Switches (To -1) in
 #pragma warning( push )
 #pragma warning( disable : 4996 )
 VGENINTERFACE_API FFBEType FfbGetEffect() { return  vJoyNS::FfbGetEffect(); }
-VGENINTERFACE_API VOID FfbRegisterGenCB(FfbGenCB cb, PVOID data) { return  vJoyNS::FfbRegisterGenCB( cb,  data); }
+VGENINTERFACE_API VOID FfbRegisterGenCB(FfbGenCB cb, PVOID data) { return  IJ_FfbRegisterGenCB( cb,  data); }
 //VGENINTERFACE_API BOOL 	FfbStart(UINT rID) { return  TRUE; }
 //VGENINTERFACE_API VOID 	FfbStop(UINT rID) { return; }
 VGENINTERFACE_API BOOL 	IsDeviceFfb(UINT rID) { return  vJoyNS::IsDeviceFfb(rID); }
@@ -387,6 +389,55 @@ VGENINTERFACE_API DWORD Ffb_h_DevGain(const FFB_DATA * Packet, BYTE * Gain) { re
 VGENINTERFACE_API DWORD Ffb_h_Eff_Envlp(const FFB_DATA * Packet, FFB_EFF_ENVLP*  Envelope) { return  vJoyNS::Ffb_h_Eff_Envlp(Packet, Envelope); }
 VGENINTERFACE_API DWORD Ffb_h_EffNew(const FFB_DATA * Packet, FFBEType * Effect) { return  vJoyNS::Ffb_h_EffNew(Packet, Effect); }
 VGENINTERFACE_API DWORD Ffb_h_Eff_Constant(const FFB_DATA * Packet, FFB_EFF_CONSTANT *  ConstantEffect) { return  vJoyNS::Ffb_h_Eff_Constant(Packet, ConstantEffect); }
+
+VGENINTERFACE_API DWORD FfbReadPackets(FFB_PACKET * Packets, UINT Count, UINT * Read, DWORD Timeout)
+{
+	if (!Packets || !Count)
+		return STATUS_INVALID_PARAMETER_1;
+	if (!Read)
+		return STATUS_INVALID_PARAMETER_3;
+	*Read = 0;
+
+	return IJ_FfbReadPackets(Packets, Count, Read, Timeout);
+}
+
+VGENINTERFACE_API DWORD FfbSubscribe(UINT rID, DWORD TypeMask, FfbPacketCB cb, PVOID data, UINT * Subscription)
+{
+	if (rID && !Range_vJoy(rID))
+		return STATUS_INVALID_PARAMETER_1;
+	if (!cb)
+		return STATUS_INVALID_PARAMETER_3;
+	if (!Subscription)
+		return STATUS_INVALID_PARAMETER_5;
+
+	return IJ_FfbSubscribe(rID, TypeMask, cb, data, Subscription);
+}
+
+VGENINTERFACE_API DWORD FfbUnsubscribe(UINT Subscription) { return IJ_FfbUnsubscribe(Subscription); }
+
+VGENINTERFACE_API DWORD FfbGetForce(UINT rID, LONG * ForceX, LONG * ForceY) { return IJ_FfbGetForce(rID, ForceX, ForceY); }
+VGENINTERFACE_API VOID FfbRegisterForceCB(FfbForceCB cb, PVOID data) { return IJ_FfbRegisterForceCB(cb, data); }
+VGENINTERFACE_API DWORD FfbSetForceTick(UINT Period) { return IJ_FfbSetForceTick(Period); }
+
+VGENINTERFACE_API DWORD FfbSetRumbleTarget(UINT rID, HDEVICE hDev)
+{
+	if (!Range_vJoy(rID))
+		return STATUS_INVALID_PARAMETER_1;
+
+	if (hDev == INVALID_DEV) {
+		IJ_FfbSetRumbleTarget(rID, nullptr);
+		return STATUS_SUCCESS;
+	}
+
+	PDEVICE pDev = GetDevice(hDev);
+	if (!pDev)
+		return STATUS_INVALID_HANDLE;
+	if (!pDev->Feedback)
+		return STATUS_NOT_SUPPORTED;
+
+	IJ_FfbSetRumbleTarget(rID, pDev->Feedback);
+	return STATUS_SUCCESS;
+}
 #pragma warning( pop )
 #pragma endregion  FFB API
 
@@ -626,6 +677,7 @@ VGENINTERFACE_API DWORD GetVibration(UINT UserIndex, PXINPUT_VIBRATION pVib)
 }
 
 #pragma endregion Interface Functions (vXbox)
+#endif // VGEN_DRIVERS
 
 #pragma region Interface Functions (Common)
 
@@ -634,6 +686,13 @@ VGENINTERFACE_API void DeInit(void)
 	if (g_isShuttingDown)
 		return;
 	g_isShuttingDown = true;
+#ifdef VGEN_DRIVERS
+	IJ_FfbWakeReaders();
+#endif
+	Shm_CloseAll();
+	Timer_Stop();
+	Pass_Stop();
+	Macro_UnloadAll();
 
 	std::vector<HDEVICE> devs;
 	devs.reserve(DevContainer.size());
@@ -644,59 +703,95 @@ VGENINTERFACE_API void DeInit(void)
 			DestroyDevice(hDev);
 	}
 
-	if (VGE_Client) {
-		vigem_disconnect(VGE_Client);
-		vigem_free(VGE_Client);
-		VGE_Client = nullptr;
-	}
+#ifdef VGEN_DRIVERS
+	IJ_FfbStopEngine();
+#endif
+	Trace_Stop();
+	Backend_Shutdown();
 
 	g_isShuttingDown = false;
 }
 
-VGENINTERFACE_API DWORD AcquireDev(UINT DevId, DevType dType, HDEVICE * hDev)
+static DWORD AcquireDevImpl(UINT DevId, DevType dType, HDEVICE * hDev)
 {
 	*hDev = INVALID_DEV;
-	if (dType == DevType::vJoy)
+	if (dType != DevType::vJoy && dType != DevType::vXbox && dType != DevType::vgeXbox && dType != DevType::vgeDS4)
+		return STATUS_INVALID_PARAMETER_2;
+
+	// A device whose unplugging failed is still in the container, plugging it in again reuses it
+	HDEVICE h = GetDeviceHandle(dType, DevId);
+	const bool created = !h;
+	if (created)
+		h = CreateDevice(dType, DevId);
+
+	PDEVICE pDev;
 	{
-		*hDev = IJ_AcquireVJD(DevId);
-		return BOOL_TO_STATUS(*hDev != INVALID_DEV);
-	};
+		std::lock_guard<std::mutex> lock(g_reportLock);
+		pDev = GetDevice(h);
+		if (!pDev)
+			return STATUS_IO_DEVICE_ERROR;
+		if (pDev->Busy)
+			return STATUS_DEVICE_BUSY;
+		if (!pDev->Backend)
+			pDev->Backend = Backend_Get();
+		pDev->Busy = true;
+	}
 
-	DWORD res;
-	if (dType == DevType::vXbox)
-		res = IX_PlugIn(DevId);
-	else if (dType == DevType::vgeXbox || dType == DevType::vgeDS4)
-		res = VGE_PlugIn(dType, DevId);
-	else
-		res = STATUS_INVALID_PARAMETER_2;
+	// Without the lock: the bus may take seconds (XOutput waits for the pad to come up), the other devices go on
+	const DWORD res = pDev->Backend->Plug(*pDev);
 
-	if (res == STATUS_SUCCESS)
-		return GetDevHandle(DevId, dType, hDev);
-	return res;
+	std::lock_guard<std::mutex> lock(g_reportLock);
+	pDev->Busy = false;
+	if (res != STATUS_SUCCESS) {
+		if (created)
+			DestroyDevice_Locked(h);
+		return res;
+	}
 
-	return STATUS_INVALID_PARAMETER_2;
+	*hDev = h;
+	return STATUS_SUCCESS;
 }
 
-VGENINTERFACE_API DWORD RelinquishDev(HDEVICE hDev)
+VGENINTERFACE_API DWORD AcquireDev(UINT DevId, DevType dType, HDEVICE * hDev)
 {
-	PDEVICE pDev = GetDevice(hDev);
-	if (!pDev)
-		return STATUS_INVALID_HANDLE;
+	PerfApiScope perf(PerfAcquireDev, INVALID_DEV, DevId, (LONG)dType);
+	const DWORD res = AcquireDevImpl(DevId, dType, hDev);
+	perf.Device(*hDev);
+	return perf.Result(res);
+}
 
-	switch (pDev->Type) {
-		case DevType::vJoy:
-			return IJ_RelinquishVJD(hDev, pDev);
+static DWORD RelinquishDevImpl(HDEVICE hDev)
+{
+	PDEVICE pDev;
+	{
+		std::lock_guard<std::mutex> lock(g_reportLock);
+		pDev = GetDevice(hDev);
+		if (!pDev || !pDev->Backend)
+			return STATUS_INVALID_HANDLE;
+		if (pDev->Busy)
+			return STATUS_DEVICE_BUSY;
+
+		// Nothing writes to the device from here on
+		Timer_CancelDevice(hDev);
+		Mirror_UnlinkAll(hDev);
+		Route_RemoveDevice(hDev);
+		pDev->Busy = true;
+	}
 
-		case DevType::vXbox:
-			return IX_UnPlug(GetDeviceId(hDev));
+	// Without the lock, as in AcquireDevImpl()
+	const DWORD res = pDev->Backend->Unplug(*pDev);
 
-		case DevType::vgeXbox:
-		case DevType::vgeDS4:
-			return VGE_UnPlug(hDev, pDev, g_isShuttingDown);
+	std::lock_guard<std::mutex> lock(g_reportLock);
+	pDev->Busy = false;
+	if (res == STATUS_SUCCESS || g_isShuttingDown)
+		DestroyDevice_Locked(hDev);
+	return res;
+}
 
-		default:
-			return STATUS_INVALID_HANDLE;
-	}
+VGENINTERFACE_API DWORD RelinquishDev(HDEVICE hDev)
+{
+	PerfApiScope perf(PerfRelinquishDev, hDev);
+	return perf.Result(RelinquishDevImpl(hDev));
 }
 
 VGENINTERFACE_API VjdStat GetDevStatus(HDEVICE hDev)
@@ -705,75 +800,12 @@ VGENINTERFACE_API VjdStat GetDevStatus(HDEVICE hDev)
 	if (!pDev)
 		return VJD_STAT_MISS;
 
-	switch (pDev->Type) {
-		case DevType::vJoy:
-			return vJoyNS::GetVJDStatus(pDev->Id);
-
-		case DevType::vXbox: {
-			BOOL Exist, Owned;
-			if SUCCEEDED(IX_isControllerOwned(pDev->Id, &Owned)) {
-				if (Owned)
-					return VJD_STAT_OWN;
-			}
-
-			if SUCCEEDED(IX_isControllerPluggedIn(pDev->Id, &Exist)) {
-				if (Exist)
-					return VJD_STAT_BUSY;
-			}
-			return VJD_STAT_FREE;
-		}
-
-		case DevType::vgeXbox:
-		case DevType::vgeDS4: {
-			if (VGE_BusExists() != STATUS_SUCCESS)
-				return VJD_STAT_MISS;
-
-			if (pDev->VGE_Target && vigem_target_is_attached(pDev->VGE_Target))
-				return VJD_STAT_OWN;
-
-			return VJD_STAT_FREE;
-		}
-
-		default:
-			return VJD_STAT_MISS;
-	}
+	return (pDev->Backend ? pDev->Backend : Backend_Get())->SlotStatus(pDev->Type, pDev->Id);
 }
 
 VGENINTERFACE_API VjdStat GetDevTypeStatus(vGenNS::DevType dType, UINT DevId)
 {
-	switch (dType) {
-		case DevType::vJoy:
-			return vJoyNS::GetVJDStatus(DevId);
-
-		case DevType::vXbox: {
-			BOOL Exist, Owned;
-			if SUCCEEDED(IX_isControllerOwned(DevId, &Owned)) {
-				if (Owned)
-					return VJD_STAT_OWN;
-			}
-
-			if SUCCEEDED(IX_isControllerPluggedIn(DevId, &Exist)) {
-				if (Exist)
-					return VJD_STAT_BUSY;
-			}
-			return VJD_STAT_FREE;
-		}
-
-		case DevType::vgeXbox:
-		case DevType::vgeDS4: {
-			if (VGE_BusExists() != STATUS_SUCCESS)
-				return VJD_STAT_MISS;
-
-			PDEVICE pDev = GetDevice(dType, DevId);
-			if (pDev && pDev->VGE_Target && vigem_target_is_attached(pDev->VGE_Target))
-				return VJD_STAT_OWN;
-
-			return VJD_STAT_FREE;
-		}
-
-		default:
-			return VJD_STAT_MISS;
-	}
+	return Backend_For(dType, DevId)->SlotStatus(dType, DevId);
 }
 
 VGENINTERFACE_API DWORD GetDevType(HDEVICE hDev, DevType * dType)
@@ -815,7 +847,9 @@ VGENINTERFACE_API DWORD GetDevNumber(HDEVICE hDev, UINT * dNumber)
 		return STATUS_SUCCESS;
 	}
 
-	if (pDev->Type == DevType::vXbox)
+#ifdef VGEN_DRIVERS
+	// XOutput knows the LED, the other backends only have the one they set when plugging in
+	if (pDev->Type == DevType::vXbox && pDev->Backend == Backend_Driver())
 	{
 		BYTE Led = 0;
 		DWORD res = IX_GetLedNumber(pDev->Id, &Led);
@@ -823,8 +857,9 @@ VGENINTERFACE_API DWORD GetDevNumber(HDEVICE hDev, UINT * dNumber)
 			*dNumber = Led;
 		return res;
 	}
+#endif
 
-	if (pDev->Type == DevType::vgeXbox) {
+	if (pDev->Type == DevType::vXbox || pDev->Type == DevType::vgeXbox) {
 		*dNumber = pDev->DevInfo.LedNumber;
 		return STATUS_SUCCESS;
 	}
@@ -901,19 +936,16 @@ VGENINTERFACE_API DWORD isDevOwned(UINT DevId, DevType dType, BOOL * Owned)
 	if (!Owned)
 		return STATUS_INVALID_PARAMETER_3;
 
-	if (dType == DevType::vJoy) {
-		*Owned = (vJoyNS::GetVJDStatus(DevId) == VJD_STAT_OWN);
+	if (dType == DevType::vJoy || dType == DevType::vXbox) {
+		*Owned = (Backend_For(dType, DevId)->SlotStatus(dType, DevId) == VJD_STAT_OWN);
 		return STATUS_SUCCESS;
 	}
 
-	if (dType == DevType::vXbox)
-		return IX_isControllerOwned(DevId, Owned);
-
 	if (dType == DevType::vgeXbox || dType == DevType::vgeDS4) {
 		PDEVICE pDev = GetDevice(dType, DevId);
-		if (!pDev)
+		if (!pDev || !pDev->Backend)
 			return STATUS_INVALID_HANDLE;
-		*Owned = (pDev->VGE_Target && vigem_target_is_attached(pDev->VGE_Target));
+		*Owned = (pDev->Backend->SlotStatus(dType, DevId) == VJD_STAT_OWN);
 		return STATUS_SUCCESS;
 	}
 
@@ -922,14 +954,12 @@ VGENINTERFACE_API DWORD isDevOwned(UINT DevId, DevType dType, BOOL * Owned)
 
 VGENINTERFACE_API DWORD isDevExist(UINT DevId, DevType dType, BOOL * Exist)
 {
-	DWORD res;
-
 	if (!Exist)
 		return STATUS_INVALID_PARAMETER_3;
 
 	if (dType == DevType::vJoy)
 	{
-		VjdStat stat = vJoyNS::GetVJDStatus(DevId);
+		VjdStat stat = Backend_For(dType, DevId)->SlotStatus(dType, DevId);
 		*Exist = (stat == VJD_STAT_OWN || stat == VJD_STAT_BUSY || stat == VJD_STAT_FREE);
 		return STATUS_SUCCESS;
 	};
@@ -939,10 +969,12 @@ VGENINTERFACE_API DWORD isDevExist(UINT DevId, DevType dType, BOOL * Exist)
 		return STATUS_SUCCESS;
 	}
 
+	// A free vXbox slot exists as well, as with vJoy
 	if (dType == DevType::vXbox)
 	{
-		res = IX_isControllerPluggedIn(DevId, Exist);
-		return res;
+		VjdStat stat = Backend_For(dType, DevId)->SlotStatus(dType, DevId);
+		*Exist = (stat == VJD_STAT_OWN || stat == VJD_STAT_BUSY || stat == VJD_STAT_FREE);
+		return STATUS_SUCCESS;
 	}
 
 	// ViGEm doesn't have a way to check an arbitrary device unless we own it.
@@ -956,11 +988,7 @@ VGENINTERFACE_API DWORD isDevFree(UINT DevId, DevType dType, BOOL * Free)
 
 	if (dType == DevType::vJoy)
 	{
-		VjdStat stat = vJoyNS::GetVJDStatus(DevId);
-		if ((stat == VJD_STAT_FREE))
-			*Free = TRUE;
-		else
-			*Free = FALSE;
+		*Free = Backend_For(dType, DevId)->SlotStatus(dType, DevId) == VJD_STAT_FREE;
 		return STATUS_SUCCESS;
 	};
 
@@ -1014,7 +1042,7 @@ VGENINTERFACE_API DWORD isAxisExist(HDEVICE hDev, HID_USAGES Axis, BOOL * Exist)
 		return STATUS_DEVICE_REMOVED;
 
 	if (pDev->Type == DevType::vJoy)
-		*Exist = IJ_GetVJDAxisExist(hDev, Axis);
+		*Exist = pDev->Caps.HasAxis(Axis);
 	else
 		*Exist = (Axis >= HID_USAGE_LX && Axis <= HID_USAGE_RT) || Axis == HID_USAGE_POV;
 
@@ -1032,8 +1060,11 @@ VGENINTERFACE_API DWORD GetDevAxisRange(HDEVICE hDev, vGenNS::HID_USAGES Axis, L
 		return STATUS_INVALID_HANDLE;
 
 	if (pDev->Type == DevType::vJoy) {
-		if (!vJoyNS::GetVJDAxisMin(pDev->Id, Axis, Min) || !vJoyNS::GetVJDAxisMax(pDev->Id, Axis, Max))
+		// vJoy axes all have the same logical range
+		if (!pDev->Caps.HasAxis(Axis))
 			return STATUS_UNSUCCESSFUL;
+		*Min = 0;
+		*Max = 32767;
 	}
 	else {
 		*Min = 0;
@@ -1054,16 +1085,10 @@ VGENINTERFACE_API DWORD GetDevButtonN(HDEVICE hDev, USHORT * nBtn)			// Get numb
 
 	switch (pDev->Type) {
 		case DevType::vJoy:
-			*nBtn = vJoyNS::GetVJDButtonNumber(pDev->Id);
-			break;
-
 		case DevType::vXbox:
 		case DevType::vgeXbox:
-			*nBtn = XINPUT_NUM_BUTTONS;
-			break;
-
 		case DevType::vgeDS4:
-			*nBtn = DS4_NUM_BUTTONS;
+			*nBtn = pDev->Caps.Buttons;
 			break;
 
 		default:
@@ -1086,9 +1111,9 @@ VGENINTERFACE_API DWORD GetDevHatN(HDEVICE hDev, PovType povType, USHORT * nHat)
 	switch (pDev->Type) {
 		case DevType::vJoy:
 			if (povType & PovType::PovTypeDiscrete)
-				*nHat += vJoyNS::GetVJDDiscPovNumber(pDev->Id);
+				*nHat += pDev->Caps.DiscPovs;
 			if (povType & PovType::PovTypeContinuous)
-				*nHat += vJoyNS::GetVJDContPovNumber(pDev->Id);
+				*nHat += pDev->Caps.ContPovs;
 			break;
 		case DevType::vXbox:
 		case DevType::vgeXbox:
@@ -1105,27 +1130,22 @@ VGENINTERFACE_API DWORD GetDevHatN(HDEVICE hDev, PovType povType, USHORT * nHat)
 /*
 Get current position report
 */
-VGENINTERFACE_API DWORD	GetPosition(HDEVICE hDev, PVOID pData)
+static DWORD GetPositionImpl(HDEVICE hDev, PVOID pData)
 {
+	std::lock_guard<std::mutex> lock(g_reportLock);
 	PDEVICE pDev = GetDevice(hDev);
 	if (!pDev)
 		return ERROR_INVALID_HANDLE;
-
-	//if (pDev->Type == DevType::vJoy)
-	//	return vJoyNS::GetPosition(pDev->Id, pData);
-
-	PVOID position = GetDevicePos(pDev);
-	if (!position)
+	if (!pDev->Backend)
 		return ERROR_DEVICE_NOT_AVAILABLE;
 
-	if (pDev->Type == DevType::vJoy)
-		memcpy(pData, position, sizeof(JOYSTICK_POSITION_V2));
-	else if (pDev->Type == DevType::vgeDS4)
-		memcpy(pData, position, sizeof(DS4_REPORT));
-	else
-		memcpy(pData, position, sizeof(XINPUT_GAMEPAD));
-	return ERROR_SUCCESS;
+	return pDev->Backend->Read(*pDev, pData);
+}
 
+VGENINTERFACE_API DWORD	GetPosition(HDEVICE hDev, PVOID pData)
+{
+	PerfApiScope perf(PerfGetPosition, hDev);
+	return perf.Result(GetPositionImpl(hDev, pData));
 }
 
 VGENINTERFACE_API DWORD GetDevInfo(HDEVICE hDev, vGenNS::DeviceInfo * DevInfo)
@@ -1141,341 +1161,593 @@ VGENINTERFACE_API DWORD GetDevInfo(HDEVICE hDev, vGenNS::DeviceInfo * DevInfo)
 	return STATUS_SUCCESS;
 }
 
+VGENINTERFACE_API DWORD GetDevFeedback(HDEVICE hDev, vGenNS::FeedbackData * Data, UINT Count, UINT * Read, DWORD Timeout)
+{
+	if (!Data || !Count)
+		return STATUS_INVALID_PARAMETER_2;
+	if (!Read)
+		return STATUS_INVALID_PARAMETER_4;
+	*Read = 0;
+
+	PDEVICE pDev = GetDevice(hDev);
+	if (!pDev)
+		return STATUS_INVALID_HANDLE;
+
+	// Keep our own reference since the device may be destroyed while we wait.
+	const std::shared_ptr<DeviceFeedback> feedback = pDev->Feedback;
+	if (!feedback)
+		return STATUS_NOT_SUPPORTED;
+
+	return feedback->Read(Data, Count, Read, Timeout);
+}
+
 VGENINTERFACE_API BOOL IsDevTypeSupported(vGenNS::DevType dType)
 {
-	switch (dType) {
-		case DevType::vJoy:
-			return vJoyEnabled();
-		case DevType::vXbox:
-			return isVBusExist() == STATUS_SUCCESS;
-		case DevType::vgeXbox:
-		case DevType::vgeDS4:
-			return VGE_BusExists() == STATUS_SUCCESS;
-		default:
-			return 0;
-	}
+	return Backend_Get()->BusStatus(dType) == STATUS_SUCCESS;
 }
 
 VGENINTERFACE_API DWORD GetDriverVersion(vGenNS::DevType dType)
 {
-	switch (dType) {
-		case DevType::vJoy:
-			return (DWORD)GetvJoyVersion();
-		case DevType::vXbox:
-			return GetVBusVersion();
-		case DevType::vgeXbox:
-		case DevType::vgeDS4:
-			return VGE_Version();
-		default:
-			return 0;
-	}
+	return Backend_Get()->BusVersion(dType);
 }
 
 // Read current positions XInput device by LED number  (helper function)
 VGENINTERFACE_API DWORD GetXInputState(UINT ledN, PXINPUT_STATE pData)
 {
-	return XInputGetState(ledN, pData);
+	if (!pData || ledN >= PASS_SLOTS)
+		return ERROR_BAD_ARGUMENTS;
+	return Pass_GetState(ledN, *pData) == STATUS_SUCCESS ? ERROR_SUCCESS : ERROR_DEVICE_NOT_CONNECTED;
 }
 
 
+static DWORD SetDevButtonImpl(HDEVICE hDev, UINT Button, BOOL Press)
+{
+	std::lock_guard<std::mutex> lock(g_reportLock);
+	const PDEVICE pDev = GetDevice(hDev);
+	if (!pDev)
+		return STATUS_INVALID_HANDLE;
+	Timer_Cancel(hDev, TimerButtonRelease, Button);
+	Timer_Cancel(hDev, TimerButtonTurbo, Button);
+
+	return Backend_SubmitIf(*pDev, Control_SetButton(*pDev, Button, Press));
+}
+
 VGENINTERFACE_API DWORD SetDevButton(HDEVICE hDev, UINT Button, BOOL Press)
 {
+	PerfApiScope perf(PerfSetDevButton, hDev, Button, Press);
+	return perf.Result(SetDevButtonImpl(hDev, Button, Press));
+}
+
+static DWORD SetDevAxisImpl(HDEVICE hDev, HID_USAGES Axis, LONG Value)
+{
+	std::lock_guard<std::mutex> lock(g_reportLock);
 	const PDEVICE pDev = GetDevice(hDev);
 	if (!pDev)
 		return STATUS_INVALID_HANDLE;
+	Timer_Cancel(hDev, TimerAxisAnimate, Axis);
+	Spring_Grab(*pDev, Axis);
 
-	switch (pDev->Type) {
-		case DevType::vJoy:
-			return BOOL_TO_STATUS(vJoyNS::SetBtn(Press, pDev->Id, Button));
-		case DevType::vXbox:
-			return IX_SetBtn(pDev, Press, Button);
-		case DevType::vgeXbox:
-		case DevType::vgeDS4:
-			return VGE_SetBtn(pDev, Press, Button);
-		default:
-			return STATUS_INVALID_HANDLE;
-	}
+	return Backend_SubmitIf(*pDev, Control_SetAxis(*pDev, Axis, Value));
 }
 
 VGENINTERFACE_API DWORD SetDevAxis(HDEVICE hDev, HID_USAGES Axis, LONG Value)
 {
+	PerfApiScope perf(PerfSetDevAxis, hDev, Axis, Value);
+	return perf.Result(SetDevAxisImpl(hDev, Axis, Value));
+}
+
+static DWORD SetDevAxisPctImpl(HDEVICE hDev, HID_USAGES Axis, FLOAT Value)
+{
+	std::lock_guard<std::mutex> lock(g_reportLock);
 	const PDEVICE pDev = GetDevice(hDev);
 	if (!pDev)
 		return STATUS_INVALID_HANDLE;
+	Timer_Cancel(hDev, TimerAxisAnimate, Axis);
+	Spring_Grab(*pDev, Axis);
 
-	if (pDev->Type == DevType::vJoy)
-		return BOOL_TO_STATUS(vJoyNS::SetAxis(Value, pDev->Id, Axis));
-
-	if (Value > 32767)
-		Value = 32767;
-	else if (Value < 0)
-		Value = 0;
+	return Backend_SubmitIf(*pDev, Control_SetAxisPct(*pDev, Axis, Value));
+}
 
-	if (pDev->Type == DevType::vXbox || pDev->Type == DevType::vgeXbox)
-	{
-		// If Triggers (Z,RZ) then remap range:   0 - 32767  ==> 0 - 255
-		// If Axis is X,Y,RX,RY then remap range: 0 - 32767  ==> -32768 - 32767
-		SHORT vx_Value = static_cast<SHORT>( Axis == HID_USAGE_LT || Axis == HID_USAGE_RT ? ((Value - 1) / 128) & 0xFF : (Value - 16384) * 2 );
+VGENINTERFACE_API DWORD SetDevAxisPct(HDEVICE hDev, HID_USAGES Axis, FLOAT Value)
+{
+	PerfApiScope perf(PerfSetDevAxisPct, hDev, Axis, Trace_FloatBits(Value));
+	return perf.Result(SetDevAxisPctImpl(hDev, Axis, Value));
+}
 
-		if (pDev->Type == DevType::vXbox)
-			return IX_SetAxis(pDev, Axis, vx_Value);
-		else
-			return VGE_SetAxis(pDev, Axis, vx_Value);
-	}
+static DWORD SetDevDiscPovImpl(HDEVICE hDev, UCHAR nPov, vGenNS::DPOV_DIRECTION Value)
+{
+	std::lock_guard<std::mutex> lock(g_reportLock);
+	const PDEVICE pDev = GetDevice(hDev);
+	if (!pDev)
+		return STATUS_INVALID_HANDLE;
+	Timer_Cancel(hDev, TimerDiscPovCenter, nPov);
 
-	if (pDev->Type == DevType::vgeDS4) {
-		// Scale all axes to byte range: 0 - 32767  ==> 0 - 255
-		BYTE vx_Value = ((Value - 1) / 128) & 0xFF;
-		if (Axis == HID_USAGE_LY || Axis == HID_USAGE_RY)
-			vx_Value = (0xFF - vx_Value);  // reverse the value
-		return VGE_SetAxis(pDev, Axis, vx_Value);
-	}
+	return Backend_SubmitIf(*pDev, Control_SetDiscPov(*pDev, nPov, Value));
+}
 
-	return STATUS_INVALID_HANDLE;
+VGENINTERFACE_API DWORD SetDevDiscPov(HDEVICE hDev, UCHAR nPov, vGenNS::DPOV_DIRECTION Value)
+{
+	PerfApiScope perf(PerfSetDevDiscPov, hDev, nPov, Value);
+	return perf.Result(SetDevDiscPovImpl(hDev, nPov, Value));
 }
 
-VGENINTERFACE_API DWORD SetDevAxisPct(HDEVICE hDev, HID_USAGES Axis, FLOAT Value)
+static DWORD SetDevContPovImpl(HDEVICE hDev, UCHAR nPov, DWORD Value)
 {
+	std::lock_guard<std::mutex> lock(g_reportLock);
 	const PDEVICE pDev = GetDevice(hDev);
 	if (!pDev)
 		return STATUS_INVALID_HANDLE;
+	Timer_Cancel(hDev, TimerDiscPovCenter, nPov);
 
-	if (pDev->Type == DevType::vJoy)
-	{
-		// Convert Value from range 0-100 to range 0-32768
-		const LONG vj_Value = static_cast <LONG>(32768 * Value * .01f);
-		return BOOL_TO_STATUS(vJoyNS::SetAxis(vj_Value, pDev->Id, Axis));
-	}
+	return Backend_SubmitIf(*pDev, Control_SetContPov(*pDev, nPov, Value));
+}
 
-	if (pDev->Type == DevType::vXbox || pDev->Type == DevType::vgeXbox)
-	{
-		// Convert Value from range (0 - 100) to range (0 - 255) for Triggers
-		{
-			if (Axis == HID_USAGE_LT || Axis == HID_USAGE_RT) {
-				const BYTE bVal = (BYTE)(255 * Value * .01f);
-				if (pDev->Type == DevType::vXbox)
-					return IX_SetAxis(pDev, Axis, bVal);
-				else
-					return VGE_SetAxis(pDev, Axis, bVal);
-			}
-		}
+VGENINTERFACE_API DWORD SetDevContPov(HDEVICE hDev, UCHAR nPov, DWORD Value)
+{
+	PerfApiScope perf(PerfSetDevContPov, hDev, nPov, (LONG)Value);
+	return perf.Result(SetDevContPovImpl(hDev, nPov, Value));
+}
 
-		const BYTE bVal = (BYTE)(255 * Value * .01f);
-		const SHORT sVal = static_cast <SHORT>((65535.0f * Value * .01f) - 32768);
-		if (pDev->Type == DevType::vXbox)
-			return IX_SetAxis(pDev, Axis, sVal);
-		else
-			return VGE_SetAxis(pDev, Axis, sVal);
-	}
+static DWORD SetDevPovImpl(HDEVICE hDev, UCHAR nPov, DWORD Value)
+{
+	std::lock_guard<std::mutex> lock(g_reportLock);
+	const PDEVICE pDev = GetDevice(hDev);
+	if (!pDev)
+		return STATUS_INVALID_HANDLE;
+	Timer_Cancel(hDev, TimerDiscPovCenter, nPov);
 
-	if (pDev->Type == DevType::vgeDS4) {
-		// Scale all axes to byte range: 0 - 32767  ==> 0 - 255
-		BYTE bVal = (BYTE)(255 * Value * .01f);
-		if (Axis == HID_USAGE_LY || Axis == HID_USAGE_RY)
-			bVal = (0xFF - bVal);  // reverse the value
-		return VGE_SetAxis(pDev, Axis, bVal);
-	}
+	return Backend_SubmitIf(*pDev, Control_SetPov(*pDev, nPov, Value));
+}
 
-	return STATUS_INVALID_HANDLE;
+VGENINTERFACE_API DWORD SetDevPov(HDEVICE hDev, UCHAR nPov, DWORD Value)
+{
+	PerfApiScope perf(PerfSetDevPov, hDev, nPov, (LONG)Value);
+	return perf.Result(SetDevPovImpl(hDev, nPov, Value));
 }
 
-static BYTE DPOV_to_DPAD(vGenNS::DPOV_DIRECTION Value, bool ds4 = false)
+VGENINTERFACE_API DWORD SetDevPovDeg(HDEVICE hDev, UCHAR nPov, FLOAT Value)
 {
-	switch (Value)
-	{
-		case DPOV_North:
-			return ds4 ? DS4_BUTTON_DPAD_NORTH : XBTN_DPAD_UP;
-		case DPOV_East:
-			return ds4 ? DS4_BUTTON_DPAD_EAST : XBTN_DPAD_RIGHT;
-		case DPOV_South:
-			return ds4 ? DS4_BUTTON_DPAD_SOUTH : XBTN_DPAD_DOWN;
-		case DPOV_West:
-			return ds4 ? DS4_BUTTON_DPAD_WEST : XBTN_DPAD_LEFT;
-		case DPOV_NorthEast:
-			return ds4 ? DS4_BUTTON_DPAD_NORTHEAST : XBTN_DPAD_UP_RIGHT;
-		case DPOV_SouthEast:
-			return ds4 ? DS4_BUTTON_DPAD_SOUTHEAST : XBTN_DPAD_DOWN_RIGHT;
-		case DPOV_SouthWest:
-			return ds4 ? DS4_BUTTON_DPAD_SOUTHWEST : XBTN_DPAD_DOWN_LEFT;
-		case DPOV_NorthWest:
-			return ds4 ? DS4_BUTTON_DPAD_NORTHWEST : XBTN_DPAD_UP_LEFT;
-		case DPOV_Center:
-		default:
-			return ds4 ? DS4_BUTTON_DPAD_NONE : XBTN_NONE;
-	}
+	return SetDevPov(hDev, nPov, (Value >= 0.0f ? static_cast <DWORD>(Value * 100) : -1));
 }
 
-// Write Value to a given discrete POV defined in the specified device handle
-VGENINTERFACE_API DWORD SetDevDiscPov(HDEVICE hDev, UCHAR nPov, vGenNS::DPOV_DIRECTION Value)
+static DWORD ResetDevPositionsImpl(HDEVICE hDev)
 {
+	std::lock_guard<std::mutex> lock(g_reportLock);
 	const PDEVICE pDev = GetDevice(hDev);
 	if (!pDev)
 		return STATUS_INVALID_HANDLE;
 
-	if (pDev->Type == DevType::vJoy)
-		return BOOL_TO_STATUS(vJoyNS::SetDiscPov((int)Value, pDev->Id, nPov));
+	Timer_CancelDevice(hDev);
+	Spring_GrabAll(*pDev);
+	Timed_Clear(*pDev);
+	Report_Reset(*pDev);
+	return Backend_Submit(*pDev);
+}
 
-	if (nPov > 1)
-		return STATUS_INVALID_PARAMETER_2;
+VGENINTERFACE_API DWORD __cdecl ResetDevPositions(HDEVICE hDev)
+{
+	PerfApiScope perf(PerfResetDevPositions, hDev);
+	return perf.Result(ResetDevPositionsImpl(hDev));
+}
 
-	if (pDev->Type == DevType::vXbox)
-		return IX_SetDpad(pDev, DPOV_to_DPAD(Value));
+VGENINTERFACE_API DWORD PulseDevButton(HDEVICE hDev, UINT Button, UINT DurationMs)
+{
+	std::lock_guard<std::mutex> lock(g_reportLock);
+	const PDEVICE pDev = GetDevice(hDev);
+	if (!pDev)
+		return STATUS_INVALID_HANDLE;
 
-	if (pDev->Type == DevType::vgeXbox)
-		return VGE_SetDpad(pDev, DPOV_to_DPAD(Value));
+	Timer_Cancel(hDev, TimerButtonTurbo, Button);
+	const DWORD res = Backend_SubmitIf(*pDev, Control_SetButton(*pDev, Button, TRUE));
+	if (res != STATUS_SUCCESS)
+		return res;
+	return Timer_Schedule(hDev, TimerButtonRelease, Button, DurationMs);
+}
+
+VGENINTERFACE_API DWORD SetDevButtonTurbo(HDEVICE hDev, UINT Button, FLOAT Hz, UINT DutyPct)
+{
+	// Both phases at least a millisecond, the timer's tick
+	UINT periodUs = 0, onUs = 0;
+	if (Hz > 0) {
+		if (!(Hz >= 0.001f && Hz <= 500))
+			return STATUS_INVALID_PARAMETER_3;
+		if (!DutyPct || DutyPct > 99)
+			return STATUS_INVALID_PARAMETER_4;
+		periodUs = (UINT)(1e6 / Hz + 0.5);
+		onUs = (UINT)((ULONGLONG)periodUs * DutyPct / 100);
+		if (onUs < 1000 || periodUs - onUs < 1000)
+			return STATUS_INVALID_PARAMETER_4;
+	}
+	else if (Hz < 0 || Hz != Hz)
+		return STATUS_INVALID_PARAMETER_3;
 
-	if (pDev->Type == DevType::vgeDS4)
-		return VGE_SetDpad(pDev, DPOV_to_DPAD(Value, true));
+	std::lock_guard<std::mutex> lock(g_reportLock);
+	const PDEVICE pDev = GetDevice(hDev);
+	if (!pDev)
+		return STATUS_INVALID_HANDLE;
 
-	return STATUS_INVALID_HANDLE;
+	Timer_Cancel(hDev, TimerButtonRelease, Button);
+	const DWORD res = Backend_SubmitIf(*pDev, Control_SetButton(*pDev, Button, periodUs != 0));
+	if (res != STATUS_SUCCESS || !periodUs) {
+		Timer_Cancel(hDev, TimerButtonTurbo, Button);
+		return res;
+	}
+	return Timer_Turbo(hDev, Button, periodUs, onUs);
 }
 
-static BYTE CPOV_to_DPAD(DWORD Value, bool ds4 = false)
+VGENINTERFACE_API DWORD PulseDevDiscPov(HDEVICE hDev, UCHAR nPov, vGenNS::DPOV_DIRECTION Value, UINT DurationMs)
 {
-	if (Value == -1)
-		return ds4 ? DS4_BUTTON_DPAD_NONE : XBTN_NONE;
+	if (Value == DPOV_Center)
+		return STATUS_INVALID_PARAMETER_3;
 
-	const LONG lVal = static_cast<LONG>(Value);
-	if (lVal < 100 || lVal > 35900)
-		return ds4 ? DS4_BUTTON_DPAD_NORTH : XBTN_DPAD_UP;
+	std::lock_guard<std::mutex> lock(g_reportLock);
+	const PDEVICE pDev = GetDevice(hDev);
+	if (!pDev)
+		return STATUS_INVALID_HANDLE;
 
-	if (abs(lVal - 4500) < 100)
-		return ds4 ? DS4_BUTTON_DPAD_NORTHEAST : XBTN_DPAD_UP_RIGHT;
+	const DWORD res = Backend_SubmitIf(*pDev, Control_SetDiscPov(*pDev, nPov, Value));
+	if (res != STATUS_SUCCESS)
+		return res;
+	return Timer_Schedule(hDev, TimerDiscPovCenter, nPov, DurationMs);
+}
 
-	if (abs(lVal - 9000) < 100)
-		return ds4 ? DS4_BUTTON_DPAD_EAST : XBTN_DPAD_RIGHT;
+VGENINTERFACE_API DWORD AnimateDevAxis(HDEVICE hDev, vGenNS::HID_USAGES Axis, LONG Target, UINT DurationMs, vGenNS::AxisEasing Easing)
+{
+	if (Target < 0 || Target > 0x7FFF)
+		return STATUS_INVALID_PARAMETER_3;
+	if (Easing > EaseInOutCubic)
+		return STATUS_INVALID_PARAMETER_5;
 
-	if (abs(lVal - 13500) < 100)
-		return ds4 ? DS4_BUTTON_DPAD_SOUTHEAST : XBTN_DPAD_DOWN_RIGHT;
+	std::lock_guard<std::mutex> lock(g_reportLock);
+	const PDEVICE pDev = GetDevice(hDev);
+	if (!pDev)
+		return STATUS_INVALID_HANDLE;
 
-	if (abs(lVal - 18000) < 100)
-		return ds4 ? DS4_BUTTON_DPAD_SOUTH : XBTN_DPAD_DOWN;
+	LONG current;
+	const DWORD res = Control_GetAxis(*pDev, Axis, current);
+	if (res != STATUS_SUCCESS)
+		return res;
+	Spring_Grab(*pDev, Axis);
+	if (!DurationMs) {
+		Timer_Cancel(hDev, TimerAxisAnimate, Axis);
+		return Backend_SubmitIf(*pDev, Control_SetAxis(*pDev, Axis, Target));
+	}
+	return Timer_Animate(hDev, Axis, current, Target, DurationMs, Easing);
+}
 
-	if (abs(lVal - 22500) < 100)
-		return ds4 ? DS4_BUTTON_DPAD_SOUTHWEST : XBTN_DPAD_DOWN_LEFT;
+VGENINTERFACE_API DWORD StopDevAxisAnimation(HDEVICE hDev, vGenNS::HID_USAGES Axis)
+{
+	std::lock_guard<std::mutex> lock(g_reportLock);
+	if (!GetDevice(hDev))
+		return STATUS_INVALID_HANDLE;
 
-	if (abs(lVal - 27000) < 100)
-		return ds4 ? DS4_BUTTON_DPAD_WEST : XBTN_DPAD_LEFT;
+	Timer_Cancel(hDev, TimerAxisAnimate, Axis);
+	return STATUS_SUCCESS;
+}
 
-	if (abs(lVal - 31500) < 100)
-		return ds4 ? DS4_BUTTON_DPAD_NORTHWEST : XBTN_DPAD_UP_LEFT;
+VGENINTERFACE_API DWORD SetDevAxisSpring(HDEVICE hDev, vGenNS::HID_USAGES Axis, const vGenNS::AxisSpring * Spring)
+{
+	std::lock_guard<std::mutex> lock(g_reportLock);
+	const PDEVICE pDev = GetDevice(hDev);
+	if (!pDev)
+		return STATUS_INVALID_HANDLE;
 
-	return ds4 ? DS4_BUTTON_DPAD_NONE : XBTN_NONE;
+	return Spring_Set(*pDev, Axis, Spring);
 }
 
-// Write Value to a given continuous POV defined in the specified device handle
-VGENINTERFACE_API DWORD SetDevContPov(HDEVICE hDev, UCHAR nPov, DWORD Value)
+VGENINTERFACE_API DWORD ReleaseDevAxis(HDEVICE hDev, vGenNS::HID_USAGES Axis)
 {
+	std::lock_guard<std::mutex> lock(g_reportLock);
 	const PDEVICE pDev = GetDevice(hDev);
 	if (!pDev)
 		return STATUS_INVALID_HANDLE;
 
-	if (pDev->Type == DevType::vJoy)
-		return BOOL_TO_STATUS(vJoyNS::SetContPov(Value, pDev->Id, nPov));
+	Timer_Cancel(hDev, TimerAxisAnimate, Axis);
+	const DWORD res = Spring_Release(*pDev, Axis);
+	if (res != STATUS_SUCCESS)
+		return res;
+	return Timer_Schedule(hDev, TimerAxisSpring, 0, SPRING_STEP_MS);
+}
+
+VGENINTERFACE_API DWORD LoadMacro(const vGenNS::MacroInstr * Program, UINT Count, UINT * MacroId)
+{
+	if (!MacroId)
+		return STATUS_INVALID_PARAMETER_3;
+	return Macro_Load(Program, Count, *MacroId);
+}
+
+VGENINTERFACE_API DWORD UnloadMacro(UINT MacroId)
+{
+	return Macro_Unload(MacroId);
+}
 
-	if (nPov > 1)
+VGENINTERFACE_API DWORD RunMacro(HDEVICE hDev, UINT MacroId)
+{
+	MacroRun run = Macro_Start(MacroId);
+	if (!run.Program)
 		return STATUS_INVALID_PARAMETER_2;
 
-	if (pDev->Type == DevType::vXbox)
-		return IX_SetDpad(pDev, CPOV_to_DPAD(Value));
+	std::lock_guard<std::mutex> lock(g_reportLock);
+	const PDEVICE pDev = GetDevice(hDev);
+	if (!pDev)
+		return STATUS_INVALID_HANDLE;
 
-	if (pDev->Type == DevType::vgeXbox)
-		return VGE_SetDpad(pDev, CPOV_to_DPAD(Value));
+	Timer_Cancel(hDev, TimerMacro, MacroId);
+	bool changed = false;
+	std::vector<MacroAnimation> ramps;
+	const UINT waitMs = Macro_Exec(*pDev, hDev, run, changed, ramps);
+	Macro_StartRamps(ramps);
+	const DWORD res = changed ? Backend_Submit(*pDev) : STATUS_SUCCESS;
+	if (waitMs)
+		Timer_Macro(hDev, MacroId, std::move(run), waitMs);
+	return res;
+}
 
-	if (pDev->Type == DevType::vgeDS4)
-		return VGE_SetDpad(pDev, CPOV_to_DPAD(Value, true));
+VGENINTERFACE_API DWORD StopMacro(HDEVICE hDev, UINT MacroId)
+{
+	std::lock_guard<std::mutex> lock(g_reportLock);
+	if (!GetDevice(hDev))
+		return STATUS_INVALID_HANDLE;
 
-	return STATUS_INVALID_HANDLE;
+	Timer_Cancel(hDev, TimerMacro, MacroId);
+	return STATUS_SUCCESS;
 }
 
-static BYTE Degrees_to_DPAD(LONG Value, bool ds4 = false)
+VGENINTERFACE_API DWORD SetControlRoutes(const vGenNS::ControlRoute * Routes, UINT Count, UINT * BadRoute)
 {
-	switch (Value)
-	{
-		case 0:
-		case 360:
-			return ds4 ? DS4_BUTTON_DPAD_NORTH : XBTN_DPAD_UP;
-		case 45:
-			return ds4 ? DS4_BUTTON_DPAD_NORTHEAST : XBTN_DPAD_UP_RIGHT;
-		case 90:
-			return ds4 ? DS4_BUTTON_DPAD_EAST : XBTN_DPAD_RIGHT;
-		case 135:
-			return ds4 ? DS4_BUTTON_DPAD_SOUTHEAST : XBTN_DPAD_DOWN_RIGHT;
-		case 180:
-			return ds4 ? DS4_BUTTON_DPAD_SOUTH : XBTN_DPAD_DOWN;
-		case 225:
-			return ds4 ? DS4_BUTTON_DPAD_SOUTHWEST : XBTN_DPAD_DOWN_LEFT;
-		case 270:
-			return ds4 ? DS4_BUTTON_DPAD_NORTHWEST : XBTN_DPAD_UP_LEFT;
-		case 315:
-			return ds4 ? DS4_BUTTON_DPAD_WEST : XBTN_DPAD_LEFT;
-		default:
-			return ds4 ? DS4_BUTTON_DPAD_NONE : XBTN_NONE;
-	}
+	UINT bad;
+	std::lock_guard<std::mutex> lock(g_reportLock);
+	const DWORD res = Route_Set(Routes, Count, bad);
+	if (BadRoute)
+		*BadRoute = bad;
+	return res;
 }
 
-VGENINTERFACE_API DWORD SetDevPov(HDEVICE hDev, UCHAR nPov, DWORD Value)
+VGENINTERFACE_API DWORD LinkDevMirror(HDEVICE Source, HDEVICE Target)
 {
+	std::lock_guard<std::mutex> lock(g_reportLock);
+	return Mirror_Link(Source, Target);
+}
+
+VGENINTERFACE_API DWORD UnlinkDevMirror(HDEVICE Source, HDEVICE Target)
+{
+	std::lock_guard<std::mutex> lock(g_reportLock);
+	return Mirror_Unlink(Source, Target);
+}
+
+VGENINTERFACE_API DWORD SetDevPassthrough(HDEVICE hDev, const vGenNS::PassthroughConfig * Config)
+{
+	std::lock_guard<std::mutex> lock(g_reportLock);
 	const PDEVICE pDev = GetDevice(hDev);
 	if (!pDev)
 		return STATUS_INVALID_HANDLE;
+	return Pass_Set(*pDev, Config);
+}
 
-	if (pDev->Type == DevType::vJoy)
-	{
-		// Don't test for type - just try
-		if (vJoyNS::SetContPov(Value, pDev->Id, nPov))
-			return STATUS_SUCCESS;
+VGENINTERFACE_API DWORD SetPadPollConfig(const vGenNS::PadPollConfig * Config)
+{
+	if (!Config)
+		return STATUS_INVALID_PARAMETER_1;
+	return Pass_Configure(*Config);
+}
 
-		// Discrete: Convert Value from range 0-360 to discrete values (-1 means Reset)
-		switch (Value)
-		{
-			case 0:
-			case 36000:
-				return BOOL_TO_STATUS(vJoyNS::SetDiscPov(DPOV_North, pDev->Id, nPov));
-			case 9000:
-				return BOOL_TO_STATUS(vJoyNS::SetDiscPov(DPOV_East, pDev->Id, nPov));
-			case 18000:
-				return BOOL_TO_STATUS(vJoyNS::SetDiscPov(DPOV_South, pDev->Id, nPov));
-			case 27000:
-				return BOOL_TO_STATUS(vJoyNS::SetDiscPov(DPOV_West, pDev->Id, nPov));
-			default:
-				return BOOL_TO_STATUS(vJoyNS::SetDiscPov(DPOV_Center, pDev->Id, nPov));
+VGENINTERFACE_API DWORD GetPadPollStats(vGenNS::PadPollStats * Stats, BOOL Reset)
+{
+	if (!Stats)
+		return STATUS_INVALID_PARAMETER_1;
+	Pass_GetStats(*Stats, Reset != FALSE);
+	return STATUS_SUCCESS;
+}
+
+VGENINTERFACE_API DWORD GetSchedulerTime(ULONGLONG * TimeUs)
+{
+	if (!TimeUs)
+		return STATUS_INVALID_PARAMETER_1;
+	*TimeUs = Timer_NowUs();
+	return STATUS_SUCCESS;
+}
+
+// Under g_reportLock. Makes the write at once if it is due and no other is held, else holds it.
+static DWORD SetDevAt(DEVICE & dev, HDEVICE hDev, const TimedWrite & write)
+{
+	if (write.AtUs <= Timer_NowUs() && (!dev.Timed || dev.Timed->empty())) {
+		if (write.Button) {
+			Timer_Cancel(hDev, TimerButtonRelease, write.Control);
+			Timer_Cancel(hDev, TimerButtonTurbo, write.Control);
+			return Backend_SubmitIf(dev, Control_SetButton(dev, write.Control, write.Value));
 		}
+		Timer_Cancel(hDev, TimerAxisAnimate, write.Control);
+		Spring_Grab(dev, (HID_USAGES)write.Control);
+		return Backend_SubmitIf(dev, Control_SetAxis(dev, (HID_USAGES)write.Control, write.Value));
 	}
 
-	if (nPov != 1)
+	bool first;
+	const DWORD res = Timed_Add(dev, write, first);
+	if (res != STATUS_SUCCESS || !first)
+		return res;
+	return Timer_At(hDev, TimerTimedWrite, 0, write.AtUs);
+}
+
+VGENINTERFACE_API DWORD SetDevAxisAt(HDEVICE hDev, vGenNS::HID_USAGES Axis, LONG Value, ULONGLONG AtUs)
+{
+	std::lock_guard<std::mutex> lock(g_reportLock);
+	const PDEVICE pDev = GetDevice(hDev);
+	if (!pDev)
+		return STATUS_INVALID_HANDLE;
+
+	return SetDevAt(*pDev, hDev, { AtUs, (UINT)Axis, Value, false });
+}
+
+VGENINTERFACE_API DWORD SetDevButtonAt(HDEVICE hDev, UINT Button, BOOL Press, ULONGLONG AtUs)
+{
+	std::lock_guard<std::mutex> lock(g_reportLock);
+	const PDEVICE pDev = GetDevice(hDev);
+	if (!pDev)
+		return STATUS_INVALID_HANDLE;
+
+	return SetDevAt(*pDev, hDev, { AtUs, Button, Press, true });
+}
+
+VGENINTERFACE_API DWORD SetSchedulerConfig(const vGenNS::SchedulerConfig * Config)
+{
+	if (!Config || Config->Priority > SchedulerRealtime)
+		return STATUS_INVALID_PARAMETER_1;
+	return Timer_Configure(*Config);
+}
+
+VGENINTERFACE_API DWORD GetSchedulerStats(vGenNS::SchedulerStats * Stats, BOOL Reset)
+{
+	if (!Stats)
+		return STATUS_INVALID_PARAMETER_1;
+	Timer_GetStats(*Stats, Reset != FALSE);
+	return STATUS_SUCCESS;
+}
+
+VGENINTERFACE_API DWORD EnablePerfStats(BOOL Enable)
+{
+	return Perf_Enable(Enable);
+}
+
+VGENINTERFACE_API DWORD GetPerfStats(vGenNS::PerfStats * Stats)
+{
+	if (!Stats)
+		return STATUS_INVALID_PARAMETER_1;
+	return Perf_GetStats(Stats);
+}
+
+VGENINTERFACE_API DWORD StartTrace(const char * FileName)
+{
+	if (!FileName || !*FileName)
+		return STATUS_INVALID_PARAMETER_1;
+	return Trace_Start(FileName);
+}
+
+VGENINTERFACE_API DWORD StopTrace(void)
+{
+	return Trace_Stop();
+}
+
+VGENINTERFACE_API DWORD ReplayTrace(const char * FileName, FLOAT Speed, vGenNS::ReplayStats * Stats)
+{
+	if (!FileName || !*FileName)
+		return STATUS_INVALID_PARAMETER_1;
+	if (Speed < 0)
 		return STATUS_INVALID_PARAMETER_2;
 
-	if (pDev->Type == DevType::vXbox)
-		return IX_SetDpad(pDev, CPOV_to_DPAD(Value));
+	ReplayStats stats;
+	const DWORD res = Replay_Run(FileName, Speed, stats);
+	if (Stats)
+		*Stats = stats;
+	return res;
+}
 
-	if (pDev->Type == DevType::vgeXbox)
-		return VGE_SetDpad(pDev, CPOV_to_DPAD(Value));
+VGENINTERFACE_API DWORD SelectBackend(vGenNS::BackendType Backend)
+{
+	return Backend_Select(Backend);
+}
 
-	if (pDev->Type == DevType::vgeDS4)
-		return VGE_SetDpad(pDev, CPOV_to_DPAD(Value, true));
+VGENINTERFACE_API DWORD SetSimBusConfig(const vGenNS::SimBusConfig * Config)
+{
+	if (!Config)
+		return STATUS_INVALID_PARAMETER_1;
+	return Sim_SetConfig(*Config);
+}
 
-	return STATUS_INVALID_HANDLE;
+VGENINTERFACE_API DWORD GetSimBusStats(vGenNS::SimBusStats * Stats)
+{
+	if (!Stats)
+		return STATUS_INVALID_PARAMETER_1;
+	Sim_GetStats(*Stats);
+	return STATUS_SUCCESS;
 }
 
-VGENINTERFACE_API DWORD SetDevPovDeg(HDEVICE hDev, UCHAR nPov, FLOAT Value)
+VGENINTERFACE_API DWORD GetSimBusReport(vGenNS::DevType dType, UINT DevId, PVOID Report)
 {
-	return SetDevPov(hDev, nPov, (Value >= 0.0f ? static_cast <DWORD>(Value * 100) : -1));
+	if (!Report)
+		return STATUS_INVALID_PARAMETER_3;
+	return Sim_GetReport(dType, DevId, Report);
 }
 
-VGENINTERFACE_API DWORD __cdecl ResetDevPositions(HDEVICE hDev)
+VGENINTERFACE_API DWORD SendSimBusFeedback(vGenNS::DevType dType, UINT DevId, const vGenNS::FeedbackData * Data)
 {
-	switch (GetDeviceType(hDev)) {
-		case DevType::vJoy:
-			return IJ_ResetPositions(hDev);
-		case DevType::vXbox:
-			return IX_ResetController(hDev);
-		case DevType::vgeXbox:
-		case DevType::vgeDS4:
-			return VGE_ResetController(hDev);
-		default:
-			return STATUS_INVALID_HANDLE;
-	}
+	if (!Data)
+		return STATUS_INVALID_PARAMETER_3;
+	return Sim_SendFeedback(dType, DevId, *Data);
+}
+
+VGENINTERFACE_API DWORD SendSimBusDs4Report(UINT DevId, const BYTE * Report, UINT Size)
+{
+	if (!Report)
+		return STATUS_INVALID_PARAMETER_2;
+	DS4_OUTPUT_BUFFER buffer = {};
+	if (!Size || Size > sizeof(buffer.Buffer))
+		return STATUS_INVALID_PARAMETER_3;
+	memcpy(buffer.Buffer, Report, Size);
+	return Sim_SendDs4Report(DevId, buffer);
+}
+
+VGENINTERFACE_API DWORD SetSimBusPad(UINT Slot, const XINPUT_STATE * State)
+{
+	return Sim_SetPad(Slot, State);
+}
+
+VGENINTERFACE_API DWORD GetUinputStats(vGenNS::BackendType Backend, vGenNS::UinputStats * Stats)
+{
+	if (!Stats)
+		return STATUS_INVALID_PARAMETER_2;
+	return Uinput_GetStats(Backend, *Stats);
+}
+
+VGENINTERFACE_API DWORD GetUinputEvents(vGenNS::DevType dType, UINT DevId, vGenNS::UinputEvent * Events, UINT Count, UINT * Read)
+{
+	if (!Events && Count)
+		return STATUS_INVALID_PARAMETER_3;
+	if (!Read)
+		return STATUS_INVALID_PARAMETER_5;
+	return Uinput_GetEvents(dType, DevId, Events, Count, *Read);
+}
+
+VGENINTERFACE_API DWORD RunDaemon(const char * Address)
+{
+	if (!Address)
+		return STATUS_INVALID_PARAMETER_1;
+	return Daemon_Run(Address);
+}
+
+VGENINTERFACE_API DWORD StopDaemon(void)
+{
+	return Daemon_Stop();
+}
+
+VGENINTERFACE_API DWORD GetDaemonStats(vGenNS::DaemonStats * Stats)
+{
+	if (!Stats)
+		return STATUS_INVALID_PARAMETER_1;
+	Daemon_GetStats(*Stats);
+	return STATUS_SUCCESS;
+}
+
+VGENINTERFACE_API DWORD OpenShmChannel(const char * Name)
+{
+	if (!Name)
+		return STATUS_INVALID_PARAMETER_1;
+	return Shm_Open(Name);
+}
+
+VGENINTERFACE_API DWORD CloseShmChannel(const char * Name)
+{
+	if (!Name)
+		return STATUS_INVALID_PARAMETER_1;
+	return Shm_Close(Name);
+}
+
+VGENINTERFACE_API DWORD GetShmChannelStats(const char * Name, vGenNS::ShmChannelStats * Stats)
+{
+	if (!Name)
+		return STATUS_INVALID_PARAMETER_1;
+	if (!Stats)
+		return STATUS_INVALID_PARAMETER_2;
+	return Shm_GetStats(Name, *Stats);
 }
 
 #pragma endregion  Interface Functions (Common)
@@ -16,7 +16,12 @@
 // that uses this DLL. This way any other project whose source files include this file see
 // VGENINTERFACE_API functions as being imported from a DLL, whereas this DLL sees symbols
 // defined with this macro as being exported.
-#ifdef VGENINTERFACE_EXPORTS
+#ifndef _WIN32
+#include "vGenCompat.h"
+#define VGENINTERFACE_API __attribute__((visibility("default")))
+#elif defined(VGEN_STATIC)  // Linked into the application (vGenStatic in CMakeLists.txt)
+#define VGENINTERFACE_API
+#elif defined(VGENINTERFACE_EXPORTS)
 #define VGENINTERFACE_API __declspec(dllexport)
 #else
 #define VGENINTERFACE_API __declspec(dllimport)
@@ -118,6 +123,123 @@ namespace vGenNS {
 		DPOV_NorthWest,
 	};
 
+	// Curves of AnimateDevAxis(): how the axis moves from its value to the target over the duration
+	enum AxisEasing : BYTE
+	{
+		EaseLinear = 0,
+		EaseInQuad,      // Starts slow
+		EaseOutQuad,     // Ends slow
+		EaseInOutQuad,
+		EaseInCubic,
+		EaseOutCubic,
+		EaseInOutCubic,
+	};
+
+	// Spring-return model of an axis, see SetDevAxisSpring(). Positions in the vJoy range (0-0x7FFF).
+	struct AxisSpring
+	{
+		FLOAT Stiffness = 0;        // Pull towards Center, 1/s^2. 0 removes the model. Up to 10000.
+		FLOAT Damping = 0;          // 1/s. 2*sqrt(Stiffness) returns without overshoot. Up to 1000.
+		LONG Center = 0x4000;       // Rest position
+		FLOAT DetentStiffness = 0;  // Pull towards a detent closer than DetentWidth, 1/s^2. Up to 10000.
+		LONG DetentWidth = 0;
+		UINT DetentCount = 0;       // Up to 4
+		LONG Detents[4] = {};
+	};
+
+	// Instructions of a macro program, see LoadMacro()
+	enum MacroOp : BYTE
+	{
+		MacroEnd = 0,   // Stops the run; so does running off the end
+		MacroButton,    // Arg16: button, Arg8: 1 press, 0 release
+		MacroAxis,      // Arg16: axis, Arg32: value, 0-0x7FFF
+		MacroRamp,      // Arg16: axis, Arg8: AxisEasing, Arg32: target (low word, 0-0x7FFF) and duration in ms (high word,
+		                // 1-65535). Starts AnimateDevAxis() and goes on without waiting for it.
+		MacroDiscPov,   // Arg8: POV, Arg32: DPOV_DIRECTION
+		MacroContPov,   // Arg8: POV, Arg32: 0-35999 or -1 (center)
+		MacroWait,      // Arg32: ms, 1 or more
+		MacroLoop,      // Arg16: index of the first instruction of the body, before this one; Arg32: times the body
+		                // runs in all, 0 forever. The body must contain a MacroWait.
+	};
+
+	struct MacroInstr
+	{
+		BYTE Op = MacroEnd;  // MacroOp
+		BYTE Arg8 = 0;
+		USHORT Arg16 = 0;
+		LONG Arg32 = 0;
+	};
+
+	// Controls and transforms of a ControlRoute, see SetControlRoutes()
+	enum RouteKind : BYTE
+	{
+		RouteAxis = 0,  // Index: HID_USAGES. Values in the vJoy range, 0-0x7FFF.
+		RouteButton,    // Index: button number. Values 1 pressed, 0 released.
+		RoutePov,       // Index: POV number. Values 0-35999 or -1 (center), as SetDevPov().
+	};
+	enum RouteTransform : BYTE
+	{
+		RouteDirect = 0,    // Any kind to the same kind, as is
+		RouteInvert,        // Axis to axis (0x7FFF - value) or button to button (released when pressed)
+		RouteScale,         // Axis to axis: value * Scale + Offset, limited to 0-0x7FFF
+		RouteThreshold,     // Axis to button: pressed from Threshold up, released below Threshold - Hysteresis
+		RouteButtonToAxis,  // Button to axis: OnValue while pressed, else OffValue
+		RouteSplitLow,      // Axis to axis: the lower half of the source, from the center (0) to 0 (0x7FFF)
+		RouteSplitHigh,     // Axis to axis: the upper half of the source, from the center (0) to 0x7FFF (0x7FFF)
+		RouteCombine,       // Buttons SrcIndex and SrcIndex2 to an axis: 0, 0x7FFF, or the center if neither or both
+	};
+
+	struct ControlRoute
+	{
+		HDEVICE SrcDev = 0;
+		HDEVICE DstDev = 0;
+		UINT SrcIndex = 0;
+		UINT SrcIndex2 = 0;                  // RouteCombine: the button towards 0x7FFF; SrcIndex goes towards 0
+		UINT DstIndex = 0;
+		RouteKind SrcKind = RouteAxis;
+		RouteKind DstKind = RouteAxis;
+		RouteTransform Transform = RouteDirect;
+		FLOAT Scale = 1;                     // RouteScale
+		LONG Offset = 0;
+		LONG Threshold = 0x4000;             // RouteThreshold
+		LONG Hysteresis = 0;
+		LONG OnValue = 0x7FFF;               // RouteButtonToAxis
+		LONG OffValue = 0;
+	};
+
+	// How a physical pad's controls merge with the application's, see SetDevPassthrough(). Buttons are always pressed
+	// if either side presses them.
+	enum PassthroughMerge : BYTE
+	{
+		MergeMax = 0,     // Each axis from the side moved furthest from rest, POV 1 from the pad unless centered
+		MergePadFirst,    // Each axis and POV 1 from the pad where it is off rest, else from the application
+		MergeFeederFirst, // Each axis and POV 1 from the application where it is off rest, else from the pad
+	};
+
+	struct PassthroughConfig
+	{
+		UINT Slot = 0;                    // XInput user index, 0-3
+		PassthroughMerge Merge = MergeMax;
+		LONG Deadzone = 0;                // vJoy range: pad axes closer than this to rest are at rest
+	};
+
+	// The reader of the physical pads, see SetPadPollConfig()
+	struct PadPollConfig
+	{
+		UINT IntervalUs = 4000;     // Between polls, 1000-100000
+		UINT EmptyProbeMs = 1000;   // Longest wait before an empty slot is read again, 16-60000
+	};
+
+	struct PadPollStats
+	{
+		ULONGLONG Polls = 0;
+		ULONGLONG Reads = 0;        // Of slots with a pad
+		ULONGLONG Probes = 0;       // Of slots found empty before
+		ULONGLONG Skipped = 0;      // Empty slots left alone until their next probe
+		ULONGLONG Served = 0;       // GetXInputState() calls
+		BYTE Connected = 0;         // Bit per slot with a pad, as of the last poll
+	};
+
 	struct DeviceInfo
 	{
 		USHORT ProdId = 0;  // USB PID
@@ -127,6 +249,197 @@ namespace vGenNS {
 		BYTE LedNumber = 0;  // XBox
 	};
 
+	// Which members of a FeedbackData record carry new values.
+	enum FeedbackFlags : BYTE
+	{
+		FeedbackNone     = 0,
+		FeedbackRumble   = 0x01,  // LargeMotor and SmallMotor
+		FeedbackLed      = 0x02,  // LedNumber (XBox)
+		FeedbackLightbar = 0x04,  // ColorBar (DS4)
+		FeedbackFlash    = 0x08,  // FlashOn and FlashOff (DS4)
+		FeedbackBridged  = 0x10,  // With FeedbackRumble: the motors come from the FFB rumble bridge, not the host
+	};
+
+	// Feedback (output) report from the host to a ViGEm device, as read by GetDevFeedback().
+	struct FeedbackData
+	{
+		DWORD Sequence = 0;   // Running record number for this device, starting at 1. Gaps indicate dropped records.
+		DWORD ColorBar = 0;   // DS4 lightbar color as 0xFFRRGGBB
+		BYTE LargeMotor = 0;  // Low frequency rumble motor, 0-255
+		BYTE SmallMotor = 0;  // High frequency rumble motor, 0-255
+		BYTE LedNumber = 0;   // XBox player LED, 1-based
+		BYTE Flags = FeedbackNone;  // FeedbackFlags
+		BYTE FlashOn = 0;     // DS4 lightbar flash on time, in 10ms units
+		BYTE FlashOff = 0;    // DS4 lightbar flash off time, in 10ms units
+	};
+
+	// Exports covered by GetPerfStats(). SetDevPovDeg() is counted as SetDevPov().
+	enum PerfApi : UINT
+	{
+		PerfSetDevButton = 0,
+		PerfSetDevAxis,
+		PerfSetDevAxisPct,
+		PerfSetDevDiscPov,
+		PerfSetDevContPov,
+		PerfSetDevPov,
+		PerfGetPosition,
+		PerfAcquireDev,
+		PerfRelinquishDev,
+		PerfResetDevPositions,
+		PerfApiCount
+	};
+
+	// Log-linear latency histogram. Buckets 0-3 are 16ns wide and cover 0-63ns, after that every power of 2 is split
+	// into 4 buckets: bucket b (b >= 4) starts at (4 + (b - 4) % 4) << ((b - 4) / 4 + 4) ns. The last bucket starts at 3.76s.
+	#define PERF_HIST_BUCKETS 108
+
+	struct PerfHistogram
+	{
+		ULONGLONG Count = 0;
+		ULONGLONG TotalNs = 0;
+		ULONGLONG MaxNs = 0;
+		ULONGLONG Buckets[PERF_HIST_BUCKETS] = {};
+	};
+
+	struct PerfApiStats
+	{
+		ULONGLONG Calls = 0;
+		ULONGLONG Errors = 0;    // Calls that did not return 0 (STATUS_SUCCESS/ERROR_SUCCESS)
+		PerfHistogram Own;       // Time spent in vGen itself
+		PerfHistogram Driver;    // Time spent in vJoy/XOutput/ViGEm calls. Only calls that reached the driver are counted.
+	};
+
+	// Snapshot returned by GetPerfStats()
+	struct PerfStats
+	{
+		ULONGLONG ElapsedNs = 0;  // Time since the statistics were (re)enabled
+		PerfApiStats Api[PerfApiCount];
+	};
+
+	// Result of ReplayTrace()
+	struct ReplayStats
+	{
+		ULONGLONG Calls = 0;       // Calls replayed
+		ULONGLONG Errors = 0;      // Replayed calls that did not return 0
+		ULONGLONG Mismatches = 0;  // Replayed calls that returned something else than during recording
+		ULONGLONG Skipped = 0;     // Calls on devices the trace did not acquire, or whose AcquireDev() had failed
+		ULONGLONG Dropped = 0;     // Calls the recorder had lost
+		ULONGLONG ElapsedNs = 0;   // Duration of the replay
+		PerfHistogram Lag;         // How late each call was issued against the schedule. Empty when playing as fast as possible.
+		PerfHistogram Latency[PerfApiCount];  // Duration of the replayed calls
+	};
+
+	// What the devices are plugged into, see SelectBackend()
+	enum BackendType : UINT
+	{
+		BackendDriver    = 0,  // vJoy, XOutput (ScpVBus) and ViGEm drivers. Windows only, the default there.
+		BackendSimulated = 1,  // In-memory bus, see SimBusConfig. The default without the drivers.
+		BackendUinput    = 2,  // Linux evdev devices created through /dev/uinput. Linux only.
+		BackendUinputMemory = 3,  // BackendUinput writing the events into memory, see GetUinputEvents()
+	};
+
+	// Operations of the simulated bus, for SimBusConfig::FailOps
+	enum SimBusOps : BYTE
+	{
+		SimOpPlug   = 0x01,  // AcquireDev()
+		SimOpUnplug = 0x02,  // RelinquishDev()
+		SimOpSubmit = 0x04,  // Sending a report: SetDev*() and ResetDevPositions()
+		SimOpRead   = 0x08,  // GetPosition()
+		SimOpAll    = 0x0F,
+	};
+
+	// Behavior of the simulated bus. Latencies are spent busy-waiting, like a driver call would block the caller.
+	struct SimBusConfig
+	{
+		DWORD PlugLatencyNs = 0;    // Added to every plug in and unplug
+		DWORD SubmitLatencyNs = 0;  // Added to every report sent
+		DWORD ReadLatencyNs = 0;    // Added to every report read
+		DWORD FailEvery = 0;        // Every FailEvery-th operation selected by FailOps fails, 0: none
+		BYTE FailOps = SimOpAll;    // SimBusOps
+		DWORD FailStatus = 0;       // Returned by a failing operation, 0: STATUS_IO_DEVICE_ERROR
+		// Every simulated vJoy device has all 8 axes and these buttons and POVs. Like vJoy, either discrete or continuous POVs.
+		USHORT vJoyButtons = 32;    // 0-128
+		BYTE vJoyDiscPovs = 0;      // 0-4
+		BYTE vJoyContPovs = 4;      // 0-4
+	};
+
+	// Operations of the simulated bus since SetSimBusConfig(), see GetSimBusStats()
+	struct SimBusStats
+	{
+		ULONGLONG Plugs = 0;
+		ULONGLONG Unplugs = 0;
+		ULONGLONG Submits = 0;
+		ULONGLONG Reads = 0;
+		ULONGLONG Failures = 0;  // Operations failed on purpose (FailEvery)
+	};
+
+	// Event written to a uinput device (struct input_event without the time)
+	struct UinputEvent
+	{
+		USHORT Type;  // EV_SYN, EV_KEY or EV_ABS
+		USHORT Code;
+		LONG Value;
+	};
+
+	// Commits of the devices currently plugged into a uinput backend, see GetUinputStats()
+	struct UinputStats
+	{
+		ULONGLONG Commits = 0;    // Batches written, each ending with one SYN_REPORT
+		ULONGLONG Events = 0;     // Control events written, without the SYN_REPORTs
+		ULONGLONG Unchanged = 0;  // Reports that changed nothing, so nothing was written
+		ULONGLONG Errors = 0;     // Failed writes
+	};
+
+	// Work of the daemon since RunDaemon(), see GetDaemonStats()
+	struct DaemonStats
+	{
+		ULONGLONG Frames = 0;    // Datagrams received, each one frame of VgenMsg (vGenProtocol.h)
+		ULONGLONG Messages = 0;  // Requests in those frames
+		ULONGLONG Commits = 0;   // Reports sent to the backend
+		ULONGLONG Errors = 0;    // Requests that failed
+		UINT Feeders = 0;        // Feeders known now
+		UINT Devices = 0;        // Devices held or subscribed to now
+	};
+
+	// Work of a shared-memory channel since OpenShmChannel(), see GetShmChannelStats()
+	struct ShmChannelStats
+	{
+		ULONGLONG Messages = 0;  // Messages drained from the ring
+		ULONGLONG Commits = 0;   // Reports sent to the backend
+		ULONGLONG Errors = 0;    // Messages that failed
+		ULONGLONG Sleeps = 0;    // Times the channel thread found the ring empty and waited for a wake
+		UINT Pending = 0;        // Messages in the ring now
+		BOOL Attached = FALSE;   // A feeder has the channel open
+	};
+
+	// Priority of the timer thread, see SetSchedulerConfig()
+	enum SchedulerPriority : BYTE
+	{
+		SchedulerNormal = 0,
+		SchedulerAboveNormal,
+		SchedulerHigh,
+		SchedulerRealtime,  // Windows: time critical. Linux: SCHED_FIFO, which needs CAP_SYS_NICE.
+	};
+
+	// Settings of the timer thread, see SetSchedulerConfig()
+	struct SchedulerConfig
+	{
+		SchedulerPriority Priority = SchedulerNormal;
+		ULONGLONG Affinity = 0;  // Mask of the CPUs the thread may run on, 0 for any
+	};
+
+	// Work of the timer thread, see GetSchedulerStats()
+	struct SchedulerStats
+	{
+		ULONGLONG Wakes = 0;     // Times the thread woke for a deadline
+		ULONGLONG Early = 0;     // Times a new timer or setting woke it before its deadline
+		ULONGLONG Fired = 0;     // Timers run; each step of an animation, turbo button, macro run or spring counts
+		UINT Pending = 0;        // Timers pending now
+		BOOL Running = FALSE;    // The thread starts with the first timer and stops with DeInit()
+		DWORD ConfigStatus = 0;  // Result of applying the SchedulerConfig, STATUS_ACCESS_DENIED if not allowed
+		PerfHistogram Lateness;  // Wake time minus deadline, for the deadline wakes
+	};
+
 }  // namespace vGenNS
 
 #ifndef VJOYHEADERUSED
@@ -316,6 +629,36 @@ typedef void (CALLBACK *FfbGenCB)(PVOID, PVOID);
 
 #endif // !VJOYHEADERUSED
 
+// Force feedback packet as decoded by the DLL when it arrives from vJoy, read by FfbReadPackets().
+// Type selects the valid member of the union. EffectBlockIndex is set for all effect related packets.
+typedef struct _FFB_PACKET {
+	DWORD		Sequence;			// Running packet number, starting at 1. Gaps indicate dropped packets.
+	UINT		DeviceID;			// vJoy device (1-16)
+	FFBPType	Type;
+	BYTE		EffectBlockIndex;
+	union
+	{
+		FFB_EFF_REPORT		Report;		// PT_EFFREP
+		FFB_EFF_ENVLP		Envelope;	// PT_ENVREP
+		FFB_EFF_COND		Condition;	// PT_CONDREP
+		FFB_EFF_PERIOD		Period;		// PT_PRIDREP
+		FFB_EFF_CONSTANT	Constant;	// PT_CONSTREP
+		FFB_EFF_RAMP		Ramp;		// PT_RAMPREP
+		FFB_EFF_OP			Operation;	// PT_EFOPREP
+		FFB_CTRL			Control;	// PT_CTRLREP
+		BYTE				Gain;		// PT_GAINREP
+		FFBEType			NewEffect;	// PT_NEWEFREP
+	};
+} FFB_PACKET, *PFFB_PACKET;
+
+// Receives the combined force of a vJoy device's playing effects whenever it changes (see FfbGetForce).
+typedef void (CALLBACK *FfbForceCB)(UINT rID, LONG ForceX, LONG ForceY, PVOID data);
+
+// Receives the decoded FFB packets a subscriber asked for (see FfbSubscribe).
+typedef void (CALLBACK *FfbPacketCB)(const FFB_PACKET * Packet, PVOID data);
+#define FFB_PT_MASK(t)	(1UL << (t))	// FfbSubscribe() type mask bit of FFBPType t
+#define FFB_PT_ALL		0xFFFFFFFF
+
 //////////////////////////////////////////////////////////////////////////////////////
 ///
 ///  vJoy interface fuctions (Native vJoy)
@@ -460,6 +803,30 @@ extern "C" {
 
 	// Added in 2.1.6
 	VGENINTERFACE_API DWORD		__cdecl Ffb_h_Eff_Constant(const FFB_DATA * Packet, FFB_EFF_CONSTANT *  ConstantEffect);
+
+	// Decoded FFB packets, oldest first. Waits up to Timeout ms (INFINITE or 0) if none is queued.
+	// Packets are queued from the first call to this function or to FfbRegisterGenCB() on.
+	VGENINTERFACE_API DWORD		__cdecl FfbReadPackets(FFB_PACKET * Packets, UINT Count, UINT * Read, DWORD Timeout);
+
+	// Any number of subscribers can receive the decoded packets of one vJoy device (rID 0 for all) whose type
+	// is in TypeMask (FFB_PT_MASK bits, 0 for all). Called on the vJoy FFB thread, in the order of subscription.
+	// FfbRegisterGenCB() is a subscription too, for all raw packets; registering again replaces it.
+	// FfbUnsubscribe() returns once the FFB threads that could still call the subscriber are out of their callbacks, so
+	// the callback's data can then be freed; packets arriving meanwhile don't hold it up. Don't call it holding a lock a
+	// callback takes. Called from a callback, it returns without waiting.
+	VGENINTERFACE_API DWORD		__cdecl FfbSubscribe(UINT rID, DWORD TypeMask, FfbPacketCB cb, PVOID data, UINT * Subscription);
+	VGENINTERFACE_API DWORD		__cdecl FfbUnsubscribe(UINT Subscription);
+
+	// The DLL keeps the effect table of every vJoy device and evaluates the combined force of the playing effects
+	// (against the current X/Y axis positions for conditions) every tick. Forces range -10000 to 10000 per axis.
+	VGENINTERFACE_API DWORD		__cdecl FfbGetForce(UINT rID, LONG * ForceX, LONG * ForceY);
+	VGENINTERFACE_API VOID		__cdecl FfbRegisterForceCB(FfbForceCB cb, PVOID data);  // Called from the engine thread
+	VGENINTERFACE_API DWORD		__cdecl FfbSetForceTick(UINT Period);  // Evaluation period in ms (1-100, default 5)
+	// Rumble bridge: drives the motors of a ViGEm device (as seen by GetDevFeedback) from the force of vJoy device rID,
+	// updated every tick. The strength of the force drives the large motor, how fast it changes the small one.
+	// These records carry FeedbackBridged and do not replace the host rumble in the other records. A bridge record and a
+	// host one made at the same time may come out of Sequence order. Pass INVALID_DEV to unlink.
+	VGENINTERFACE_API DWORD		__cdecl FfbSetRumbleTarget(UINT rID, HDEVICE hDev);
 	#pragma endregion  vJoy FFB
 #pragma endregion  vJoy Backward compatibility API
 
@@ -562,10 +929,17 @@ extern "C" {
 	VGENINTERFACE_API DWORD   __cdecl GetDevHatN(HDEVICE hDev, vGenNS::PovType povType, USHORT * nHat);	// Get number of Hats/POVs in device.
 	VGENINTERFACE_API DWORD   __cdecl	GetPosition(HDEVICE hDev, PVOID pData);	          //  Read current positions vJoy device
 	VGENINTERFACE_API DWORD   __cdecl GetDevInfo(HDEVICE hDev, vGenNS::DeviceInfo * DevInfo);
+	// Read up to Count queued feedback records (rumble, LED, lightbar) sent by the host to a ViGEm device, oldest first. The number of records
+	// copied into Data is returned in Read. If none are queued, waits up to Timeout ms for one to arrive (0 = no wait, INFINITE = wait forever)
+	// and returns STATUS_TIMEOUT if none did. The latest values are also always available from GetDevInfo().
+	VGENINTERFACE_API DWORD   __cdecl GetDevFeedback(HDEVICE hDev, vGenNS::FeedbackData * Data, UINT Count, UINT * Read, DWORD Timeout);
 
 	VGENINTERFACE_API BOOL    __cdecl	IsDevTypeSupported(vGenNS::DevType dType);
 	VGENINTERFACE_API DWORD   __cdecl	GetDriverVersion(vGenNS::DevType dType);
-	VGENINTERFACE_API DWORD   __cdecl	GetXInputState(UINT ledN, PXINPUT_STATE pData);	 //  Read current positions XInput device by LED number. Should work for unowned devices as well.
+	// Read current positions XInput device by LED number. Should work for unowned devices as well. Served from the
+	// snapshot of the pad reader (SetPadPollConfig()), not read from the pad: the first call for a slot reads it and
+	// has the reader poll it from then on. XInput results: ERROR_DEVICE_NOT_CONNECTED, ERROR_BAD_ARGUMENTS.
+	VGENINTERFACE_API DWORD   __cdecl	GetXInputState(UINT ledN, PXINPUT_STATE pData);
 
 	// Position Setting
 	// The button number for gamepads corresponds to the button mapping described at the top of this file.
@@ -584,5 +958,151 @@ extern "C" {
 	VGENINTERFACE_API DWORD   __cdecl SetDevPovDeg(HDEVICE hDev, UCHAR nPov, FLOAT Value);
 
 	VGENINTERFACE_API DWORD   __cdecl ResetDevPositions(HDEVICE hDev);
+
+	// Timed controls. PulseDevButton() presses a button and releases it DurationMs later; PulseDevDiscPov() sets a
+	// discrete POV and centers it DurationMs later (Value may not be DPOV_Center). The press is sent at once, the release
+	// by a timer thread, together with any other release due in the same millisecond. Pulsing the same control again
+	// moves its release; SetDevButton() or a POV setter on it, ResetDevPositions() and RelinquishDev() cancel it.
+	VGENINTERFACE_API DWORD   __cdecl PulseDevButton(HDEVICE hDev, UINT Button, UINT DurationMs);
+	VGENINTERFACE_API DWORD   __cdecl PulseDevDiscPov(HDEVICE hDev, UCHAR nPov, vGenNS::DPOV_DIRECTION Value, UINT DurationMs);
+	// Auto-fire. The button is pressed for DutyPct (1-99) percent of every period, Hz periods a second, starting now
+	// with a press; Hz 0 stops it and releases the button. Each phase must last at least 1 ms. The toggles of all turbo
+	// buttons due in the same millisecond reach a device as one report. SetDevButton() and PulseDevButton() on the
+	// button, ResetDevPositions() and RelinquishDev() stop it as well.
+	VGENINTERFACE_API DWORD   __cdecl SetDevButtonTurbo(HDEVICE hDev, UINT Button, FLOAT Hz, UINT DutyPct);
+	// Moves an axis from its current value to Target (vJoy range, as SetDevAxis()) over DurationMs, along the Easing
+	// curve. The timer thread sends a value every few milliseconds. Animating the axis again starts from where it is
+	// now; SetDevAxis() or SetDevAxisPct() on it, ResetDevPositions() and StopDevAxisAnimation() stop it there.
+	VGENINTERFACE_API DWORD   __cdecl AnimateDevAxis(HDEVICE hDev, vGenNS::HID_USAGES Axis, LONG Target, UINT DurationMs, vGenNS::AxisEasing Easing);
+	VGENINTERFACE_API DWORD   __cdecl StopDevAxisAnimation(HDEVICE hDev, vGenNS::HID_USAGES Axis);
+
+	// Spring-return axes. An axis with a model stays where SetDevAxis() puts it, as if held; ReleaseDevAxis() lets go of
+	// it and the timer thread moves it back to Center (or into a detent), damped, until it comes to rest. Setting or
+	// animating the axis takes hold of it again. Spring NULL removes the model and leaves the axis where it is.
+	VGENINTERFACE_API DWORD   __cdecl SetDevAxisSpring(HDEVICE hDev, vGenNS::HID_USAGES Axis, const vGenNS::AxisSpring * Spring);
+	VGENINTERFACE_API DWORD   __cdecl ReleaseDevAxis(HDEVICE hDev, vGenNS::HID_USAGES Axis);
+
+	// Macros: programs of MacroInstr (see MacroOp), checked once by LoadMacro() and then run by the timer thread. A
+	// device runs any number of macros at once; their changes due in the same millisecond reach it as one report.
+	// Controls the device lacks are skipped. Macros don't cancel the timed controls above, nor do those stop macros.
+	// Program: Count instructions, up to 4096. MacroId: receives the macro's id, 1-0xFFFF.
+	VGENINTERFACE_API DWORD   __cdecl LoadMacro(const vGenNS::MacroInstr * Program, UINT Count, UINT * MacroId);
+	// Runs that already started go on to their end
+	VGENINTERFACE_API DWORD   __cdecl UnloadMacro(UINT MacroId);
+	// Starts the macro on a device; its instructions up to the first wait run before the call returns. A macro already
+	// running on the device starts over.
+	VGENINTERFACE_API DWORD   __cdecl RunMacro(HDEVICE hDev, UINT MacroId);
+	// Stops the macro on a device, leaving the controls as they are
+	VGENINTERFACE_API DWORD   __cdecl StopMacro(HDEVICE hDev, UINT MacroId);
+
+	// Mirroring: every report sent for Source is also converted for Target and sent to it, inside the call that sent
+	// it. Axes keep their vJoy-range values, POV 1 and the gamepad dpad map onto each other (vJoy to vJoy keeps all
+	// POVs) and buttons keep their numbers, e.g. vJoy button 1 is A on an XBox pad and Cross on a DS4. A source has up
+	// to 8 targets, a target may be the source of others, but not of a device that leads back to it
+	// (STATUS_INVALID_PARAMETER_2). Linking sends the target the source's state at once. Writes to the target itself
+	// stay until the next report of the source overwrites them. RelinquishDev() removes a device's links.
+	VGENINTERFACE_API DWORD   __cdecl LinkDevMirror(HDEVICE Source, HDEVICE Target);
+	VGENINTERFACE_API DWORD   __cdecl UnlinkDevMirror(HDEVICE Source, HDEVICE Target);
+
+	// Routing: each ControlRoute drives a control of DstDev from one of SrcDev through a transform. The table replaces
+	// the previous one (Count 0 removes it) and is compiled once, by source, so that every report sent for a device
+	// only reads its routed controls and runs the routes of those that changed. Outputs on the source device itself go
+	// into the same report, other devices get one report each. Routes run on every report, whatever sent it (a feeder,
+	// a timer, a mirror or another route), up to 4 routes deep. A new table is applied to the current state at once.
+	// Up to 4096 routes; BadRoute (may be NULL) receives the index of the route that was refused.
+	// STATUS_INVALID_HANDLE for a device not acquired, STATUS_INVALID_PARAMETER_1 for a control the device lacks or a
+	// transform that doesn't take those kinds. RelinquishDev() removes the routes from or to the device.
+	VGENINTERFACE_API DWORD   __cdecl SetControlRoutes(const vGenNS::ControlRoute * Routes, UINT Count, UINT * BadRoute);
+
+	// Passthrough: a background reader polls the physical XInput controller in Config->Slot and merges it into every
+	// report sent for the device, through the units of the Common API as LinkDevMirror() does. The application's own
+	// writes are kept apart, so a button released on the pad stays pressed if the application pressed it. The device
+	// gets a report when the pad's state changes, not on every poll; a pad unplugged leaves the application's state.
+	// Rest is the reset position: the center for sticks, 0 for triggers, the one ResetDevPositions() sets for the
+	// device. Config NULL stops the passthrough. STATUS_INVALID_PARAMETER_2 for a bad member, or a slot held by a vGen
+	// XBox device, which would feed the device its own output. RelinquishDev() stops it.
+	VGENINTERFACE_API DWORD   __cdecl SetDevPassthrough(HDEVICE hDev, const vGenNS::PassthroughConfig * Config);
+	// The reader behind passthrough and GetXInputState(). It polls the slots in use every IntervalUs; a slot found
+	// empty is read again after 16 ms, then after twice as long each time it is still empty, up to EmptyProbeMs, so that
+	// empty slots, slow to read, cost little. Applies from the next poll. Reset: starts the counters again from zero.
+	VGENINTERFACE_API DWORD   __cdecl SetPadPollConfig(const vGenNS::PadPollConfig * Config);
+	VGENINTERFACE_API DWORD   __cdecl GetPadPollStats(vGenNS::PadPollStats * Stats, BOOL Reset);
+
+	// De-jitter buffer. SetDevAxisAt() and SetDevButtonAt() do what SetDevAxis() and SetDevButton() do, at time AtUs of
+	// GetSchedulerTime() instead of now: the device holds up to 256 such writes (STATUS_INSUFFICIENT_RESOURCES beyond)
+	// and the timer thread makes each at its time, in the report of that millisecond with the other changes due then.
+	// Writes for the same time are made in the order of the calls; one whose time has passed is made at once, or after
+	// the writes still held. Bursty input replayed with its original spacing plus a fixed delay reaches the device evenly
+	// spaced. The write, when it is made, cancels the axis' animation, or the button's release and turbo, until then
+	// they go on; ResetDevPositions() and RelinquishDev() drop the writes held.
+	VGENINTERFACE_API DWORD   __cdecl GetSchedulerTime(ULONGLONG * TimeUs);
+	VGENINTERFACE_API DWORD   __cdecl SetDevAxisAt(HDEVICE hDev, vGenNS::HID_USAGES Axis, LONG Value, ULONGLONG AtUs);
+	VGENINTERFACE_API DWORD   __cdecl SetDevButtonAt(HDEVICE hDev, UINT Button, BOOL Press, ULONGLONG AtUs);
+
+	// The timer thread behind the calls above. It sleeps until the earliest deadline, or until a new timer comes in,
+	// and not at all while no timer is pending; deadlines are whole milliseconds of a monotonic clock. Config applies at
+	// once if the thread runs, else when it starts; the result is also kept in SchedulerStats::ConfigStatus.
+	VGENINTERFACE_API DWORD   __cdecl SetSchedulerConfig(const vGenNS::SchedulerConfig * Config);
+	// Reset: starts the counters and the histogram again from zero after the snapshot
+	VGENINTERFACE_API DWORD   __cdecl GetSchedulerStats(vGenNS::SchedulerStats * Stats, BOOL Reset);
+
+	// Per-API call counters and latency histograms. Off by default. EnablePerfStats(TRUE) starts again from zero,
+	// EnablePerfStats(FALSE) stops recording and keeps the counters for GetPerfStats().
+	VGENINTERFACE_API DWORD   __cdecl EnablePerfStats(BOOL Enable);
+	// Snapshot of the counters, summed over all threads.
+	VGENINTERFACE_API DWORD   __cdecl GetPerfStats(vGenNS::PerfStats * Stats);
+
+	// API call trace. Records every call of the exports covered by GetPerfStats() with its arguments, return value,
+	// start time and duration into the file FileName (UTF-8). The calling thread only queues the call, a background
+	// thread writes the file. Returns STATUS_INVALID_DEVICE_STATE if a trace is already running.
+	VGENINTERFACE_API DWORD   __cdecl StartTrace(const char * FileName);
+	// Writes the remaining calls and closes the file. DeInit() also stops the trace. If the file could not be written
+	// (disk full), the trace stopped recording at that point and this returns STATUS_UNEXPECTED_IO_ERROR; the file keeps
+	// the calls written before. StartTrace() can only start another trace after this call.
+	VGENINTERFACE_API DWORD   __cdecl StopTrace(void);
+	// Re-issues the calls of a trace file, in time order, from the calling thread. Speed 1 keeps the recorded timing,
+	// 2 plays twice as fast, 0 as fast as possible. Devices acquired in the trace are acquired again (mapping the recorded
+	// handles to the new ones) and released at the end. Stats may be NULL.
+	VGENINTERFACE_API DWORD   __cdecl ReplayTrace(const char * FileName, FLOAT Speed, vGenNS::ReplayStats * Stats);
+
+	// Backends. All devices are plugged into the selected backend; it can only be changed while no device is acquired
+	// (STATUS_INVALID_DEVICE_STATE otherwise). BackendDriver returns STATUS_NOT_SUPPORTED in builds without the drivers.
+	VGENINTERFACE_API DWORD   __cdecl SelectBackend(vGenNS::BackendType Backend);
+	// Simulated bus: every device type, in memory. Config replaces the current configuration and zeroes the statistics.
+	VGENINTERFACE_API DWORD   __cdecl SetSimBusConfig(const vGenNS::SimBusConfig * Config);
+	VGENINTERFACE_API DWORD   __cdecl GetSimBusStats(vGenNS::SimBusStats * Stats);
+	// Copies the last report the simulated bus received for a plugged in device (JOYSTICK_POSITION_V2, XINPUT_GAMEPAD or DS4_REPORT).
+	// Unlike GetPosition() this is the bus side, it is neither delayed nor failed.
+	VGENINTERFACE_API DWORD   __cdecl GetSimBusReport(vGenNS::DevType dType, UINT DevId, PVOID Report);
+	// Plays the host: sends feedback to a simulated vgeXbox or vgeDS4 device. The members selected by Data->Flags
+	// (FeedbackFlags) go to GetDevInfo() and GetDevFeedback() as if the ViGEm bus had sent them.
+	VGENINTERFACE_API DWORD   __cdecl SendSimBusFeedback(vGenNS::DevType dType, UINT DevId, const vGenNS::FeedbackData * Data);
+	// Plays the host writing a raw output report (Size bytes, at most 64) to a simulated vgeDS4 device: USB report 0x05 or
+	// Bluetooth report 0x11. It is decoded as the ViGEm output reports are, into rumble, lightbar and flash.
+	// STATUS_INVALID_PARAMETER_2 if it is neither report or sets none of them.
+	VGENINTERFACE_API DWORD   __cdecl SendSimBusDs4Report(UINT DevId, const BYTE * Report, UINT Size);
+	// Plays a physical XInput controller in Slot (0-3) for SetDevPassthrough(), while the simulated bus is selected.
+	// State NULL unplugs it.
+	VGENINTERFACE_API DWORD   __cdecl SetSimBusPad(UINT Slot, const XINPUT_STATE * State);
+	// uinput: vJoy devices are generic joysticks (8 axes, 4 continuous POVs as 8-way hats, 32 buttons), vXbox/vgeXbox
+	// ones Xbox 360 pads and vgeDS4 ones DualShock 4 pads. Every report sent writes the controls that changed and one
+	// SYN_REPORT. Backend is BackendUinput or BackendUinputMemory.
+	VGENINTERFACE_API DWORD   __cdecl GetUinputStats(vGenNS::BackendType Backend, vGenNS::UinputStats * Stats);
+	// Takes up to Count of the oldest events BackendUinputMemory wrote for a device (the last 4096 are kept)
+	VGENINTERFACE_API DWORD   __cdecl GetUinputEvents(vGenNS::DevType dType, UINT DevId, vGenNS::UinputEvent * Events, UINT Count, UINT * Read);
+	// Daemon mode: serves the devices to feeders in other processes (vGenProtocol.h, vGenClient.h) until StopDaemon(),
+	// from the calling thread, on the selected backend. Address is "unix:<path>" or "udp:[127.x.x.x:]<port>" (loopback
+	// only); Windows has no "unix:". Devices the feeders left plugged in are released on exit.
+	VGENINTERFACE_API DWORD   __cdecl RunDaemon(const char * Address);
+	// Makes RunDaemon() return; may be called from any thread or a signal handler
+	VGENINTERFACE_API DWORD   __cdecl StopDaemon(void);
+	VGENINTERFACE_API DWORD   __cdecl GetDaemonStats(vGenNS::DaemonStats * Stats);
+	// Shared-memory channel: one feeder process (vGenShmFeeder.h) writes VgenMsg commands (vGenProtocol.h) into a ring
+	// that a thread of this process drains, without a syscall on either side while the ring is busy. Name is up to 64
+	// letters, digits, '.', '-' or '_'. Devices the feeder acquired are released when the channel is closed; DeInit()
+	// closes every channel.
+	VGENINTERFACE_API DWORD   __cdecl OpenShmChannel(const char * Name);
+	VGENINTERFACE_API DWORD   __cdecl CloseShmChannel(const char * Name);
+	VGENINTERFACE_API DWORD   __cdecl GetShmChannelStats(const char * Name, vGenNS::ShmChannelStats * Stats);
 #pragma endregion  Common API
 } // extern "C"
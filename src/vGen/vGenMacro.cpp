@@ -0,0 +1,178 @@
+// vGenMacro.cpp : Macro programs (LoadMacro) and their interpreter.
+//
+// A program is checked once, when it is loaded, so the interpreter trusts every operand but the controls, which depend
+// on the device. Runs are timers of the wheel (vGenTimer.cpp): Macro_Exec() runs a run's instructions up to its next
+// wait, the wheel calls it again when the wait is over.
+
+#include "stdafx.h"
+#include "Private.h"
+
+using namespace vGenNS;
+
+namespace {
+
+#define MACRO_MAX_CODE  4096
+#define MACRO_MAX_ID    0xFFFF  // Ids are timer indexes, 16 bits
+#define MACRO_BUDGET    1024    // Instructions run without a wait before the run yields for 1 ms
+
+std::mutex g_macroLock;
+std::map<UINT, std::shared_ptr<const MacroProgram>> g_macros;  // By id, under g_macroLock
+UINT g_macroNextId = 1;                                           // under g_macroLock
+
+// STATUS_SUCCESS if the instruction at pc is valid in the program
+DWORD Macro_Check(const MacroInstr * program, UINT pc)
+{
+	const MacroInstr & instr = program[pc];
+	switch (instr.Op) {
+		case MacroEnd:
+			return STATUS_SUCCESS;
+
+		case MacroButton:
+			return instr.Arg16 && instr.Arg8 <= 1 ? STATUS_SUCCESS : STATUS_INVALID_PARAMETER_1;
+
+		case MacroAxis:
+			return instr.Arg16 >= HID_USAGE_X && instr.Arg16 <= HID_USAGE_WHL && instr.Arg32 >= 0 && instr.Arg32 <= 0x7FFF ?
+				STATUS_SUCCESS : STATUS_INVALID_PARAMETER_1;
+
+		case MacroRamp: {
+			const LONG target = instr.Arg32 & 0xFFFF;
+			const UINT duration = (ULONG)instr.Arg32 >> 16;
+			return instr.Arg16 >= HID_USAGE_X && instr.Arg16 <= HID_USAGE_WHL && target <= 0x7FFF && duration &&
+				instr.Arg8 <= EaseInOutCubic ? STATUS_SUCCESS : STATUS_INVALID_PARAMETER_1;
+		}
+
+		case MacroDiscPov:
+			return instr.Arg8 && instr.Arg32 >= DPOV_Center && instr.Arg32 <= DPOV_NorthWest ? STATUS_SUCCESS : STATUS_INVALID_PARAMETER_1;
+
+		case MacroContPov:
+			return instr.Arg8 && instr.Arg32 >= -1 && instr.Arg32 <= 35999 ? STATUS_SUCCESS : STATUS_INVALID_PARAMETER_1;
+
+		case MacroWait:
+			return instr.Arg32 > 0 ? STATUS_SUCCESS : STATUS_INVALID_PARAMETER_1;
+
+		case MacroLoop:
+			if (instr.Arg16 >= pc || instr.Arg32 < 0)
+				return STATUS_INVALID_PARAMETER_1;
+			// A body without a wait would spin the timer thread
+			for (UINT i = instr.Arg16; i < pc; ++i) {
+				if (program[i].Op == MacroWait)
+					return STATUS_SUCCESS;
+			}
+			return STATUS_INVALID_PARAMETER_1;
+
+		default:
+			return STATUS_INVALID_PARAMETER_1;
+	}
+}
+
+}  // namespace
+
+DWORD Macro_Load(const MacroInstr * program, UINT count, UINT & id)
+{
+	if (!program || !count || count > MACRO_MAX_CODE)
+		return STATUS_INVALID_PARAMETER_1;
+	for (UINT pc = 0; pc < count; ++pc) {
+		const DWORD res = Macro_Check(program, pc);
+		if (res != STATUS_SUCCESS)
+			return res;
+	}
+
+	std::shared_ptr<MacroProgram> loaded = std::make_shared<MacroProgram>();
+	loaded->Code.assign(program, program + count);
+
+	std::lock_guard<std::mutex> lock(g_macroLock);
+	if (g_macros.size() >= MACRO_MAX_ID)
+		return STATUS_INSUFFICIENT_RESOURCES;
+	while (g_macros.count(g_macroNextId))
+		g_macroNextId = g_macroNextId % MACRO_MAX_ID + 1;
+	id = g_macroNextId;
+	g_macroNextId = g_macroNextId % MACRO_MAX_ID + 1;
+	g_macros[id] = std::move(loaded);
+	return STATUS_SUCCESS;
+}
+
+DWORD Macro_Unload(UINT id)
+{
+	std::lock_guard<std::mutex> lock(g_macroLock);
+	return g_macros.erase(id) ? STATUS_SUCCESS : STATUS_INVALID_PARAMETER_1;
+}
+
+void Macro_UnloadAll(void)
+{
+	std::lock_guard<std::mutex> lock(g_macroLock);
+	g_macros.clear();
+	g_macroNextId = 1;
+}
+
+MacroRun Macro_Start(UINT id)
+{
+	MacroRun run;
+	std::lock_guard<std::mutex> lock(g_macroLock);
+	const auto it = g_macros.find(id);
+	if (it != g_macros.end()) {
+		run.Program = it->second;
+		run.Counters.assign(it->second->Code.size(), 0);
+	}
+	return run;
+}
+
+UINT Macro_Exec(DEVICE & dev, HDEVICE hDev, MacroRun & run, bool & changed, std::vector<MacroAnimation> & ramps)
+{
+	const std::vector<MacroInstr> & code = run.Program->Code;
+	for (UINT budget = MACRO_BUDGET; budget; --budget) {
+		if (run.Pc >= code.size())
+			return 0;
+
+		const MacroInstr & instr = code[run.Pc++];
+		switch (instr.Op) {
+			case MacroEnd:
+				run.Pc = (UINT)code.size();
+				return 0;
+
+			case MacroButton:
+				changed |= Control_SetButton(dev, instr.Arg16, instr.Arg8) == STATUS_SUCCESS;
+				break;
+
+			case MacroAxis:
+				changed |= Control_SetAxis(dev, (HID_USAGES)instr.Arg16, instr.Arg32) == STATUS_SUCCESS;
+				break;
+
+			case MacroRamp:
+				ramps.push_back({ hDev, (HID_USAGES)instr.Arg16, instr.Arg32 & 0xFFFF, (UINT)((ULONG)instr.Arg32 >> 16), (AxisEasing)instr.Arg8 });
+				break;
+
+			case MacroDiscPov:
+				changed |= Control_SetDiscPov(dev, instr.Arg8, (DPOV_DIRECTION)instr.Arg32) == STATUS_SUCCESS;
+				break;
+
+			case MacroContPov:
+				changed |= Control_SetContPov(dev, instr.Arg8, (DWORD)instr.Arg32) == STATUS_SUCCESS;
+				break;
+
+			case MacroWait:
+				return (UINT)instr.Arg32;
+
+			case MacroLoop: {
+				// Runs of the body so far; back to 0 once done, for the next time the loop is reached
+				UINT & counter = run.Counters[run.Pc - 1];
+				if (!instr.Arg32 || ++counter < (UINT)instr.Arg32)
+					run.Pc = instr.Arg16;
+				else
+					counter = 0;
+				break;
+			}
+		}
+	}
+	return 1;
+}
+
+void Macro_StartRamps(std::vector<MacroAnimation> & ramps)
+{
+	for (const MacroAnimation & ramp : ramps) {
+		const PDEVICE pDev = GetDevice(ramp.hDev);
+		LONG from;
+		if (pDev && Control_GetAxis(*pDev, ramp.Axis, from) == STATUS_SUCCESS)
+			Timer_Animate(ramp.hDev, ramp.Axis, from, ramp.Target, ramp.DurationMs, ramp.Easing);
+	}
+	ramps.clear();
+}
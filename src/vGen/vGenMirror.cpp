@@ -0,0 +1,125 @@
+// vGenMirror.cpp : Device mirroring (LinkDevMirror).
+//
+// Every report sent for a source device is converted to each of its targets and sent there too, in the same call.
+// The conversion goes through the units of the Common API, as a feeder writing both devices would: axes in the vJoy
+// range, POVs in hundredths of a degree (a hat becomes the dpad and back), buttons by number, which g_xButtons and
+// g_ds4Buttons turn into gamepad buttons. Targets may have targets of their own, but links never form a loop.
+
+#include "stdafx.h"
+#include "Private.h"
+
+#include <algorithm>
+
+using namespace vGenNS;
+
+namespace {
+
+#define MIRROR_DPAD_FIRST  12  // Gamepad buttons 12-19 are the dpad directions
+#define MIRROR_DPAD_LAST   19
+#define MIRROR_MAX_POVS    4
+
+bool Mirror_HasPov(const DEVICE & dev)
+{
+	return dev.Caps.DiscPovs || dev.Caps.ContPovs;
+}
+
+// True if the links from `from` lead to `to`
+bool Mirror_Reaches(HDEVICE from, HDEVICE to)
+{
+	if (from == to)
+		return true;
+	const PDEVICE pDev = GetDevice(from);
+	if (!pDev)
+		return false;
+	for (HDEVICE next : pDev->Mirrors) {
+		if (Mirror_Reaches(next, to))
+			return true;
+	}
+	return false;
+}
+
+}  // namespace
+
+void Mirror_Convert(const DEVICE & source, DEVICE & target)
+{
+	for (UINT axis = HID_USAGE_X; axis <= HID_USAGE_WHL; ++axis) {
+		LONG value;
+		if (Control_GetAxis(source, (HID_USAGES)axis, value) == STATUS_SUCCESS)
+			Control_SetAxis(target, (HID_USAGES)axis, value);
+	}
+
+	const bool povs = Mirror_HasPov(source) && Mirror_HasPov(target);
+	for (UCHAR pov = 1; povs && pov <= MIRROR_MAX_POVS; ++pov) {
+		DWORD value;
+		if (Control_GetPov(source, pov, value) != STATUS_SUCCESS)
+			break;
+		Control_SetPov(target, pov, value);
+	}
+
+	// With a hat on both sides a gamepad's dpad follows it, not the buttons of the same numbers. Releases go first, so
+	// that releasing a dpad diagonal doesn't clear the direction another button presses.
+	const bool dpadByPov = povs && (source.Type != DevType::vJoy || target.Type != DevType::vJoy);
+	const UINT buttons = std::min<UINT>(source.Caps.Buttons, target.Caps.Buttons);
+	for (int pass = 0; pass < 2; ++pass) {
+		for (UINT button = 1; button <= buttons; ++button) {
+			BOOL press;
+			if (dpadByPov && button >= MIRROR_DPAD_FIRST && button <= MIRROR_DPAD_LAST)
+				continue;
+			if (Report_GetButton(source, button, press) == STATUS_SUCCESS && (press != FALSE) == (pass == 1))
+				Control_SetButton(target, button, press);
+		}
+	}
+}
+
+void Mirror_Submit(const DEVICE & dev, const DEVICE & report)
+{
+	for (HDEVICE hTarget : dev.Mirrors) {
+		const PDEVICE pTarget = GetDevice(hTarget);
+		if (!pTarget)
+			continue;
+		Mirror_Convert(report, *pTarget);
+		Backend_Submit(*pTarget);
+	}
+}
+
+DWORD Mirror_Link(HDEVICE hSource, HDEVICE hTarget)
+{
+	const PDEVICE pSource = GetDevice(hSource);
+	if (!pSource)
+		return STATUS_INVALID_HANDLE;
+	const PDEVICE pTarget = GetDevice(hTarget);
+	if (!pTarget || Mirror_Reaches(hTarget, hSource))
+		return STATUS_INVALID_PARAMETER_2;
+
+	std::vector<HDEVICE> & mirrors = pSource->Mirrors;
+	if (std::find(mirrors.begin(), mirrors.end(), hTarget) == mirrors.end()) {
+		if (mirrors.size() >= MIRROR_MAX_TARGETS)
+			return STATUS_INSUFFICIENT_RESOURCES;
+		mirrors.push_back(hTarget);
+	}
+
+	Mirror_Convert(*pSource, *pTarget);
+	return Backend_Submit(*pTarget);
+}
+
+DWORD Mirror_Unlink(HDEVICE hSource, HDEVICE hTarget)
+{
+	const PDEVICE pSource = GetDevice(hSource);
+	if (!pSource)
+		return STATUS_INVALID_HANDLE;
+
+	std::vector<HDEVICE> & mirrors = pSource->Mirrors;
+	const auto it = std::find(mirrors.begin(), mirrors.end(), hTarget);
+	if (it == mirrors.end())
+		return STATUS_INVALID_PARAMETER_2;
+	mirrors.erase(it);
+	return STATUS_SUCCESS;
+}
+
+void Mirror_UnlinkAll(HDEVICE hDev)
+{
+	for (DevContainer_cit it = DevContainer_cref.cbegin(); it != DevContainer_cref.cend(); ++it) {
+		std::vector<HDEVICE> & mirrors = GetDevice(it->first)->Mirrors;
+		mirrors.erase(std::remove(mirrors.begin(), mirrors.end(), hDev), mirrors.end());
+	}
+}
@@ -0,0 +1,433 @@
+// vGenPassthrough.cpp : Physical pads (SetDevPassthrough, GetXInputState).
+//
+// A reader thread polls the XInput slots that devices follow or GetXInputState() asked for, through the selected
+// backend (DeviceBackend::PadState), outside g_reportLock: XInputGetState() can take long, on an empty slot above all.
+// A slot found empty is only read again after a wait that doubles with each empty read, the other slots at every poll.
+// What it reads goes into a snapshot, which GetXInputState() returns without reading a pad. It only changes a device
+// when the state read differs from the one the device has, and then sends the device's report. The merge itself happens
+// in Backend_Submit(), on every report whatever sent it: a copy of the report gets the pad merged in for the backend
+// and the mirrors, the application's report is never written. The application's controls and the pad's thus stay
+// apart, and a button released on the pad goes back to what the application set.
+
+#include "stdafx.h"
+#include "Private.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <thread>
+
+#ifdef _WIN32
+#include <timeapi.h>
+#endif
+
+using namespace vGenNS;
+
+#define PASS_AXES        6   // HID_USAGE_X to HID_USAGE_RZ, those of a pad
+#define PASS_DPAD_FIRST  12  // Gamepad buttons 12-19 are the dpad directions
+#define PASS_DPAD_LAST   19
+#define PASS_MIN_INTERVAL_US  1000
+#define PASS_MAX_INTERVAL_US  100000
+#define PASS_FIRST_PROBE_MS   16   // Wait before reading a slot found empty again; doubles up to EmptyProbeMs
+#define PASS_MIN_PROBE_MS     16
+#define PASS_MAX_PROBE_MS     60000
+
+// Under g_reportLock. Never copied: Pad points into it.
+struct PadPassthrough
+{
+	PassthroughConfig Config;
+	XINPUT_GAMEPAD Gamepad = {};   // Last state the reader stored
+	bool Connected = false;
+	DEVICE Pad = {};               // vgeXbox device over Gamepad, for Control_Get*()
+	LONG PadRest[PASS_AXES];       // Pad axes at rest
+	LONG Rest[PASS_AXES];          // Device axes after a reset
+	union
+	{
+		JOYSTICK_POSITION_V2 vJoy;
+		XINPUT_GAMEPAD xbox;
+		DS4_REPORT ds4;
+	} Merged;                      // Copy of the application's report that Pass_Merge() merges the pad into
+	DEVICE View = {};              // The device over Merged, for Control_*() and the backend
+};
+
+namespace {
+
+using PassClock = std::chrono::steady_clock;
+
+void Pass_GetAxes(const DEVICE & dev, LONG values[PASS_AXES])
+{
+	for (UINT i = 0; i < PASS_AXES; ++i) {
+		if (Control_GetAxis(dev, (HID_USAGES)(HID_USAGE_X + i), values[i]) != STATUS_SUCCESS)
+			values[i] = 0;
+	}
+}
+
+// Slots of vGen's own XBox devices, as the XInput user index their LED shows
+UINT Pass_OwnSlots(void)
+{
+	UINT slots = 0;
+	for (DevContainer_cit it = DevContainer_cref.cbegin(); it != DevContainer_cref.cend(); ++it) {
+		const DEVICE & dev = it->second;
+		const BYTE led = dev.DevInfo.LedNumber;
+		if ((dev.Type == DevType::vXbox || dev.Type == DevType::vgeXbox) && led >= 1 && led <= PASS_SLOTS)
+			slots |= 1 << (led - 1);
+	}
+	return slots;
+}
+
+class PadReader
+{
+public:
+	~PadReader()
+	{
+		// Pass_Stop() normally stopped the thread. Joining it here, under the loader lock, could dead-lock.
+		if (m_thread.joinable())
+			m_thread.detach();
+	}
+
+	// Under g_reportLock. A device started or changed its passthrough: compares every device on the next poll.
+	void Start()
+	{
+		m_fresh = true;
+		if (m_thread.joinable()) {
+			m_wake.notify_one();
+			return;
+		}
+		m_stop = false;
+		m_thread = std::thread(&PadReader::Run, this);
+	}
+
+	DWORD Configure(const PadPollConfig & config)
+	{
+		if (config.IntervalUs < PASS_MIN_INTERVAL_US || config.IntervalUs > PASS_MAX_INTERVAL_US ||
+			config.EmptyProbeMs < PASS_MIN_PROBE_MS || config.EmptyProbeMs > PASS_MAX_PROBE_MS)
+			return STATUS_INVALID_PARAMETER_1;
+
+		std::lock_guard<std::mutex> lock(g_reportLock);
+		m_config = config;
+		m_wake.notify_one();
+		return STATUS_SUCCESS;
+	}
+
+	// The snapshot of a slot. The first call for a slot reads it once and has the reader poll it from then on.
+	DWORD GetState(UINT slot, XINPUT_STATE & state)
+	{
+		if (slot >= PASS_SLOTS)
+			return STATUS_INVALID_PARAMETER_1;
+
+		if (!(m_watched.load(std::memory_order_acquire) >> slot & 1)) {
+			{
+				std::lock_guard<std::mutex> lock(g_reportLock);
+				m_watched.fetch_or(1 << slot);
+				Start();
+			}
+			XINPUT_STATE first = {};
+			const bool connected = Backend_Get()->PadState(slot, first) == STATUS_SUCCESS;
+			std::lock_guard<std::mutex> lock(m_snapLock);
+			if (!(m_polled >> slot & 1)) {
+				m_snapshot[slot] = first;
+				m_connected[slot] = connected;
+			}
+		}
+
+		std::lock_guard<std::mutex> lock(m_snapLock);
+		++m_stats.Served;
+		if (!m_connected[slot])
+			return STATUS_DEVICE_NOT_CONNECTED;
+		state = m_snapshot[slot];
+		return STATUS_SUCCESS;
+	}
+
+	void GetStats(PadPollStats & stats, bool reset)
+	{
+		std::lock_guard<std::mutex> lock(m_snapLock);
+		stats = m_stats;
+		stats.Connected = 0;
+		for (UINT slot = 0; slot < PASS_SLOTS; ++slot)
+			stats.Connected |= m_connected[slot] << slot;
+		if (reset)
+			m_stats = PadPollStats();
+	}
+
+	// The settings stay, for the next thread
+	void Stop()
+	{
+		{
+			std::lock_guard<std::mutex> lock(g_reportLock);
+			if (!m_thread.joinable())
+				return;
+			m_stop = true;
+			m_wake.notify_one();
+		}
+		m_thread.join();
+
+		m_watched = 0;
+		std::lock_guard<std::mutex> lock(m_snapLock);
+		m_polled = 0;
+		std::fill(std::begin(m_connected), std::end(m_connected), false);
+	}
+
+private:
+	void Run()
+	{
+#ifdef _WIN32
+		timeBeginPeriod(1);  // The default 15.6 ms scheduler tick is slower than any pad
+#endif
+		PassClock::time_point next = PassClock::now();
+		PassClock::time_point probeAt[PASS_SLOTS] = {};  // Next read of an empty slot
+		UINT backoffMs[PASS_SLOTS] = {};
+
+		std::unique_lock<std::mutex> lock(g_reportLock);
+		while (!m_stop) {
+			const UINT slots = Slots() | m_watched.load(std::memory_order_acquire);
+			if (!slots) {
+				m_wake.wait(lock);
+				next = PassClock::now();
+				continue;
+			}
+
+			// Nothing of the library is used while reading
+			DeviceBackend * backend = Backend_Get();
+			const UINT emptyProbeMs = m_config.EmptyProbeMs;
+			lock.unlock();
+			const PassClock::time_point start = PassClock::now();
+			XINPUT_STATE states[PASS_SLOTS] = {};
+			UINT read = 0, connected = 0, reads = 0, probes = 0, skipped = 0;
+			for (UINT slot = 0; slot < PASS_SLOTS; ++slot) {
+				if (!(slots >> slot & 1))
+					continue;
+				// An empty slot is read again after a wait that doubles up to emptyProbeMs
+				if (backoffMs[slot] && start < probeAt[slot]) {
+					++skipped;
+					continue;
+				}
+
+				read |= 1 << slot;
+				if (backoffMs[slot])
+					++probes;
+				else
+					++reads;
+				if (backend->PadState(slot, states[slot]) == STATUS_SUCCESS) {
+					connected |= 1 << slot;
+					backoffMs[slot] = 0;
+				}
+				else {
+					backoffMs[slot] = std::min(backoffMs[slot] ? backoffMs[slot] * 2 : PASS_FIRST_PROBE_MS, emptyProbeMs);
+					probeAt[slot] = start + std::chrono::milliseconds(backoffMs[slot]);
+				}
+			}
+			const bool changed = Publish(slots, read, connected, states, reads, probes, skipped);
+			lock.lock();
+
+			if (changed || m_fresh) {
+				m_fresh = false;
+				Apply();
+			}
+
+			// At a steady rate; a poll that came late doesn't make the next ones early
+			next += std::chrono::microseconds(m_config.IntervalUs);
+			const PassClock::time_point now = PassClock::now();
+			if (next < now)
+				next = now;
+			m_wake.wait_until(lock, next);
+		}
+#ifdef _WIN32
+		timeEndPeriod(1);
+#endif
+	}
+
+	// Under g_reportLock
+	UINT Slots()
+	{
+		UINT slots = 0;
+		for (DevContainer_cit it = DevContainer_cref.cbegin(); it != DevContainer_cref.cend(); ++it) {
+			const PadPassthrough * pass = it->second.Passthrough.get();
+			if (pass)
+				slots |= 1 << pass->Config.Slot;
+		}
+		return slots;
+	}
+
+	// Puts the slots read into the snapshot, and takes out those no longer polled; true if any of them changed
+	bool Publish(UINT slots, UINT read, UINT connected, const XINPUT_STATE states[PASS_SLOTS], UINT reads, UINT probes,
+		UINT skipped)
+	{
+		bool changed = false;
+		std::lock_guard<std::mutex> lock(m_snapLock);
+		for (UINT slot = 0; slot < PASS_SLOTS; ++slot) {
+			if (!(slots >> slot & 1) && (m_polled >> slot & 1)) {
+				m_connected[slot] = false;  // Read again by the first GetState() or passthrough that wants it
+				m_polled &= ~(1 << slot);
+				continue;
+			}
+			if (!(read >> slot & 1))
+				continue;
+			const bool now = connected >> slot & 1;
+			if (now != m_connected[slot] ||
+				(now && memcmp(&states[slot].Gamepad, &m_snapshot[slot].Gamepad, sizeof(XINPUT_GAMEPAD))))
+				changed = true;
+			m_connected[slot] = now;
+			if (now)
+				m_snapshot[slot] = states[slot];
+		}
+		m_polled |= read;
+		++m_stats.Polls;
+		m_stats.Reads += reads;
+		m_stats.Probes += probes;
+		m_stats.Skipped += skipped;
+		return changed;
+	}
+
+	// Under g_reportLock. Stores each device's slot state and sends the devices it changed.
+	void Apply()
+	{
+		XINPUT_GAMEPAD gamepads[PASS_SLOTS];
+		bool connected[PASS_SLOTS];
+		{
+			std::lock_guard<std::mutex> lock(m_snapLock);
+			for (UINT slot = 0; slot < PASS_SLOTS; ++slot) {
+				gamepads[slot] = m_snapshot[slot].Gamepad;
+				connected[slot] = m_connected[slot];
+			}
+		}
+
+		const UINT own = Pass_OwnSlots();
+		for (DevContainer_cit it = DevContainer_cref.cbegin(); it != DevContainer_cref.cend(); ++it) {
+			const PDEVICE pDev = GetDevice(it->first);
+			PadPassthrough * pass = pDev->Passthrough.get();
+			if (!pass)
+				continue;
+
+			const UINT slot = pass->Config.Slot;
+			const bool now = connected[slot] && !(own >> slot & 1);
+			if (now == pass->Connected && (!now || !memcmp(&pass->Gamepad, &gamepads[slot], sizeof(XINPUT_GAMEPAD))))
+				continue;
+
+			pass->Connected = now;
+			pass->Gamepad = now ? gamepads[slot] : XINPUT_GAMEPAD();
+			Backend_Submit(*pDev);
+		}
+	}
+
+	PadPollConfig m_config;                        // Under g_reportLock
+	bool m_fresh = false;                          // Under g_reportLock
+	bool m_stop = false;
+	std::atomic<UINT> m_watched {0};               // Slots GetXInputState() asked for
+	std::condition_variable m_wake;
+	std::thread m_thread;
+
+	std::mutex m_snapLock;                         // Never held with g_reportLock taken after it
+	XINPUT_STATE m_snapshot[PASS_SLOTS] = {};      // Under m_snapLock, valid while m_connected
+	bool m_connected[PASS_SLOTS] = {};             // Under m_snapLock
+	UINT m_polled = 0;                             // Under m_snapLock: slots the reader polls and read at least once
+	PadPollStats m_stats;                          // Under m_snapLock
+};
+
+PadReader g_padReader;
+
+}  // namespace
+
+DWORD Pass_Set(DEVICE & dev, const PassthroughConfig * config)
+{
+	const bool connected = dev.Passthrough && dev.Passthrough->Connected;
+	if (!config) {
+		dev.Passthrough.reset();
+		return connected ? Backend_Submit(dev) : STATUS_SUCCESS;
+	}
+	if (config->Slot >= PASS_SLOTS || (Pass_OwnSlots() >> config->Slot & 1) || config->Merge > MergeFeederFirst ||
+		config->Deadzone < 0)
+		return STATUS_INVALID_PARAMETER_2;
+
+	if (!dev.Passthrough) {
+		dev.Passthrough = std::make_shared<PadPassthrough>();
+		PadPassthrough & pass = *dev.Passthrough;
+		pass.Pad.Type = DevType::vgeXbox;
+		pass.Pad.PPosition.vXboxPos = &pass.Gamepad;
+		pass.Pad.Caps.Buttons = XINPUT_NUM_BUTTONS;
+		pass.Pad.Caps.DiscPovs = 1;
+		Pass_GetAxes(pass.Pad, pass.PadRest);
+
+		// The rest of the device's own axes, from a report reset on the side
+		pass.View.Type = dev.Type;
+		pass.View.Id = dev.Id;
+		pass.View.Caps = dev.Caps;
+		pass.View.PPosition.vJoyPos = &pass.Merged.vJoy;
+		Report_Reset(pass.View);
+		Pass_GetAxes(pass.View, pass.Rest);
+	}
+
+	// A new slot starts disconnected, until the reader reads it
+	PadPassthrough & pass = *dev.Passthrough;
+	if (config->Slot != pass.Config.Slot) {
+		pass.Connected = false;
+		pass.Gamepad = XINPUT_GAMEPAD();
+	}
+	pass.Config = *config;
+	g_padReader.Start();
+	return connected ? Backend_Submit(dev) : STATUS_SUCCESS;
+}
+
+const DEVICE * Pass_Merge(const DEVICE & dev)
+{
+	PadPassthrough & pass = *dev.Passthrough;
+	if (!pass.Connected)
+		return nullptr;
+	DEVICE & view = pass.View;
+	view.Caps = dev.Caps;  // A vJoy device has them once plugged in
+	memcpy(&pass.Merged, dev.PPosition.vJoyPos, GetDevicePosSize(dev));
+
+	const PassthroughMerge merge = pass.Config.Merge;
+	for (UINT i = 0; i < PASS_AXES; ++i) {
+		const HID_USAGES axis = (HID_USAGES)(HID_USAGE_X + i);
+		LONG pad, own;
+		if (Control_GetAxis(pass.Pad, axis, pad) != STATUS_SUCCESS || Control_GetAxis(dev, axis, own) != STATUS_SUCCESS)
+			continue;
+
+		LONG padOff = std::abs(pad - pass.PadRest[i]);
+		if (padOff <= pass.Config.Deadzone)
+			padOff = 0;
+		const LONG ownOff = std::abs(own - pass.Rest[i]);
+		const bool usePad = merge == MergePadFirst ? padOff > 0 : merge == MergeFeederFirst ? padOff && !ownOff : padOff > ownOff;
+		if (usePad)
+			Control_SetAxis(view, axis, pad);
+	}
+
+	// The dpad goes to POV 1 if the device has one, else to the buttons of the same numbers
+	const bool pov = dev.Caps.DiscPovs || dev.Caps.ContPovs;
+	DWORD padPov, ownPov;
+	if (pov && Control_GetPov(pass.Pad, 1, padPov) == STATUS_SUCCESS && Control_GetPov(dev, 1, ownPov) == STATUS_SUCCESS &&
+		padPov != (DWORD)-1 && (merge != MergeFeederFirst || ownPov == (DWORD)-1))
+		Control_SetPov(view, 1, padPov);
+
+	const UINT buttons = std::min<UINT>(XINPUT_NUM_BUTTONS, dev.Caps.Buttons);
+	for (UINT button = 1; button <= buttons; ++button) {
+		BOOL press;
+		if (pov && button >= PASS_DPAD_FIRST && button <= PASS_DPAD_LAST)
+			continue;
+		if (Report_GetButton(pass.Pad, button, press) == STATUS_SUCCESS && press)
+			Control_SetButton(view, button, TRUE);
+	}
+	return &view;
+}
+
+DWORD Pass_Configure(const PadPollConfig & config)
+{
+	return g_padReader.Configure(config);
+}
+
+DWORD Pass_GetState(UINT slot, XINPUT_STATE & state)
+{
+	return g_padReader.GetState(slot, state);
+}
+
+void Pass_GetStats(PadPollStats & stats, bool reset)
+{
+	g_padReader.GetStats(stats, reset);
+}
+
+void Pass_Stop(void)
+{
+	g_padReader.Stop();
+}
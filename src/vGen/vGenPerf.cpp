@@ -0,0 +1,220 @@
+// vGenPerf.cpp : Per-API call counters and latency histograms (GetPerfStats).
+//
+// Each thread that calls an instrumented export gets its own block of counters. Only the owning thread
+// writes to a block (relaxed load + store, no read-modify-write), GetPerfStats() sums the blocks.
+// Blocks of exited threads are kept with their counts and reused by the next new thread.
+
+#include "stdafx.h"
+#include "Private.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+using namespace vGenNS;
+
+std::atomic_bool g_perfEnabled {false};
+thread_local PerfThreadState t_perf;
+
+namespace {
+
+typedef std::atomic<ULONGLONG> PerfCounter;
+
+struct PerfHistCounters
+{
+	PerfCounter Count;
+	PerfCounter TotalNs;
+	PerfCounter MaxNs;
+	PerfCounter Buckets[PERF_HIST_BUCKETS];
+};
+
+struct PerfApiCounters
+{
+	PerfCounter Calls;
+	PerfCounter Errors;
+	PerfHistCounters Own;
+	PerfHistCounters Driver;
+};
+
+struct PerfBlock
+{
+	std::atomic<UINT> Generation {0};  // g_perfGeneration the counters belong to
+	std::atomic_bool InUse {false};
+	PerfApiCounters Api[PerfApiCount];
+};
+
+std::mutex g_perfLock;                             // g_perfBlocks, g_perfStart, g_perfStop
+std::vector<std::unique_ptr<PerfBlock>> g_perfBlocks;  // Never shrinks, blocks are reused
+std::atomic<UINT> g_perfGeneration {1};            // Bumped by EnablePerfStats(TRUE), makes all blocks stale
+PerfClock::time_point g_perfStart;
+PerfClock::time_point g_perfStop;                  // Valid while disabled
+
+thread_local PerfBlock * t_perfBlock = nullptr;
+
+// Returns the block to the pool when its thread exits.
+struct PerfBlockOwner
+{
+	~PerfBlockOwner()
+	{
+		if (t_perfBlock)
+			t_perfBlock->InUse.store(false, std::memory_order_release);
+	}
+};
+thread_local PerfBlockOwner t_perfBlockOwner;
+
+inline void Perf_Add(PerfCounter & counter, ULONGLONG value)
+{
+	counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+inline UINT Perf_Log2(ULONGLONG value)
+{
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanReverse64(&index, value);
+	return index;
+#else
+	return 63 - __builtin_clzll(value);
+#endif
+}
+
+inline UINT Perf_Bucket(ULONGLONG ns)
+{
+	if (ns < 64)
+		return (UINT)(ns / 16);
+
+	const UINT log2 = Perf_Log2(ns);
+	const UINT bucket = (log2 - 6) * 4 + 4 + (UINT)((ns >> (log2 - 2)) & 3);
+	return bucket < PERF_HIST_BUCKETS ? bucket : PERF_HIST_BUCKETS - 1;
+}
+
+void Perf_AddSample(PerfHistCounters & hist, ULONGLONG ns)
+{
+	Perf_Add(hist.Count, 1);
+	Perf_Add(hist.TotalNs, ns);
+	if (ns > hist.MaxNs.load(std::memory_order_relaxed))
+		hist.MaxNs.store(ns, std::memory_order_relaxed);
+	Perf_Add(hist.Buckets[Perf_Bucket(ns)], 1);
+}
+
+void Perf_ZeroHist(PerfHistCounters & hist)
+{
+	hist.Count.store(0, std::memory_order_relaxed);
+	hist.TotalNs.store(0, std::memory_order_relaxed);
+	hist.MaxNs.store(0, std::memory_order_relaxed);
+	for (PerfCounter & bucket : hist.Buckets)
+		bucket.store(0, std::memory_order_relaxed);
+}
+
+void Perf_SumHist(PerfHistogram & sum, const PerfHistCounters & hist)
+{
+	sum.Count += hist.Count.load(std::memory_order_relaxed);
+	sum.TotalNs += hist.TotalNs.load(std::memory_order_relaxed);
+	const ULONGLONG maxNs = hist.MaxNs.load(std::memory_order_relaxed);
+	if (maxNs > sum.MaxNs)
+		sum.MaxNs = maxNs;
+	for (UINT i = 0; i < PERF_HIST_BUCKETS; ++i)
+		sum.Buckets[i] += hist.Buckets[i].load(std::memory_order_relaxed);
+}
+
+PerfBlock * Perf_AcquireBlock()
+{
+	std::lock_guard<std::mutex> lock(g_perfLock);
+	for (const std::unique_ptr<PerfBlock> & block : g_perfBlocks) {
+		bool inUse = false;
+		if (block->InUse.compare_exchange_strong(inUse, true, std::memory_order_acquire))
+			return block.get();
+	}
+	g_perfBlocks.emplace_back(new PerfBlock);
+	g_perfBlocks.back()->InUse = true;
+	return g_perfBlocks.back().get();
+}
+
+// The calling thread's block, with the counters of the current generation
+PerfBlock * Perf_ThreadBlock()
+{
+	PerfBlock * block = t_perfBlock;
+	if (!block) {
+		(void)&t_perfBlockOwner;  // Registers the thread exit cleanup
+		block = t_perfBlock = Perf_AcquireBlock();
+	}
+
+	const UINT generation = g_perfGeneration.load(std::memory_order_acquire);
+	if (block->Generation.load(std::memory_order_relaxed) != generation) {
+		for (PerfApiCounters & api : block->Api) {
+			api.Calls.store(0, std::memory_order_relaxed);
+			api.Errors.store(0, std::memory_order_relaxed);
+			Perf_ZeroHist(api.Own);
+			Perf_ZeroHist(api.Driver);
+		}
+		block->Generation.store(generation, std::memory_order_release);
+	}
+	return block;
+}
+
+}  // namespace
+
+void Perf_Record(PerfApi api, ULONGLONG totalNs, ULONGLONG driverNs, bool driverCalled, DWORD result)
+{
+	if (api >= PerfApiCount)
+		return;
+
+	PerfApiCounters & counters = Perf_ThreadBlock()->Api[api];
+	Perf_Add(counters.Calls, 1);
+	if (result)
+		Perf_Add(counters.Errors, 1);
+	Perf_AddSample(counters.Own, totalNs > driverNs ? totalNs - driverNs : 0);
+	if (driverCalled)
+		Perf_AddSample(counters.Driver, driverNs);
+}
+
+void Perf_Sample(PerfHistogram & hist, ULONGLONG ns)
+{
+	++hist.Count;
+	hist.TotalNs += ns;
+	if (ns > hist.MaxNs)
+		hist.MaxNs = ns;
+	++hist.Buckets[Perf_Bucket(ns)];
+}
+
+DWORD Perf_Enable(BOOL enable)
+{
+	std::lock_guard<std::mutex> lock(g_perfLock);
+	if (enable) {
+		++g_perfGeneration;
+		g_perfStart = PerfClock::now();
+		g_perfEnabled = true;
+	}
+	else if (g_perfEnabled) {
+		g_perfEnabled = false;
+		g_perfStop = PerfClock::now();
+	}
+	return STATUS_SUCCESS;
+}
+
+DWORD Perf_GetStats(PerfStats * stats)
+{
+	*stats = PerfStats();
+
+	std::lock_guard<std::mutex> lock(g_perfLock);
+	if (g_perfStart == PerfClock::time_point())
+		return STATUS_SUCCESS;  // Never enabled
+
+	stats->ElapsedNs = Perf_Ns((g_perfEnabled ? PerfClock::now() : g_perfStop) - g_perfStart);
+
+	// A block whose thread did not record since the last reset still holds the previous generation
+	const UINT generation = g_perfGeneration.load(std::memory_order_acquire);
+	for (const std::unique_ptr<PerfBlock> & block : g_perfBlocks) {
+		if (block->Generation.load(std::memory_order_acquire) != generation)
+			continue;
+		for (UINT i = 0; i < PerfApiCount; ++i) {
+			const PerfApiCounters & counters = block->Api[i];
+			PerfApiStats & sum = stats->Api[i];
+			sum.Calls += counters.Calls.load(std::memory_order_relaxed);
+			sum.Errors += counters.Errors.load(std::memory_order_relaxed);
+			Perf_SumHist(sum.Own, counters.Own);
+			Perf_SumHist(sum.Driver, counters.Driver);
+		}
+	}
+	return STATUS_SUCCESS;
+}
@@ -5,22 +5,16 @@
 //#include <iostream>
 
 #include "stdafx.h"
-#include "public.h"
 #include "Private.h"
 
-#pragma comment(lib, "vJoyInterfaceStat.lib")
-#pragma comment(lib, "XOutputStatic_1_2.lib")
-#pragma comment(lib, "XInput")
-#pragma comment(lib, "setupapi.lib")
-
 using namespace vGenNS;
 
-////////  Globals  (the first 4 are imported as extern declarations in vGenInterface.cpp)
+////////  Globals  (the first 3 are imported as extern declarations in vGenInterface.cpp)
 
-PVIGEM_CLIENT VGE_Client = nullptr;
-std::atomic_bool g_isShuttingDown = false;
+std::atomic_bool g_isShuttingDown {false};
 DevContainer_t DevContainer;
 const DevContainer_t &DevContainer_cref = DevContainer;
+std::mutex g_reportLock;
 
 // Mapping the buttons to an array, dpad at end
 WORD g_xButtons[XINPUT_NUM_BUTTONS] = {
@@ -45,8 +39,6 @@ WORD g_xButtons[XINPUT_NUM_BUTTONS] = {
 	vGenNS::XBTN_DPAD_UP_LEFT
 };
 
-#define DS4_SPECIAL_BUTTON_FLAG  1 << 16
-
 DWORD g_ds4Buttons[DS4_NUM_BUTTONS] = {
 	DS4_BUTTON_CROSS,
 	DS4_BUTTON_CIRCLE,
@@ -72,1063 +64,726 @@ DWORD g_ds4Buttons[DS4_NUM_BUTTONS] = {
 	DS4_SPECIAL_BUTTON_TOUCHPAD | DS4_SPECIAL_BUTTON_FLAG,
 };
 
-#pragma region Internal vXbox
-
-DWORD	IX_isVBusExists(void)
-{
-	DWORD Version;
-	DWORD res = XOutputGetBusVersion(&Version);
-	return IX_ErrorToStatus(res);
-}
-
-DWORD	IX_GetNumEmptyBusSlots(UCHAR * nSlots)
-{
-	DWORD res = XOutputGetFreeSlots(1, nSlots);
-	return IX_ErrorToStatus(res);
-}
-
-DWORD	IX_isControllerPluggedIn(UINT UserIndex, PBOOL Exist)
-{
-	DWORD res = XOutputIsPluggedIn(UserIndex - 1, Exist);
-	return IX_ErrorToStatus(res);
-}
+#pragma region Report Conversion
 
-BOOL	IX_isControllerPluggedIn(HDEVICE hDev)
+DWORD	Report_SetButton(DEVICE & dev, UINT Button, BOOL Press, BOOL XInput)
 {
-	UINT UserIndex = GetDeviceId(hDev);
-	if (!UserIndex)
-		return FALSE;
+	if (dev.Type == DevType::vJoy) {
+		if (!Button || Button > dev.Caps.Buttons)
+			return STATUS_UNSUCCESSFUL;
 
-	BOOL Exist;
-	return XOutputIsPluggedIn(UserIndex - 1, &Exist) == ERROR_SUCCESS && Exist;
-}
-
-DWORD	IX_isControllerOwned(UINT UserIndex, PBOOL Owned)
-{
-	DWORD res = XOutputIsOwned(UserIndex - 1, Owned);
-	return IX_ErrorToStatus(res);
-}
-
-BOOL	IX_isControllerOwned(HDEVICE hDev)
-{
-	BOOL Owned;
-	if (!hDev)
-		return FALSE;
-
-	UINT UserIndex = GetDeviceId(hDev);
-	if (!UserIndex)
-		return FALSE;
+		// 32 buttons per field
+		LONG * const fields[] = {
+			&dev.PPosition.vJoyPos->lButtons, &dev.PPosition.vJoyPos->lButtonsEx1,
+			&dev.PPosition.vJoyPos->lButtonsEx2, &dev.PPosition.vJoyPos->lButtonsEx3,
+		};
+		LONG & buttons = *fields[(Button - 1) / 32];
+		const LONG Mask = (LONG)(1UL << ((Button - 1) % 32));
+		if (Press)
+			buttons |= Mask;
+		else
+			buttons &= ~Mask;
+		return STATUS_SUCCESS;
+	}
 
-	if (ERROR_SUCCESS == XOutputIsOwned(UserIndex - 1, &Owned))
-		return Owned;
+	DWORD Mask;
+	if (XInput)
+		Mask = Button;
+	else if ((dev.Type == DevType::vXbox || dev.Type == DevType::vgeXbox) && Button >= 1 && Button <= XINPUT_NUM_BUTTONS)
+		Mask = g_xButtons[Button - 1];
+	else if (dev.Type == DevType::vgeDS4 && Button >= 1 && Button <= DS4_NUM_BUTTONS)
+		Mask = g_ds4Buttons[Button - 1];
 	else
-		return FALSE;
-}
-
-DWORD	IX_PlugIn(UINT UserIndex)
-{
-	// Test is it is possible to Plug-In
-	BOOL Exist;
-	DWORD res;
-
-	res = IX_isControllerPluggedIn(UserIndex, &Exist);
-	if (res != ERROR_SUCCESS)
-		return IX_ErrorToStatus(res);
-	if (Exist)
-		return STATUS_DEVICE_ALREADY_ATTACHED;
-
-	// Plug-in
-	res = XOutputPlugIn(UserIndex - 1);
-	if (res != ERROR_SUCCESS)
-		return IX_ErrorToStatus(res);
-
-	// Wait for device to start - try up to 2 seconds
-	BYTE Led;
-	for (int i = 0; i < 2000; i++)
-	{
-		res = XoutputGetLedNumber(UserIndex - 1, &Led);
-
-		// If device not ready then wait and try again
-		if (res == XOUTPUT_VBUS_DEVICE_NOT_READY)
-		{
-			Sleep(1);
-			continue;
-		}
-
-		// Device is ready or error occured
-		break;
-	}
+		return STATUS_INVALID_PARAMETER_3;
 
-	// If still not ready
-	if (res == XOUTPUT_VBUS_DEVICE_NOT_READY)
-		return STATUS_DEVICE_NOT_READY;
-
-	// Create the device data structure and insert it into the device-container
-	if (HDEVICE hDev = CreateDevice(vXbox, UserIndex)) {
-		PDEVICE pDev = GetDevice(hDev);
-		pDev->DevInfo.LedNumber = Led;
-		DWORD serial;
-		if (XOutputGetRealUserIndex(UserIndex - 1, &serial) == STATUS_SUCCESS)
-			pDev->DevInfo.Serial = serial;
+	if (dev.Type == DevType::vXbox || dev.Type == DevType::vgeXbox) {
+		PXINPUT_GAMEPAD position = dev.PPosition.vXboxPos;
+		if (Press)
+			position->wButtons |= (WORD)Mask;
+		else
+			position->wButtons &= ~(WORD)Mask;
 		return STATUS_SUCCESS;
 	}
 
-	// Failed to create device
-	XOutputUnPlug(UserIndex - 1);
-	return STATUS_INVALID_HANDLE;
-
-}
-
-DWORD	IX_PlugInNext(UINT * UserIndex)
-{
-	// Look for an empty slot
-	BOOL Exist;
-	UINT i = 0;
-	DWORD res;
-	do {
-		res = IX_isControllerPluggedIn(++i, &Exist);
-		if (!Exist)
-		{
-			*UserIndex = i;
-			break;
-		}
-	} while (res == STATUS_SUCCESS);
-
-	// Slot not found?
-	if (res != STATUS_SUCCESS)
-		return res;
-
-	// Found, now plugin
-	return IX_PlugIn(i);
-}
-
-DWORD	IX_UnPlug(UINT UserIndex)
-{
-	DWORD res;
-
-	// Owned?
-	BOOL Owned;
-	res = IX_isControllerOwned(UserIndex, &Owned);
-	if (res != STATUS_SUCCESS)
-		return res;
-	if (!Owned)
-		return STATUS_RESOURCE_NOT_OWNED;
+	if (dev.Type != DevType::vgeDS4)
+		return STATUS_INVALID_HANDLE;
 
-	// Unplug
-	res = XOutputUnPlug(UserIndex - 1);
-	res = IX_ErrorToStatus(res);
+	// DS4 dpad buttons are directions, not bits
+	if (Mask <= XBTN_DPAD_MASK)
+		return Report_SetDpad(dev, (USHORT)(Press ? Mask : DS4_BUTTON_DPAD_NONE));
 
-	// Wait for device to be unplugged
-	for (int i = 0; i < 2000; i++)
-	{
-		if (!IX_isControllerPluggedIn(UserIndex))
-			break;
-		Sleep(2);
+	PDS4_REPORT position = dev.PPosition.ds4Pos;
+	// special buttons?
+	if (Mask & DS4_SPECIAL_BUTTON_FLAG) {
+		if (Press)
+			position->bSpecial |= (BYTE)Mask;
+		else
+			position->bSpecial &= ~(BYTE)Mask;
 	}
-
-	//Sleep(1000); // Temporary - replace with detection code
-
-	// If still exists - error
-	if (IX_isControllerPluggedIn(UserIndex))
-		return STATUS_TIMEOUT;
-
-	// Get handle to device and destroy it
-	HDEVICE hDev = GetDeviceHandle(vXbox, UserIndex);
-	DestroyDevice(hDev);
-	return res;
-}
-
-DWORD	IX_UnPlugForce(UINT UserIndex)
-{
-	DWORD res;
-	BOOL Exist;
-
-	// Exists?
-	res = IX_isControllerPluggedIn(UserIndex, &Exist);
-	if (res != STATUS_SUCCESS)
-		return res;
-	if (!Exist)
-		return STATUS_SUCCESS; // STATUS_DEVICE_DOES_NOT_EXIST;
-
-	// Unplug
-	res = XOutputUnPlugForce(UserIndex - 1);
-	if (res != ERROR_SUCCESS)
-		return IX_ErrorToStatus(res);
-
-	// Wait for device to be unplugged
-	for (int i = 0; i < 2000; i++)
-	{
-		if (!IX_isControllerPluggedIn(UserIndex))
-			break;
-		Sleep(2);
+	// normal buttons
+	else {
+		if (Press)
+			position->wButtons |= (WORD)Mask;
+		else
+			position->wButtons &= ~(WORD)Mask;
 	}
-
-	//Sleep(1000); // Temporary - replace with detection code
-
-	// If still exists - error
-	if (IX_isControllerPluggedIn(UserIndex))
-		return STATUS_TIMEOUT;
-
-
-	// Get handle to device and destroy it
-	HDEVICE h = GetDeviceHandle(vXbox, UserIndex);
-	DestroyDevice(h);
 	return STATUS_SUCCESS;
 }
 
-// IX Reset                        ////////////////////////////////////////////////////////
-
-DWORD	IX_ResetController(HDEVICE hDev)
-{
-	const PDEVICE pDev = GetDevice(hDev);
-	if (!pDev || !pDev->Id)
-		return STATUS_INVALID_HANDLE;
-	if (!pDev->PPosition.vXboxPos)
-		return STATUS_MEMORY_NOT_ALLOCATED;
-
-	memset(pDev->PPosition.vXboxPos, 0, sizeof(XINPUT_GAMEPAD));
-	DWORD res = XOutputSetState(pDev->Id - 1, pDev->PPosition.vXboxPos);
-	return IX_ErrorToStatus(res);
-}
-
-DWORD	IX_ResetController(UINT UserIndex)
-{
-	return IX_ResetController(GetDeviceHandle(vXbox, UserIndex));
-}
-
-DWORD	IX_ResetAllControllers()
-{
-	DWORD res[4] = {0};
-	res[0] = IX_ResetController((UINT)1);
-	res[1] = IX_ResetController((UINT)2);
-	res[2] = IX_ResetController((UINT)3);
-	res[3] = IX_ResetController((UINT)4);
-
-	for (int i = 0; i < 4; i++)
-		if (res[i] != STATUS_SUCCESS)
-			return res[i];
-	return STATUS_SUCCESS;
-}
-
-DWORD	IX_ResetControllerBtns(HDEVICE hDev)
-{
-	const PDEVICE pDev = GetDevice(hDev);
-	if (!pDev || !pDev->Id)
-		return STATUS_INVALID_HANDLE;
-	if (!pDev->PPosition.vXboxPos)
-		return STATUS_MEMORY_NOT_ALLOCATED;
-
-	// Change position value
-	pDev->PPosition.vXboxPos->wButtons &= XBTN_DPAD_MASK;
-	const DWORD res = XOutputSetState(pDev->Id - 1, pDev->PPosition.vXboxPos);
-	return IX_ErrorToStatus(res);
-}
-
-DWORD	IX_ResetControllerBtns(UINT UserIndex)
-{
-	return IX_ResetControllerBtns(GetDeviceHandle(vXbox, UserIndex));
-}
-
-DWORD	IX_ResetControllerDPad(HDEVICE hDev)
-{
-	const PDEVICE pDev = GetDevice(hDev);
-	if (!pDev || !pDev->Id)
-		return STATUS_INVALID_HANDLE;
-	if (!pDev->PPosition.vXboxPos)
-		return STATUS_MEMORY_NOT_ALLOCATED;
-
-	// Change position value
-	pDev->PPosition.vXboxPos->wButtons &= ~XBTN_DPAD_MASK;
-	const DWORD res = XOutputSetState(pDev->Id - 1, pDev->PPosition.vXboxPos);
-	return IX_ErrorToStatus(res);
-}
-
-DWORD	IX_ResetControllerDPad(UINT UserIndex)
-{
-	return IX_ResetControllerDPad(GetDeviceHandle(vXbox, UserIndex));
-}
-
-// IX Buttons                        ////////////////////////////////////////////////////////
-
-DWORD	IX_SetBtn(const PDEVICE pDev, BOOL Press, WORD Button, BOOL XInput)
-{
-	if (!pDev)
-		return STATUS_INVALID_HANDLE;
-
-	// Get  position
-	PXINPUT_GAMEPAD position = pDev->PPosition.vXboxPos;
-	if (!position)
-		return STATUS_MEMORY_NOT_ALLOCATED;
-
-	WORD Mask;
-	if (!XInput && Button <= XINPUT_NUM_BUTTONS)
-		Mask = g_xButtons[Button - 1];
-	else
-		Mask = Button;
-
-	// Change position value
-	if (Press)
-		position->wButtons |= Mask;
-	else
-		position->wButtons &= ~Mask;
-	const DWORD res = XOutputSetState(pDev->Id - 1, position);
-	return IX_ErrorToStatus(res);
-}
-
-#ifdef SPECIFICBUTTONS
-BOOL	IX_SetBtnA(HDEVICE hDev, BOOL Press)
-{
-	return IX_SetBtn(hDev, Press, XINPUT_GAMEPAD_A);
-}
-
-BOOL	IX_SetBtnB(HDEVICE hDev, BOOL Press)
-{
-	return IX_SetBtn(hDev, Press, XINPUT_GAMEPAD_B);
-}
-
-BOOL	IX_SetBtnX(HDEVICE hDev, BOOL Press)
-{
-	return IX_SetBtn(hDev, Press, XINPUT_GAMEPAD_X);
-}
-
-BOOL	IX_SetBtnY(HDEVICE hDev, BOOL Press)
-{
-	return IX_SetBtn(hDev, Press, XINPUT_GAMEPAD_Y);
-}
-
-BOOL	IX_SetBtnStart(HDEVICE hDev, BOOL Press)
-{
-	return IX_SetBtn(hDev, Press, XINPUT_GAMEPAD_START);
-}
-
-BOOL	IX_SetBtnBack(HDEVICE hDev, BOOL Press)
-{
-	return IX_SetBtn(hDev, Press, XINPUT_GAMEPAD_BACK);
-}
-
-BOOL	IX_SetBtnLT(HDEVICE hDev, BOOL Press) // Left Thumb/Stick
-{
-	return IX_SetBtn(hDev, Press, XINPUT_GAMEPAD_LEFT_THUMB);
-}
-
-BOOL	IX_SetBtnRT(HDEVICE hDev, BOOL Press) // Right Thumb/Stick
-{
-	return IX_SetBtn(hDev, Press, XINPUT_GAMEPAD_RIGHT_THUMB);
-}
-
-BOOL	IX_SetBtnLB(HDEVICE hDev, BOOL Press) // Left Bumper
-{
-	return IX_SetBtn(hDev, Press, XINPUT_GAMEPAD_LEFT_SHOULDER);
-}
-
-BOOL	IX_SetBtnRB(HDEVICE hDev, BOOL Press) // Right Bumper
-{
-	return IX_SetBtn(hDev, Press, XINPUT_GAMEPAD_RIGHT_SHOULDER);
-}
-
-BOOL	IX_SetBtnA(UINT UserIndex, BOOL Press)
-{
-	return IX_SetBtn(UserIndex, Press, XINPUT_GAMEPAD_A);
-}
-
-BOOL	IX_SetBtnB(UINT UserIndex, BOOL Press)
-{
-	return IX_SetBtn(UserIndex, Press, XINPUT_GAMEPAD_B);
-}
-
-BOOL	IX_SetBtnX(UINT UserIndex, BOOL Press)
-{
-	return IX_SetBtn(UserIndex, Press, XINPUT_GAMEPAD_X);
-}
-
-BOOL	IX_SetBtnY(UINT UserIndex, BOOL Press)
+// The inverse of Report_SetButton() for button numbers. A dpad button is pressed when the dpad is in its direction.
+DWORD	Report_GetButton(const DEVICE & dev, UINT Button, BOOL & Press)
 {
-	return IX_SetBtn(UserIndex, Press, XINPUT_GAMEPAD_Y);
-}
-
-BOOL	IX_SetBtnStart(UINT UserIndex, BOOL Press)
-{
-	return IX_SetBtn(UserIndex, Press, XINPUT_GAMEPAD_START);
-}
-
-BOOL	IX_SetBtnBack(UINT UserIndex, BOOL Press)
-{
-	return IX_SetBtn(UserIndex, Press, XINPUT_GAMEPAD_BACK);
-}
+	if (dev.Type == DevType::vJoy) {
+		if (!Button || Button > dev.Caps.Buttons)
+			return STATUS_UNSUCCESSFUL;
 
-BOOL	IX_SetBtnLT(UINT UserIndex, BOOL Press) // Left Thumb/Stick
-{
-	return IX_SetBtn(UserIndex, Press, XINPUT_GAMEPAD_LEFT_THUMB);
-}
+		const LONG fields[] = {
+			dev.PPosition.vJoyPos->lButtons, dev.PPosition.vJoyPos->lButtonsEx1,
+			dev.PPosition.vJoyPos->lButtonsEx2, dev.PPosition.vJoyPos->lButtonsEx3,
+		};
+		Press = (fields[(Button - 1) / 32] >> ((Button - 1) % 32)) & 1;
+		return STATUS_SUCCESS;
+	}
 
-BOOL	IX_SetBtnRT(UINT UserIndex, BOOL Press) // Right Thumb/Stick
-{
-	return IX_SetBtn(UserIndex, Press, XINPUT_GAMEPAD_RIGHT_THUMB);
-}
+	if ((dev.Type == DevType::vXbox || dev.Type == DevType::vgeXbox) && Button >= 1 && Button <= XINPUT_NUM_BUTTONS) {
+		const WORD Mask = g_xButtons[Button - 1];
+		Press = (dev.PPosition.vXboxPos->wButtons & Mask) == Mask;
+		return STATUS_SUCCESS;
+	}
 
-BOOL	IX_SetBtnLB(UINT UserIndex, BOOL Press) // Left Bumper
-{
-	return IX_SetBtn(UserIndex, Press, XINPUT_GAMEPAD_LEFT_SHOULDER);
-}
+	if (dev.Type == DevType::vgeDS4 && Button >= 1 && Button <= DS4_NUM_BUTTONS) {
+		const DWORD Mask = g_ds4Buttons[Button - 1];
+		const DS4_REPORT * position = dev.PPosition.ds4Pos;
+		if (Mask <= XBTN_DPAD_MASK)
+			Press = (DWORD)(position->wButtons & XBTN_DPAD_MASK) == Mask;
+		else if (Mask & DS4_SPECIAL_BUTTON_FLAG)
+			Press = (position->bSpecial & (BYTE)Mask) != 0;
+		else
+			Press = (position->wButtons & (WORD)Mask) != 0;
+		return STATUS_SUCCESS;
+	}
 
-BOOL	IX_SetBtnRB(UINT UserIndex, BOOL Press) // Right Bumper
-{
-	return IX_SetBtn(UserIndex, Press, XINPUT_GAMEPAD_RIGHT_SHOULDER);
+	return dev.Type == DevType::vJoy || dev.Type == DevType::vXbox || dev.Type == DevType::vgeXbox || dev.Type == DevType::vgeDS4 ?
+		STATUS_INVALID_PARAMETER_2 : STATUS_INVALID_HANDLE;
 }
 
-#endif // SPECIFICBUTTONS
-
-// IX Axis                //////////////////////////////////////////////
-
-DWORD	IX_SetAxis(const PDEVICE pDev, HID_USAGES Axis, SHORT Value)
+// This lets any of the 4 dpov button bits be set at any one time but will not allow
+// individual bits to be set one at a time, like you get with the actual "button" types.
+// Subsequent calls to this function will clear any previously set DPOV button bits (0xF)
+DWORD	Report_SetDpad(DEVICE & dev, USHORT Value)
 {
-	if (!pDev)
-		return STATUS_INVALID_HANDLE;
-
-	// Get  position
-	PXINPUT_GAMEPAD position = pDev->PPosition.vXboxPos;
-	if (!position)
-		return STATUS_MEMORY_NOT_ALLOCATED;
-
-	// Change position value
-	switch (Axis) {
-		case HID_USAGE_LT:
-			position->bLeftTrigger = Value & 0xFF;
-			break;
-		case HID_USAGE_RT:
-			position->bRightTrigger = Value & 0xFF;
-			break;
-		case HID_USAGE_LX:
-			position->sThumbLX = Value;
-			break;
-		case HID_USAGE_LY:
-			position->sThumbLY = Value;
-			break;
-		case HID_USAGE_RX:
-			position->sThumbRX = Value;
+	USHORT * buttons;
+	switch (dev.Type) {
+		case DevType::vXbox:
+		case DevType::vgeXbox:
+			buttons = &dev.PPosition.vXboxPos->wButtons;
 			break;
-		case HID_USAGE_RY:
-			position->sThumbRY = Value;
+		case DevType::vgeDS4:
+			buttons = &dev.PPosition.ds4Pos->wButtons;
 			break;
 		default:
-			return STATUS_INVALID_PARAMETER_2;
-	};
-
-	const DWORD res = XOutputSetState(pDev->Id - 1, position);
-	return IX_ErrorToStatus(res);
-}
-
-#ifdef SPECIFICBUTTONS
-DWORD	IX_SetTriggerL(HDEVICE hDev, BYTE Value) // Left Trigger
-{
-	return IX_SetAxis(hDev, HID_USAGE_LT, Value);
-}
-
-DWORD	IX_SetTriggerL(UINT UserIndex, BYTE Value) // Left Trigger
-{
-	return IX_SetTriggerL(GetDeviceHandle(vXbox, UserIndex), Value);
-}
-
-DWORD	IX_SetTriggerR(HDEVICE hDev, BYTE Value) // Right Trigger
-{
-	return IX_SetAxis(hDev, HID_USAGE_RT, Value);
-}
-
-DWORD	IX_SetTriggerR(UINT UserIndex, BYTE Value) // Right Trigger
-{
-	return IX_SetTriggerR(GetDeviceHandle(vXbox, UserIndex), Value);
-}
-
-DWORD	IX_SetAxisLx(HDEVICE hDev, SHORT Value) // Left Stick X
-{
-	return IX_SetAxis(hDev, HID_USAGE_LX, Value);
-}
-
-DWORD	IX_SetAxisLx(UINT UserIndex, SHORT Value) // Left Stick X
-{
-	return IX_SetAxisLx(GetDeviceHandle(vXbox, UserIndex), Value);
-}
+			return STATUS_INVALID_HANDLE;
+	}
 
-DWORD	IX_SetAxisLy(HDEVICE hDev, SHORT Value) // Left Stick Y
-{
-	return IX_SetAxis(hDev, HID_USAGE_LY, Value);
+	*buttons &= ~XBTN_DPAD_MASK;
+	*buttons |= Value & XBTN_DPAD_MASK;
+	return STATUS_SUCCESS;
 }
 
-DWORD	IX_SetAxisLy(UINT UserIndex, SHORT Value) // Left Stick Y
+DWORD	Report_SetAxis(DEVICE & dev, HID_USAGES Axis, LONG Value)
 {
-	return IX_SetAxisLy(GetDeviceHandle(vXbox, UserIndex), Value);
-}
+	if (dev.Type == DevType::vJoy) {
+		if (!dev.Caps.HasAxis(Axis))
+			return STATUS_UNSUCCESSFUL;
 
-DWORD	IX_SetAxisRx(HDEVICE hDev, SHORT Value) // Right Stick X
-{
-	return IX_SetAxis(hDev, HID_USAGE_RX, Value);
-}
+		PJOYSTICK_POSITION_V2 position = dev.PPosition.vJoyPos;
+		switch (Axis) {
+			case HID_USAGE_X:
+				position->wAxisX = Value;
+				break;
+			case HID_USAGE_Y:
+				position->wAxisY = Value;
+				break;
+			case HID_USAGE_Z:
+				position->wAxisZ = Value;
+				break;
+			case HID_USAGE_RX:
+				position->wAxisXRot = Value;
+				break;
+			case HID_USAGE_RY:
+				position->wAxisYRot = Value;
+				break;
+			case HID_USAGE_RZ:
+				position->wAxisZRot = Value;
+				break;
+			case HID_USAGE_SL0:
+				position->wSlider = Value;
+				break;
+			case HID_USAGE_SL1:
+				position->wDial = Value;
+				break;
+			case HID_USAGE_WHL:
+				position->wWheel = Value;
+				break;
+			default:
+				return STATUS_UNSUCCESSFUL;
+		}
+		return STATUS_SUCCESS;
+	}
 
-DWORD	IX_SetAxisRx(UINT UserIndex, SHORT Value) // Right Stick X
-{
-	return IX_SetAxisRx(GetDeviceHandle(vXbox, UserIndex), Value);
-}
+	if (dev.Type == DevType::vXbox || dev.Type == DevType::vgeXbox) {
+		PXINPUT_GAMEPAD position = dev.PPosition.vXboxPos;
+		switch (Axis) {
+			case HID_USAGE_LT:
+				position->bLeftTrigger = Value & 0xFF;
+				break;
+			case HID_USAGE_RT:
+				position->bRightTrigger = Value & 0xFF;
+				break;
+			case HID_USAGE_LX:
+				position->sThumbLX = (SHORT)Value;
+				break;
+			case HID_USAGE_LY:
+				position->sThumbLY = (SHORT)Value;
+				break;
+			case HID_USAGE_RX:
+				position->sThumbRX = (SHORT)Value;
+				break;
+			case HID_USAGE_RY:
+				position->sThumbRY = (SHORT)Value;
+				break;
+			default:
+				return STATUS_INVALID_PARAMETER_2;
+		};
+		return STATUS_SUCCESS;
+	}
 
-DWORD	IX_SetAxisRy(HDEVICE hDev, SHORT Value) // Right Stick Y
-{
-	return IX_SetAxis(hDev, HID_USAGE_RY, Value);
-}
+	if (dev.Type == DevType::vgeDS4) {
+		PDS4_REPORT position = dev.PPosition.ds4Pos;
+		const BYTE bValue = Value & 0xFF;
+		switch (Axis) {
+			case HID_USAGE_LT:
+				position->bTriggerL = bValue;
+				break;
+			case HID_USAGE_RT:
+				position->bTriggerR = bValue;
+				break;
+			case HID_USAGE_LX:
+				position->bThumbLX = bValue;
+				break;
+			case HID_USAGE_LY:
+				position->bThumbLY = bValue;
+				break;
+			case HID_USAGE_RX:
+				position->bThumbRX = bValue;
+				break;
+			case HID_USAGE_RY:
+				position->bThumbRY = bValue;
+				break;
+			default:
+				return STATUS_INVALID_PARAMETER_2;
+		};
+		return STATUS_SUCCESS;
+	}
 
-DWORD	IX_SetAxisRy(UINT UserIndex, SHORT Value) // Right Stick Y
-{
-	return IX_SetAxisRy(GetDeviceHandle(vXbox, UserIndex), Value);
+	return STATUS_INVALID_HANDLE;
 }
-#endif // SPECIFICBUTTONS
 
-// IX DPAD               ///////////////////////////////////////
-
-// This lets any of the 4 dpov button bits be set at any one time but will not allow
-// individual bits to be set one at a time, like you get with the actual "button" types.
-// Subsequent calls to this function will clear any previously set DPOV button bits (0xF)
-DWORD	IX_SetDpad(const PDEVICE pDev, UCHAR Value)
+DWORD	Report_GetAxis(const DEVICE & dev, HID_USAGES Axis, LONG & Value)
 {
-	if (!pDev)
-		return STATUS_INVALID_HANDLE;
+	if (dev.Type == DevType::vJoy) {
+		if (!dev.Caps.HasAxis(Axis))
+			return STATUS_UNSUCCESSFUL;
 
-	// Get  position
-	PXINPUT_GAMEPAD position = pDev->PPosition.vXboxPos;
-	if (!position)
-		return STATUS_MEMORY_NOT_ALLOCATED;
+		const JOYSTICK_POSITION_V2 * position = dev.PPosition.vJoyPos;
+		switch (Axis) {
+			case HID_USAGE_X:   Value = position->wAxisX; break;
+			case HID_USAGE_Y:   Value = position->wAxisY; break;
+			case HID_USAGE_Z:   Value = position->wAxisZ; break;
+			case HID_USAGE_RX:  Value = position->wAxisXRot; break;
+			case HID_USAGE_RY:  Value = position->wAxisYRot; break;
+			case HID_USAGE_RZ:  Value = position->wAxisZRot; break;
+			case HID_USAGE_SL0: Value = position->wSlider; break;
+			case HID_USAGE_SL1: Value = position->wDial; break;
+			case HID_USAGE_WHL: Value = position->wWheel; break;
+			default:
+				return STATUS_UNSUCCESSFUL;
+		}
+		return STATUS_SUCCESS;
+	}
 
-	// Change position value
-	position->wButtons &= ~XBTN_DPAD_MASK;
-	position->wButtons |= Value;
-	const DWORD res = XOutputSetState(pDev->Id - 1, position);
-	return IX_ErrorToStatus(res);
-}
+	if (dev.Type == DevType::vXbox || dev.Type == DevType::vgeXbox) {
+		const XINPUT_GAMEPAD * position = dev.PPosition.vXboxPos;
+		switch (Axis) {
+			case HID_USAGE_LT: Value = position->bLeftTrigger; break;
+			case HID_USAGE_RT: Value = position->bRightTrigger; break;
+			case HID_USAGE_LX: Value = position->sThumbLX; break;
+			case HID_USAGE_LY: Value = position->sThumbLY; break;
+			case HID_USAGE_RX: Value = position->sThumbRX; break;
+			case HID_USAGE_RY: Value = position->sThumbRY; break;
+			default:
+				return STATUS_INVALID_PARAMETER_2;
+		}
+		return STATUS_SUCCESS;
+	}
 
-#ifdef SPECIFICBUTTONS
-BOOL	IX_SetDpadUp(HDEVICE hDev)
-{
-	return IX_SetDpad(hDev, XBTN_DPAD_UP);
-}
+	if (dev.Type == DevType::vgeDS4) {
+		const DS4_REPORT * position = dev.PPosition.ds4Pos;
+		switch (Axis) {
+			case HID_USAGE_LT: Value = position->bTriggerL; break;
+			case HID_USAGE_RT: Value = position->bTriggerR; break;
+			case HID_USAGE_LX: Value = position->bThumbLX; break;
+			case HID_USAGE_LY: Value = position->bThumbLY; break;
+			case HID_USAGE_RX: Value = position->bThumbRX; break;
+			case HID_USAGE_RY: Value = position->bThumbRY; break;
+			default:
+				return STATUS_INVALID_PARAMETER_2;
+		}
+		return STATUS_SUCCESS;
+	}
 
-BOOL	IX_SetDpadUp(UINT UserIndex)
-{
-	return IX_SetDpad(UserIndex, XBTN_DPAD_UP);
+	return STATUS_INVALID_HANDLE;
 }
 
-BOOL	IX_SetDpadRight(HDEVICE hDev)
+// Discrete POV n is nibble n-1 of bHats, 0xF is centered
+DWORD	Report_SetDiscPov(DEVICE & dev, UCHAR nPov, int Value)
 {
-	return IX_SetDpad(hDev, XBTN_DPAD_RIGHT);
-}
+	if (dev.Type != DevType::vJoy)
+		return STATUS_INVALID_HANDLE;
+	if (!nPov || nPov > dev.Caps.DiscPovs || Value < DPOV_Center || Value > DPOV_West)
+		return STATUS_UNSUCCESSFUL;
 
-BOOL	IX_SetDpadRight(UINT UserIndex)
-{
-	return IX_SetDpad(UserIndex, XBTN_DPAD_RIGHT);
+	const UINT shift = (nPov - 1) * 4;
+	DWORD & hats = dev.PPosition.vJoyPos->bHats;
+	hats = (hats & ~(0xFUL << shift)) | ((DWORD)(Value & 0xF) << shift);
+	return STATUS_SUCCESS;
 }
 
-BOOL	IX_SetDpadDown(HDEVICE hDev)
+// Continuous POV n is bHats, bHatsEx1, bHatsEx2 or bHatsEx3
+DWORD	Report_SetContPov(DEVICE & dev, UCHAR nPov, DWORD Value)
 {
-	return IX_SetDpad(hDev, XBTN_DPAD_DOWN);
-}
+	if (dev.Type != DevType::vJoy)
+		return STATUS_INVALID_HANDLE;
+	if (!nPov || nPov > dev.Caps.ContPovs || (Value > 35999 && Value != (DWORD)-1))
+		return STATUS_UNSUCCESSFUL;
 
-BOOL	IX_SetDpadDown(UINT UserIndex)
-{
-	return IX_SetDpad(UserIndex, XBTN_DPAD_DOWN);
+	DWORD * const hats[] = {
+		&dev.PPosition.vJoyPos->bHats, &dev.PPosition.vJoyPos->bHatsEx1,
+		&dev.PPosition.vJoyPos->bHatsEx2, &dev.PPosition.vJoyPos->bHatsEx3,
+	};
+	*hats[nPov - 1] = Value;
+	return STATUS_SUCCESS;
 }
 
-BOOL	IX_SetDpadLeft(HDEVICE hDev)
+void	Report_Reset(DEVICE & dev)
 {
-	return IX_SetDpad(hDev, XBTN_DPAD_LEFT);
+	switch (dev.Type) {
+		case DevType::vJoy:
+			IJ_JoystickReportInit(dev.PPosition.vJoyPos);
+			dev.PPosition.vJoyPos->bDevice = (BYTE)dev.Id;
+			break;
+		case DevType::vXbox:
+		case DevType::vgeXbox:
+			RtlZeroMemory(dev.PPosition.vXboxPos, sizeof(XINPUT_GAMEPAD));
+			break;
+		case DevType::vgeDS4:
+			DS4_REPORT_INIT(dev.PPosition.ds4Pos);
+			break;
+		default:
+			break;
+	}
 }
 
-BOOL	IX_SetDpadLeft(UINT UserIndex)
-{
-	return IX_SetDpad(UserIndex, XBTN_DPAD_LEFT);
-}
+#pragma endregion Report Conversion
 
-BOOL	IX_SetDpadOff(HDEVICE hDev)
-{
-	return IX_SetDpad(hDev, XBTN_NONE);
-}
+#pragma region Controls
 
-BOOL	IX_SetDpadOff(UINT UserIndex)
+static BYTE DPOV_to_DPAD(vGenNS::DPOV_DIRECTION Value, bool ds4 = false)
 {
-	return IX_SetDpad(UserIndex, XBTN_NONE);
+	switch (Value)
+	{
+		case DPOV_North:
+			return ds4 ? (BYTE)DS4_BUTTON_DPAD_NORTH : (BYTE)XBTN_DPAD_UP;
+		case DPOV_East:
+			return ds4 ? (BYTE)DS4_BUTTON_DPAD_EAST : (BYTE)XBTN_DPAD_RIGHT;
+		case DPOV_South:
+			return ds4 ? (BYTE)DS4_BUTTON_DPAD_SOUTH : (BYTE)XBTN_DPAD_DOWN;
+		case DPOV_West:
+			return ds4 ? (BYTE)DS4_BUTTON_DPAD_WEST : (BYTE)XBTN_DPAD_LEFT;
+		case DPOV_NorthEast:
+			return ds4 ? (BYTE)DS4_BUTTON_DPAD_NORTHEAST : (BYTE)XBTN_DPAD_UP_RIGHT;
+		case DPOV_SouthEast:
+			return ds4 ? (BYTE)DS4_BUTTON_DPAD_SOUTHEAST : (BYTE)XBTN_DPAD_DOWN_RIGHT;
+		case DPOV_SouthWest:
+			return ds4 ? (BYTE)DS4_BUTTON_DPAD_SOUTHWEST : (BYTE)XBTN_DPAD_DOWN_LEFT;
+		case DPOV_NorthWest:
+			return ds4 ? (BYTE)DS4_BUTTON_DPAD_NORTHWEST : (BYTE)XBTN_DPAD_UP_LEFT;
+		case DPOV_Center:
+		default:
+			return ds4 ? (BYTE)DS4_BUTTON_DPAD_NONE : (BYTE)XBTN_NONE;
+	}
 }
-#endif // SPECIFICBUTTONS
-
-// IX Get infos                 /////////////////////////////////////////
 
-DWORD	IX_GetLedNumber(UINT UserIndex, PBYTE pLed)
+static BYTE CPOV_to_DPAD(DWORD Value, bool ds4 = false)
 {
-	BOOL Exist;
-	DWORD res;
-
-	// Test if device is plugged-in
-	res = IX_isControllerPluggedIn(UserIndex, &Exist);
-	if (res != STATUS_SUCCESS)
-		return res;
-	if (!Exist)
-		return STATUS_DEVICE_DOES_NOT_EXIST;
-
-	HDEVICE h = GetDeviceHandle(vXbox, UserIndex);
-	if (!h)
-		return STATUS_INVALID_HANDLE;
-
-	if (!pLed)
-		return STATUS_INVALID_PARAMETER_2;
+	if (Value == -1)
+		return ds4 ? (BYTE)DS4_BUTTON_DPAD_NONE : (BYTE)XBTN_NONE;
 
-	res = XoutputGetLedNumber(UserIndex - 1, pLed);
-	return IX_ErrorToStatus(res);
-}
+	const LONG lVal = static_cast<LONG>(Value);
+	if (lVal < 100 || lVal > 35900)
+		return ds4 ? (BYTE)DS4_BUTTON_DPAD_NORTH : (BYTE)XBTN_DPAD_UP;
 
-DWORD	IX_GetVibration(UINT UserIndex, PXINPUT_VIBRATION pVib)
-{
-	HDEVICE h = GetDeviceHandle(vXbox, UserIndex);
-	if (!h)
-		return STATUS_INVALID_HANDLE;
+	if (abs(lVal - 4500) < 100)
+		return ds4 ? (BYTE)DS4_BUTTON_DPAD_NORTHEAST : (BYTE)XBTN_DPAD_UP_RIGHT;
 
-	if (!pVib)
-		return STATUS_INVALID_PARAMETER_2;
+	if (abs(lVal - 9000) < 100)
+		return ds4 ? (BYTE)DS4_BUTTON_DPAD_EAST : (BYTE)XBTN_DPAD_RIGHT;
 
-	const DWORD res = XoutputGetVibration(UserIndex - 1, pVib);
-	return IX_ErrorToStatus(res);
-}
+	if (abs(lVal - 13500) < 100)
+		return ds4 ? (BYTE)DS4_BUTTON_DPAD_SOUTHEAST : (BYTE)XBTN_DPAD_DOWN_RIGHT;
 
-#pragma endregion Internal vXbox
+	if (abs(lVal - 18000) < 100)
+		return ds4 ? (BYTE)DS4_BUTTON_DPAD_SOUTH : (BYTE)XBTN_DPAD_DOWN;
 
-/////////////////////////////////////////
+	if (abs(lVal - 22500) < 100)
+		return ds4 ? (BYTE)DS4_BUTTON_DPAD_SOUTHWEST : (BYTE)XBTN_DPAD_DOWN_LEFT;
 
-#pragma region Internal vJoy
+	if (abs(lVal - 27000) < 100)
+		return ds4 ? (BYTE)DS4_BUTTON_DPAD_WEST : (BYTE)XBTN_DPAD_LEFT;
 
-HDEVICE	IJ_AcquireVJD(UINT rID)
-{
-	if (vJoyNS::AcquireVJD(rID))
-		return CreateDevice(vJoy, rID);
+	if (abs(lVal - 31500) < 100)
+		return ds4 ? (BYTE)DS4_BUTTON_DPAD_NORTHWEST : (BYTE)XBTN_DPAD_UP_LEFT;
 
-	return INVALID_DEV;
+	return ds4 ? (BYTE)DS4_BUTTON_DPAD_NONE : (BYTE)XBTN_NONE;
 }
 
-DWORD IJ_RelinquishVJD(HDEVICE hDev, PDEVICE pDev)			// Relinquish the specified vJoy Device.
+static BYTE Degrees_to_DPAD(LONG Value, bool ds4 = false)
 {
-	if (pDev && pDev->Type == DevType::vJoy)
+	switch (Value)
 	{
-		vJoyNS::RelinquishVJD(pDev->Id);
-		DestroyDevice(hDev);
-		return STATUS_SUCCESS;
+		case 0:
+		case 360:
+			return ds4 ? (BYTE)DS4_BUTTON_DPAD_NORTH : (BYTE)XBTN_DPAD_UP;
+		case 45:
+			return ds4 ? (BYTE)DS4_BUTTON_DPAD_NORTHEAST : (BYTE)XBTN_DPAD_UP_RIGHT;
+		case 90:
+			return ds4 ? (BYTE)DS4_BUTTON_DPAD_EAST : (BYTE)XBTN_DPAD_RIGHT;
+		case 135:
+			return ds4 ? (BYTE)DS4_BUTTON_DPAD_SOUTHEAST : (BYTE)XBTN_DPAD_DOWN_RIGHT;
+		case 180:
+			return ds4 ? (BYTE)DS4_BUTTON_DPAD_SOUTH : (BYTE)XBTN_DPAD_DOWN;
+		case 225:
+			return ds4 ? (BYTE)DS4_BUTTON_DPAD_SOUTHWEST : (BYTE)XBTN_DPAD_DOWN_LEFT;
+		case 270:
+			return ds4 ? (BYTE)DS4_BUTTON_DPAD_NORTHWEST : (BYTE)XBTN_DPAD_UP_LEFT;
+		case 315:
+			return ds4 ? (BYTE)DS4_BUTTON_DPAD_WEST : (BYTE)XBTN_DPAD_LEFT;
+		default:
+			return ds4 ? (BYTE)DS4_BUTTON_DPAD_NONE : (BYTE)XBTN_NONE;
 	}
-	return STATUS_UNSUCCESSFUL;
 }
 
-BOOL IJ_isVJDExists(HDEVICE hDev)
+DWORD	Control_SetButton(DEVICE & dev, UINT Button, BOOL Press)
 {
-	const PDEVICE pDev = GetDevice(hDev);
-	return pDev && pDev->Type == DevType::vJoy &&
-		vJoyNS::isVJDExists(pDev->Id);
+	return Report_SetButton(dev, Button, Press);
 }
 
-VjdStat IJ_GetVJDStatus(HDEVICE hDev)
+DWORD	Control_SetAxis(DEVICE & dev, HID_USAGES Axis, LONG Value)
 {
-	const PDEVICE pDev = GetDevice(hDev);
-	if (pDev && pDev->Type == DevType::vJoy)
-		return vJoyNS::GetVJDStatus(pDev->Id);
-	else
-		return VJD_STAT_MISS;
-}
+	if (dev.Type == DevType::vJoy)
+		return Report_SetAxis(dev, Axis, Value);
 
-BOOL IJ_GetVJDAxisExist(HDEVICE hDev, HID_USAGES Axis)
-{
-	const PDEVICE pDev = GetDevice(hDev);
-	return pDev && pDev->Type == DevType::vJoy &&
-		vJoyNS::GetVJDAxisExist(pDev->Id, Axis);
-}
+	if (Value > 32767)
+		Value = 32767;
+	else if (Value < 0)
+		Value = 0;
 
-int	IJ_GetVJDButtonNumber(HDEVICE hDev)	// Get the number of buttons defined in the specified VDJ
-{
-	const PDEVICE pDev = GetDevice(hDev);
-	if (pDev && pDev->Type == DevType::vJoy)
-		return vJoyNS::GetVJDButtonNumber(pDev->Id);
-	return 0;
-}
+	if (dev.Type == DevType::vXbox || dev.Type == DevType::vgeXbox)
+	{
+		// If Triggers (Z,RZ) then remap range:   0 - 32767  ==> 0 - 255
+		// If Axis is X,Y,RX,RY then remap range: 0 - 32767  ==> -32768 - 32767
+		SHORT vx_Value = static_cast<SHORT>( Axis == HID_USAGE_LT || Axis == HID_USAGE_RT ? ((Value - 1) / 128) & 0xFF : (Value - 16384) * 2 );
+		return Report_SetAxis(dev, Axis, vx_Value);
+	}
 
-int IJ_GetVJDDiscPovNumber(HDEVICE hDev)   // Get the number of POVs defined in the specified device
-{
-	const PDEVICE pDev = GetDevice(hDev);
-	if (pDev && pDev->Type == DevType::vJoy)
-		return vJoyNS::GetVJDDiscPovNumber(pDev->Id);
-	return 0;
-}
+	if (dev.Type == DevType::vgeDS4) {
+		// Scale all axes to byte range: 0 - 32767  ==> 0 - 255
+		BYTE vx_Value = ((Value - 1) / 128) & 0xFF;
+		if (Axis == HID_USAGE_LY || Axis == HID_USAGE_RY)
+			vx_Value = (0xFF - vx_Value);  // reverse the value
+		return Report_SetAxis(dev, Axis, vx_Value);
+	}
 
-int IJ_GetVJDContPovNumber(HDEVICE hDev)	// Get the number of descrete-type POV hats defined in the specified VDJ
-{
-	const PDEVICE pDev = GetDevice(hDev);
-	if (pDev && pDev->Type == DevType::vJoy)
-		return vJoyNS::GetVJDContPovNumber(pDev->Id);
-	return 0;
+	return STATUS_INVALID_HANDLE;
 }
 
-BOOL IJ_SetAxis(LONG Value, HDEVICE hDev, HID_USAGES Axis)		// Write Value to a given axis defined in the specified VDJ
+// The inverse of Control_SetAxis(): a value that Control_SetAxis() turns into the report's current one
+DWORD	Control_GetAxis(const DEVICE & dev, HID_USAGES Axis, LONG & Value)
 {
-	const PDEVICE pDev = GetDevice(hDev);
-	return pDev && pDev->Type == DevType::vJoy && vJoyNS::GetVJDAxisExist(pDev->Id, Axis) &&
-		vJoyNS::SetAxis(Value, pDev->Id, Axis);
-}
+	LONG raw = 0;
+	const DWORD res = Report_GetAxis(dev, Axis, raw);
+	if (res != STATUS_SUCCESS)
+		return res;
+	if (dev.Type == DevType::vJoy) {
+		Value = raw;
+		return STATUS_SUCCESS;
+	}
 
-BOOL IJ_SetBtn(BOOL Value, HDEVICE hDev, UCHAR nBtn)		// Write Value to a given button defined in the specified VDJ
-{
-	const PDEVICE pDev = GetDevice(hDev);
-	return pDev && pDev->Type == DevType::vJoy && vJoyNS::GetVJDButtonNumber(pDev->Id) >= nBtn &&
-		vJoyNS::SetBtn(Value, pDev->Id, nBtn);
-}
+	const bool trigger = Axis == HID_USAGE_LT || Axis == HID_USAGE_RT;
+	if ((dev.Type == DevType::vXbox || dev.Type == DevType::vgeXbox) && !trigger) {
+		Value = raw / 2 + 16384;
+		return STATUS_SUCCESS;
+	}
 
-BOOL IJ_SetDiscPov(int Value, HDEVICE hDev, UCHAR nPov)	// Write Value to a given descrete POV defined in the specified VDJ
-{
-	const PDEVICE pDev = GetDevice(hDev);
-	return pDev && pDev->Type == DevType::vJoy && vJoyNS::GetVJDDiscPovNumber(pDev->Id) >= nPov &&
-		vJoyNS::SetDiscPov(Value, pDev->Id, nPov);
+	// Byte: triggers, DS4 sticks
+	if (dev.Type == DevType::vgeDS4 && (Axis == HID_USAGE_LY || Axis == HID_USAGE_RY))
+		raw = 0xFF - raw;
+	Value = raw * 128 + 64;
+	return STATUS_SUCCESS;
 }
 
-BOOL IJ_SetContPov(DWORD Value, HDEVICE hDev, UCHAR nPov)	// Write Value to a given continuous POV defined in the specified VDJ
+DWORD	Control_SetAxisPct(DEVICE & dev, HID_USAGES Axis, FLOAT Value)
 {
-	const PDEVICE pDev = GetDevice(hDev);
-	return pDev && pDev->Type == DevType::vJoy && vJoyNS::GetVJDContPovNumber(pDev->Id) >= nPov &&
-		vJoyNS::SetContPov(Value, pDev->Id, nPov);
-}
+	if (dev.Type == DevType::vJoy)
+	{
+		// Convert Value from range 0-100 to range 0-32768
+		const LONG vj_Value = static_cast <LONG>(32768 * Value * .01f);
+		return Report_SetAxis(dev, Axis, vj_Value);
+	}
 
-DWORD IJ_ResetPositions(HDEVICE hDev)
-{
-	const PDEVICE pDev = GetDevice(hDev);
-	if (!pDev)
-		return STATUS_INVALID_HANDLE;
+	if (dev.Type == DevType::vXbox || dev.Type == DevType::vgeXbox)
+	{
+		// Convert Value from range (0 - 100) to range (0 - 255) for Triggers
+		{
+			if (Axis == HID_USAGE_LT || Axis == HID_USAGE_RT) {
+				const BYTE bVal = (BYTE)(255 * Value * .01f);
+				return Report_SetAxis(dev, Axis, bVal);
+			}
+		}
 
-	IJ_JoystickReportInit(pDev->PPosition.vJoyPos);
-	return BOOL_TO_STATUS(vJoyNS::UpdateVJD(pDev->Id, pDev->PPosition.vJoyPos));
-}
+		const SHORT sVal = static_cast <SHORT>((65535.0f * Value * .01f) - 32768);
+		return Report_SetAxis(dev, Axis, sVal);
+	}
 
-#pragma endregion
+	if (dev.Type == DevType::vgeDS4) {
+		// Scale all axes to byte range: 0 - 32767  ==> 0 - 255
+		BYTE bVal = (BYTE)(255 * Value * .01f);
+		if (Axis == HID_USAGE_LY || Axis == HID_USAGE_RY)
+			bVal = (0xFF - bVal);  // reverse the value
+		return Report_SetAxis(dev, Axis, bVal);
+	}
 
-#pragma region ViGEm Internal Functions
+	return STATUS_INVALID_HANDLE;
+}
 
-DWORD VGE_InitClient(void)
+// Write Value to a given discrete POV defined in the specified device handle
+DWORD	Control_SetDiscPov(DEVICE & dev, UCHAR nPov, vGenNS::DPOV_DIRECTION Value)
 {
-	if (VGE_Client)
-		return STATUS_SUCCESS;
+	if (dev.Type == DevType::vJoy)
+		return Report_SetDiscPov(dev, nPov, (int)Value);
 
-	VGE_Client = vigem_alloc();
-	if (!VGE_Client)
-		return STATUS_MEMORY_NOT_ALLOCATED;
+	if (nPov > 1)
+		return STATUS_INVALID_PARAMETER_2;
 
-	const VIGEM_ERROR res = vigem_connect(VGE_Client);
-	if (res == VIGEM_ERROR_NONE || res == VIGEM_ERROR_BUS_ALREADY_CONNECTED)
-		return STATUS_SUCCESS;
+	if (dev.Type == DevType::vXbox || dev.Type == DevType::vgeXbox)
+		return Report_SetDpad(dev, DPOV_to_DPAD(Value));
 
-	vigem_free(VGE_Client);
-	VGE_Client = nullptr;
-	return VGE_ErrorToStatus(res);
-}
+	if (dev.Type == DevType::vgeDS4)
+		return Report_SetDpad(dev, DPOV_to_DPAD(Value, true));
 
-DWORD VGE_BusExists(void)
-{
-	// There's no better way to check if the bus exists than to init it.
-	return VGE_InitClient();
+	return STATUS_INVALID_HANDLE;
 }
 
-#if 0
-static VOID CALLBACK VGE_notification_x360(
-	PVIGEM_CLIENT Client, PVIGEM_TARGET Target,
-	UCHAR LargeMotor, UCHAR SmallMotor, UCHAR LedNumber,
-	LPVOID UserData
-)
+// Write Value to a given continuous POV defined in the specified device handle
+DWORD	Control_SetContPov(DEVICE & dev, UCHAR nPov, DWORD Value)
 {
-	//static int count = 1;
-	//std::cout << count++ << " " << (int)LedNumber << " " << UserData << std::endl;
+	if (dev.Type == DevType::vJoy)
+		return Report_SetContPov(dev, nPov, Value);
 
-	if (PDEVICE pDev = (PDEVICE)UserData)
-		pDev->DevInfo.LedNumber = LedNumber + 1;
-	//if (LedNumber)
-	//vigem_target_x360_unregister_notification(Target);
-}
+	if (nPov > 1)
+		return STATUS_INVALID_PARAMETER_2;
 
-VOID CALLBACK VGE_notification_ds4(
-	PVIGEM_CLIENT Client, PVIGEM_TARGET Target,
-	UCHAR LargeMotor, UCHAR SmallMotor, DS4_LIGHTBAR_COLOR LightbarColor,
-	LPVOID UserData
-)
-{
-	static int count = 1;
-	std::cout << '\n' << count++ << " " << std::hex << std::setfill('0')
-		<< std::setw(2) << (int)LightbarColor.Red << ':'
-		<< std::setw(2) << (int)LightbarColor.Green << ':'
-		<< std::setw(2) << (int)LightbarColor.Blue << std::endl;
-	if (PDEVICE pDev = (PDEVICE)UserData) {
-		pDev->DevInfo.ColorBar = (0xFF << 24) | (LightbarColor.Red << 16) | (LightbarColor.Green << 8) | LightbarColor.Blue;
-		//if (pDev->DevInfo.ColorBar & 0x00FFFFFF)
-		//vigem_target_x360_unregister_notification(Target);
-	}
-}
-#endif
+	if (dev.Type == DevType::vXbox || dev.Type == DevType::vgeXbox)
+		return Report_SetDpad(dev, CPOV_to_DPAD(Value));
 
-DWORD VGE_PlugIn(vGenNS::DevType dType, UINT DevId)
-{
-	PDEVICE pDev = GetDevice(dType, DevId);
-	if (!pDev) {
-		HDEVICE hDev = CreateDevice(dType, DevId);
-		pDev = GetDevice(hDev);
-		if (!pDev)
-			return STATUS_IO_DEVICE_ERROR;
-	}
-	else {
-		pDev->DevInfo.LedNumber = 0;
-		pDev->DevInfo.Serial = 0;
-	}
+	if (dev.Type == DevType::vgeDS4)
+		return Report_SetDpad(dev, CPOV_to_DPAD(Value, true));
 
-	if (!pDev->VGE_Target) {
-		DWORD stat = VGE_InitClient();
-		if (stat != STATUS_SUCCESS)
-			return stat;
+	return STATUS_INVALID_HANDLE;
+}
 
-		pDev->VGE_Target = dType == DevType::vgeXbox ? vigem_target_x360_alloc() : vigem_target_ds4_alloc();
-		if (!pDev->VGE_Target)
-			return STATUS_MEMORY_NOT_ALLOCATED;
-	}
-	else if (vigem_target_is_attached(pDev->VGE_Target)) {
-		return STATUS_DEVICE_ALREADY_ATTACHED;
-	}
+DWORD	Control_SetPov(DEVICE & dev, UCHAR nPov, DWORD Value)
+{
+	if (dev.Type == DevType::vJoy)
+	{
+		// Don't test for type - just try
+		if (Report_SetContPov(dev, nPov, Value) == STATUS_SUCCESS)
+			return STATUS_SUCCESS;
 
-	const VIGEM_ERROR res = vigem_target_add(VGE_Client, pDev->VGE_Target);
-	if (res == VIGEM_ERROR_NONE) {
-		pDev->DevInfo.Serial = vigem_target_get_index(pDev->VGE_Target);
-		pDev->DevInfo.VendId = vigem_target_get_vid(pDev->VGE_Target);
-		pDev->DevInfo.ProdId = vigem_target_get_pid(pDev->VGE_Target);
-		if (dType == DevType::vgeXbox) {
-			//vigem_target_x360_register_notification(VGE_Client, pDev->VGE_Target, &VGE_notification_x360, pDev);
-			ULONG led;
-			if (vigem_target_x360_get_user_index(VGE_Client, pDev->VGE_Target, &led) == VIGEM_ERROR_NONE)
-				pDev->DevInfo.LedNumber = (BYTE)led + 1;
-			//std::cout << pDev->DevInfo.Serial << " " << (int)pDev->DevInfo.LedNumber << std::endl;
-		}
-#if 0   // none of this is working to get the lightbar color
-		else {
-			/*DS4_OUTPUT_BUFFER ds4Rep;
-			RtlZeroMemory(&ds4Rep, sizeof(DS4_OUTPUT_BUFFER));
-			VIGEM_ERROR res2 = vigem_target_ds4_await_output_report_timeout(VGE_Client, pDev->VGE_Target, 500, &ds4Rep);
-			pDev->DevInfo.ColorBar = (ds4Rep.Buffer[2] << 16) | (ds4Rep.Buffer[3] << 8) | ds4Rep.Buffer[4];
-			std::cout << std::hex << std::setfill('0') << std::setw(8) << res2 << " " << std::setw(8) << pDev->DevInfo.ColorBar << " "
-			<< std::setw(2) << (int)ds4Rep.Buffer[0] << ":" << std::setw(2) << (int)ds4Rep.Buffer[1] << ":"<< std::setw(2) << (int)ds4Rep.Buffer[2] << ":" << std::setw(2) << (int)ds4Rep.Buffer[3] << ":" << std::setw(2) << (int)ds4Rep.Buffer[4] << std::endl;*/
-			//vigem_target_ds4_register_notification(VGE_Client, pDev->VGE_Target, &VGE_notification_ds4, pDev);
+		// Discrete: Convert Value from range 0-360 to discrete values (-1 means Reset)
+		DPOV_DIRECTION dir;
+		switch (Value)
+		{
+			case 0:
+			case 36000:
+				dir = DPOV_North;
+				break;
+			case 9000:
+				dir = DPOV_East;
+				break;
+			case 18000:
+				dir = DPOV_South;
+				break;
+			case 27000:
+				dir = DPOV_West;
+				break;
+			default:
+				dir = DPOV_Center;
+				break;
 		}
-#endif
+		return Report_SetDiscPov(dev, nPov, dir);
 	}
-	return VGE_ErrorToStatus(res);
-}
 
-DWORD VGE_UnPlug(HDEVICE hDev, PDEVICE pDev, BOOL destroy)
-{
-	if (!hDev || !pDev)
-		return STATUS_INVALID_HANDLE;
+	if (nPov != 1)
+		return STATUS_INVALID_PARAMETER_2;
 
-	DWORD ret;
-	if (pDev->VGE_Target && vigem_target_is_attached(pDev->VGE_Target)) {
-		//if (pDev->Type == DevType::vgeXbox)
-		//vigem_target_x360_unregister_notification(pDev->VGE_Target);
-		const VIGEM_ERROR res = vigem_target_remove(VGE_Client, pDev->VGE_Target);
-		ret = VGE_ErrorToStatus(res);
-	}
-	else {
-		ret = STATUS_DEVICE_NOT_CONNECTED;
-	}
-	if (destroy /*&& res == VIGEM_ERROR_NONE*/)
-		DestroyDevice(hDev);
+	if (dev.Type == DevType::vXbox || dev.Type == DevType::vgeXbox)
+		return Report_SetDpad(dev, CPOV_to_DPAD(Value));
 
-	return ret;
+	if (dev.Type == DevType::vgeDS4)
+		return Report_SetDpad(dev, CPOV_to_DPAD(Value, true));
+
+	return STATUS_INVALID_HANDLE;
 }
 
-DWORD VGE_ResetController(HDEVICE hDev)
+// The inverse of Control_SetPov(): 0-35999, or -1 for center. A discrete POV or a dpad gives multiples of 4500.
+DWORD	Control_GetPov(const DEVICE & dev, UCHAR nPov, DWORD & Value)
 {
-	PDEVICE pDev = GetDevice(hDev);
-	if (!pDev || !pDev->VGE_Target)
-		return STATUS_INVALID_HANDLE;
+	if (dev.Type == DevType::vJoy) {
+		const JOYSTICK_POSITION_V2 * position = dev.PPosition.vJoyPos;
+		if (nPov && nPov <= dev.Caps.ContPovs) {
+			const DWORD hats[] = { position->bHats, position->bHatsEx1, position->bHatsEx2, position->bHatsEx3 };
+			Value = hats[nPov - 1] > 35999 ? (DWORD)-1 : hats[nPov - 1];
+			return STATUS_SUCCESS;
+		}
+		if (nPov && nPov <= dev.Caps.DiscPovs) {
+			const DWORD dir = (position->bHats >> ((nPov - 1) * 4)) & 0xF;
+			Value = dir <= DPOV_West ? dir * 9000 : (DWORD)-1;
+			return STATUS_SUCCESS;
+		}
+		return STATUS_INVALID_PARAMETER_2;
+	}
 
-	VIGEM_ERROR res;
+	if (nPov != 1)
+		return STATUS_INVALID_PARAMETER_2;
 
-	if (pDev->Type == DevType::vgeXbox) {
-		RtlZeroMemory(pDev->PPosition.vXboxPos, sizeof(XINPUT_GAMEPAD));
-		res = vigem_target_x360_update(VGE_Client, pDev->VGE_Target, *((PXUSB_REPORT)pDev->PPosition.vXboxPos));
+	if (dev.Type == DevType::vXbox || dev.Type == DevType::vgeXbox) {
+		// By XBTN_DPAD_* bits: up 1, down 2, left 4, right 8. Opposite directions at once are centered.
+		static const DWORD angles[16] = {
+			(DWORD)-1, 0, 18000, (DWORD)-1, 27000, 31500, 22500, 27000,
+			9000, 4500, 13500, 9000, (DWORD)-1, 0, 18000, (DWORD)-1,
+		};
+		Value = angles[dev.PPosition.vXboxPos->wButtons & XBTN_DPAD_MASK];
+		return STATUS_SUCCESS;
 	}
-	// DS4
-	else {
-		DS4_REPORT_INIT(pDev->PPosition.ds4Pos);
-		res = vigem_target_ds4_update(VGE_Client, pDev->VGE_Target, *pDev->PPosition.ds4Pos);
+
+	if (dev.Type == DevType::vgeDS4) {
+		// DS4_BUTTON_DPAD_NORTH (0) to _NORTHWEST (7), clockwise
+		const DWORD dir = dev.PPosition.ds4Pos->wButtons & XBTN_DPAD_MASK;
+		Value = dir <= DS4_BUTTON_DPAD_NORTHWEST ? dir * 4500 : (DWORD)-1;
+		return STATUS_SUCCESS;
 	}
 
-	return VGE_ErrorToStatus(res);
+	return STATUS_INVALID_HANDLE;
 }
 
-DWORD VGE_ResetController(vGenNS::DevType dType, UINT DevId)
+DWORD	Control_Apply(DEVICE & dev, const VgenMsg & msg)
 {
-	return VGE_ResetController(GetDeviceHandle(dType, DevId));
+	switch (msg.Cmd)
+	{
+		case VgenCmdButton:
+			return Control_SetButton(dev, msg.Index, msg.Value != 0);
+		case VgenCmdAxis:
+			return Control_SetAxis(dev, (HID_USAGES)msg.Index, msg.Value);
+		case VgenCmdPov:
+			return Control_SetPov(dev, (UCHAR)msg.Index, (DWORD)msg.Value);
+		case VgenCmdReset:
+			Report_Reset(dev);
+			return STATUS_SUCCESS;
+		default:
+			return STATUS_INVALID_DEVICE_REQUEST;
+	}
 }
 
-DWORD	VGE_SetBtn(const PDEVICE pDev, BOOL Press, WORD Button, BOOL XInput)
+bool	Control_ParseDevice(int32_t Number, DevType & Type, UINT & Id)
 {
-	if (!pDev || !pDev->VGE_Target)
-		return STATUS_INVALID_HANDLE;
-
-	DWORD Mask;
-	if (XInput)
-		Mask = Button;
-	else if (pDev->Type == DevType::vgeXbox && Button <= XINPUT_NUM_BUTTONS)
-		Mask = g_xButtons[Button - 1];
-	else if (pDev->Type == DevType::vgeDS4 && Button <= DS4_NUM_BUTTONS)
-		Mask = g_ds4Buttons[Button - 1];
-	else
-		return STATUS_INVALID_PARAMETER_3;
+	if (Number <= 0)
+		return false;
+	Type = (DevType)(Number / 1000 * 1000);
+	Id = (UINT)(Number % 1000);
+	return Id && (Type == DevType::vJoy || Type == DevType::vXbox || Type == DevType::vgeXbox || Type == DevType::vgeDS4);
+}
 
-	VIGEM_ERROR res;
+#pragma endregion Controls
 
-	if (pDev->Type == DevType::vgeXbox) {
-		PXUSB_REPORT position = (PXUSB_REPORT)pDev->PPosition.vXboxPos;
-		if (!position)
-			return STATUS_MEMORY_NOT_ALLOCATED;
+#pragma region Backend Selection
 
-		// Change position value
-		if (Press)
-			position->wButtons |= (WORD)Mask;
-		else
-			position->wButtons &= ~(WORD)Mask;
-		res = vigem_target_x360_update(VGE_Client, pDev->VGE_Target, *position);
-	}
-	// DS4
-	else {
-		if (Mask <= XBTN_DPAD_MASK)
-			return VGE_SetDpad(pDev, Press ? (SHORT)Mask : DS4_BUTTON_DPAD_NONE);
-
-		PDS4_REPORT position = pDev->PPosition.ds4Pos;
-		if (!position)
-			return STATUS_MEMORY_NOT_ALLOCATED;
-
-		// special buttons?
-		if (Mask & DS4_SPECIAL_BUTTON_FLAG) {
-			if (Press)
-				position->bSpecial |= (BYTE)Mask;
-			else
-				position->bSpecial &= ~(BYTE)Mask;
-		}
-		// normal buttons
-		else {
-			if (Press)
-				position->wButtons |= (WORD)Mask;
-			else
-				position->wButtons &= ~(WORD)Mask;
-		}
-		res = vigem_target_ds4_update(VGE_Client, pDev->VGE_Target, *position);
-	}
+#ifdef VGEN_DRIVERS
+static std::atomic<DeviceBackend *> g_backend {Backend_Driver()};
+#else
+static std::atomic<DeviceBackend *> g_backend {Backend_Sim()};
+#endif
 
-	return VGE_ErrorToStatus(res);
+DeviceBackend * Backend_Get(void)
+{
+	return g_backend.load(std::memory_order_acquire);
 }
 
-DWORD	VGE_SetDpad(const PDEVICE pDev, USHORT Value)
+DWORD Backend_Select(BackendType type)
 {
-	if (!pDev || !pDev->VGE_Target)
-		return STATUS_INVALID_HANDLE;
-
-	VIGEM_ERROR res;
-
-	if (pDev->Type == DevType::vgeXbox) {
-		PXUSB_REPORT position = (PXUSB_REPORT)pDev->PPosition.vXboxPos;
-		if (!position)
-			return STATUS_MEMORY_NOT_ALLOCATED;
-
-		position->wButtons &= ~XBTN_DPAD_MASK;
-		position->wButtons |= Value;
-		res = vigem_target_x360_update(VGE_Client, pDev->VGE_Target, *position);
+	DeviceBackend * backend;
+	switch (type) {
+		case BackendType::BackendDriver:
+#ifdef VGEN_DRIVERS
+			backend = Backend_Driver();
+			break;
+#else
+			return STATUS_NOT_SUPPORTED;
+#endif
+		case BackendType::BackendSimulated:
+			backend = Backend_Sim();
+			break;
+		case BackendType::BackendUinput:
+#ifdef __linux__
+			backend = Backend_Uinput();
+			break;
+#else
+			return STATUS_NOT_SUPPORTED;
+#endif
+		case BackendType::BackendUinputMemory:
+			backend = Backend_UinputMemory();
+			break;
+		default:
+			return STATUS_INVALID_PARAMETER_1;
 	}
-	// DS4
-	else {
-		PDS4_REPORT position = pDev->PPosition.ds4Pos;
-		if (!position)
-			return STATUS_MEMORY_NOT_ALLOCATED;
 
-		position->wButtons &= ~XBTN_DPAD_MASK;
-		position->wButtons |= Value;
-		res = vigem_target_ds4_update(VGE_Client, pDev->VGE_Target, *position);
-	}
+	// Devices stay with the backend they were plugged into
+	if (!DevContainer_cref.empty())
+		return backend == Backend_Get() ? STATUS_SUCCESS : STATUS_INVALID_DEVICE_STATE;
 
-	return VGE_ErrorToStatus(res);
+	g_backend.store(backend, std::memory_order_release);
+	return STATUS_SUCCESS;
 }
 
-DWORD	VGE_SetAxis(const PDEVICE pDev, HID_USAGES Axis, SHORT Value)
+void Backend_Shutdown(void)
 {
-	if (!pDev || !pDev->VGE_Target)
-		return STATUS_INVALID_HANDLE;
-
-	VIGEM_ERROR res;
-
-	if (pDev->Type == DevType::vgeXbox) {
-		PXUSB_REPORT position = (PXUSB_REPORT)pDev->PPosition.vXboxPos;
-		if (!position)
-			return STATUS_MEMORY_NOT_ALLOCATED;
-
-		switch (Axis) {
-			case HID_USAGE_LT:
-				position->bLeftTrigger = Value & 0xFF;
-				break;
-			case HID_USAGE_RT:
-				position->bRightTrigger = Value & 0xFF;
-				break;
-			case HID_USAGE_LX:
-				position->sThumbLX = Value;
-				break;
-			case HID_USAGE_LY:
-				position->sThumbLY = Value;
-				break;
-			case HID_USAGE_RX:
-				position->sThumbRX = Value;
-				break;
-			case HID_USAGE_RY:
-				position->sThumbRY = Value;
-				break;
-			default:
-				return STATUS_INVALID_PARAMETER_2;
-		};
-
-		res = vigem_target_x360_update(VGE_Client, pDev->VGE_Target, *position);
-	}
-	// DS4
-	else {
-		PDS4_REPORT position = pDev->PPosition.ds4Pos;
-		if (!position)
-			return STATUS_MEMORY_NOT_ALLOCATED;
-
-		const BYTE bValue = Value & 0xFF;
-		switch (Axis) {
-			case HID_USAGE_LT:
-				position->bTriggerL = bValue;
-				break;
-			case HID_USAGE_RT:
-				position->bTriggerR = bValue;
-				break;
-			case HID_USAGE_LX:
-				position->bThumbLX = bValue;
-				break;
-			case HID_USAGE_LY:
-				position->bThumbLY = bValue;
-				break;
-			case HID_USAGE_RX:
-				position->bThumbRX = bValue;
-				break;
-			case HID_USAGE_RY:
-				position->bThumbRY = bValue;
-				break;
-			default:
-				return STATUS_INVALID_PARAMETER_2;
-		};
-
-		res = vigem_target_ds4_update(VGE_Client, pDev->VGE_Target, *position);
-	}
-
-	return VGE_ErrorToStatus(res);
+#ifdef VGEN_DRIVERS
+	Backend_Driver()->Shutdown();
+#endif
+	Backend_Sim()->Shutdown();
 }
 
-#pragma endregion  ViGEm Internal Functions
-
+#pragma endregion Backend Selection
 
 #pragma region Helper Functions
 
@@ -1143,26 +798,33 @@ HDEVICE CreateDevice(vGenNS::DevType Type, UINT i)
 	h = i + Type + ((rand() % 1000 + 1) << 16);
 	DEVICE dev = {h, Type, i};
 
+	// Gamepad axes: X, Y, Z, RX, RY, RZ and the POV, which doubles as the dpad. vJoy caps come from the backend.
+	const DWORD gamepadAxes = 0x3F | (1UL << (HID_USAGE_POV - HID_USAGE_X));
 	switch (Type) {
 		case DevType::vJoy:
 			dev.PPosition.vJoyPos = new JOYSTICK_POSITION_V2;
-			IJ_JoystickReportInit(dev.PPosition.vJoyPos);
 			break;
 		case DevType::vXbox:
 		case DevType::vgeXbox:
 			dev.PPosition.vXboxPos = new XINPUT_GAMEPAD;
-			RtlZeroMemory(dev.PPosition.vXboxPos, sizeof(XINPUT_GAMEPAD));
+			dev.Caps.Axes = gamepadAxes;
+			dev.Caps.Buttons = XINPUT_NUM_BUTTONS;
+			dev.Caps.DiscPovs = 1;
 			break;
 		case DevType::vgeDS4:
 			dev.PPosition.ds4Pos = new DS4_REPORT;
-			DS4_REPORT_INIT(dev.PPosition.ds4Pos);
+			dev.Caps.Axes = gamepadAxes;
+			dev.Caps.Buttons = DS4_NUM_BUTTONS;
+			dev.Caps.DiscPovs = 1;
 			break;
 
 		default:
 			return INVALID_DEV;
 	}
+	Report_Reset(dev);
 
 	// Insert in container
+	std::lock_guard<std::mutex> lock(g_reportLock);
 	if (DevContainer.emplace(h, dev).second)
 		return h;
 
@@ -1170,13 +832,30 @@ HDEVICE CreateDevice(vGenNS::DevType Type, UINT i)
 }
 
 void DestroyDevice(HDEVICE & dev)
+{
+	std::lock_guard<std::mutex> lock(g_reportLock);
+	DestroyDevice_Locked(dev);
+}
+
+void DestroyDevice_Locked(HDEVICE & dev)
 {
 	DevContainer_cit it = DevContainer_cref.find(dev);
+	if (it != DevContainer_cref.cend() && it->second.Busy)
+		return;  // The thread plugging it in or out still uses it, and destroys it if it has to
+	Timer_CancelDevice(dev);
+	Mirror_UnlinkAll(dev);
+	Route_RemoveDevice(dev);
 	dev = INVALID_DEV;
 	if (it == DevContainer.cend())
 		return;
 
-	const DEVICE &device = it->second;
+	DEVICE &device = DevContainer.at(it->first);
+	if (device.Feedback)
+		device.Feedback->Close();
+
+	if (device.Backend)
+		device.Backend->Release(device);
+
 	switch (device.Type) {
 		case DevType::vJoy:
 			delete device.PPosition.vJoyPos;
@@ -1190,68 +869,7 @@ void DestroyDevice(HDEVICE & dev)
 			break;
 	}
 
-	if (device.VGE_Target) {
-		if (vigem_target_is_attached(device.VGE_Target))
-			vigem_target_remove(VGE_Client, device.VGE_Target);
-		vigem_target_free(device.VGE_Target);
-	}
-
 	DevContainer.erase(it);
 }
 
-#if 0
-BOOL ConvertPosition_vJoy2vXbox(void *vJoyPos, void *vXboxPos)
-{
-	if (!vJoyPos || !vXboxPos)
-		return FALSE;
-
-	// Convert the input position
-	JOYSTICK_POSITION_V2 * inPos = (JOYSTICK_POSITION_V2 *)vJoyPos;
-
-	// Convert the output position
-	XINPUT_GAMEPAD * position = (XINPUT_GAMEPAD *)vXboxPos;
-
-	///////// Convert values from vJoy to vXbox
-	/////  Axes
-	position->sThumbLX = 2 * ((SHORT)inPos->wAxisX - 1) - 32767;
-	position->sThumbLY = 2 * ((SHORT)inPos->wAxisY - 1) - 32767;
-	position->bLeftTrigger = ((SHORT)inPos->wAxisZ - 1) / 128;
-	position->sThumbRX = 2 * ((SHORT)inPos->wAxisXRot - 1) - 32767;
-	position->sThumbRY = 2 * ((SHORT)inPos->wAxisYRot - 1) - 32767;
-	position->bRightTrigger = ((SHORT)inPos->wAxisZRot - 1) / 128;
-
-	//// Dpad / Discrete POV #1
-	switch (inPos->bHats & 0xF)
-	{
-		case 0:
-			position->wButtons |= XBTN_DPAD_UP;
-			break;
-		case 1:
-			position->wButtons |= XBTN_DPAD_RIGHT;
-			break;
-		case 2:
-			position->wButtons |= XBTN_DPAD_DOWN;
-			break;
-		case 4:
-			position->wButtons |= XBTN_DPAD_LEFT;
-			break;
-		default:
-			position->wButtons &= ~XBTN_DPAD_MASK;
-	}
-
-	// Buttons (may override hats)
-	for (UINT i = 0; i < XINPUT_NUM_BUTTONS; ++i)
-		position->wButtons = ConvertButton(inPos->lButtons, position->wButtons, i + 1, g_xButtons[i]);
-
-	return TRUE;
-}
-
-WORD ConvertButton(LONG vBtns, WORD xBtns, UINT vBtn, UINT xBtn)
-{
-	WORD out;
-	out = ((vBtns&(1 << (vBtn - 1))) == 0) ? xBtns & ~xBtn : xBtns | xBtn;
-	return out;
-}
-#endif
-
 #pragma endregion // Helper Functions
@@ -0,0 +1,76 @@
+//////////////////////////////////////////////////////////
+//
+// vGen daemon protocol
+//
+// RunDaemon() owns the devices for feeders in other processes.
+// Feeders talk to it over a Unix domain datagram socket or
+// loopback UDP (see RunDaemon() for the addresses), with
+// datagrams of 1 to VGEN_PROTO_MAX_FRAME fixed-size VgenMsg
+// messages: one datagram is one frame, one syscall each way.
+//
+// Devices are numbered as in the vJoy API: 1-16 vJoy,
+// 1001-1004 vXbox, 2001-2004 vgeXbox, 3001-3004 vgeDS4.
+// A device stays plugged in while any feeder holds it; every
+// holder may change its controls. Control changes only touch
+// the device's report, a commit sends it, so a frame of
+// changes ending with a commit reaches the bus as one report.
+//
+// The daemon answers a frame with at most one datagram of
+// VgenCmdReply messages, in request order: one for every
+// request without VGEN_MSG_QUIET and one for every failed
+// request. Subscribers get a datagram of VgenCmdState messages
+// after every commit of the device.
+//
+// All members are little endian. The client side is
+// vGenClient.h; this header has no other dependency.
+//
+//////////////////////////////////////////////////////////
+#pragma once
+
+#include <stdint.h>
+
+#define VGEN_PROTO_VERSION    1
+#define VGEN_PROTO_MAX_FRAME  64  // Messages in one datagram
+#define VGEN_PROTO_STATE_SIZE 8   // Report bytes in one VgenCmdState message
+
+enum VgenCmd : uint8_t
+{
+	// Feeder to daemon
+	VgenCmdHello = 1,      // Value: VGEN_PROTO_VERSION. STATUS_NOT_SUPPORTED if the daemon speaks another.
+	VgenCmdBye,            // Releases everything the feeder holds or subscribed to. No reply.
+	VgenCmdAcquire,        // Plugs Device in, unless another feeder holds it already
+	VgenCmdRelease,        // Unplugs Device when its last holder releases it
+	VgenCmdButton,         // Index: button (1-based), Value: pressed. As SetDevButton().
+	VgenCmdAxis,           // Index: HID_USAGE_*, Value: 0-32767. As SetDevAxis().
+	VgenCmdPov,            // Index: POV (1-based), Value: 0-35999 or -1. As SetDevPov().
+	VgenCmdReset,          // As ResetDevPositions(), without sending the report
+	VgenCmdCommit,         // Sends Device's report if it changed, Device 0: every changed device the feeder holds
+	VgenCmdSubscribe,      // VgenCmdState after every commit of Device, by any feeder. Needs no hold.
+	VgenCmdUnsubscribe,
+
+	// Daemon to feeder
+	VgenCmdReply = 0x80,   // Index: the command, Value: its position in the frame, Status: NTSTATUS,
+	                       // Flags: VGEN_MSG_QUIET if the request had it (so it failed)
+	VgenCmdState,          // Index: chunk number; Value and Status: VGEN_PROTO_STATE_SIZE bytes of the report
+	                       // (JOYSTICK_POSITION_V2, XINPUT_GAMEPAD or DS4_REPORT) from offset Index * VGEN_PROTO_STATE_SIZE
+};
+
+enum VgenMsgFlags : uint8_t
+{
+	VGEN_MSG_QUIET = 0x01,  // Request: reply only if it fails
+	VGEN_MSG_LAST  = 0x02,  // State: last chunk of the report
+};
+
+#pragma pack(push, 1)
+struct VgenMsg
+{
+	uint8_t Cmd;       // VgenCmd
+	uint8_t Flags;     // VgenMsgFlags
+	uint16_t Index;
+	int32_t Device;
+	int32_t Value;
+	uint32_t Status;
+};
+#pragma pack(pop)
+
+static_assert(sizeof(VgenMsg) == 16, "VgenMsg is 16 bytes on the wire");
@@ -0,0 +1,158 @@
+// vGenReplay.cpp : Replays a trace recorded by StartTrace() (ReplayTrace).
+//
+// The whole file is decoded up front, so decoding is not part of the measured calls. Calls are then issued in time
+// order from the calling thread, through the exports, exactly as an application would make them.
+
+#include "stdafx.h"
+#include "Private.h"
+
+#include <algorithm>
+#include <chrono>
+
+using namespace vGenNS;
+
+// Waits longer than this sleep, shorter ones spin so the schedule is kept to the microsecond
+#define REPLAY_SPIN_NS  2000000
+
+namespace {
+
+// Recorded handle => handle acquired by the replay
+typedef std::map<HDEVICE, HDEVICE> ReplayHandles;
+
+void Replay_WaitUntil(PerfClock::time_point due)
+{
+	for (;;) {
+		const PerfClock::duration left = due - PerfClock::now();
+		if (left <= PerfClock::duration::zero())
+			return;
+		if (Perf_Ns(left) > REPLAY_SPIN_NS)
+			std::this_thread::sleep_for(left - std::chrono::nanoseconds(REPLAY_SPIN_NS));
+		else
+			std::this_thread::yield();
+	}
+}
+
+DWORD Replay_Call(const TraceRecord & rec, HDEVICE hDev, ReplayHandles & handles)
+{
+	switch (rec.Api) {
+		case PerfSetDevButton:
+			return SetDevButton(hDev, rec.Arg, rec.Value);
+		case PerfSetDevAxis:
+			return SetDevAxis(hDev, (HID_USAGES)rec.Arg, rec.Value);
+		case PerfSetDevAxisPct:
+			return SetDevAxisPct(hDev, (HID_USAGES)rec.Arg, Trace_BitsFloat(rec.Value));
+		case PerfSetDevDiscPov:
+			return SetDevDiscPov(hDev, (UCHAR)rec.Arg, (DPOV_DIRECTION)rec.Value);
+		case PerfSetDevContPov:
+			return SetDevContPov(hDev, (UCHAR)rec.Arg, (DWORD)rec.Value);
+		case PerfSetDevPov:
+			return SetDevPov(hDev, (UCHAR)rec.Arg, (DWORD)rec.Value);
+		case PerfResetDevPositions:
+			return ResetDevPositions(hDev);
+
+		case PerfGetPosition: {
+			union {
+				JOYSTICK_POSITION_V2 vJoy;
+				XINPUT_GAMEPAD xbox;
+				DS4_REPORT ds4;
+			} position;
+			return GetPosition(hDev, &position);
+		}
+
+		case PerfAcquireDev: {
+			HDEVICE acquired = INVALID_DEV;
+			const DWORD res = AcquireDev(rec.Arg, (DevType)rec.Value, &acquired);
+			if (res == STATUS_SUCCESS)
+				handles[rec.hDev] = acquired;
+			return res;
+		}
+
+		case PerfRelinquishDev: {
+			const DWORD res = RelinquishDev(hDev);
+			handles.erase(rec.hDev);
+			return res;
+		}
+
+		default:
+			return STATUS_NOT_SUPPORTED;
+	}
+}
+
+}  // namespace
+
+DWORD Replay_Run(const char * fileName, FLOAT speed, ReplayStats & stats)
+{
+	std::vector<BYTE> data;
+	const DWORD res = Trace_ReadFile(fileName, data);
+	if (res != STATUS_SUCCESS)
+		return res;
+
+	TraceFileHeader header;
+	if (data.size() < sizeof(header))
+		return STATUS_FILE_CORRUPT_ERROR;
+	memcpy(&header, data.data(), sizeof(header));
+	if (memcmp(header.Magic, TRACE_MAGIC, sizeof(header.Magic)) || header.Version != TRACE_VERSION ||
+		header.DataBytes > data.size() - sizeof(header))
+		return STATUS_FILE_CORRUPT_ERROR;
+
+	std::vector<TraceRecord> records;
+	const BYTE * p = data.data() + sizeof(header);
+	const BYTE * const end = p + header.DataBytes;
+	ULONGLONG prevNs = 0;
+	TraceRecord rec;
+	while (Trace_Decode(p, end, rec, prevNs)) {
+		if (rec.Api == TRACE_API_DROPPED)
+			stats.Dropped += (DWORD)rec.Value;
+		else
+			records.push_back(rec);
+	}
+	if (p != end)
+		return STATUS_FILE_CORRUPT_ERROR;
+
+	// Threads push their records in the order they finish; replay them in the order they started
+	std::stable_sort(records.begin(), records.end(), [](const TraceRecord & a, const TraceRecord & b) {
+		return a.TimeNs < b.TimeNs;
+	});
+
+	ReplayHandles handles;
+	const PerfClock::time_point start = PerfClock::now();
+	for (const TraceRecord & call : records) {
+		HDEVICE hDev = INVALID_DEV;
+		if (call.Api == PerfAcquireDev) {
+			if (call.Status != STATUS_SUCCESS) {
+				++stats.Skipped;
+				continue;
+			}
+		}
+		else {
+			const auto handle = handles.find(call.hDev);
+			if (handle == handles.end()) {
+				++stats.Skipped;
+				continue;
+			}
+			hDev = handle->second;
+		}
+
+		if (speed > 0) {
+			const PerfClock::time_point due = start + std::chrono::nanoseconds((LONGLONG)(call.TimeNs / speed));
+			Replay_WaitUntil(due);
+			Perf_Sample(stats.Lag, Perf_Ns(PerfClock::now() - due));
+		}
+
+		const PerfClock::time_point callStart = PerfClock::now();
+		const DWORD callRes = Replay_Call(call, hDev, handles);
+		Perf_Sample(stats.Latency[call.Api], Perf_Ns(PerfClock::now() - callStart));
+
+		++stats.Calls;
+		if (callRes)
+			++stats.Errors;
+		if (callRes != call.Status)
+			++stats.Mismatches;
+	}
+	stats.ElapsedNs = Perf_Ns(PerfClock::now() - start);
+
+	// Leave the devices as they were before the replay
+	for (const auto & handle : handles)
+		RelinquishDev(handle.second);
+	return STATUS_SUCCESS;
+}
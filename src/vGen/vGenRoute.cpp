@@ -0,0 +1,269 @@
+// vGenRoute.cpp : Control routing (SetControlRoutes).
+//
+// The table is compiled into one array sorted by source control, so the routes of a device are a range of it and the
+// routes of one control are next to each other. Backend_Submit() runs a device's range: each routed control is read
+// once, and only the routes of those that changed since the last report run. A RouteCombine route is in the array
+// twice, once for each of its buttons. Values are in the units of the Common API (RouteKind), so routes work between
+// devices of any type.
+
+#include "stdafx.h"
+#include "Private.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace vGenNS;
+
+namespace {
+
+#define ROUTE_UNSET   ((LONG)0x80000000)  // Last of a route that has yet to run
+#define ROUTE_CENTER  0x4000
+
+struct CompiledRoute
+{
+	ULONGLONG Key;       // Source device, kind and index; the array is sorted by it
+	ControlRoute Route;
+	UINT Index;          // Source control: SrcIndex, or SrcIndex2 for the second entry of a RouteCombine route
+	LONG Last;           // Value of the source control when the route last ran
+	bool On;             // RouteThreshold: the output
+	bool Pending;        // Changed DstDev, another device than the source, for Route_Submit() to send
+};
+
+std::vector<CompiledRoute> g_routes;  // Under g_reportLock
+thread_local UINT t_routeDepth = 0;   // Route_Submit() nesting
+
+ULONGLONG Route_Key(HDEVICE hDev, RouteKind kind, UINT index)
+{
+	return ((ULONGLONG)(UINT)hDev << 32) | ((ULONGLONG)kind << 16) | (index & 0xFFFF);
+}
+
+DWORD Route_Read(const DEVICE & dev, RouteKind kind, UINT index, LONG & value)
+{
+	switch (kind) {
+		case RouteAxis:
+			return Control_GetAxis(dev, (HID_USAGES)index, value);
+		case RouteButton: {
+			BOOL press = FALSE;
+			const DWORD res = Report_GetButton(dev, index, press);
+			value = press ? 1 : 0;
+			return res;
+		}
+		case RoutePov: {
+			if (index > 0xFF)
+				return STATUS_INVALID_PARAMETER_2;
+			DWORD pov = 0;
+			const DWORD res = Control_GetPov(dev, (UCHAR)index, pov);
+			value = (LONG)pov;
+			return res;
+		}
+		default:
+			return STATUS_INVALID_PARAMETER_1;
+	}
+}
+
+DWORD Route_Write(DEVICE & dev, RouteKind kind, UINT index, LONG value)
+{
+	switch (kind) {
+		case RouteAxis:
+			return Control_SetAxis(dev, (HID_USAGES)index, value);
+		case RouteButton:
+			return Control_SetButton(dev, index, value != 0);
+		case RoutePov:
+			return Control_SetPov(dev, (UCHAR)index, (DWORD)value);
+		default:
+			return STATUS_INVALID_PARAMETER_1;
+	}
+}
+
+DWORD Route_Check(const ControlRoute & route)
+{
+	const PDEVICE pSrc = GetDevice(route.SrcDev);
+	const PDEVICE pDst = GetDevice(route.DstDev);
+	if (!pSrc || !pDst)
+		return STATUS_INVALID_HANDLE;
+
+	const bool axes = route.SrcKind == RouteAxis && route.DstKind == RouteAxis;
+	bool kinds;
+	switch (route.Transform) {
+		case RouteDirect:
+			kinds = route.SrcKind == route.DstKind;
+			break;
+		case RouteInvert:
+			kinds = route.SrcKind == route.DstKind && route.SrcKind != RoutePov;
+			break;
+		case RouteScale:
+			kinds = axes && std::isfinite(route.Scale);
+			break;
+		case RouteSplitLow:
+		case RouteSplitHigh:
+			kinds = axes;
+			break;
+		case RouteThreshold:
+			kinds = route.SrcKind == RouteAxis && route.DstKind == RouteButton && route.Hysteresis >= 0;
+			break;
+		case RouteButtonToAxis:
+		case RouteCombine:
+			kinds = route.SrcKind == RouteButton && route.DstKind == RouteAxis;
+			break;
+		default:
+			kinds = false;
+			break;
+	}
+
+	LONG value;
+	if (!kinds || Route_Read(*pSrc, route.SrcKind, route.SrcIndex, value) != STATUS_SUCCESS ||
+		Route_Read(*pDst, route.DstKind, route.DstIndex, value) != STATUS_SUCCESS)
+		return STATUS_INVALID_PARAMETER_1;
+	if (route.Transform == RouteCombine &&
+		(route.SrcIndex2 == route.SrcIndex || Route_Read(*pSrc, RouteButton, route.SrcIndex2, value) != STATUS_SUCCESS))
+		return STATUS_INVALID_PARAMETER_1;
+	return STATUS_SUCCESS;
+}
+
+// Sets the destination from the source's value; true if it went through
+bool Route_Run(CompiledRoute & compiled, const DEVICE & src, DEVICE & dst, LONG value)
+{
+	const ControlRoute & route = compiled.Route;
+	LONG out;
+	switch (route.Transform) {
+		case RouteInvert:
+			out = route.SrcKind == RouteButton ? !value : 0x7FFF - value;
+			break;
+		case RouteScale:
+			out = (LONG)std::min(std::max(value * (double)route.Scale + route.Offset, 0.0), (double)0x7FFF);
+			break;
+		case RouteThreshold:
+			if (value >= route.Threshold)
+				compiled.On = true;
+			else if (value < route.Threshold - route.Hysteresis)
+				compiled.On = false;
+			out = compiled.On;
+			break;
+		case RouteButtonToAxis:
+			out = value ? route.OnValue : route.OffValue;
+			break;
+		case RouteSplitLow:
+			out = value < ROUTE_CENTER ? (ROUTE_CENTER - value) * 0x7FFF / ROUTE_CENTER : 0;
+			break;
+		case RouteSplitHigh:
+			out = value > ROUTE_CENTER ? (value - ROUTE_CENTER) * 0x7FFF / (0x7FFF - ROUTE_CENTER) : 0;
+			break;
+		case RouteCombine: {
+			BOOL low = FALSE, high = FALSE;
+			Report_GetButton(src, route.SrcIndex, low);
+			Report_GetButton(src, route.SrcIndex2, high);
+			out = low == high ? ROUTE_CENTER : high ? 0x7FFF : 0;
+			break;
+		}
+		case RouteDirect:
+		default:
+			out = value;
+			break;
+	}
+	return Route_Write(dst, route.DstKind, route.DstIndex, out) == STATUS_SUCCESS;
+}
+
+// Sets every device's range of g_routes
+void Route_Index(void)
+{
+	for (DevContainer_cit it = DevContainer_cref.cbegin(); it != DevContainer_cref.cend(); ++it) {
+		const PDEVICE pDev = GetDevice(it->first);
+		pDev->RouteFirst = pDev->RouteEnd = 0;
+	}
+	for (UINT first = 0, end; first < g_routes.size(); first = end) {
+		const HDEVICE hDev = g_routes[first].Route.SrcDev;
+		for (end = first + 1; end < g_routes.size() && g_routes[end].Route.SrcDev == hDev; ++end)
+			;
+		const PDEVICE pDev = GetDevice(hDev);
+		pDev->RouteFirst = first;
+		pDev->RouteEnd = end;
+	}
+}
+
+}  // namespace
+
+DWORD Route_Set(const ControlRoute * routes, UINT count, UINT & bad)
+{
+	bad = 0;
+	if ((!routes && count) || count > ROUTE_MAX_ROUTES)
+		return STATUS_INVALID_PARAMETER_1;
+
+	std::vector<CompiledRoute> table;
+	table.reserve(count);
+	for (UINT i = 0; i < count; ++i) {
+		const ControlRoute & route = routes[i];
+		const DWORD res = Route_Check(route);
+		if (res != STATUS_SUCCESS) {
+			bad = i;
+			return res;
+		}
+		table.push_back({ Route_Key(route.SrcDev, route.SrcKind, route.SrcIndex), route, route.SrcIndex, ROUTE_UNSET, false, false });
+		if (route.Transform == RouteCombine)
+			table.push_back({ Route_Key(route.SrcDev, RouteButton, route.SrcIndex2), route, route.SrcIndex2, ROUTE_UNSET, false, false });
+	}
+	std::stable_sort(table.begin(), table.end(), [](const CompiledRoute & a, const CompiledRoute & b) { return a.Key < b.Key; });
+
+	g_routes.swap(table);
+	Route_Index();
+
+	// Every route has yet to run: one report of each source runs them all
+	for (DevContainer_cit it = DevContainer_cref.cbegin(); it != DevContainer_cref.cend(); ++it) {
+		const PDEVICE pDev = GetDevice(it->first);
+		if (pDev->RouteFirst != pDev->RouteEnd)
+			Backend_Submit(*pDev);
+	}
+	return STATUS_SUCCESS;
+}
+
+void Route_RemoveDevice(HDEVICE hDev)
+{
+	const auto end = std::remove_if(g_routes.begin(), g_routes.end(),
+		[hDev](const CompiledRoute & r) { return r.Route.SrcDev == hDev || r.Route.DstDev == hDev; });
+	if (end == g_routes.end())
+		return;
+	g_routes.erase(end, g_routes.end());
+	Route_Index();
+}
+
+void Route_Update(DEVICE & dev)
+{
+	ULONGLONG key = ~0ULL;
+	LONG value = 0;
+	bool read = false;
+	for (UINT i = dev.RouteFirst; i < dev.RouteEnd; ++i) {
+		CompiledRoute & compiled = g_routes[i];
+		if (compiled.Key != key) {
+			key = compiled.Key;
+			read = Route_Read(dev, compiled.Route.SrcKind, compiled.Index, value) == STATUS_SUCCESS;
+		}
+		if (!read || value == compiled.Last)
+			continue;
+
+		compiled.Last = value;
+		const bool own = compiled.Route.DstDev == dev.Handle;
+		const PDEVICE pDst = own ? &dev : GetDevice(compiled.Route.DstDev);
+		if (pDst && Route_Run(compiled, dev, *pDst, value) && !own)
+			compiled.Pending = true;
+	}
+}
+
+void Route_Submit(DEVICE & dev)
+{
+	const bool deep = t_routeDepth >= ROUTE_MAX_DEPTH;
+	++t_routeDepth;
+	for (UINT i = dev.RouteFirst; i < dev.RouteEnd; ++i) {
+		if (!g_routes[i].Pending)
+			continue;
+
+		// One report for all the routes to the device
+		const HDEVICE hDst = g_routes[i].Route.DstDev;
+		for (UINT j = i; j < dev.RouteEnd; ++j) {
+			if (g_routes[j].Route.DstDev == hDst)
+				g_routes[j].Pending = false;
+		}
+		const PDEVICE pDst = GetDevice(hDst);
+		if (pDst && !deep)
+			Backend_Submit(*pDst);
+	}
+	--t_routeDepth;
+}
@@ -0,0 +1,247 @@
+// vGenShm.cpp : Shared-memory command channels (OpenShmChannel), the owner side. See ShmChannel.h.
+//
+// Every channel has a thread that drains its ring and applies the messages as the daemon does (vGenDaemon.cpp):
+// control changes only touch the report, VgenCmdCommit sends it. The devices a channel acquired are its own; closing
+// the channel, or the feeder's VgenCmdBye, releases them.
+
+#include "stdafx.h"
+#include "Private.h"
+#include "ShmChannel.h"
+
+#include <string>
+
+using namespace vGenNS;
+
+namespace {
+
+#define SHM_DRAIN_BATCH  64    // Messages applied per pass
+#define SHM_WAIT_MS      1000  // Longest sleep; the thread then looks at the ring again
+
+class ShmChannel
+{
+public:
+	~ShmChannel()
+	{
+		// Shm_Close() normally stopped the thread. Joining it here, under the loader lock, could dead-lock.
+		if (m_thread.joinable())
+			m_thread.detach();
+	}
+
+	DWORD Start(const char * name)
+	{
+		const DWORD res = m_map.Create(name);
+		if (res != STATUS_SUCCESS)
+			return res;
+		m_stop = false;
+		m_thread = std::thread(&ShmChannel::Run, this);
+		return STATUS_SUCCESS;
+	}
+
+	void Stop()
+	{
+		m_stop = true;
+		m_map.Block()->Open = 0;
+		m_map.Wake();
+		if (m_thread.joinable())
+			m_thread.join();
+
+		ReleaseAll();
+		m_map.Close();
+	}
+
+	void GetStats(ShmChannelStats & stats)
+	{
+		std::lock_guard<std::mutex> lock(m_statsLock);
+		stats = m_stats;
+		stats.Attached = m_map.Block()->Producer != 0;
+		stats.Pending = (UINT)m_map.Block()->Ring.Size();
+	}
+
+private:
+	void Run()
+	{
+		ShmChannelBlock & block = *m_map.Block();
+		VgenMsg batch[SHM_DRAIN_BATCH];
+		while (!m_stop) {
+			const size_t first = block.Ring.Popped();
+			const size_t count = block.Ring.Drain(batch, SHM_DRAIN_BATCH);
+			if (!count) {
+				// Sleeping before the last look at the ring: a push after it finds Sleeping set and wakes us
+				block.Sleeping = 1;
+				if (block.Ring.Empty() && !m_stop) {
+					m_map.Wait(SHM_WAIT_MS);
+					std::lock_guard<std::mutex> lock(m_statsLock);
+					++m_stats.Sleeps;
+				}
+				block.Sleeping = 0;
+				continue;
+			}
+
+			ULONGLONG errors = 0, commits = 0;
+			bool bye = false;
+			for (size_t i = 0; i < count; ++i) {
+				bye |= batch[i].Cmd == VgenCmdBye;
+				const DWORD res = Apply(batch[i], commits);
+				if (res != STATUS_SUCCESS) {
+					++errors;
+					block.LastFailure = res;
+					block.Failures.fetch_add(1);
+				}
+				// The drained messages left the ring before they were applied; a Sync() waits for this
+				block.Consumed.store(first + i + 1, std::memory_order_release);
+			}
+			if (bye)
+				block.Producer = 0;  // Only now, so the next feeder starts counting after the last feeder's messages
+
+			std::lock_guard<std::mutex> lock(m_statsLock);
+			m_stats.Messages += count;
+			m_stats.Commits += commits;
+			m_stats.Errors += errors;
+		}
+	}
+
+	DWORD Apply(const VgenMsg & msg, ULONGLONG & commits)
+	{
+		switch (msg.Cmd) {
+			case VgenCmdAcquire: {
+				DevType type;
+				UINT id;
+				if (!Control_ParseDevice(msg.Device, type, id))
+					return STATUS_INVALID_PARAMETER_2;
+				if (m_devices.count(msg.Device))
+					return STATUS_SUCCESS;
+				HDEVICE hDev = INVALID_DEV;
+				const DWORD res = AcquireDev(id, type, &hDev);
+				if (res == STATUS_SUCCESS)
+					m_devices[msg.Device] = { hDev, false };
+				return res;
+			}
+
+			case VgenCmdRelease: {
+				const auto it = m_devices.find(msg.Device);
+				if (it == m_devices.end())
+					return STATUS_RESOURCE_NOT_OWNED;
+				const HDEVICE hDev = it->second.Handle;
+				m_devices.erase(it);
+				return RelinquishDev(hDev);
+			}
+
+			case VgenCmdButton:
+			case VgenCmdAxis:
+			case VgenCmdPov:
+			case VgenCmdReset: {
+				std::lock_guard<std::mutex> lock(g_reportLock);
+				const auto it = m_devices.find(msg.Device);
+				const PDEVICE pDev = it != m_devices.end() ? GetDevice(it->second.Handle) : nullptr;
+				if (!pDev)
+					return STATUS_RESOURCE_NOT_OWNED;
+				const DWORD res = Control_Apply(*pDev, msg);
+				if (res == STATUS_SUCCESS)
+					it->second.Changed = true;
+				return res;
+			}
+
+			case VgenCmdCommit: {
+				std::lock_guard<std::mutex> lock(g_reportLock);
+				DWORD res = STATUS_SUCCESS;
+				for (auto & device : m_devices) {
+					if (msg.Device && msg.Device != device.first)
+						continue;
+					const PDEVICE pDev = GetDevice(device.second.Handle);
+					if (!pDev || !device.second.Changed)
+						continue;
+					const DWORD submitted = Backend_Submit(*pDev);
+					if (submitted == STATUS_SUCCESS) {
+						device.second.Changed = false;
+						++commits;
+					}
+					else if (res == STATUS_SUCCESS)
+						res = submitted;
+				}
+				return msg.Device && !m_devices.count(msg.Device) ? STATUS_RESOURCE_NOT_OWNED : res;
+			}
+
+			case VgenCmdBye:
+				ReleaseAll();
+				return STATUS_SUCCESS;
+
+			default:
+				return STATUS_INVALID_DEVICE_REQUEST;
+		}
+	}
+
+	void ReleaseAll()
+	{
+		for (const auto & device : m_devices)
+			RelinquishDev(device.second.Handle);
+		m_devices.clear();
+	}
+
+	struct HeldDevice
+	{
+		HDEVICE Handle;
+		bool Changed;  // The report changed since the last commit
+	};
+
+	ShmChannelMap m_map;
+	std::thread m_thread;
+	std::atomic_bool m_stop {false};
+	std::map<int32_t, HeldDevice> m_devices;  // By protocol device number; channel thread, then Stop()
+
+	std::mutex m_statsLock;
+	ShmChannelStats m_stats;  // under m_statsLock
+};
+
+std::mutex g_shmLock;
+std::map<std::string, std::unique_ptr<ShmChannel>> g_shmChannels;  // under g_shmLock
+
+}  // namespace
+
+DWORD Shm_Open(const char * name)
+{
+	std::lock_guard<std::mutex> lock(g_shmLock);
+	if (g_shmChannels.count(name))
+		return STATUS_DEVICE_BUSY;
+
+	std::unique_ptr<ShmChannel> channel(new ShmChannel);
+	const DWORD res = channel->Start(name);
+	if (res == STATUS_SUCCESS)
+		g_shmChannels[name] = std::move(channel);
+	return res;
+}
+
+DWORD Shm_Close(const char * name)
+{
+	std::unique_ptr<ShmChannel> channel;
+	{
+		std::lock_guard<std::mutex> lock(g_shmLock);
+		const auto it = g_shmChannels.find(name);
+		if (it == g_shmChannels.end())
+			return STATUS_INVALID_PARAMETER_1;
+		channel = std::move(it->second);
+		g_shmChannels.erase(it);
+	}
+	channel->Stop();
+	return STATUS_SUCCESS;
+}
+
+void Shm_CloseAll(void)
+{
+	std::map<std::string, std::unique_ptr<ShmChannel>> channels;
+	{
+		std::lock_guard<std::mutex> lock(g_shmLock);
+		channels.swap(g_shmChannels);
+	}
+	for (auto & channel : channels)
+		channel.second->Stop();
+}
+
+DWORD Shm_GetStats(const char * name, ShmChannelStats & stats)
+{
+	std::lock_guard<std::mutex> lock(g_shmLock);
+	const auto it = g_shmChannels.find(name);
+	if (it == g_shmChannels.end())
+		return STATUS_INVALID_PARAMETER_1;
+	it->second->GetStats(stats);
+	return STATUS_SUCCESS;
+}
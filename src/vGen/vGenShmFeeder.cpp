@@ -0,0 +1,143 @@
+// vGenShmFeeder.cpp : Feeder side of the shared-memory channel (vGenShmFeeder.h).
+
+#include "vGenShmFeeder.h"
+
+#include <chrono>
+#include <thread>
+
+namespace {
+
+// Spins briefly, then naps: the channel thread applies a batch in microseconds. False on timeout.
+template <typename Done>
+bool ShmFeeder_WaitFor(Done done, DWORD timeoutMs)
+{
+	const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+	for (unsigned spins = 0; !done(); ++spins) {
+		if (std::chrono::steady_clock::now() >= deadline)
+			return false;
+		if (spins < 1000)
+			std::this_thread::yield();
+		else
+			std::this_thread::sleep_for(std::chrono::microseconds(100));
+	}
+	return true;
+}
+
+}  // namespace
+
+vGenShmFeeder::~vGenShmFeeder()
+{
+	Close();
+}
+
+DWORD vGenShmFeeder::Open(const char * name)
+{
+	Close();
+	const DWORD res = m_map.Open(name);
+	if (res != STATUS_SUCCESS)
+		return res;
+
+	ShmChannelBlock & block = *m_map.Block();
+	uint32_t expected = 0;
+	if (!block.Producer.compare_exchange_strong(expected, 1)) {
+		m_map.Close();
+		return STATUS_DEVICE_BUSY;
+	}
+
+	// Whatever a previous feeder left in the ring counts as pushed before us
+	m_pushed = block.Ring.Pushed();
+	m_failures = block.Failures;
+	return STATUS_SUCCESS;
+}
+
+void vGenShmFeeder::Close()
+{
+	if (!Opened())
+		return;
+
+	// The channel releases our devices and clears Producer when it gets the Bye. Waiting for that lets the next
+	// feeder open the channel at once; a channel that can't take the Bye in time is given up on.
+	ShmChannelBlock & block = *m_map.Block();
+	if (Push(VgenCmdBye, 0, 0, 0) != STATUS_SUCCESS ||
+		!ShmFeeder_WaitFor([&block] { return !block.Producer || !block.Open; }, 1000))
+		block.Producer = 0;
+	m_map.Close();
+}
+
+DWORD vGenShmFeeder::Acquire(int device, DWORD timeoutMs)
+{
+	const DWORD res = Push(VgenCmdAcquire, device, 0, 0);
+	return res == STATUS_SUCCESS ? Sync(timeoutMs) : res;
+}
+
+DWORD vGenShmFeeder::Release(int device, DWORD timeoutMs)
+{
+	const DWORD res = Push(VgenCmdRelease, device, 0, 0);
+	return res == STATUS_SUCCESS ? Sync(timeoutMs) : res;
+}
+
+DWORD vGenShmFeeder::SetButton(int device, UINT button, BOOL pressed)
+{
+	return Push(VgenCmdButton, device, (uint16_t)button, pressed ? 1 : 0);
+}
+
+DWORD vGenShmFeeder::SetAxis(int device, vGenNS::HID_USAGES axis, LONG value)
+{
+	return Push(VgenCmdAxis, device, (uint16_t)axis, value);
+}
+
+DWORD vGenShmFeeder::SetPov(int device, UCHAR pov, DWORD value)
+{
+	return Push(VgenCmdPov, device, pov, (int32_t)value);
+}
+
+DWORD vGenShmFeeder::Reset(int device)
+{
+	return Push(VgenCmdReset, device, 0, 0);
+}
+
+DWORD vGenShmFeeder::Commit(int device)
+{
+	return Push(VgenCmdCommit, device, 0, 0);
+}
+
+DWORD vGenShmFeeder::Sync(DWORD timeoutMs)
+{
+	if (!Opened())
+		return STATUS_DEVICE_NOT_CONNECTED;
+
+	const ShmChannelBlock & block = *m_map.Block();
+	const uint64_t target = m_pushed;
+	if (!ShmFeeder_WaitFor([&block, target] { return block.Consumed.load(std::memory_order_acquire) >= target || !block.Open; }, timeoutMs))
+		return STATUS_TIMEOUT;
+	if (block.Consumed.load(std::memory_order_acquire) < target)
+		return STATUS_DEVICE_NOT_CONNECTED;
+
+	const uint32_t failures = block.Failures;
+	if (failures == m_failures)
+		return STATUS_SUCCESS;
+	m_failures = failures;
+	return block.LastFailure;
+}
+
+DWORD vGenShmFeeder::Push(uint8_t cmd, int device, uint16_t index, int32_t value)
+{
+	if (!Opened())
+		return STATUS_DEVICE_NOT_CONNECTED;
+	ShmChannelBlock & block = *m_map.Block();
+	if (!block.Open)
+		return STATUS_DEVICE_NOT_CONNECTED;
+
+	VgenMsg msg;
+	msg.Cmd = cmd;
+	msg.Flags = 0;
+	msg.Index = index;
+	msg.Device = device;
+	msg.Value = value;
+	msg.Status = 0;
+	if (!block.Ring.Push(msg))
+		return STATUS_DEVICE_BUSY;
+	m_pushed = block.Ring.Pushed();
+	m_map.Wake();
+	return STATUS_SUCCESS;
+}
@@ -0,0 +1,59 @@
+//////////////////////////////////////////////////////////
+//
+// vGen shared-memory channel feeder
+//
+// Feeds devices through a channel opened with OpenShmChannel()
+// in another process, see ShmChannel.h. Every call is a push
+// into the channel's ring: plain memory writes, plus a wake
+// when the channel's thread sleeps. Nothing comes back per
+// message; Sync() waits until the channel applied everything
+// pushed so far and reports failures since the last Sync().
+//
+// Needs only this header, ShmChannel.h, SpscRing.h,
+// vGenProtocol.h and vGenInterface.h; it does not link the
+// vGen library. One feeder per channel, on one thread.
+//
+//////////////////////////////////////////////////////////
+#pragma once
+
+#include "vGenInterface.h"
+#include "ShmChannel.h"
+
+class vGenShmFeeder
+{
+public:
+	vGenShmFeeder() = default;
+	~vGenShmFeeder();
+	vGenShmFeeder(const vGenShmFeeder &) = delete;
+	vGenShmFeeder & operator=(const vGenShmFeeder &) = delete;
+
+	// STATUS_DEVICE_BUSY if another feeder has the channel open
+	DWORD Open(const char * name);
+	// Releases the devices this feeder acquired; returns once the channel did
+	void Close();
+
+	// Pushed, then synced: returns the channel's answer
+	DWORD Acquire(int device, DWORD timeoutMs = 1000);
+	DWORD Release(int device, DWORD timeoutMs = 1000);
+
+	// Pushed only. STATUS_DEVICE_BUSY if the ring is full; failures are reported by Sync().
+	DWORD SetButton(int device, UINT button, BOOL pressed);
+	DWORD SetAxis(int device, vGenNS::HID_USAGES axis, LONG value);
+	DWORD SetPov(int device, UCHAR pov, DWORD value);
+	DWORD Reset(int device);
+	// Sends device's report (0: every device this feeder holds) if it changed
+	DWORD Commit(int device = 0);
+
+	// Waits until the channel applied every message pushed so far. Returns STATUS_TIMEOUT, or the last failure since
+	// the previous Sync(), or STATUS_SUCCESS.
+	DWORD Sync(DWORD timeoutMs);
+
+	bool Opened() const { return m_map.Block() != nullptr; }
+
+private:
+	DWORD Push(uint8_t cmd, int device, uint16_t index, int32_t value);
+
+	ShmChannelMap m_map;
+	uint64_t m_pushed = 0;    // Ring position after our last push, Sync() waits until Consumed reaches it
+	uint32_t m_failures = 0;  // Failures at the last Sync()
+};
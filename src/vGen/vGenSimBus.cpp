@@ -0,0 +1,371 @@
+// vGenSimBus.cpp : The simulated backend. An in-memory bus with every device type, for testing and benchmarking
+// without the drivers (BackendSimulated).
+//
+// The bus keeps its own copy of each plugged in device's report, as a driver would. Operations can be delayed and
+// made to fail on a schedule (SimBusConfig), so callers can be tested against a slow or unreliable bus. Physical XInput
+// controllers can be played as well (SetSimBusPad), and so can the host's feedback (SendSimBusFeedback, or raw DS4
+// output reports with SendSimBusDs4Report).
+
+#include "stdafx.h"
+#include "Private.h"
+
+#include <chrono>
+
+using namespace vGenNS;
+
+#define SIM_VJOY_SLOTS     16
+#define SIM_GAMEPAD_SLOTS  4
+#define SIM_SLOTS          (SIM_VJOY_SLOTS + 3 * SIM_GAMEPAD_SLOTS)
+#define SIM_PAD_SLOTS      4  // XInput user indexes
+
+namespace {
+
+struct SimSlot
+{
+	bool Plugged = false;
+	PDEVICE Device = nullptr;  // Device plugged in here, valid until Release()
+	union
+	{
+		JOYSTICK_POSITION_V2 vJoy;
+		XINPUT_GAMEPAD xbox;
+		DS4_REPORT ds4;
+	} Report;
+};
+
+// Busy-waits, as a blocking driver call would keep the caller
+void Sim_Delay(DWORD ns)
+{
+	if (!ns)
+		return;
+
+	PerfDriverScope driver;
+	const PerfClock::time_point due = PerfClock::now() + std::chrono::nanoseconds(ns);
+	while (PerfClock::now() < due)
+		;
+}
+
+class SimBackend : public DeviceBackend
+{
+public:
+	DWORD BusStatus(DevType type) override
+	{
+		return Range(type) ? STATUS_SUCCESS : STATUS_INVALID_PARAMETER_1;
+	}
+
+	DWORD BusVersion(DevType) override
+	{
+		return 0;
+	}
+
+	VjdStat SlotStatus(DevType type, UINT id) override
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		const SimSlot * slot = Slot(type, id);
+		if (!slot)
+			return VJD_STAT_MISS;
+		return slot->Plugged ? VJD_STAT_OWN : VJD_STAT_FREE;
+	}
+
+	DWORD Plug(DEVICE & dev) override
+	{
+		DWORD res;
+		DWORD latency;
+		{
+			std::lock_guard<std::mutex> lock(m_lock);
+			latency = m_config.PlugLatencyNs;
+			res = Plug_Locked(dev);
+		}
+		Sim_Delay(latency);
+		return res;
+	}
+
+	DWORD Unplug(DEVICE & dev) override
+	{
+		DWORD res;
+		DWORD latency;
+		{
+			std::lock_guard<std::mutex> lock(m_lock);
+			latency = m_config.PlugLatencyNs;
+			SimSlot * slot = Slot(dev.Type, dev.Id);
+			if (!slot || !slot->Plugged || slot->Device != &dev)
+				res = STATUS_RESOURCE_NOT_OWNED;
+			else if ((res = Fail(SimOpUnplug)) == STATUS_SUCCESS) {
+				slot->Plugged = false;
+				slot->Device = nullptr;
+				++m_stats.Unplugs;
+			}
+		}
+		Sim_Delay(latency);
+		return res;
+	}
+
+	DWORD Submit(DEVICE & dev, const DEVICE & report) override
+	{
+		DWORD res;
+		DWORD latency;
+		{
+			std::lock_guard<std::mutex> lock(m_lock);
+			latency = m_config.SubmitLatencyNs;
+			SimSlot * slot = Slot(dev.Type, dev.Id);
+			if (!slot || !slot->Plugged || slot->Device != &dev)
+				res = STATUS_DEVICE_NOT_CONNECTED;
+			else if ((res = Fail(SimOpSubmit)) == STATUS_SUCCESS) {
+				memcpy(&slot->Report, report.PPosition.vJoyPos, GetDevicePosSize(dev));
+				++m_stats.Submits;
+			}
+		}
+		Sim_Delay(latency);
+		return res;
+	}
+
+	DWORD Read(const DEVICE & dev, PVOID report) override
+	{
+		DWORD res;
+		DWORD latency;
+		{
+			std::lock_guard<std::mutex> lock(m_lock);
+			latency = m_config.ReadLatencyNs;
+			const SimSlot * slot = Slot(dev.Type, dev.Id);
+			if (!slot || !slot->Plugged || slot->Device != &dev)
+				res = STATUS_DEVICE_NOT_CONNECTED;
+			else if ((res = Fail(SimOpRead)) == STATUS_SUCCESS) {
+				memcpy(report, &slot->Report, GetDevicePosSize(dev));
+				++m_stats.Reads;
+			}
+		}
+		Sim_Delay(latency);
+		return res;
+	}
+
+	void Release(DEVICE & dev) override
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		SimSlot * slot = Slot(dev.Type, dev.Id);
+		if (slot && slot->Device == &dev) {
+			slot->Plugged = false;
+			slot->Device = nullptr;
+		}
+	}
+
+	DWORD PadState(UINT slot, XINPUT_STATE & state) override
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		if (slot >= SIM_PAD_SLOTS || !m_padPlugged[slot])
+			return STATUS_DEVICE_NOT_CONNECTED;
+		state = m_pads[slot];
+		return STATUS_SUCCESS;
+	}
+
+	DWORD SetConfig(const SimBusConfig & config)
+	{
+		if (config.vJoyButtons > 128 || config.vJoyDiscPovs > 4 || config.vJoyContPovs > 4 ||
+			(config.vJoyDiscPovs && config.vJoyContPovs))
+			return STATUS_INVALID_PARAMETER_1;
+
+		std::lock_guard<std::mutex> lock(m_lock);
+		m_config = config;
+		m_stats = SimBusStats();
+		m_failCounter = 0;
+		return STATUS_SUCCESS;
+	}
+
+	void GetStats(SimBusStats & stats)
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		stats = m_stats;
+	}
+
+	DWORD GetReport(DevType type, UINT id, PVOID report)
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		const SimSlot * slot = Slot(type, id);
+		if (!slot)
+			return STATUS_INVALID_PARAMETER_2;
+		if (!slot->Plugged)
+			return STATUS_DEVICE_NOT_CONNECTED;
+
+		memcpy(report, &slot->Report, GetDevicePosSize(*slot->Device));
+		return STATUS_SUCCESS;
+	}
+
+	DWORD SendFeedback(DevType type, UINT id, FeedbackData data)
+	{
+		if (type != DevType::vgeXbox && type != DevType::vgeDS4)
+			return STATUS_INVALID_PARAMETER_1;
+
+		std::lock_guard<std::mutex> lock(m_lock);
+		const SimSlot * slot = Slot(type, id);
+		if (!slot)
+			return STATUS_INVALID_PARAMETER_2;
+		if (!slot->Plugged)
+			return STATUS_DEVICE_NOT_CONNECTED;
+
+		// Same as the ViGEm notifications: the selected members go to DevInfo, the whole record to the queue
+		const BYTE fields = data.Flags ? data.Flags : (BYTE)(FeedbackRumble | (type == DevType::vgeXbox ? FeedbackLed : FeedbackLightbar));
+		Deliver(slot->Device, data, fields);
+		return STATUS_SUCCESS;
+	}
+
+	// The host writes a raw output report to a DS4, decoded as the reader decodes the ViGEm ones
+	DWORD SendDs4Report(UINT id, const DS4_OUTPUT_BUFFER & report)
+	{
+		FeedbackData data;
+		const BYTE fields = Ds4_DecodeOutputReport(report, data);
+		if (!fields)
+			return STATUS_INVALID_PARAMETER_2;
+
+		std::lock_guard<std::mutex> lock(m_lock);
+		const SimSlot * slot = Slot(DevType::vgeDS4, id);
+		if (!slot)
+			return STATUS_INVALID_PARAMETER_1;
+		if (!slot->Plugged)
+			return STATUS_DEVICE_NOT_CONNECTED;
+
+		Deliver(slot->Device, data, fields);
+		return STATUS_SUCCESS;
+	}
+
+	DWORD SetPad(UINT slot, const XINPUT_STATE * state)
+	{
+		if (slot >= SIM_PAD_SLOTS)
+			return STATUS_INVALID_PARAMETER_1;
+
+		std::lock_guard<std::mutex> lock(m_lock);
+		m_padPlugged[slot] = state != nullptr;
+		if (state)
+			m_pads[slot] = *state;
+		return STATUS_SUCCESS;
+	}
+
+private:
+	// Under m_lock
+	static void Deliver(PDEVICE pDev, const FeedbackData & data, BYTE fields)
+	{
+		if ((fields & FeedbackLed) && pDev->DevInfo.LedNumber != data.LedNumber)
+			InterlockedExchange8((CHAR *)&pDev->DevInfo.LedNumber, (CHAR)data.LedNumber);
+		if ((fields & FeedbackLightbar) && pDev->DevInfo.ColorBar != data.ColorBar)
+			InterlockedExchange((LONG *)&pDev->DevInfo.ColorBar, (LONG)data.ColorBar);
+		if (pDev->Feedback)
+			pDev->Feedback->Publish(data, fields);
+	}
+
+	static bool Range(DevType type)
+	{
+		return type == DevType::vJoy || type == DevType::vXbox || type == DevType::vgeXbox || type == DevType::vgeDS4;
+	}
+
+	SimSlot * Slot(DevType type, UINT id)
+	{
+		if (type == DevType::vJoy)
+			return id >= 1 && id <= SIM_VJOY_SLOTS ? &m_slots[id - 1] : nullptr;
+		if (!Range(type) || id < 1 || id > SIM_GAMEPAD_SLOTS)
+			return nullptr;
+		return &m_slots[SIM_VJOY_SLOTS + (type / 1000 - 1) * SIM_GAMEPAD_SLOTS + id - 1];
+	}
+
+	// Counts an operation and returns the status it has to fail with, STATUS_SUCCESS if it goes through
+	DWORD Fail(SimBusOps op)
+	{
+		if (!m_config.FailEvery || !(m_config.FailOps & op) || ++m_failCounter % m_config.FailEvery)
+			return STATUS_SUCCESS;
+
+		++m_stats.Failures;
+		return m_config.FailStatus ? m_config.FailStatus : STATUS_IO_DEVICE_ERROR;
+	}
+
+	DWORD Plug_Locked(DEVICE & dev)
+	{
+		SimSlot * slot = Slot(dev.Type, dev.Id);
+		if (!slot)
+			return STATUS_INVALID_PARAMETER_1;
+		if (slot->Plugged)
+			return STATUS_DEVICE_ALREADY_ATTACHED;
+
+		const DWORD res = Fail(SimOpPlug);
+		if (res != STATUS_SUCCESS)
+			return res;
+
+		dev.DevInfo = DeviceInfo();
+		dev.DevInfo.Serial = dev.Id;
+		switch (dev.Type) {
+			case DevType::vJoy:
+				dev.DevInfo.VendId = 0x1234;
+				dev.DevInfo.ProdId = 0xBEAD;
+				dev.Caps.Axes = 0xFF;  // X to SL1
+				dev.Caps.Buttons = m_config.vJoyButtons;
+				dev.Caps.DiscPovs = m_config.vJoyDiscPovs;
+				dev.Caps.ContPovs = m_config.vJoyContPovs;
+				break;
+
+			case DevType::vXbox:
+			case DevType::vgeXbox:
+				dev.DevInfo.VendId = 0x045E;
+				dev.DevInfo.ProdId = 0x028E;
+				dev.DevInfo.LedNumber = (BYTE)dev.Id;
+				break;
+
+			case DevType::vgeDS4:
+				dev.DevInfo.VendId = 0x054C;
+				dev.DevInfo.ProdId = 0x05C4;
+				break;
+
+			default:
+				break;
+		}
+		if ((dev.Type == DevType::vgeXbox || dev.Type == DevType::vgeDS4) && !dev.Feedback)
+			dev.Feedback = std::make_shared<DeviceFeedback>();
+
+		slot->Plugged = true;
+		slot->Device = &dev;
+		memcpy(&slot->Report, dev.PPosition.vJoyPos, GetDevicePosSize(dev));
+		++m_stats.Plugs;
+		return STATUS_SUCCESS;
+	}
+
+	std::mutex m_lock;
+	SimSlot m_slots[SIM_SLOTS];     // under m_lock
+	SimBusConfig m_config;          // under m_lock
+	SimBusStats m_stats;            // under m_lock
+	ULONGLONG m_failCounter = 0;    // under m_lock
+	XINPUT_STATE m_pads[SIM_PAD_SLOTS] = {};     // under m_lock
+	bool m_padPlugged[SIM_PAD_SLOTS] = {};       // under m_lock
+};
+
+SimBackend g_simBackend;
+
+}  // namespace
+
+DeviceBackend * Backend_Sim(void)
+{
+	return &g_simBackend;
+}
+
+DWORD Sim_SetConfig(const SimBusConfig & config)
+{
+	return g_simBackend.SetConfig(config);
+}
+
+void Sim_GetStats(SimBusStats & stats)
+{
+	g_simBackend.GetStats(stats);
+}
+
+DWORD Sim_GetReport(DevType type, UINT id, PVOID report)
+{
+	return g_simBackend.GetReport(type, id, report);
+}
+
+DWORD Sim_SendFeedback(DevType type, UINT id, const FeedbackData & data)
+{
+	return g_simBackend.SendFeedback(type, id, data);
+}
+
+DWORD Sim_SendDs4Report(UINT id, const DS4_OUTPUT_BUFFER & report)
+{
+	return g_simBackend.SendDs4Report(id, report);
+}
+
+DWORD Sim_SetPad(UINT slot, const XINPUT_STATE * state)
+{
+	return g_simBackend.SetPad(slot, state);
+}
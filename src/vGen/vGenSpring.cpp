@@ -0,0 +1,145 @@
+// vGenSpring.cpp : Spring-return axes (SetDevAxisSpring, ReleaseDevAxis).
+//
+// An axis let go of is a damped mass on a spring to its center, plus the pull of any detent it is close to. The timer
+// wheel (vGenTimer.cpp) steps every device with such an axis every SPRING_STEP_MS with semi-implicit Euler, which is
+// stable for the stiffness limits below. An axis is at rest once it is slow and barely pulled, and stays where it is.
+
+#include "stdafx.h"
+#include "Private.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace vGenNS;
+
+namespace {
+
+#define SPRING_MAX_STIFFNESS  10000.0f
+#define SPRING_MAX_DAMPING    1000.0f
+#define SPRING_FAR            -1e9f   // Position of an unused detent
+#define SPRING_REST_SPEED     2.0f    // Units/s
+#define SPRING_REST_ACCEL     40.0f   // Units/s^2
+
+// Index of the axis in AxisSprings, or SPRING_AXES
+UINT Spring_Index(HID_USAGES axis)
+{
+	return axis >= HID_USAGE_X && axis <= HID_USAGE_WHL ? axis - HID_USAGE_X : SPRING_AXES;
+}
+
+}  // namespace
+
+DWORD Spring_Set(DEVICE & dev, HID_USAGES axis, const AxisSpring * spring)
+{
+	const UINT a = Spring_Index(axis);
+	LONG value;
+	if (a == SPRING_AXES || Control_GetAxis(dev, axis, value) != STATUS_SUCCESS)
+		return STATUS_INVALID_PARAMETER_2;
+
+	if (!spring || !spring->Stiffness) {
+		if (dev.Springs) {
+			dev.Springs->Stiffness[a] = 0;
+			dev.Springs->Free[a] = 0;
+		}
+		return STATUS_SUCCESS;
+	}
+
+	const bool valid = spring->Stiffness > 0 && spring->Stiffness <= SPRING_MAX_STIFFNESS &&
+		spring->Damping >= 0 && spring->Damping <= SPRING_MAX_DAMPING &&
+		spring->DetentStiffness >= 0 && spring->DetentStiffness <= SPRING_MAX_STIFFNESS &&
+		spring->Center >= 0 && spring->Center <= 0x7FFF && spring->DetentWidth >= 0 && spring->DetentCount <= SPRING_DETENTS;
+	if (!valid)
+		return STATUS_INVALID_PARAMETER_3;
+
+	if (!dev.Springs)
+		dev.Springs = std::make_shared<AxisSprings>();
+	AxisSprings & springs = *dev.Springs;
+	springs.Stiffness[a] = spring->Stiffness;
+	springs.Damping[a] = spring->Damping;
+	springs.Center[a] = (float)spring->Center;
+	springs.DetentStiffness[a] = spring->DetentStiffness;
+	springs.DetentWidth[a] = (float)spring->DetentWidth;
+	for (UINT d = 0; d < SPRING_DETENTS; ++d)
+		springs.Detents[d][a] = d < spring->DetentCount ? (float)spring->Detents[d] : SPRING_FAR;
+	return STATUS_SUCCESS;
+}
+
+DWORD Spring_Release(DEVICE & dev, HID_USAGES axis)
+{
+	const UINT a = Spring_Index(axis);
+	LONG value;
+	if (a == SPRING_AXES || !dev.Springs || !dev.Springs->Stiffness[a] || Control_GetAxis(dev, axis, value) != STATUS_SUCCESS)
+		return STATUS_INVALID_PARAMETER_2;
+
+	AxisSprings & springs = *dev.Springs;
+	springs.Position[a] = (float)value;
+	springs.Velocity[a] = 0;
+	springs.Free[a] = 1;
+	return STATUS_SUCCESS;
+}
+
+void Spring_Grab(DEVICE & dev, HID_USAGES axis)
+{
+	const UINT a = Spring_Index(axis);
+	if (dev.Springs && a < SPRING_AXES) {
+		dev.Springs->Free[a] = 0;
+		dev.Springs->Velocity[a] = 0;
+	}
+}
+
+void Spring_GrabAll(DEVICE & dev)
+{
+	if (dev.Springs) {
+		std::fill(std::begin(dev.Springs->Free), std::end(dev.Springs->Free), 0.0f);
+		std::fill(std::begin(dev.Springs->Velocity), std::end(dev.Springs->Velocity), 0.0f);
+	}
+}
+
+bool Spring_Step(DEVICE & dev, bool & changed)
+{
+	if (!dev.Springs)
+		return false;
+
+	AxisSprings & s = *dev.Springs;
+	const float dt = SPRING_STEP_MS / 1000.0f;
+	float accel[SPRING_AXES];
+
+	// Every axis, held or not: branch-free loops the compiler can vectorize; Free zeroes the held ones
+	for (UINT a = 0; a < SPRING_AXES; ++a)
+		accel[a] = -s.Stiffness[a] * (s.Position[a] - s.Center[a]) - s.Damping[a] * s.Velocity[a];
+	for (UINT d = 0; d < SPRING_DETENTS; ++d) {
+		for (UINT a = 0; a < SPRING_AXES; ++a) {
+			const float dist = s.Detents[d][a] - s.Position[a];
+			accel[a] += std::fabs(dist) < s.DetentWidth[a] ? s.DetentStiffness[a] * dist : 0.0f;
+		}
+	}
+	for (UINT a = 0; a < SPRING_AXES; ++a) {
+		accel[a] *= s.Free[a];
+		s.Velocity[a] = (s.Velocity[a] + accel[a] * dt) * s.Free[a];
+		s.Position[a] += s.Velocity[a] * dt;
+	}
+
+	// The report, for the axes let go of
+	bool moving = false;
+	for (UINT a = 0; a < SPRING_AXES; ++a) {
+		if (!s.Free[a])
+			continue;
+
+		if (s.Position[a] < 0 || s.Position[a] > 0x7FFF) {
+			s.Position[a] = std::min(std::max(s.Position[a], 0.0f), (float)0x7FFF);
+			s.Velocity[a] = 0;
+		}
+		if (std::fabs(s.Velocity[a]) < SPRING_REST_SPEED && std::fabs(accel[a]) < SPRING_REST_ACCEL)
+			s.Free[a] = 0;
+		else
+			moving = true;
+
+		const HID_USAGES axis = (HID_USAGES)(HID_USAGE_X + a);
+		LONG before, after;
+		if (Report_GetAxis(dev, axis, before) != STATUS_SUCCESS ||
+			Control_SetAxis(dev, axis, (LONG)std::lround(s.Position[a])) != STATUS_SUCCESS)
+			continue;
+		Report_GetAxis(dev, axis, after);
+		changed |= after != before;
+	}
+	return moving;
+}
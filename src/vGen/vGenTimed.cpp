@@ -0,0 +1,62 @@
+// vGenTimed.cpp : Timestamped writes (SetDevAxisAt, SetDevButtonAt).
+//
+// A device's writes wait in a buffer ordered by apply time, writes of equal time in the order they came. The timer
+// wheel (vGenTimer.cpp) has one timer per device with writes waiting, due at the first one: Timed_Apply() applies all
+// those due by the tick it fires in, so that they reach the device in that tick's report, and the timer goes back in
+// for the next one.
+
+#include "stdafx.h"
+#include "Private.h"
+
+#include <algorithm>
+
+using namespace vGenNS;
+
+DWORD Timed_Add(DEVICE & dev, const TimedWrite & write, bool & first)
+{
+	LONG value;
+	if (write.Button ? !write.Control || write.Control > dev.Caps.Buttons :
+		Control_GetAxis(dev, (HID_USAGES)write.Control, value) != STATUS_SUCCESS)
+		return STATUS_INVALID_PARAMETER_2;
+
+	if (!dev.Timed)
+		dev.Timed = std::make_shared<std::deque<TimedWrite>>();
+	std::deque<TimedWrite> & writes = *dev.Timed;
+	if (writes.size() >= TIMED_MAX_WRITES)
+		return STATUS_INSUFFICIENT_RESOURCES;
+
+	// Usually the last
+	const auto it = std::upper_bound(writes.begin(), writes.end(), write.AtUs,
+		[](ULONGLONG at, const TimedWrite & w) { return at < w.AtUs; });
+	first = it == writes.begin();
+	writes.insert(it, write);
+	return STATUS_SUCCESS;
+}
+
+ULONGLONG Timed_Apply(DEVICE & dev, HDEVICE hDev, ULONGLONG untilUs, bool & changed)
+{
+	if (!dev.Timed)
+		return 0;
+
+	std::deque<TimedWrite> & writes = *dev.Timed;
+	for (; !writes.empty() && writes.front().AtUs <= untilUs; writes.pop_front()) {
+		const TimedWrite & write = writes.front();
+		if (write.Button) {
+			Timer_Cancel(hDev, TimerButtonRelease, write.Control);
+			Timer_Cancel(hDev, TimerButtonTurbo, write.Control);
+			changed |= Control_SetButton(dev, write.Control, write.Value) == STATUS_SUCCESS;
+		}
+		else {
+			Timer_Cancel(hDev, TimerAxisAnimate, write.Control);
+			Spring_Grab(dev, (HID_USAGES)write.Control);
+			changed |= Control_SetAxis(dev, (HID_USAGES)write.Control, write.Value) == STATUS_SUCCESS;
+		}
+	}
+	return writes.empty() ? 0 : writes.front().AtUs;
+}
+
+void Timed_Clear(DEVICE & dev)
+{
+	if (dev.Timed)
+		dev.Timed->clear();
+}
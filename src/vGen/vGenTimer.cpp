@@ -0,0 +1,671 @@
+// vGenTimer.cpp : Timer wheel for timed control changes (PulseDevButton, PulseDevDiscPov, AnimateDevAxis,
+// SetDevButtonTurbo, RunMacro, ReleaseDevAxis, SetDevAxisAt, SetDevButtonAt).
+//
+// A hashed wheel of TIMER_SLOTS slots of one tick each; a timer further away than one turn waits in its slot for the
+// turns to pass. Timers are intrusive list nodes in a pool and are found by their control, so scheduling, replacing and
+// cancelling are O(1) whatever the number pending. One thread advances the wheel, under g_reportLock like the SetDev*()
+// exports: the changes of every timer due in a tick go into the reports first and each device changed is then sent
+// once. It sleeps until the earliest tick a timer is due, which a bitmap of the slots in use finds in a few words, or
+// until a new timer comes in; with no timer pending it sleeps without a deadline. An axis animation is a timer that moves its axis and goes back into the wheel
+// TIMER_ANIM_STEP ticks later, until its time is up; a turbo button one that goes back in for its next edge, a macro
+// run one that goes back in for the end of its wait, the springs of a device one that steps them until they rest, the
+// timestamped writes of a device one that goes back in for the next write.
+
+#include "stdafx.h"
+#include "Private.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <unordered_map>
+
+#ifdef _WIN32
+#include <timeapi.h>
+#pragma comment(lib, "winmm.lib")
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#include <sys/prctl.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+using namespace vGenNS;
+
+namespace {
+
+#define TIMER_TICK_US  1000  // Wheel resolution
+#define TIMER_SLOTS    512   // Power of 2; one turn is TIMER_SLOTS ticks
+#define TIMER_NONE     0xFFFFFFFF
+#define TIMER_ANIM_STEP 4    // Ticks between the values of an animated axis
+#define TIMER_RT_PRIORITY 10 // SCHED_FIFO priority of SchedulerRealtime, below the kernel's interrupt threads (50)
+
+using TimerClock = std::chrono::steady_clock;
+
+struct TimerEntry
+{
+	ULONGLONG Due;       // Tick
+	HDEVICE hDev;
+	TimerAction Action;
+	UINT Index;          // Button, POV or axis
+	UINT Prev, Next;     // Slot list, or Next in the free list
+	bool Used;
+	bool Cancelled;      // During the walk over the slots, freed after it
+
+	// TimerAxisAnimate
+	AxisEasing Easing;
+	LONG From, To;       // vJoy range
+	ULONGLONG Begin;     // Tick
+	ULONGLONG Length;    // Ticks
+
+	// TimerButtonTurbo. Edges are counted from Begin, so late ticks don't add up.
+	UINT PeriodUs;
+	UINT OnUs;           // Pressed for the first OnUs of each period
+	bool Pressed;
+
+	// TimerMacro. Begin is the tick the run is at: waits add to it, so a late tick doesn't delay the rest.
+	MacroRun Macro;
+};
+
+// Position along the curve at time t, both 0-1
+double Timer_Ease(AxisEasing easing, double t)
+{
+	switch (easing) {
+		case EaseInQuad:     return t * t;
+		case EaseOutQuad:    return t * (2 - t);
+		case EaseInOutQuad:  return t < 0.5 ? 2 * t * t : 1 - 2 * (1 - t) * (1 - t);
+		case EaseInCubic:    return t * t * t;
+		case EaseOutCubic:   return 1 - (1 - t) * (1 - t) * (1 - t);
+		case EaseInOutCubic: return t < 0.5 ? 4 * t * t * t : 1 - 4 * (1 - t) * (1 - t) * (1 - t);
+		case EaseLinear:
+		default:             return t;
+	}
+}
+
+class TimerWheel
+{
+public:
+	~TimerWheel()
+	{
+		// Timer_Stop() normally stopped the thread. Joining it here, under the loader lock, could dead-lock.
+		if (m_thread.joinable())
+			m_thread.detach();
+	}
+
+	// Under g_reportLock
+	DWORD Schedule(HDEVICE hDev, TimerAction action, UINT index, UINT delayMs)
+	{
+		const UINT id = Place(hDev, action, index);
+		TimerEntry & entry = m_pool[id];
+		entry.Due = std::max(Now() + Ticks(delayMs), m_tick + 1);
+		Link(id);
+		m_wake.notify_one();
+		return STATUS_SUCCESS;
+	}
+
+	// Under g_reportLock. durationMs > 0.
+	DWORD Animate(HDEVICE hDev, HID_USAGES axis, LONG from, LONG to, UINT durationMs, AxisEasing easing)
+	{
+		const UINT id = Place(hDev, TimerAxisAnimate, axis);
+		TimerEntry & entry = m_pool[id];
+		entry.Easing = easing;
+		entry.From = from;
+		entry.To = to;
+		entry.Begin = Now();
+		entry.Length = Ticks(durationMs);
+		entry.Due = std::max(entry.Begin + std::min<ULONGLONG>(TIMER_ANIM_STEP, entry.Length), m_tick + 1);
+		Link(id);
+		m_wake.notify_one();
+		return STATUS_SUCCESS;
+	}
+
+	// Under g_reportLock. The button was just pressed, for the first period.
+	DWORD Turbo(HDEVICE hDev, UINT button, UINT periodUs, UINT onUs)
+	{
+		const UINT id = Place(hDev, TimerButtonTurbo, button);
+		TimerEntry & entry = m_pool[id];
+		entry.Begin = Now();
+		entry.PeriodUs = periodUs;
+		entry.OnUs = onUs;
+		entry.Pressed = true;
+		entry.Due = std::max(entry.Begin + (onUs + TIMER_TICK_US - 1) / TIMER_TICK_US, m_tick + 1);
+		Link(id);
+		m_wake.notify_one();
+		return STATUS_SUCCESS;
+	}
+
+	// Under g_reportLock
+	DWORD Macro(HDEVICE hDev, UINT id, MacroRun && run, UINT waitMs)
+	{
+		const UINT idx = Place(hDev, TimerMacro, id);
+		TimerEntry & entry = m_pool[idx];
+		entry.Macro = std::move(run);
+		entry.Begin = Now() + Ticks(waitMs);
+		entry.Due = std::max(entry.Begin, m_tick + 1);
+		Link(idx);
+		m_wake.notify_one();
+		return STATUS_SUCCESS;
+	}
+
+	// Under g_reportLock
+	DWORD At(HDEVICE hDev, TimerAction action, UINT index, ULONGLONG atUs)
+	{
+		const UINT id = Place(hDev, action, index);
+		TimerEntry & entry = m_pool[id];
+		entry.Due = std::max(TickOf(atUs), m_tick + 1);
+		Link(id);
+		m_wake.notify_one();
+		return STATUS_SUCCESS;
+	}
+
+	static ULONGLONG NowUs()
+	{
+		return (ULONGLONG)std::chrono::duration_cast<std::chrono::microseconds>(TimerClock::now().time_since_epoch()).count();
+	}
+
+	// Under g_reportLock. A timed write cancels from the walk over the slots, which freeing an entry would upset: the
+	// entry is then skipped and freed after the walk.
+	void Cancel(HDEVICE hDev, TimerAction action, UINT index)
+	{
+		if (!m_count)
+			return;
+		const auto it = m_keys.find(Key(hDev, action, index));
+		if (it == m_keys.end())
+			return;
+		if (!m_walking)
+			Free(it->second);
+		else if (!m_pool[it->second].Cancelled) {
+			m_pool[it->second].Cancelled = true;
+			m_cancelled.push_back(it->second);
+		}
+	}
+
+	// Under g_reportLock. O(timers pending), only when devices go away.
+	void CancelDevice(HDEVICE hDev)
+	{
+		for (UINT id = 0; m_count && id < m_pool.size(); ++id) {
+			if (m_pool[id].Used && m_pool[id].hDev == hDev)
+				Free(id);
+		}
+	}
+
+	DWORD Configure(const SchedulerConfig & config)
+	{
+		std::unique_lock<std::mutex> lock(g_reportLock);
+		m_config = config;
+		m_configSet = true;
+		if (!m_thread.joinable()) {
+			m_configStatus = STATUS_SUCCESS;
+			return STATUS_SUCCESS;
+		}
+
+		m_configPending = true;
+		m_wake.notify_one();
+		m_applied.wait(lock, [this] { return !m_configPending || m_stop; });
+		return m_configStatus;
+	}
+
+	void GetStats(SchedulerStats & stats, bool reset)
+	{
+		std::lock_guard<std::mutex> lock(g_reportLock);
+		stats = m_stats;
+		stats.Pending = m_count;
+		stats.Running = m_thread.joinable();
+		stats.ConfigStatus = m_configStatus;
+		if (reset)
+			m_stats = SchedulerStats();
+	}
+
+	// The settings stay, for the next thread
+	void Stop()
+	{
+		{
+			std::lock_guard<std::mutex> lock(g_reportLock);
+			if (!m_thread.joinable())
+				return;
+			m_stop = true;
+			m_wake.notify_one();
+		}
+		m_thread.join();
+
+		std::lock_guard<std::mutex> lock(g_reportLock);
+		m_keys.clear();
+		m_pool.clear();
+		m_free = TIMER_NONE;
+		m_count = 0;
+	}
+
+private:
+	static ULONGLONG Key(HDEVICE hDev, TimerAction action, UINT index)
+	{
+		return ((ULONGLONG)(UINT)hDev << 32) | ((ULONGLONG)action << 16) | (index & 0xFFFF);
+	}
+
+	// Rounded up: a change never comes early
+	static ULONGLONG Ticks(UINT ms)
+	{
+		return ((ULONGLONG)ms * 1000 + TIMER_TICK_US - 1) / TIMER_TICK_US;
+	}
+
+	// The entry of a control, its own if it has one, unlinked; starts the thread if needed
+	UINT Place(HDEVICE hDev, TimerAction action, UINT index)
+	{
+		if (!m_thread.joinable()) {
+			m_start = TimerClock::now();
+			m_tick = 0;
+			m_stop = false;
+			m_configPending = m_configSet;
+			for (UINT & head : m_slots)
+				head = TIMER_NONE;
+			std::fill(std::begin(m_used), std::end(m_used), 0ULL);
+			m_thread = std::thread(&TimerWheel::Run, this);
+		}
+
+		const ULONGLONG key = Key(hDev, action, index);
+		const auto it = m_keys.find(key);
+		if (it != m_keys.end()) {
+			Unlink(it->second);
+			return it->second;
+		}
+
+		const UINT id = Alloc();
+		m_keys.emplace(key, id);
+		++m_count;
+		TimerEntry & entry = m_pool[id];
+		entry.hDev = hDev;
+		entry.Action = action;
+		entry.Index = index;
+		return id;
+	}
+
+	// Time of tick 0 on the NowUs() clock
+	ULONGLONG StartUs() const
+	{
+		return (ULONGLONG)std::chrono::duration_cast<std::chrono::microseconds>(m_start.time_since_epoch()).count();
+	}
+
+	// Tick of time atUs of NowUs(), rounded up
+	ULONGLONG TickOf(ULONGLONG atUs) const
+	{
+		return atUs > StartUs() ? (atUs - StartUs() + TIMER_TICK_US - 1) / TIMER_TICK_US : 0;
+	}
+
+	ULONGLONG Now() const
+	{
+		return (ULONGLONG)std::chrono::duration_cast<std::chrono::microseconds>(TimerClock::now() - m_start).count() / TIMER_TICK_US;
+	}
+
+	UINT Alloc()
+	{
+		if (m_free == TIMER_NONE) {
+			m_pool.emplace_back();
+			m_pool.back().Used = true;
+			return (UINT)m_pool.size() - 1;
+		}
+		const UINT id = m_free;
+		m_free = m_pool[id].Next;
+		m_pool[id].Used = true;
+		return id;
+	}
+
+	void Free(UINT id)
+	{
+		TimerEntry & entry = m_pool[id];
+		Unlink(id);
+		m_keys.erase(Key(entry.hDev, entry.Action, entry.Index));
+		entry.Macro = MacroRun();
+		entry.Used = false;
+		entry.Cancelled = false;
+		entry.Next = m_free;
+		m_free = id;
+		--m_count;
+	}
+
+	void Link(UINT id)
+	{
+		TimerEntry & entry = m_pool[id];
+		const UINT slot = entry.Due & (TIMER_SLOTS - 1);
+		UINT & head = m_slots[slot];
+		entry.Prev = TIMER_NONE;
+		entry.Next = head;
+		if (head != TIMER_NONE)
+			m_pool[head].Prev = id;
+		head = id;
+		m_used[slot / 64] |= 1ULL << (slot % 64);
+	}
+
+	void Unlink(UINT id)
+	{
+		TimerEntry & entry = m_pool[id];
+		const UINT slot = entry.Due & (TIMER_SLOTS - 1);
+		if (entry.Prev != TIMER_NONE)
+			m_pool[entry.Prev].Next = entry.Next;
+		else if ((m_slots[slot] = entry.Next) == TIMER_NONE)
+			m_used[slot / 64] &= ~(1ULL << (slot % 64));
+		if (entry.Next != TIMER_NONE)
+			m_pool[entry.Next].Prev = entry.Prev;
+	}
+
+	// Tick of the earliest timer; m_count > 0. The first slot in use after m_tick holds it, unless all the timers found
+	// on the way are due in a later turn.
+	ULONGLONG NextDue() const
+	{
+		ULONGLONG due = ~0ULL;
+		for (UINT k = 0; k < TIMER_SLOTS; ) {
+			const ULONGLONG tick = m_tick + 1 + k;
+			const UINT slot = tick & (TIMER_SLOTS - 1);
+			ULONGLONG used = m_used[slot / 64] >> (slot % 64);
+			if (!used) {
+				k += 64 - slot % 64;
+				continue;
+			}
+			for (; !(used & 1); used >>= 1)
+				++k;
+			if (k >= TIMER_SLOTS)
+				break;  // Back at slots seen at the start of the turn
+
+			for (UINT id = m_slots[(m_tick + 1 + k) & (TIMER_SLOTS - 1)]; id != TIMER_NONE; id = m_pool[id].Next)
+				due = std::min(due, m_pool[id].Due);
+			if (due <= m_tick + 1 + k)
+				return due;
+			++k;
+		}
+		return due;
+	}
+
+	void Run()
+	{
+#ifdef _WIN32
+		timeBeginPeriod(1);  // The default 15.6 ms scheduler tick would make every timer that late
+#elif defined(__linux__)
+		prctl(PR_SET_TIMERSLACK, 1UL);  // Wake at the deadline, not up to 50 us after it
+		m_baseNice = getpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid));
+		pthread_getaffinity_np(pthread_self(), sizeof(m_baseCpus), &m_baseCpus);
+#endif
+		std::unique_lock<std::mutex> lock(g_reportLock);
+		while (!m_stop) {
+			if (m_configPending) {
+				m_configStatus = ApplyConfig();
+				m_configPending = false;
+				m_applied.notify_all();
+			}
+			if (!m_count) {
+				m_wake.wait(lock);
+				continue;
+			}
+
+			const auto deadline = m_start + std::chrono::microseconds(NextDue() * TIMER_TICK_US);
+			if (TimerClock::now() < deadline) {
+				m_wake.wait_until(lock, deadline);
+				const auto woke = TimerClock::now();
+				if (woke < deadline) {
+					++m_stats.Early;  // A new timer, new settings or Stop(): look again
+					continue;
+				}
+				++m_stats.Wakes;
+				Perf_Sample(m_stats.Lateness, Perf_Ns(woke - deadline));
+			}
+			Advance(Now());
+		}
+		m_applied.notify_all();
+#ifdef _WIN32
+		timeEndPeriod(1);
+#endif
+	}
+
+	// Applies m_config to the calling thread, under g_reportLock
+	DWORD ApplyConfig()
+	{
+#ifdef _WIN32
+		static const int priorities[] = { THREAD_PRIORITY_NORMAL, THREAD_PRIORITY_ABOVE_NORMAL, THREAD_PRIORITY_HIGHEST,
+			THREAD_PRIORITY_TIME_CRITICAL };
+		DWORD res = SetThreadPriority(GetCurrentThread(), priorities[m_config.Priority]) ? STATUS_SUCCESS : STATUS_ACCESS_DENIED;
+
+		DWORD_PTR mask = (DWORD_PTR)m_config.Affinity, system;
+		if (!mask)
+			GetProcessAffinityMask(GetCurrentProcess(), &mask, &system);
+		if (!SetThreadAffinityMask(GetCurrentThread(), mask) && res == STATUS_SUCCESS)
+			res = STATUS_INVALID_PARAMETER;
+		return res;
+#elif defined(__linux__)
+		// Nice values relative to the process' for the priorities below SchedulerRealtime
+		static const int nices[] = { 0, -5, -10 };
+		DWORD res = STATUS_SUCCESS;
+		sched_param param = {};
+		if (m_config.Priority == SchedulerRealtime) {
+			param.sched_priority = TIMER_RT_PRIORITY;
+			if (pthread_setschedparam(pthread_self(), SCHED_FIFO, &param))
+				res = STATUS_ACCESS_DENIED;
+		}
+		else if (pthread_setschedparam(pthread_self(), SCHED_OTHER, &param) ||
+			setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), m_baseNice + nices[m_config.Priority]))
+			res = STATUS_ACCESS_DENIED;
+
+		cpu_set_t cpus = m_baseCpus;
+		if (m_config.Affinity) {
+			CPU_ZERO(&cpus);
+			for (UINT cpu = 0; cpu < 64; ++cpu) {
+				if (m_config.Affinity >> cpu & 1)
+					CPU_SET(cpu, &cpus);
+			}
+		}
+		if (pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) && res == STATUS_SUCCESS)
+			res = STATUS_INVALID_PARAMETER;
+		return res;
+#else
+		return m_config.Priority == SchedulerNormal && !m_config.Affinity ? STATUS_SUCCESS : STATUS_NOT_SUPPORTED;
+#endif
+	}
+
+	// Fires every timer due up to tick now
+	void Advance(ULONGLONG now)
+	{
+		if (now <= m_tick)
+			return;
+
+		// A thread that fell a turn or more behind visits every slot once
+		ULONGLONG tick = now - m_tick > TIMER_SLOTS ? now - TIMER_SLOTS + 1 : m_tick + 1;
+		m_changed.clear();
+		m_walking = true;
+		for (; tick <= now; ++tick) {
+			UINT id = m_slots[tick & (TIMER_SLOTS - 1)];
+			while (id != TIMER_NONE) {
+				const UINT next = m_pool[id].Next;
+				if (m_pool[id].Due <= now && !m_pool[id].Cancelled)
+					Fire(id, now);
+				id = next;
+			}
+		}
+		m_walking = false;
+		m_tick = now;
+		for (UINT id : m_cancelled)
+			Free(id);
+		m_cancelled.clear();
+
+		// After the walk over the slots, which relinking an animation's entry would upset
+		Macro_StartRamps(m_ramps);
+
+		// The changes of one tick reach each device as one report
+		for (HDEVICE hDev : m_changed) {
+			const PDEVICE pDev = GetDevice(hDev);
+			if (pDev)
+				Backend_Submit(*pDev);
+		}
+	}
+
+	void Fire(UINT id, ULONGLONG now)
+	{
+		TimerEntry & entry = m_pool[id];
+		const HDEVICE hDev = entry.hDev;
+		const PDEVICE pDev = GetDevice(hDev);
+		++m_stats.Fired;
+		ULONGLONG again = 0;  // Tick the timer is due next, if it goes on
+		bool changed = false;
+		if (pDev) {
+			switch (entry.Action) {
+				case TimerButtonRelease:
+					changed = Control_SetButton(*pDev, entry.Index, FALSE) == STATUS_SUCCESS;
+					break;
+				case TimerDiscPovCenter:
+					changed = Control_SetDiscPov(*pDev, (UCHAR)entry.Index, DPOV_Center) == STATUS_SUCCESS;
+					break;
+				case TimerAxisAnimate:
+					changed = Step(*pDev, entry, now);
+					if (now < entry.Begin + entry.Length)
+						again = std::min(now + TIMER_ANIM_STEP, entry.Begin + entry.Length);
+					break;
+				case TimerButtonTurbo:
+					changed = Toggle(*pDev, entry, now, again);
+					break;
+				case TimerAxisSpring:
+					if (Spring_Step(*pDev, changed))
+						again = now + Ticks(SPRING_STEP_MS);
+					break;
+				case TimerTimedWrite: {
+					// Every write TickOf() puts in this tick or an earlier one
+					const ULONGLONG next = Timed_Apply(*pDev, hDev, StartUs() + now * TIMER_TICK_US, changed);
+					if (next)
+						again = std::max(TickOf(next), now + 1);
+					break;
+				}
+				case TimerMacro: {
+					const UINT waitMs = Macro_Exec(*pDev, hDev, entry.Macro, changed, m_ramps);
+					if (waitMs) {
+						entry.Begin += Ticks(waitMs);
+						again = std::max(entry.Begin, now + 1);
+					}
+					break;
+				}
+			}
+		}
+
+		if (again) {
+			Unlink(id);
+			entry.Due = again;
+			Link(id);
+		}
+		else
+			Free(id);
+
+		if (changed && std::find(m_changed.begin(), m_changed.end(), hDev) == m_changed.end())
+			m_changed.push_back(hDev);
+	}
+
+	// Sets an animated axis to its value at tick now; true if the report changed
+	static bool Step(DEVICE & dev, const TimerEntry & entry, ULONGLONG now)
+	{
+		const double t = now >= entry.Begin + entry.Length ? 1.0 : (double)(now - entry.Begin) / entry.Length;
+		const LONG value = entry.From + (LONG)lround((entry.To - entry.From) * Timer_Ease(entry.Easing, t));
+
+		const HID_USAGES axis = (HID_USAGES)entry.Index;
+		LONG before, after;
+		if (Report_GetAxis(dev, axis, before) != STATUS_SUCCESS || Control_SetAxis(dev, axis, value) != STATUS_SUCCESS)
+			return false;
+		Report_GetAxis(dev, axis, after);
+		return after != before;
+	}
+
+	// Sets a turbo button as it is at tick now, and the tick of its next edge; true if the report changed
+	static bool Toggle(DEVICE & dev, TimerEntry & entry, ULONGLONG now, ULONGLONG & next)
+	{
+		const ULONGLONG elapsedUs = (now - entry.Begin) * TIMER_TICK_US;
+		const ULONGLONG phase = elapsedUs % entry.PeriodUs;
+		const bool press = phase < entry.OnUs;
+		const ULONGLONG edgeUs = elapsedUs - phase + (press ? entry.OnUs : entry.PeriodUs);
+		next = std::max(entry.Begin + (edgeUs + TIMER_TICK_US - 1) / TIMER_TICK_US, now + 1);
+
+		if (press == entry.Pressed || Control_SetButton(dev, entry.Index, press) != STATUS_SUCCESS)
+			return false;
+		entry.Pressed = press;
+		return true;
+	}
+
+	// Under g_reportLock
+	std::vector<TimerEntry> m_pool;
+	UINT m_free = TIMER_NONE;
+	UINT m_count = 0;                              // Timers pending
+	UINT m_slots[TIMER_SLOTS];                     // List heads
+	ULONGLONG m_used[TIMER_SLOTS / 64];            // Bit per slot with a timer
+	std::unordered_map<ULONGLONG, UINT> m_keys;    // Control => entry
+	ULONGLONG m_tick = 0;                          // Last tick advanced to
+	TimerClock::time_point m_start;
+	std::vector<HDEVICE> m_changed;                // Devices changed in the current tick
+	std::vector<MacroAnimation> m_ramps;           // Ramps macros started in the current tick
+	std::vector<UINT> m_cancelled;                 // Entries cancelled in the current tick's walk
+	bool m_walking = false;                        // Advance() is walking over the slots
+	bool m_stop = false;
+	SchedulerConfig m_config;
+	bool m_configSet = false;                      // SetSchedulerConfig() was called
+	bool m_configPending = false;                  // For the thread to apply
+	DWORD m_configStatus = STATUS_SUCCESS;
+	SchedulerStats m_stats;                        // Wakes, Early, Fired and Lateness
+#if defined(__linux__)
+	int m_baseNice = 0;                            // Of the thread when it started, under SchedulerNormal
+	cpu_set_t m_baseCpus;
+#endif
+
+	std::condition_variable m_wake;
+	std::condition_variable m_applied;             // m_configPending cleared
+	std::thread m_thread;
+};
+
+TimerWheel g_timers;
+
+}  // namespace
+
+DWORD Timer_Schedule(HDEVICE hDev, TimerAction action, UINT index, UINT delayMs)
+{
+	return g_timers.Schedule(hDev, action, index, delayMs);
+}
+
+DWORD Timer_Animate(HDEVICE hDev, HID_USAGES axis, LONG from, LONG to, UINT durationMs, AxisEasing easing)
+{
+	return g_timers.Animate(hDev, axis, from, to, durationMs, easing);
+}
+
+DWORD Timer_Turbo(HDEVICE hDev, UINT button, UINT periodUs, UINT onUs)
+{
+	return g_timers.Turbo(hDev, button, periodUs, onUs);
+}
+
+DWORD Timer_Macro(HDEVICE hDev, UINT id, MacroRun && run, UINT waitMs)
+{
+	return g_timers.Macro(hDev, id, std::move(run), waitMs);
+}
+
+DWORD Timer_At(HDEVICE hDev, TimerAction action, UINT index, ULONGLONG atUs)
+{
+	return g_timers.At(hDev, action, index, atUs);
+}
+
+void Timer_Cancel(HDEVICE hDev, TimerAction action, UINT index)
+{
+	g_timers.Cancel(hDev, action, index);
+}
+
+void Timer_CancelDevice(HDEVICE hDev)
+{
+	g_timers.CancelDevice(hDev);
+}
+
+DWORD Timer_Configure(const SchedulerConfig & config)
+{
+	return g_timers.Configure(config);
+}
+
+void Timer_GetStats(SchedulerStats & stats, bool reset)
+{
+	g_timers.GetStats(stats, reset);
+}
+
+void Timer_Stop(void)
+{
+	g_timers.Stop();
+}
+
+ULONGLONG Timer_NowUs(void)
+{
+	return TimerWheel::NowUs();
+}
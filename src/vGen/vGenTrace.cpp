@@ -0,0 +1,449 @@
+// vGenTrace.cpp : API call trace recorder (StartTrace/StopTrace). See ApiTrace.h for the file format.
+//
+// Calling threads only push a fixed size record into a lock-free queue. A background thread drains
+// the queue every TRACE_FLUSH_MS, encodes the records and appends them to a memory-mapped file.
+
+#include "stdafx.h"
+#include "Private.h"
+
+#include <chrono>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+using namespace vGenNS;
+
+// Queued records. At 1kHz on several devices this holds well over a second of calls.
+#define TRACE_QUEUE_SIZE   16384
+// How often the writer drains the queue
+#define TRACE_FLUSH_MS     10
+// The file is mapped, and grows, in steps of this size
+#define TRACE_MAP_STEP     (4 * 1024 * 1024)
+
+std::atomic_bool g_traceEnabled {false};
+
+namespace {
+
+typedef MpscRing<TraceRecord, TRACE_QUEUE_SIZE> TraceQueue;
+
+#ifdef _WIN32
+// File names are UTF-8
+bool Trace_WideName(const char * fileName, std::vector<WCHAR> & wideName)
+{
+	const int len = MultiByteToWideChar(CP_UTF8, MB_ERR_INVALID_CHARS, fileName, -1, nullptr, 0);
+	if (len <= 0)
+		return false;
+	wideName.resize(len);
+	return MultiByteToWideChar(CP_UTF8, MB_ERR_INVALID_CHARS, fileName, -1, wideName.data(), len) == len;
+}
+
+// Wall clock as FILETIME
+ULONGLONG Trace_WallClock()
+{
+	FILETIME now;
+	GetSystemTimeAsFileTime(&now);
+	return ((ULONGLONG)now.dwHighDateTime << 32) | now.dwLowDateTime;
+}
+
+// Memory-mapped output file. Used by the writer thread only.
+class TraceFile
+{
+public:
+	~TraceFile() { Close(); }
+
+	bool Open(const char * fileName)
+	{
+		std::vector<WCHAR> wideName;
+		if (!Trace_WideName(fileName, wideName))
+			return false;
+
+		m_file = CreateFileW(wideName.data(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (m_file == INVALID_HANDLE_VALUE)
+			return false;
+		return Map(TRACE_MAP_STEP);
+	}
+
+	// Makes sure `size` bytes from the start of the file are mapped
+	bool Reserve(ULONGLONG size)
+	{
+		if (size <= m_size)
+			return true;
+		return Map((size + TRACE_MAP_STEP - 1) / TRACE_MAP_STEP * TRACE_MAP_STEP);
+	}
+
+	BYTE * Data() const { return m_view; }
+
+	// Unmaps and cuts the file to `used` bytes
+	void Close(ULONGLONG used = 0)
+	{
+		Unmap();
+		if (m_file == INVALID_HANDLE_VALUE)
+			return;
+		LARGE_INTEGER end;
+		end.QuadPart = (LONGLONG)used;
+		if (used && SetFilePointerEx(m_file, end, nullptr, FILE_BEGIN))
+			SetEndOfFile(m_file);
+		CloseHandle(m_file);
+		m_file = INVALID_HANDLE_VALUE;
+	}
+
+private:
+	bool Map(ULONGLONG size)
+	{
+		Unmap();
+		m_mapping = CreateFileMappingW(m_file, nullptr, PAGE_READWRITE, (DWORD)(size >> 32), (DWORD)size, nullptr);
+		if (!m_mapping)
+			return false;
+		m_view = (BYTE *)MapViewOfFile(m_mapping, FILE_MAP_WRITE, 0, 0, (SIZE_T)size);
+		if (!m_view) {
+			Unmap();
+			return false;
+		}
+		m_size = size;
+		return true;
+	}
+
+	void Unmap()
+	{
+		if (m_view)
+			UnmapViewOfFile(m_view);
+		if (m_mapping)
+			CloseHandle(m_mapping);
+		m_view = nullptr;
+		m_mapping = nullptr;
+		m_size = 0;
+	}
+
+	HANDLE m_file = INVALID_HANDLE_VALUE;
+	HANDLE m_mapping = nullptr;
+	BYTE * m_view = nullptr;
+	ULONGLONG m_size = 0;
+};
+
+#else
+
+// FILETIME counts 100ns units since 1601-01-01
+ULONGLONG Trace_WallClock()
+{
+	timespec now;
+	clock_gettime(CLOCK_REALTIME, &now);
+	return ((ULONGLONG)now.tv_sec + 11644473600ULL) * 10000000 + now.tv_nsec / 100;
+}
+
+// Memory-mapped output file. Used by the writer thread only.
+class TraceFile
+{
+public:
+	~TraceFile() { Close(); }
+
+	bool Open(const char * fileName)
+	{
+		m_file = open(fileName, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+		if (m_file < 0)
+			return false;
+		return Map(TRACE_MAP_STEP);
+	}
+
+	// Makes sure `size` bytes from the start of the file are mapped
+	bool Reserve(ULONGLONG size)
+	{
+		if (size <= m_size)
+			return true;
+		return Map((size + TRACE_MAP_STEP - 1) / TRACE_MAP_STEP * TRACE_MAP_STEP);
+	}
+
+	BYTE * Data() const { return m_view; }
+
+	// Unmaps and cuts the file to `used` bytes
+	void Close(ULONGLONG used = 0)
+	{
+		Unmap();
+		if (m_file < 0)
+			return;
+		if (used && ftruncate(m_file, (off_t)used)) {
+			// Keep the longer file, the header still tells how much of it is valid
+		}
+		close(m_file);
+		m_file = -1;
+	}
+
+private:
+	bool Map(ULONGLONG size)
+	{
+		Unmap();
+		if (ftruncate(m_file, (off_t)size))
+			return false;
+		void * view = mmap(nullptr, (size_t)size, PROT_READ | PROT_WRITE, MAP_SHARED, m_file, 0);
+		if (view == MAP_FAILED)
+			return false;
+		m_view = (BYTE *)view;
+		m_size = size;
+		return true;
+	}
+
+	void Unmap()
+	{
+		if (m_view)
+			munmap(m_view, (size_t)m_size);
+		m_view = nullptr;
+		m_size = 0;
+	}
+
+	int m_file = -1;
+	BYTE * m_view = nullptr;
+	ULONGLONG m_size = 0;
+};
+
+#endif // _WIN32
+
+// The queue outlives every session: a caller that saw g_traceEnabled just before StopTrace() may still push into it.
+// Trace_Start() discards such leftovers.
+std::atomic<TraceQueue *> g_traceQueue {nullptr};
+std::atomic<ULONGLONG> g_traceDropped {0};
+std::atomic<UINT> g_traceThreads {0};
+thread_local UINT t_traceThread = 0;
+
+std::mutex g_traceLock;  // Start/stop
+
+struct TraceWriterThread
+{
+	~TraceWriterThread()
+	{
+		// StopTrace() or DeInit() normally stopped the writer. Joining it here, under the loader lock, could dead-lock.
+		if (Thread.joinable())
+			Thread.detach();
+	}
+	std::thread Thread;
+} g_traceWriter;
+
+std::atomic_bool g_traceStop {false};
+std::atomic<DWORD> g_traceStatus {STATUS_SUCCESS};  // Why the writer gave up, for Trace_Stop()
+std::mutex g_traceWaitLock;
+std::condition_variable g_traceWaitCond;
+
+class TraceWriter
+{
+public:
+	TraceWriter(TraceQueue & queue, ULONGLONG startNs) : m_queue(queue), m_prevNs(startNs) {}
+
+	bool Open(const char * fileName)
+	{
+		if (!m_file.Open(fileName))
+			return false;
+
+		TraceFileHeader & header = Header();
+		memcpy(header.Magic, TRACE_MAGIC, sizeof(header.Magic));
+		header.Version = TRACE_VERSION;
+		header.StartTime = Trace_WallClock();
+		header.DataBytes = 0;
+		header.Dropped = 0;
+		return true;
+	}
+
+	void Run()
+	{
+		for (;;) {
+			{
+				std::unique_lock<std::mutex> lock(g_traceWaitLock);
+				g_traceWaitCond.wait_for(lock, std::chrono::milliseconds(TRACE_FLUSH_MS), []() { return g_traceStop.load(); });
+			}
+			// The final flush comes after g_traceEnabled was cleared, so it picks up everything but stragglers
+			const bool stop = g_traceStop;
+			if (!Flush()) {
+				// The calls stop paying for a trace that goes nowhere; StopTrace() tells why
+				g_traceEnabled = false;
+				g_traceStatus = STATUS_UNEXPECTED_IO_ERROR;
+				break;
+			}
+			if (stop)
+				break;
+		}
+		m_file.Close(sizeof(TraceFileHeader) + m_used);
+	}
+
+private:
+	TraceFileHeader & Header() { return *(TraceFileHeader *)m_file.Data(); }
+
+	bool Flush()
+	{
+		TraceRecord batch[256];
+		for (;;) {
+			const ULONGLONG dropped = g_traceDropped.exchange(0);
+			if (dropped) {
+				TraceRecord marker = TraceRecord();
+				marker.Api = TRACE_API_DROPPED;
+				marker.TimeNs = m_prevNs;
+				marker.Value = (LONG)dropped;
+				if (!Write(&marker, 1))
+					return false;
+				Header().Dropped += dropped;
+			}
+
+			const size_t n = m_queue.Drain(batch, _countof(batch));
+			if (!n)
+				return true;
+			if (!Write(batch, n))
+				return false;
+		}
+	}
+
+	bool Write(const TraceRecord * records, size_t count)
+	{
+		if (!m_file.Reserve(sizeof(TraceFileHeader) + m_used + count * TRACE_MAX_RECORD))
+			return false;
+
+		BYTE * const start = m_file.Data() + sizeof(TraceFileHeader) + m_used;
+		BYTE * p = start;
+		for (size_t i = 0; i < count; ++i)
+			p = Trace_Encode(p, records[i], m_prevNs);
+		m_used += p - start;
+		Header().DataBytes = m_used;  // After the records, so a reader never sees a count beyond valid data
+		return true;
+	}
+
+	TraceQueue & m_queue;
+	TraceFile m_file;
+	ULONGLONG m_prevNs;
+	ULONGLONG m_used = 0;
+};
+
+}  // namespace
+
+void Trace_Record(PerfApi api, ULONGLONG startNs, ULONGLONG durationNs, HDEVICE hDev, UINT arg, LONG value, DWORD result)
+{
+	TraceQueue * queue = g_traceQueue.load(std::memory_order_acquire);
+	if (!queue)
+		return;
+
+	if (!t_traceThread)
+		t_traceThread = ++g_traceThreads;
+
+	TraceRecord rec;
+	rec.TimeNs = startNs;
+	rec.DurationNs = durationNs > MAXDWORD ? MAXDWORD : (DWORD)durationNs;
+	rec.Status = result;
+	rec.hDev = hDev;
+	rec.Arg = arg;
+	rec.Value = value;
+	rec.Thread = t_traceThread;
+	rec.Api = (BYTE)api;
+	if (!queue->Push(rec))
+		++g_traceDropped;
+}
+
+DWORD Trace_Start(const char * fileName)
+{
+	std::lock_guard<std::mutex> lock(g_traceLock);
+	if (g_traceWriter.Thread.joinable())
+		return STATUS_INVALID_DEVICE_STATE;
+
+	TraceQueue * queue = g_traceQueue.load();
+	if (!queue) {
+		queue = new TraceQueue;
+		g_traceQueue.store(queue);
+	}
+	else {
+		TraceRecord leftovers[256];
+		while (queue->Drain(leftovers, _countof(leftovers)))
+			;
+	}
+	g_traceDropped = 0;
+	g_traceStatus = STATUS_SUCCESS;
+
+	const ULONGLONG startNs = Perf_Ns(PerfClock::now().time_since_epoch());
+	std::unique_ptr<TraceWriter> writer(new TraceWriter(*queue, startNs));
+	if (!writer->Open(fileName))
+		return STATUS_UNSUCCESSFUL;
+
+	// Devices acquired before the trace started, so a replay knows what the handles stand for. Listed and tracing turned
+	// on under g_reportLock, which the container is under.
+	g_traceStop = false;
+	{
+		std::lock_guard<std::mutex> reportLock(g_reportLock);
+		for (const auto & dev : DevContainer_cref) {
+			TraceRecord rec = TraceRecord();
+			rec.TimeNs = startNs;
+			rec.hDev = dev.first;
+			rec.Arg = dev.second.Id;
+			rec.Value = (LONG)dev.second.Type;
+			rec.Api = PerfAcquireDev;
+			queue->Push(rec);
+		}
+		g_traceEnabled = true;
+	}
+	g_traceWriter.Thread = std::thread([](TraceWriter * w) {
+		std::unique_ptr<TraceWriter> owned(w);
+		owned->Run();
+	}, writer.release());
+	return STATUS_SUCCESS;
+}
+
+DWORD Trace_Stop(void)
+{
+	std::lock_guard<std::mutex> lock(g_traceLock);
+	if (!g_traceWriter.Thread.joinable())
+		return STATUS_INVALID_DEVICE_STATE;
+
+	g_traceEnabled = false;
+	{
+		std::lock_guard<std::mutex> waitLock(g_traceWaitLock);
+		g_traceStop = true;
+		g_traceWaitCond.notify_all();
+	}
+	g_traceWriter.Thread.join();
+	return g_traceStatus;
+}
+
+DWORD Trace_ReadFile(const char * fileName, std::vector<BYTE> & data)
+{
+#ifdef _WIN32
+	std::vector<WCHAR> wideName;
+	if (!Trace_WideName(fileName, wideName))
+		return STATUS_NO_SUCH_FILE;
+
+	const HANDLE file = CreateFileW(wideName.data(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return STATUS_NO_SUCH_FILE;
+
+	DWORD res = STATUS_SUCCESS;
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size) || size.QuadPart > MAXDWORD)
+		res = STATUS_FILE_TOO_LARGE;
+	else {
+		data.resize((size_t)size.QuadPart);
+		DWORD read = 0;
+		if (!data.empty() && (!ReadFile(file, data.data(), (DWORD)data.size(), &read, nullptr) || read != data.size()))
+			res = STATUS_UNEXPECTED_IO_ERROR;
+	}
+	CloseHandle(file);
+	return res;
+#else
+	const int file = open(fileName, O_RDONLY | O_CLOEXEC);
+	if (file < 0)
+		return STATUS_NO_SUCH_FILE;
+
+	DWORD res = STATUS_SUCCESS;
+	struct stat st;
+	if (fstat(file, &st) || (ULONGLONG)st.st_size > MAXDWORD)
+		res = STATUS_FILE_TOO_LARGE;
+	else {
+		data.resize((size_t)st.st_size);
+		size_t done = 0;
+		while (done < data.size()) {
+			const ssize_t n = read(file, data.data() + done, data.size() - done);
+			if (n <= 0)
+				break;
+			done += (size_t)n;
+		}
+		if (done != data.size())
+			res = STATUS_UNEXPECTED_IO_ERROR;
+	}
+	close(file);
+	return res;
+#endif
+}
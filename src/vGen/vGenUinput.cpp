@@ -0,0 +1,652 @@
+// vGenUinput.cpp : The uinput backend. Linux virtual devices created through /dev/uinput (BackendUinput), or the same
+// thing written into memory (BackendUinputMemory) where /dev/uinput isn't available.
+//
+// Each device type gets a fixed layout of evdev controls: vJoy devices are a generic joystick, vXbox and vgeXbox ones
+// look like xpad's Xbox 360 pad, vgeDS4 ones like hid-playstation's DualShock 4. A commit (one Submit) compares the
+// report with the values last sent and writes the controls that changed, followed by a single SYN_REPORT, with one
+// write() call. Nothing is written when nothing changed.
+
+#include "stdafx.h"
+#include "Private.h"
+
+#ifdef __linux__
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#include <linux/uinput.h>
+#else
+// The codes the layouts use (linux/input-event-codes.h), for the in-memory stand-in
+#define EV_SYN          0x00
+#define EV_KEY          0x01
+#define EV_ABS          0x03
+#define SYN_REPORT      0
+#define ABS_X           0x00
+#define ABS_Y           0x01
+#define ABS_Z           0x02
+#define ABS_RX          0x03
+#define ABS_RY          0x04
+#define ABS_RZ          0x05
+#define ABS_THROTTLE    0x06
+#define ABS_RUDDER      0x07
+#define ABS_HAT0X       0x10
+#define ABS_HAT0Y       0x11
+#define ABS_HAT1X       0x12
+#define ABS_HAT1Y       0x13
+#define ABS_HAT2X       0x14
+#define ABS_HAT2Y       0x15
+#define ABS_HAT3X       0x16
+#define ABS_HAT3Y       0x17
+#define BTN_JOYSTICK    0x120
+#define BTN_SOUTH       0x130
+#define BTN_EAST        0x131
+#define BTN_NORTH       0x133
+#define BTN_WEST        0x134
+#define BTN_TL          0x136
+#define BTN_TR          0x137
+#define BTN_TL2         0x138
+#define BTN_TR2         0x139
+#define BTN_SELECT      0x13a
+#define BTN_START       0x13b
+#define BTN_MODE        0x13c
+#define BTN_THUMBL      0x13d
+#define BTN_THUMBR      0x13e
+#define BTN_TRIGGER_HAPPY1  0x2c0
+#define BTN_A           BTN_SOUTH
+#define BTN_B           BTN_EAST
+#define BTN_X           BTN_NORTH
+#define BTN_Y           BTN_WEST
+#endif
+
+#include <algorithm>
+#include <deque>
+
+using namespace vGenNS;
+
+#define UINPUT_VJOY_SLOTS     16
+#define UINPUT_GAMEPAD_SLOTS  4
+#define UINPUT_SLOTS          (UINPUT_VJOY_SLOTS + 3 * UINPUT_GAMEPAD_SLOTS)
+#define UINPUT_MAX_CONTROLS   48    // Controls of the largest layout (vJoy: 8 axes, 4 hats, 32 buttons)
+#define UINPUT_VJOY_BUTTONS   32
+#define UINPUT_MEMORY_EVENTS  4096  // Events kept per device by the in-memory stand-in, the oldest are dropped
+
+namespace {
+
+struct UinputControl
+{
+	USHORT Type;  // EV_ABS or EV_KEY
+	USHORT Code;
+	LONG Min;     // EV_ABS only
+	LONG Max;
+};
+
+struct UinputLayout
+{
+	const char * Name;
+	const UinputControl * Controls;
+	UINT Count;
+};
+
+#define UINPUT_AXIS(code, min, max)  { EV_ABS, code, min, max }
+#define UINPUT_HAT(n)                { EV_ABS, ABS_HAT0X + 2 * (n), -1, 1 }, { EV_ABS, ABS_HAT0Y + 2 * (n), -1, 1 }
+#define UINPUT_BUTTON(code)          { EV_KEY, code, 0, 1 }
+
+// Generic joystick: X, Y, Z, RX, RY, RZ, SL0 (throttle), SL1 (rudder), 4 continuous POVs as 8-way hats, 32 buttons
+const UinputControl g_vJoyControls[] = {
+	UINPUT_AXIS(ABS_X, 0, 32767), UINPUT_AXIS(ABS_Y, 0, 32767), UINPUT_AXIS(ABS_Z, 0, 32767),
+	UINPUT_AXIS(ABS_RX, 0, 32767), UINPUT_AXIS(ABS_RY, 0, 32767), UINPUT_AXIS(ABS_RZ, 0, 32767),
+	UINPUT_AXIS(ABS_THROTTLE, 0, 32767), UINPUT_AXIS(ABS_RUDDER, 0, 32767),
+	UINPUT_HAT(0), UINPUT_HAT(1), UINPUT_HAT(2), UINPUT_HAT(3),
+	UINPUT_BUTTON(BTN_JOYSTICK + 0), UINPUT_BUTTON(BTN_JOYSTICK + 1), UINPUT_BUTTON(BTN_JOYSTICK + 2),
+	UINPUT_BUTTON(BTN_JOYSTICK + 3), UINPUT_BUTTON(BTN_JOYSTICK + 4), UINPUT_BUTTON(BTN_JOYSTICK + 5),
+	UINPUT_BUTTON(BTN_JOYSTICK + 6), UINPUT_BUTTON(BTN_JOYSTICK + 7), UINPUT_BUTTON(BTN_JOYSTICK + 8),
+	UINPUT_BUTTON(BTN_JOYSTICK + 9), UINPUT_BUTTON(BTN_JOYSTICK + 10), UINPUT_BUTTON(BTN_JOYSTICK + 11),
+	UINPUT_BUTTON(BTN_JOYSTICK + 12), UINPUT_BUTTON(BTN_JOYSTICK + 13), UINPUT_BUTTON(BTN_JOYSTICK + 14),
+	UINPUT_BUTTON(BTN_JOYSTICK + 15),
+	UINPUT_BUTTON(BTN_TRIGGER_HAPPY1 + 0), UINPUT_BUTTON(BTN_TRIGGER_HAPPY1 + 1), UINPUT_BUTTON(BTN_TRIGGER_HAPPY1 + 2),
+	UINPUT_BUTTON(BTN_TRIGGER_HAPPY1 + 3), UINPUT_BUTTON(BTN_TRIGGER_HAPPY1 + 4), UINPUT_BUTTON(BTN_TRIGGER_HAPPY1 + 5),
+	UINPUT_BUTTON(BTN_TRIGGER_HAPPY1 + 6), UINPUT_BUTTON(BTN_TRIGGER_HAPPY1 + 7), UINPUT_BUTTON(BTN_TRIGGER_HAPPY1 + 8),
+	UINPUT_BUTTON(BTN_TRIGGER_HAPPY1 + 9), UINPUT_BUTTON(BTN_TRIGGER_HAPPY1 + 10), UINPUT_BUTTON(BTN_TRIGGER_HAPPY1 + 11),
+	UINPUT_BUTTON(BTN_TRIGGER_HAPPY1 + 12), UINPUT_BUTTON(BTN_TRIGGER_HAPPY1 + 13), UINPUT_BUTTON(BTN_TRIGGER_HAPPY1 + 14),
+	UINPUT_BUTTON(BTN_TRIGGER_HAPPY1 + 15),
+};
+
+// As xpad reports an Xbox 360 pad. Buttons in g_xButtons order, without the dpad.
+const UinputControl g_xboxControls[] = {
+	UINPUT_AXIS(ABS_X, -32768, 32767), UINPUT_AXIS(ABS_Y, -32768, 32767),
+	UINPUT_AXIS(ABS_RX, -32768, 32767), UINPUT_AXIS(ABS_RY, -32768, 32767),
+	UINPUT_AXIS(ABS_Z, 0, 255), UINPUT_AXIS(ABS_RZ, 0, 255),
+	UINPUT_HAT(0),
+	UINPUT_BUTTON(BTN_A), UINPUT_BUTTON(BTN_B), UINPUT_BUTTON(BTN_X), UINPUT_BUTTON(BTN_Y),
+	UINPUT_BUTTON(BTN_TL), UINPUT_BUTTON(BTN_TR), UINPUT_BUTTON(BTN_SELECT), UINPUT_BUTTON(BTN_START),
+	UINPUT_BUTTON(BTN_MODE), UINPUT_BUTTON(BTN_THUMBL), UINPUT_BUTTON(BTN_THUMBR),
+};
+
+// As hid-playstation reports a DualShock 4. Buttons in g_ds4Buttons order, without the dpad and the touchpad.
+const UinputControl g_ds4Controls[] = {
+	UINPUT_AXIS(ABS_X, 0, 255), UINPUT_AXIS(ABS_Y, 0, 255), UINPUT_AXIS(ABS_RX, 0, 255), UINPUT_AXIS(ABS_RY, 0, 255),
+	UINPUT_AXIS(ABS_Z, 0, 255), UINPUT_AXIS(ABS_RZ, 0, 255),
+	UINPUT_HAT(0),
+	UINPUT_BUTTON(BTN_SOUTH), UINPUT_BUTTON(BTN_EAST), UINPUT_BUTTON(BTN_WEST), UINPUT_BUTTON(BTN_NORTH),
+	UINPUT_BUTTON(BTN_TL), UINPUT_BUTTON(BTN_TR), UINPUT_BUTTON(BTN_SELECT), UINPUT_BUTTON(BTN_START),
+	UINPUT_BUTTON(BTN_MODE), UINPUT_BUTTON(BTN_THUMBL), UINPUT_BUTTON(BTN_THUMBR),
+	UINPUT_BUTTON(BTN_TL2), UINPUT_BUTTON(BTN_TR2),
+};
+
+const UinputLayout g_vJoyLayout = { "vJoy Device", g_vJoyControls, _countof(g_vJoyControls) };
+const UinputLayout g_xboxLayout = { "Microsoft X-Box 360 pad", g_xboxControls, _countof(g_xboxControls) };
+const UinputLayout g_ds4Layout = { "Sony Computer Entertainment Wireless Controller", g_ds4Controls, _countof(g_ds4Controls) };
+
+const UinputLayout & Uinput_Layout(DevType type)
+{
+	switch (type) {
+		case DevType::vJoy:
+			return g_vJoyLayout;
+		case DevType::vgeDS4:
+			return g_ds4Layout;
+		default:
+			return g_xboxLayout;
+	}
+}
+
+// Hat X and Y of the 8 directions, clockwise from north
+const LONG g_hatX[8] = { 0, 1, 1, 1, 0, -1, -1, -1 };
+const LONG g_hatY[8] = { -1, -1, 0, 1, 1, 1, 0, -1 };
+
+void Uinput_Hat(int direction, LONG * values)
+{
+	values[0] = direction < 0 ? 0 : g_hatX[direction];
+	values[1] = direction < 0 ? 0 : g_hatY[direction];
+}
+
+// Values of the layout's controls, in layout order, for the device's report
+void Uinput_State(const DEVICE & dev, LONG * values)
+{
+	switch (dev.Type) {
+		case DevType::vJoy: {
+			const JOYSTICK_POSITION_V2 & pos = *dev.PPosition.vJoyPos;
+			const LONG axes[] = {
+				pos.wAxisX, pos.wAxisY, pos.wAxisZ, pos.wAxisXRot, pos.wAxisYRot, pos.wAxisZRot, pos.wSlider, pos.wDial,
+			};
+			memcpy(values, axes, sizeof(axes));
+			values += _countof(axes);
+
+			const DWORD hats[] = { pos.bHats, pos.bHatsEx1, pos.bHatsEx2, pos.bHatsEx3 };
+			for (DWORD hat : hats) {
+				Uinput_Hat(hat > 35999 ? -1 : (int)((hat + 2250) / 4500 % 8), values);
+				values += 2;
+			}
+
+			for (UINT i = 0; i < UINPUT_VJOY_BUTTONS; ++i)
+				*values++ = (pos.lButtons >> i) & 1;
+			break;
+		}
+
+		case DevType::vXbox:
+		case DevType::vgeXbox: {
+			const XINPUT_GAMEPAD & pos = *dev.PPosition.vXboxPos;
+			// XInput Y axes point up, evdev ones down; inverted the way xpad does it
+			*values++ = pos.sThumbLX;
+			*values++ = (SHORT)~pos.sThumbLY;
+			*values++ = pos.sThumbRX;
+			*values++ = (SHORT)~pos.sThumbRY;
+			*values++ = pos.bLeftTrigger;
+			*values++ = pos.bRightTrigger;
+			*values++ = !!(pos.wButtons & XBTN_DPAD_RIGHT) - !!(pos.wButtons & XBTN_DPAD_LEFT);
+			*values++ = !!(pos.wButtons & XBTN_DPAD_DOWN) - !!(pos.wButtons & XBTN_DPAD_UP);
+			for (UINT i = 0; i < g_xboxLayout.Count - 8; ++i)
+				*values++ = !!(pos.wButtons & g_xButtons[i]);
+			break;
+		}
+
+		case DevType::vgeDS4: {
+			const DS4_REPORT & pos = *dev.PPosition.ds4Pos;
+			*values++ = pos.bThumbLX;
+			*values++ = pos.bThumbLY;
+			*values++ = pos.bThumbRX;
+			*values++ = pos.bThumbRY;
+			*values++ = pos.bTriggerL;
+			*values++ = pos.bTriggerR;
+			const UINT dpad = pos.wButtons & 0xF;
+			Uinput_Hat(dpad < 8 ? (int)dpad : -1, values);
+			values += 2;
+			for (UINT i = 0; i < 11; ++i)  // Cross to R3
+				*values++ = (g_ds4Buttons[i] & DS4_SPECIAL_BUTTON_FLAG) ?
+					!!(pos.bSpecial & g_ds4Buttons[i]) : !!(pos.wButtons & g_ds4Buttons[i]);
+			*values++ = !!(pos.wButtons & DS4_BUTTON_TRIGGER_LEFT);
+			*values++ = !!(pos.wButtons & DS4_BUTTON_TRIGGER_RIGHT);
+			break;
+		}
+
+		default:
+			break;
+	}
+}
+
+// Where the events of a commit go. One instance per backend; a slot is only used by one thread at a time.
+class UinputSink
+{
+public:
+	virtual ~UinputSink() {}
+
+	// STATUS_SUCCESS if devices can be created
+	virtual DWORD Status() = 0;
+	virtual DWORD Create(UINT slot, const UinputLayout & layout, const DEVICE & dev) = 0;
+	virtual void Destroy(UINT slot) = 0;
+	// Writes a whole commit, ending with SYN_REPORT, at once
+	virtual DWORD Write(UINT slot, const UinputEvent * events, UINT count) = 0;
+};
+
+#ifdef __linux__
+class UinputDeviceSink : public UinputSink
+{
+public:
+	DWORD Status() override
+	{
+		return access("/dev/uinput", W_OK) ? Uinput_Errno(errno) : STATUS_SUCCESS;
+	}
+
+	DWORD Create(UINT slot, const UinputLayout & layout, const DEVICE & dev) override
+	{
+		const int fd = open("/dev/uinput", O_WRONLY | O_NONBLOCK | O_CLOEXEC);
+		if (fd < 0)
+			return Uinput_Errno(errno);
+
+		bool ok = !ioctl(fd, UI_SET_EVBIT, EV_KEY) && !ioctl(fd, UI_SET_EVBIT, EV_ABS);
+		for (UINT i = 0; ok && i < layout.Count; ++i) {
+			const UinputControl & control = layout.Controls[i];
+			if (control.Type == EV_KEY) {
+				ok = !ioctl(fd, UI_SET_KEYBIT, control.Code);
+				continue;
+			}
+
+			uinput_abs_setup abs = {};
+			abs.code = control.Code;
+			abs.absinfo.minimum = control.Min;
+			abs.absinfo.maximum = control.Max;
+			ok = !ioctl(fd, UI_SET_ABSBIT, control.Code) && !ioctl(fd, UI_ABS_SETUP, &abs);
+		}
+
+		uinput_setup setup = {};
+		setup.id.bustype = BUS_USB;
+		setup.id.vendor = dev.DevInfo.VendId;
+		setup.id.product = dev.DevInfo.ProdId;
+		setup.id.version = 1;
+		snprintf(setup.name, sizeof(setup.name), "%s", layout.Name);
+		ok = ok && !ioctl(fd, UI_DEV_SETUP, &setup) && !ioctl(fd, UI_DEV_CREATE);
+
+		if (!ok) {
+			const DWORD res = Uinput_Errno(errno);
+			close(fd);
+			return res;
+		}
+		m_fds[slot] = fd;
+		return STATUS_SUCCESS;
+	}
+
+	void Destroy(UINT slot) override
+	{
+		if (m_fds[slot] < 0)
+			return;
+		ioctl(m_fds[slot], UI_DEV_DESTROY);
+		close(m_fds[slot]);
+		m_fds[slot] = -1;
+	}
+
+	DWORD Write(UINT slot, const UinputEvent * events, UINT count) override
+	{
+		// The kernel stamps the events, the time member is ignored
+		input_event batch[UINPUT_MAX_CONTROLS + 1] = {};
+		for (UINT i = 0; i < count; ++i) {
+			batch[i].type = events[i].Type;
+			batch[i].code = events[i].Code;
+			batch[i].value = events[i].Value;
+		}
+
+		const ssize_t size = (ssize_t)(count * sizeof(input_event));
+		const ssize_t written = write(m_fds[slot], batch, size);
+		if (written == size)
+			return STATUS_SUCCESS;
+		return written < 0 ? Uinput_Errno(errno) : STATUS_IO_DEVICE_ERROR;
+	}
+
+private:
+	static DWORD Uinput_Errno(int err)
+	{
+		switch (err) {
+			case ENOENT:
+			case ENODEV:
+				return STATUS_NO_SUCH_DEVICE;
+			case EACCES:
+			case EPERM:
+				return STATUS_ACCESS_DENIED;
+			case EAGAIN:
+				return STATUS_DEVICE_BUSY;
+			default:
+				return STATUS_IO_DEVICE_ERROR;
+		}
+	}
+
+	int m_fds[UINPUT_SLOTS] = { -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+								-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 };
+};
+#endif // __linux__
+
+// Keeps the last UINPUT_MEMORY_EVENTS events of every device for GetUinputEvents()
+class UinputMemorySink : public UinputSink
+{
+public:
+	DWORD Status() override
+	{
+		return STATUS_SUCCESS;
+	}
+
+	DWORD Create(UINT slot, const UinputLayout &, const DEVICE &) override
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		m_events[slot].clear();
+		return STATUS_SUCCESS;
+	}
+
+	void Destroy(UINT) override
+	{
+	}
+
+	DWORD Write(UINT slot, const UinputEvent * events, UINT count) override
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		std::deque<UinputEvent> & queue = m_events[slot];
+		queue.insert(queue.end(), events, events + count);
+		if (queue.size() > UINPUT_MEMORY_EVENTS)
+			queue.erase(queue.begin(), queue.begin() + (queue.size() - UINPUT_MEMORY_EVENTS));
+		return STATUS_SUCCESS;
+	}
+
+	UINT Read(UINT slot, UinputEvent * events, UINT count)
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		std::deque<UinputEvent> & queue = m_events[slot];
+		const UINT read = (UINT)std::min<size_t>(count, queue.size());
+		std::copy(queue.begin(), queue.begin() + read, events);
+		queue.erase(queue.begin(), queue.begin() + read);
+		return read;
+	}
+
+private:
+	std::mutex m_lock;
+	std::deque<UinputEvent> m_events[UINPUT_SLOTS];  // under m_lock
+};
+
+struct UinputSlot
+{
+	std::mutex Lock;
+	bool Plugged = false;         // under Lock, as all below
+	PDEVICE Device = nullptr;     // Device plugged in here, valid until Release()
+	LONG Sent[UINPUT_MAX_CONTROLS] = {};  // Control values of the last commit
+	union
+	{
+		JOYSTICK_POSITION_V2 vJoy;
+		XINPUT_GAMEPAD xbox;
+		DS4_REPORT ds4;
+	} Report;                     // Report of the last commit, for Read()
+	UinputStats Stats;
+};
+
+class UinputBackend : public DeviceBackend
+{
+public:
+	explicit UinputBackend(UinputSink & sink) : m_sink(sink) {}
+
+	DWORD BusStatus(DevType type) override
+	{
+		if (!Range(type))
+			return STATUS_INVALID_PARAMETER_1;
+		return m_sink.Status();
+	}
+
+	DWORD BusVersion(DevType) override
+	{
+		return 0;
+	}
+
+	VjdStat SlotStatus(DevType type, UINT id) override
+	{
+		UinputSlot * slot = Slot(type, id);
+		if (!slot || m_sink.Status() != STATUS_SUCCESS)
+			return VJD_STAT_MISS;
+		std::lock_guard<std::mutex> lock(slot->Lock);
+		return slot->Plugged ? VJD_STAT_OWN : VJD_STAT_FREE;
+	}
+
+	DWORD Plug(DEVICE & dev) override
+	{
+		UinputSlot * slot = Slot(dev.Type, dev.Id);
+		if (!slot)
+			return STATUS_INVALID_PARAMETER_1;
+		std::lock_guard<std::mutex> lock(slot->Lock);
+		if (slot->Plugged)
+			return STATUS_DEVICE_ALREADY_ATTACHED;
+
+		dev.DevInfo = DeviceInfo();
+		dev.DevInfo.Serial = dev.Id;
+		switch (dev.Type) {
+			case DevType::vJoy:
+				dev.DevInfo.VendId = 0x1234;
+				dev.DevInfo.ProdId = 0xBEAD;
+				dev.Caps.Axes = 0xFF;  // X to SL1
+				dev.Caps.Buttons = UINPUT_VJOY_BUTTONS;
+				dev.Caps.DiscPovs = 0;
+				dev.Caps.ContPovs = 4;
+				break;
+
+			case DevType::vXbox:
+			case DevType::vgeXbox:
+				dev.DevInfo.VendId = 0x045E;
+				dev.DevInfo.ProdId = 0x028E;
+				dev.DevInfo.LedNumber = (BYTE)dev.Id;
+				break;
+
+			case DevType::vgeDS4:
+				dev.DevInfo.VendId = 0x054C;
+				dev.DevInfo.ProdId = 0x05C4;
+				break;
+
+			default:
+				break;
+		}
+
+		const UinputLayout & layout = Uinput_Layout(dev.Type);
+		const DWORD res = m_sink.Create(Index(slot), layout, dev);
+		if (res != STATUS_SUCCESS)
+			return res;
+
+		// The kernel starts every control at 0; send the device's actual state as the first commit
+		memset(slot->Sent, 0, sizeof(slot->Sent));
+		slot->Plugged = true;
+		slot->Device = &dev;
+		slot->Stats = UinputStats();
+		Commit_Locked(*slot, dev);
+		return STATUS_SUCCESS;
+	}
+
+	DWORD Unplug(DEVICE & dev) override
+	{
+		UinputSlot * slot = Slot(dev.Type, dev.Id);
+		if (!slot)
+			return STATUS_RESOURCE_NOT_OWNED;
+		std::lock_guard<std::mutex> lock(slot->Lock);
+		if (!slot->Plugged || slot->Device != &dev)
+			return STATUS_RESOURCE_NOT_OWNED;
+
+		Unplug_Locked(*slot);
+		return STATUS_SUCCESS;
+	}
+
+	DWORD Submit(DEVICE & dev, const DEVICE & report) override
+	{
+		UinputSlot * slot = Slot(dev.Type, dev.Id);
+		if (!slot)
+			return STATUS_DEVICE_NOT_CONNECTED;
+		std::lock_guard<std::mutex> lock(slot->Lock);
+		if (!slot->Plugged || slot->Device != &dev)
+			return STATUS_DEVICE_NOT_CONNECTED;
+		return Commit_Locked(*slot, report);
+	}
+
+	DWORD Read(const DEVICE & dev, PVOID report) override
+	{
+		UinputSlot * slot = Slot(dev.Type, dev.Id);
+		if (!slot)
+			return STATUS_DEVICE_NOT_CONNECTED;
+		std::lock_guard<std::mutex> lock(slot->Lock);
+		if (!slot->Plugged || slot->Device != &dev)
+			return STATUS_DEVICE_NOT_CONNECTED;
+
+		memcpy(report, &slot->Report, GetDevicePosSize(dev));
+		return STATUS_SUCCESS;
+	}
+
+	void Release(DEVICE & dev) override
+	{
+		UinputSlot * slot = Slot(dev.Type, dev.Id);
+		if (!slot)
+			return;
+		std::lock_guard<std::mutex> lock(slot->Lock);
+		if (slot->Device == &dev)
+			Unplug_Locked(*slot);
+	}
+
+	void GetStats(UinputStats & stats)
+	{
+		stats = UinputStats();
+		for (UinputSlot & slot : m_slots) {
+			std::lock_guard<std::mutex> lock(slot.Lock);
+			stats.Commits += slot.Stats.Commits;
+			stats.Events += slot.Stats.Events;
+			stats.Unchanged += slot.Stats.Unchanged;
+			stats.Errors += slot.Stats.Errors;
+		}
+	}
+
+	// Index of slot `id` of `type`, -1 if there is none
+	static int Index(DevType type, UINT id)
+	{
+		if (type == DevType::vJoy)
+			return id >= 1 && id <= UINPUT_VJOY_SLOTS ? (int)id - 1 : -1;
+		if (!Range(type) || id < 1 || id > UINPUT_GAMEPAD_SLOTS)
+			return -1;
+		return UINPUT_VJOY_SLOTS + (type / 1000 - 1) * UINPUT_GAMEPAD_SLOTS + id - 1;
+	}
+
+private:
+	static bool Range(DevType type)
+	{
+		return type == DevType::vJoy || type == DevType::vXbox || type == DevType::vgeXbox || type == DevType::vgeDS4;
+	}
+
+	UinputSlot * Slot(DevType type, UINT id)
+	{
+		const int index = Index(type, id);
+		return index < 0 ? nullptr : &m_slots[index];
+	}
+
+	UINT Index(const UinputSlot * slot) const
+	{
+		return (UINT)(slot - m_slots);
+	}
+
+	// Writes the controls that changed since the last commit, and a SYN_REPORT, in one go
+	DWORD Commit_Locked(UinputSlot & slot, const DEVICE & dev)
+	{
+		const UinputLayout & layout = Uinput_Layout(dev.Type);
+		LONG values[UINPUT_MAX_CONTROLS];
+		Uinput_State(dev, values);
+
+		UinputEvent events[UINPUT_MAX_CONTROLS + 1];
+		UINT count = 0;
+		for (UINT i = 0; i < layout.Count; ++i) {
+			if (values[i] == slot.Sent[i])
+				continue;
+			events[count].Type = layout.Controls[i].Type;
+			events[count].Code = layout.Controls[i].Code;
+			events[count].Value = values[i];
+			++count;
+		}
+
+		if (count) {
+			events[count].Type = EV_SYN;
+			events[count].Code = SYN_REPORT;
+			events[count].Value = 0;
+
+			const DWORD res = m_sink.Write(Index(&slot), events, count + 1);
+			if (res != STATUS_SUCCESS) {
+				++slot.Stats.Errors;
+				return res;  // Sent stays as it was, the next commit sends the changes again
+			}
+			memcpy(slot.Sent, values, layout.Count * sizeof(LONG));
+			++slot.Stats.Commits;
+			slot.Stats.Events += count;
+		}
+		else
+			++slot.Stats.Unchanged;
+
+		memcpy(&slot.Report, dev.PPosition.vJoyPos, GetDevicePosSize(dev));
+		return STATUS_SUCCESS;
+	}
+
+	void Unplug_Locked(UinputSlot & slot)
+	{
+		m_sink.Destroy(Index(&slot));
+		slot.Plugged = false;
+		slot.Device = nullptr;
+	}
+
+	UinputSink & m_sink;
+	UinputSlot m_slots[UINPUT_SLOTS];
+};
+
+#ifdef __linux__
+UinputDeviceSink g_uinputDeviceSink;
+UinputBackend g_uinputBackend(g_uinputDeviceSink);
+#endif
+UinputMemorySink g_uinputMemorySink;
+UinputBackend g_uinputMemoryBackend(g_uinputMemorySink);
+
+}  // namespace
+
+#ifdef __linux__
+DeviceBackend * Backend_Uinput(void)
+{
+	return &g_uinputBackend;
+}
+#endif
+
+DeviceBackend * Backend_UinputMemory(void)
+{
+	return &g_uinputMemoryBackend;
+}
+
+DWORD Uinput_GetStats(BackendType backend, UinputStats & stats)
+{
+	switch (backend) {
+#ifdef __linux__
+		case BackendType::BackendUinput:
+			g_uinputBackend.GetStats(stats);
+			return STATUS_SUCCESS;
+#endif
+		case BackendType::BackendUinputMemory:
+			g_uinputMemoryBackend.GetStats(stats);
+			return STATUS_SUCCESS;
+		default:
+			return STATUS_INVALID_PARAMETER_1;
+	}
+}
+
+DWORD Uinput_GetEvents(DevType type, UINT id, UinputEvent * events, UINT count, UINT & read)
+{
+	const int index = UinputBackend::Index(type, id);
+	if (index < 0)
+		return STATUS_INVALID_PARAMETER_2;
+	read = g_uinputMemorySink.Read((UINT)index, events, count);
+	return STATUS_SUCCESS;
+}
@@ -27,6 +27,13 @@ namespace ComTest
             VGEN_DEV_TYPE type = VGEN_DEV_TYPE.vJoy;
             int hDev=0;
 
+            // ComTest replay <trace file> [speed]
+            if (args.Length >= 2 && args[0] == "replay")
+            {
+                Replay(args[1], args.Length >= 3 ? Convert.ToSingle(args[2]) : 1.0f);
+                return;
+            }
+
             joystick = new vGen();
 
             // Print device' status
@@ -104,6 +111,34 @@ namespace ComTest
 
         }
 
+        // Replays a trace recorded with vGen.StartTrace() and prints throughput and latencies
+        static void Replay(string file, float speed)
+        {
+            vGen.ReplayStats stats;
+            VJRESULT res = vGen.ReplayTrace(file, speed, out stats);
+            if (res != VJRESULT.SUCCESS)
+            {
+                Console.WriteLine("Replay failed: " + res.ToString());
+                return;
+            }
+
+            double seconds = stats.ElapsedNs / 1e9;
+            Console.WriteLine("Calls: {0}  Errors: {1}  Mismatches: {2}  Skipped: {3}  Dropped: {4}",
+                stats.Calls, stats.Errors, stats.Mismatches, stats.Skipped, stats.Dropped);
+            Console.WriteLine("Time: {0:F3}s  Throughput: {1:F0} calls/s", seconds, seconds > 0 ? stats.Calls / seconds : 0);
+            if (stats.Lag.Count > 0)
+                Console.WriteLine("Lag (ns)           p50 {0,9}  p99 {1,9}  max {2,9}",
+                    vGen.PerfPercentile(stats.Lag, 50), vGen.PerfPercentile(stats.Lag, 99), stats.Lag.MaxNs);
+            for (int i = 0; i < (int)vGen.PerfApi.Count; i++)
+            {
+                vGen.PerfHistogram h = stats.Latency[i];
+                if (h.Count == 0)
+                    continue;
+                Console.WriteLine("{0,-18} p50 {1,9}  p99 {2,9}  max {3,9}  ({4} calls)", ((vGen.PerfApi)i).ToString(),
+                    vGen.PerfPercentile(h, 50), vGen.PerfPercentile(h, 99), h.MaxNs, h.Count);
+            }
+        }
+
         static void dev_stat()
         {
             bool Free=false, Owned=false, Exist=false;
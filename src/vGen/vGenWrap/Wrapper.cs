@@ -1,4 +1,5 @@
 ﻿using System;
+using System.Collections.Generic;
 using System.Runtime.CompilerServices;
 using System.Runtime.InteropServices;
 
@@ -169,6 +170,122 @@ public enum DPOV_DIRECTION : short
     DPOV_NorthWest,
 };
 
+public enum AxisEasing : byte
+{
+    EaseLinear = 0,
+    EaseInQuad,
+    EaseOutQuad,
+    EaseInOutQuad,
+    EaseInCubic,
+    EaseOutCubic,
+    EaseInOutCubic,
+};
+
+[StructLayout(LayoutKind.Sequential)]
+public struct AxisSpring
+{
+    public float Stiffness;        // 1/s^2, 0 removes the model
+    public float Damping;          // 1/s
+    public Int32 Center;           // vJoy range
+    public float DetentStiffness;  // 1/s^2
+    public Int32 DetentWidth;
+    public UInt32 DetentCount;     // Up to 4
+    [MarshalAs(UnmanagedType.ByValArray, SizeConst = 4)]
+    public Int32[] Detents;
+};
+
+public enum MacroOp : byte
+{
+    MacroEnd = 0,
+    MacroButton,   // Arg16: button, Arg8: 1 press, 0 release
+    MacroAxis,     // Arg16: axis, Arg32: value
+    MacroRamp,     // Arg16: axis, Arg8: AxisEasing, Arg32: target | duration ms << 16
+    MacroDiscPov,  // Arg8: POV, Arg32: DPOV_DIRECTION
+    MacroContPov,  // Arg8: POV, Arg32: 0-35999 or -1
+    MacroWait,     // Arg32: ms
+    MacroLoop,     // Arg16: first instruction of the body, Arg32: times in all, 0 forever
+};
+
+[StructLayout(LayoutKind.Sequential)]
+public struct MacroInstr
+{
+    public MacroOp Op;
+    public byte Arg8;
+    public UInt16 Arg16;
+    public Int32 Arg32;
+};
+
+public enum RouteKind : byte
+{
+    RouteAxis = 0,  // Index: HID_USAGES, values 0-0x7FFF
+    RouteButton,    // Index: button number, values 1 or 0
+    RoutePov,       // Index: POV number, values 0-35999 or -1
+};
+
+public enum RouteTransform : byte
+{
+    RouteDirect = 0,
+    RouteInvert,
+    RouteScale,         // value * Scale + Offset
+    RouteThreshold,     // Threshold, Hysteresis
+    RouteButtonToAxis,  // OnValue, OffValue
+    RouteSplitLow,
+    RouteSplitHigh,
+    RouteCombine,       // SrcIndex towards 0, SrcIndex2 towards 0x7FFF
+};
+
+[StructLayout(LayoutKind.Sequential)]
+public struct ControlRoute
+{
+    public Int32 SrcDev;
+    public Int32 DstDev;
+    public UInt32 SrcIndex;
+    public UInt32 SrcIndex2;
+    public UInt32 DstIndex;
+    public RouteKind SrcKind;
+    public RouteKind DstKind;
+    public RouteTransform Transform;
+    public float Scale;
+    public Int32 Offset;
+    public Int32 Threshold;
+    public Int32 Hysteresis;
+    public Int32 OnValue;
+    public Int32 OffValue;
+};
+
+public enum PassthroughMerge : byte
+{
+    MergeMax = 0,      // Axes from the side furthest from rest
+    MergePadFirst,
+    MergeFeederFirst,
+};
+
+[StructLayout(LayoutKind.Sequential)]
+public struct PassthroughConfig
+{
+    public UInt32 Slot;            // XInput user index, 0-3
+    public PassthroughMerge Merge;
+    public Int32 Deadzone;         // vJoy range
+};
+
+[StructLayout(LayoutKind.Sequential)]
+public struct PadPollConfig
+{
+    public UInt32 IntervalUs;      // 1000-100000, 4000 by default
+    public UInt32 EmptyProbeMs;    // 16-60000, 1000 by default
+};
+
+[StructLayout(LayoutKind.Sequential)]
+public struct PadPollStats
+{
+    public UInt64 Polls;
+    public UInt64 Reads;
+    public UInt64 Probes;
+    public UInt64 Skipped;
+    public UInt64 Served;          // GetXInputState() calls
+    public byte Connected;         // Bit per slot
+};
+
 public enum VJDSTATUS : short
 {
     VJD_STAT_OWN,	// The  vJoy Device is owned by this application.
@@ -280,6 +397,8 @@ namespace vGenInterfaceWrap
 
         private static FfbCbFunc UserFfbCB;
         private static WrapFfbCbFunc wf;
+        private static FfbForceCbFunc ffbForceCB;
+        private static Dictionary<UInt32, FfbPacketCbFunc> ffbSubscribers = new Dictionary<UInt32, FfbPacketCbFunc>();
         private static GCHandle hFfbUserData;
 
         [StructLayout(LayoutKind.Sequential)]
@@ -292,6 +411,132 @@ namespace vGenInterfaceWrap
             public byte LedNumber;  // XBox
         };
 
+        [Flags]
+        public enum FeedbackFlags : byte
+        {
+            None     = 0,
+            Rumble   = 0x01,  // LargeMotor and SmallMotor
+            Led      = 0x02,  // LedNumber (XBox)
+            Lightbar = 0x04,  // ColorBar (DS4)
+            Flash    = 0x08,  // FlashOn and FlashOff (DS4)
+            Bridged  = 0x10,  // With Rumble: the motors come from the FFB rumble bridge, not the host
+        };
+
+        [StructLayout(LayoutKind.Sequential)]
+        public struct FeedbackData
+        {
+            public UInt32 Sequence;  // Running record number, gaps indicate dropped records
+            public UInt32 ColorBar;  // DS4 lightbar color as 0xFFRRGGBB
+            public byte LargeMotor;
+            public byte SmallMotor;
+            public byte LedNumber;   // XBox
+            public FeedbackFlags Flags;
+            public byte FlashOn;     // DS4 lightbar flash on time, 10ms units
+            public byte FlashOff;    // DS4 lightbar flash off time, 10ms units
+        };
+
+        // Exports covered by GetPerfStats(). SetDevPovDeg() is counted as SetDevPov().
+        public enum PerfApi : uint
+        {
+            SetDevButton = 0,
+            SetDevAxis,
+            SetDevAxisPct,
+            SetDevDiscPov,
+            SetDevContPov,
+            SetDevPov,
+            GetPosition,
+            AcquireDev,
+            RelinquishDev,
+            ResetDevPositions,
+            Count
+        };
+
+        public const int PERF_HIST_BUCKETS = 108;
+
+        // Log-linear latency histogram, see vGenInterface.h for the bucket boundaries
+        [StructLayout(LayoutKind.Sequential)]
+        public struct PerfHistogram
+        {
+            public UInt64 Count;
+            public UInt64 TotalNs;
+            public UInt64 MaxNs;
+            [MarshalAs(UnmanagedType.ByValArray, SizeConst = PERF_HIST_BUCKETS)]
+            public UInt64[] Buckets;
+        };
+
+        [StructLayout(LayoutKind.Sequential)]
+        public struct PerfApiStats
+        {
+            public UInt64 Calls;
+            public UInt64 Errors;        // Calls that did not return success
+            public PerfHistogram Own;    // Time spent in vGen itself
+            public PerfHistogram Driver; // Time spent in driver calls
+        };
+
+        [StructLayout(LayoutKind.Sequential)]
+        public struct PerfStats
+        {
+            public UInt64 ElapsedNs;     // Time since the statistics were (re)enabled
+            [MarshalAs(UnmanagedType.ByValArray, SizeConst = (int)PerfApi.Count)]
+            public PerfApiStats[] Api;
+        };
+
+        [StructLayout(LayoutKind.Sequential)]
+        public struct ReplayStats
+        {
+            public UInt64 Calls;
+            public UInt64 Errors;
+            public UInt64 Mismatches;    // Calls that returned something else than during recording
+            public UInt64 Skipped;       // Calls on devices the trace did not acquire
+            public UInt64 Dropped;       // Calls the recorder had lost
+            public UInt64 ElapsedNs;
+            public PerfHistogram Lag;    // How late calls were issued against the schedule
+            [MarshalAs(UnmanagedType.ByValArray, SizeConst = (int)PerfApi.Count)]
+            public PerfHistogram[] Latency;
+        };
+
+        public enum SchedulerPriority : byte
+        {
+            SchedulerNormal = 0,
+            SchedulerAboveNormal,
+            SchedulerHigh,
+            SchedulerRealtime,
+        };
+
+        [StructLayout(LayoutKind.Sequential)]
+        public struct SchedulerConfig
+        {
+            public SchedulerPriority Priority;
+            public UInt64 Affinity;      // CPU mask, 0 for any
+        };
+
+        [StructLayout(LayoutKind.Sequential)]
+        public struct SchedulerStats
+        {
+            public UInt64 Wakes;         // Wakes for a deadline
+            public UInt64 Early;         // Wakes for a new timer or setting
+            public UInt64 Fired;
+            public UInt32 Pending;
+            public Int32 Running;
+            public UInt32 ConfigStatus;
+            public PerfHistogram Lateness; // Wake time minus deadline
+        };
+
+        // Value of percentile p (0-100) in a histogram, as the lower bound of its bucket in ns
+        public static UInt64 PerfPercentile(PerfHistogram Hist, double p)
+        {
+            if (Hist.Count == 0)
+                return 0;
+            UInt64 rank = (UInt64)Math.Ceiling(Hist.Count * p / 100.0), seen = 0;
+            for (int b = 0; b < PERF_HIST_BUCKETS; b++)
+            {
+                seen += Hist.Buckets[b];
+                if (seen >= rank && seen > 0)
+                    return b < 4 ? (UInt64)b * 16 : (UInt64)(4 + (b - 4) % 4) << ((b - 4) / 4 + 4);
+            }
+            return Hist.MaxNs;
+        }
+
         [StructLayout(LayoutKind.Sequential)]
         public struct JoystickState
         {
@@ -501,6 +746,42 @@ namespace vGenInterfaceWrap
             public Int16 End;               // The Normalized magnitude at the end of the effect
         }
 
+        // Decoded FFB packet (FfbReadPackets). Type selects the valid effect member.
+        [StructLayout(LayoutKind.Explicit)]
+        public struct FFB_PACKET
+        {
+            [FieldOffset(0)]
+            public UInt32 Sequence; // Running packet number, gaps indicate dropped packets
+            [FieldOffset(4)]
+            public UInt32 DeviceID;
+            [FieldOffset(8)]
+            public FFBPType Type;
+            [FieldOffset(12)]
+            public Byte EffectBlockIndex;
+            [FieldOffset(16)]
+            public FFB_EFF_REPORT Report;       // PT_EFFREP
+            [FieldOffset(16)]
+            public FFB_EFF_ENVLP Envelope;      // PT_ENVREP
+            [FieldOffset(16)]
+            public FFB_EFF_COND Condition;      // PT_CONDREP
+            [FieldOffset(16)]
+            public FFB_EFF_PERIOD Period;       // PT_PRIDREP
+            [FieldOffset(16)]
+            public FFB_EFF_CONSTANT Constant;   // PT_CONSTREP
+            [FieldOffset(16)]
+            public FFB_EFF_RAMP Ramp;           // PT_RAMPREP
+            [FieldOffset(16)]
+            public FFB_EFF_OP Operation;        // PT_EFOPREP
+            [FieldOffset(16)]
+            public FFB_CTRL Control;            // PT_CTRLREP
+            [FieldOffset(16)]
+            public Byte Gain;                   // PT_GAINREP
+            [FieldOffset(16)]
+            public FFBEType NewEffect;          // PT_NEWEFREP
+            [FieldOffset(44)]
+            private UInt32 _pad;                // sizeof(FFB_EFF_COND)
+        }
+
         [StructLayout(LayoutKind.Sequential)]
         public struct XINPUT_VIBRATION
         {
@@ -702,6 +983,31 @@ namespace vGenInterfaceWrap
          [DllImport("vGenInterface.dll", EntryPoint = "Ffb_h_Eff_Constant")]
          private static extern UInt32 _Ffb_h_Eff_Constant(IntPtr Packet, ref FFB_EFF_CONSTANT ConstantEffect);
 
+        [DllImport("vGenInterface.dll", EntryPoint = "FfbReadPackets", CallingConvention = CallingConvention.Cdecl)]
+        private static extern UInt32 _FfbReadPackets([Out] FFB_PACKET[] Packets, UInt32 Count, ref UInt32 Read, UInt32 Timeout);
+
+        public delegate void FfbPacketCbFunc(ref FFB_PACKET Packet, IntPtr userData);
+
+        [DllImport("vGenInterface.dll", EntryPoint = "FfbSubscribe", CallingConvention = CallingConvention.Cdecl)]
+        private static extern UInt32 _FfbSubscribe(UInt32 rID, UInt32 TypeMask, FfbPacketCbFunc cb, IntPtr data, ref UInt32 Subscription);
+
+        [DllImport("vGenInterface.dll", EntryPoint = "FfbUnsubscribe", CallingConvention = CallingConvention.Cdecl)]
+        private static extern UInt32 _FfbUnsubscribe(UInt32 Subscription);
+
+        public delegate void FfbForceCbFunc(UInt32 rID, Int32 ForceX, Int32 ForceY, IntPtr userData);
+
+        [DllImport("vGenInterface.dll", EntryPoint = "FfbRegisterForceCB", CallingConvention = CallingConvention.Cdecl)]
+        private static extern void _FfbRegisterForceCB(FfbForceCbFunc cb, IntPtr data);
+
+        [DllImport("vGenInterface.dll", EntryPoint = "FfbGetForce", CallingConvention = CallingConvention.Cdecl)]
+        private static extern UInt32 _FfbGetForce(UInt32 rID, ref Int32 ForceX, ref Int32 ForceY);
+
+        [DllImport("vGenInterface.dll", EntryPoint = "FfbSetForceTick", CallingConvention = CallingConvention.Cdecl)]
+        private static extern UInt32 _FfbSetForceTick(UInt32 Period);
+
+        [DllImport("vGenInterface.dll", EntryPoint = "FfbSetRumbleTarget", CallingConvention = CallingConvention.Cdecl)]
+        private static extern UInt32 _FfbSetRumbleTarget(UInt32 rID, Int32 hDev);
+
         #endregion Force Feedback (FFB)
 
         #endregion Backward compatibility API (vJoy)
@@ -940,6 +1246,76 @@ namespace vGenInterfaceWrap
         [DllImport("vGenInterface.dll")]
         public static extern VJRESULT ResetDevPositions(Int32 hDev);
 
+        [DllImport("vGenInterface.dll")]
+        public static extern VJRESULT PulseDevButton(Int32 hDev, UInt32 Button, UInt32 DurationMs);
+
+        [DllImport("vGenInterface.dll")]
+        public static extern VJRESULT PulseDevDiscPov(Int32 hDev, byte nPov, DPOV_DIRECTION Value, UInt32 DurationMs);
+
+        [DllImport("vGenInterface.dll")]
+        public static extern VJRESULT SetDevButtonTurbo(Int32 hDev, UInt32 Button, float Hz, UInt32 DutyPct);
+
+        [DllImport("vGenInterface.dll")]
+        public static extern VJRESULT AnimateDevAxis(Int32 hDev, HID_USAGES Axis, Int32 Target, UInt32 DurationMs, AxisEasing Easing);
+
+        [DllImport("vGenInterface.dll")]
+        public static extern VJRESULT StopDevAxisAnimation(Int32 hDev, HID_USAGES Axis);
+
+        [DllImport("vGenInterface.dll")]
+        public static extern VJRESULT SetDevAxisSpring(Int32 hDev, HID_USAGES Axis, ref AxisSpring Spring);
+
+        [DllImport("vGenInterface.dll")]
+        public static extern VJRESULT ReleaseDevAxis(Int32 hDev, HID_USAGES Axis);
+
+        [DllImport("vGenInterface.dll")]
+        public static extern VJRESULT LoadMacro(MacroInstr[] Program, UInt32 Count, out UInt32 MacroId);
+
+        [DllImport("vGenInterface.dll")]
+        public static extern VJRESULT UnloadMacro(UInt32 MacroId);
+
+        [DllImport("vGenInterface.dll")]
+        public static extern VJRESULT RunMacro(Int32 hDev, UInt32 MacroId);
+
+        [DllImport("vGenInterface.dll")]
+        public static extern VJRESULT StopMacro(Int32 hDev, UInt32 MacroId);
+
+        [DllImport("vGenInterface.dll")]
+        public static extern VJRESULT LinkDevMirror(Int32 Source, Int32 Target);
+
+        [DllImport("vGenInterface.dll")]
+        public static extern VJRESULT UnlinkDevMirror(Int32 Source, Int32 Target);
+
+        [DllImport("vGenInterface.dll")]
+        public static extern VJRESULT SetControlRoutes(ControlRoute[] Routes, UInt32 Count, out UInt32 BadRoute);
+
+        [DllImport("vGenInterface.dll")]
+        public static extern VJRESULT SetDevPassthrough(Int32 hDev, ref PassthroughConfig Config);
+
+        // IntPtr.Zero stops the passthrough
+        [DllImport("vGenInterface.dll")]
+        public static extern VJRESULT SetDevPassthrough(Int32 hDev, IntPtr Config);
+
+        [DllImport("vGenInterface.dll")]
+        public static extern VJRESULT SetPadPollConfig(ref PadPollConfig Config);
+
+        [DllImport("vGenInterface.dll")]
+        public static extern VJRESULT GetPadPollStats(out PadPollStats Stats, Boolean Reset);
+
+        [DllImport("vGenInterface.dll")]
+        public static extern VJRESULT GetSchedulerTime(out UInt64 TimeUs);
+
+        [DllImport("vGenInterface.dll")]
+        public static extern VJRESULT SetDevAxisAt(Int32 hDev, HID_USAGES Axis, Int32 Value, UInt64 AtUs);
+
+        [DllImport("vGenInterface.dll")]
+        public static extern VJRESULT SetDevButtonAt(Int32 hDev, UInt32 Button, Boolean Press, UInt64 AtUs);
+
+        [DllImport("vGenInterface.dll")]
+        public static extern VJRESULT SetSchedulerConfig(ref SchedulerConfig Config);
+
+        [DllImport("vGenInterface.dll")]
+        public static extern VJRESULT GetSchedulerStats(out SchedulerStats Stats, bool Reset);
+
 
         [DllImport("vGenInterface.dll", EntryPoint = "GetPosition")]
         public static extern VJRESULT GetPosition(Int32 hDev, ref JoystickState pPosition);
@@ -959,6 +1335,26 @@ namespace vGenInterfaceWrap
         [DllImport("vGenInterface.dll")]
         public static extern VJRESULT GetDevInfo(Int32 hDev, ref DeviceInfo DevInfo);
 
+        [DllImport("vGenInterface.dll")]
+        public static extern VJRESULT GetDevFeedback(Int32 hDev, [Out] FeedbackData[] Data, UInt32 Count, ref UInt32 Read, UInt32 Timeout);
+
+        [DllImport("vGenInterface.dll")]
+        public static extern VJRESULT EnablePerfStats(bool Enable);
+
+        [DllImport("vGenInterface.dll")]
+        public static extern VJRESULT GetPerfStats(out PerfStats Stats);
+
+        // Records calls of the exports covered by GetPerfStats() into a binary trace file
+        [DllImport("vGenInterface.dll")]
+        public static extern VJRESULT StartTrace([MarshalAs(UnmanagedType.LPUTF8Str)] string FileName);
+
+        [DllImport("vGenInterface.dll")]
+        public static extern VJRESULT StopTrace();
+
+        // Speed: 1 = recorded timing, 2 = twice as fast, 0 = as fast as possible
+        [DllImport("vGenInterface.dll")]
+        public static extern VJRESULT ReplayTrace([MarshalAs(UnmanagedType.LPUTF8Str)] string FileName, float Speed, out ReplayStats Stats);
+
         #endregion Common API
 
         #region XInput helpers
@@ -1057,6 +1453,30 @@ namespace vGenInterfaceWrap
         public UInt32 Ffb_h_EffNew(IntPtr Packet, ref FFBEType Effect) { return _Ffb_h_EffNew( Packet, ref  Effect); }
         public UInt32 Ffb_h_Eff_Ramp(IntPtr Packet, ref FFB_EFF_RAMP RampEffect) { return _Ffb_h_Eff_Ramp( Packet, ref  RampEffect);}
         public UInt32 Ffb_h_Eff_Constant(IntPtr Packet, ref FFB_EFF_CONSTANT ConstantEffect) { return _Ffb_h_Eff_Constant(Packet, ref  ConstantEffect); }
+        public UInt32 FfbReadPackets(FFB_PACKET[] Packets, ref UInt32 Read, UInt32 Timeout) { return _FfbReadPackets(Packets, (UInt32)Packets.Length, ref Read, Timeout); }
+        // TypeMask: bit (1 << FFBPType) for each wanted packet type, 0 for all. rID 0 for all devices.
+        public UInt32 FfbSubscribe(UInt32 rID, UInt32 TypeMask, FfbPacketCbFunc cb, IntPtr data, ref UInt32 Subscription)
+        {
+            UInt32 res = _FfbSubscribe(rID, TypeMask, cb, data, ref Subscription);
+            if (res == 0)
+                lock (ffbSubscribers) { ffbSubscribers[Subscription] = cb; }  // Keep the delegate alive
+            return res;
+        }
+        public UInt32 FfbUnsubscribe(UInt32 Subscription)
+        {
+            UInt32 res = _FfbUnsubscribe(Subscription);
+            lock (ffbSubscribers) { ffbSubscribers.Remove(Subscription); }
+            return res;
+        }
+        public UInt32 FfbGetForce(UInt32 rID, ref Int32 ForceX, ref Int32 ForceY) { return _FfbGetForce(rID, ref ForceX, ref ForceY); }
+        public UInt32 FfbSetForceTick(UInt32 Period) { return _FfbSetForceTick(Period); }
+        public UInt32 FfbSetRumbleTarget(UInt32 rID, Int32 hDev) { return _FfbSetRumbleTarget(rID, hDev); }
+        public void FfbRegisterForceCB(FfbForceCbFunc cb, IntPtr data)
+        {
+            // Keep the delegate alive while the DLL holds it
+            ffbForceCB = cb;
+            _FfbRegisterForceCB(cb, data);
+        }
 
         #endregion Force Feedback (FFB)
         #endregion Backward compatibility API (vJoy)